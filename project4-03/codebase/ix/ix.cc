@@ -4,10 +4,22 @@
 #include "../rbf/pfm.h"
 #include "../rbf/rbfm.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <cstring>
 #include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Int and real keys sit at the start of entries of the same width in leaves and internal nodes
+static_assert(sizeof(DataEntry) == sizeof(IndexEntry) && sizeof(DataEntry) == 8, "fixed width entries should be 8 bytes");
+
+// Directory pages hold their node type and entry count, then the entries. Bucket pages hold their
+// node type and BucketHeader, then the pairs.
+static const unsigned directoryEntriesOffset = sizeof(NodeType) + sizeof(uint32_t);
+static const unsigned bucketPairsOffset = sizeof(NodeType) + sizeof(BucketHeader);
 
 IndexManager* IndexManager::_index_manager = 0;
 
@@ -20,6 +32,7 @@ IndexManager* IndexManager::instance()
 }
 
 IndexManager::IndexManager()
+: fillFactor(IX_FILL_FACTOR)
 {
 }
 
@@ -27,7 +40,7 @@ IndexManager::~IndexManager()
 {
 }
 
-RC IndexManager::createFile(const string &fileName)
+RC IndexManager::createFile(const string &fileName, const IndexType type)
 {
     PagedFileManager *pfm = PagedFileManager::instance();
 
@@ -44,9 +57,21 @@ RC IndexManager::createFile(const string &fileName)
     if (pageData == NULL)
         return IX_MALLOC_FAILED;
 
+    if (type == IX_INDEX_HASH)
+    {
+        rc = createHashFile(handle, pageData);
+        closeFile(handle);
+        free(pageData);
+        return rc;
+    }
+
     // Initialize the first page with metadata. root page will be page 1
     MetaHeader meta;
     meta.rootPage = 1;
+    meta.freePage = 0;
+    meta.indexType = IX_INDEX_BTREE;
+    meta.globalDepth = 0;
+    meta.directoryPages = 0;
     setMetaData(meta, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -78,6 +103,7 @@ RC IndexManager::createFile(const string &fileName)
     leafHeader.prev            = 0;
     leafHeader.entriesNumber   = 0;
     leafHeader.freeSpaceOffset = PAGE_SIZE;
+    leafHeader.prefixLength    = 0;
     setLeafHeader(leafHeader, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -100,90 +126,173 @@ RC IndexManager::destroyFile(const string &fileName)
     return SUCCESS;
 }
 
-RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle)
+RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle, FileAccessMode mode)
 {
     PagedFileManager *pfm = PagedFileManager::instance();
-    if (pfm->openFile(fileName, ixfileHandle.fh))
+    if (pfm->openFile(fileName, ixfileHandle.fh, mode))
         return IX_OPEN_FAILED;
+    ixfileHandle.latches = acquireLatches(ixfileHandle.fh.getFileId());
+    ixfileHandle.dropResident();
+    ixfileHandle.residentVersion = ixfileHandle.fh.getVersion();
+
+    // createFile opens the file before there is a meta page
+    ixfileHandle.indexType = IX_INDEX_BTREE;
+    if (ixfileHandle.getNumberOfPages() == 0)
+        return SUCCESS;
+    lock_guard<mutex> lock(ixfileHandle.latches->pages);
+    void *metaPage;
+    if (ixfileHandle.pinPage(0, metaPage))
+        return IX_READ_FAILED;
+    ixfileHandle.indexType = (IndexType)getMetaData(metaPage).indexType;
+    ixfileHandle.unpinPage(0, false);
     return SUCCESS;
 }
 
 RC IndexManager::closeFile(IXFileHandle &ixfileHandle)
 {
     PagedFileManager *pfm = PagedFileManager::instance();
+    ixfileHandle.dropResident();
+    releaseLatches(ixfileHandle.latches);
+    ixfileHandle.latches = NULL;
     if (pfm->closeFile(ixfileHandle.fh))
         return IX_CLOSE_FAILED;
     return SUCCESS;
 }
 
+IX_FileLatches *IndexManager::acquireLatches(const FileId fileId)
+{
+    lock_guard<mutex> lock(fileLatchesMutex);
+    IX_FileLatches *&latches = fileLatches[fileId];
+    if (latches == NULL)
+    {
+        latches = new IX_FileLatches();
+        latches->fileId = fileId;
+        latches->handles = 0;
+        // Splits would wait forever behind a steady stream of descents if readers went first
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        pthread_rwlock_init(&latches->tree, &attr);
+        pthread_rwlockattr_destroy(&attr);
+        for (int i = 0; i < IX_LEAF_LATCHES; i++)
+            pthread_rwlock_init(&latches->leaves[i], NULL);
+    }
+    latches->handles++;
+    return latches;
+}
+
+void IndexManager::releaseLatches(IX_FileLatches *latches)
+{
+    if (latches == NULL)
+        return;
+    lock_guard<mutex> lock(fileLatchesMutex);
+    if (--latches->handles > 0)
+        return;
+    fileLatches.erase(latches->fileId);
+    pthread_rwlock_destroy(&latches->tree);
+    for (int i = 0; i < IX_LEAF_LATCHES; i++)
+        pthread_rwlock_destroy(&latches->leaves[i]);
+    delete latches;
+}
+
 RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
+    if (ixfileHandle.indexType == IX_INDEX_HASH)
+    {
+        ixfileHandle.latchTree(true);
+        RC rc = hashInsert(ixfileHandle, attribute, key, rid);
+        ixfileHandle.unlatchTree();
+        return rc;
+    }
+
+    // Most inserts only change their leaf, and share the tree with everyone else
+    ixfileHandle.latchTree(false);
+    RC rc = insertWithinLeaf(ixfileHandle, attribute, key, rid);
+    ixfileHandle.unlatchTree();
+    if (rc != IX_NO_FREE_SPACE)
+        return rc;
+
+    // The leaf has to split, which changes the nodes above it. Go down again with the tree to ourselves.
     ChildEntry childEntry = {.key = NULL, .childPage = 0};
     int32_t rootPage;
-    RC rc = getRootPageNum(ixfileHandle, rootPage);
-    if (rc)
-        return rc;
-    return insert(attribute, key, rid, ixfileHandle, rootPage, childEntry);
+    ixfileHandle.latchTree(true);
+    rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc == SUCCESS)
+        rc = insert(attribute, key, rid, ixfileHandle, rootPage, 0, childEntry);
+    ixfileHandle.unlatchTree();
+    return rc;
 }
 
-RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry)
+RC IndexManager::insertWithinLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    void *pageData = malloc(PAGE_SIZE);
-    if(pageData == NULL)
-        return IX_MALLOC_FAILED;
-    if (fileHandle.readPage(pageID, pageData))
+    int32_t leafPage;
+    RC rc = find(fileHandle, attribute, key, leafPage);
+    if (rc)
+        return rc;
+    void *pageData;
+    fileHandle.latchLeaf(leafPage, true);
+    if (fileHandle.pinPage(leafPage, pageData))
     {
-        free(pageData);
+        fileHandle.unlatchLeaf(leafPage);
         return IX_READ_FAILED;
     }
+    rc = insertIntoLeaf(fileHandle, attribute, key, rid, pageData);
+    if (fileHandle.unpinPage(leafPage, rc == SUCCESS) && rc == SUCCESS)
+        rc = IX_WRITE_FAILED;
+    fileHandle.unlatchLeaf(leafPage);
+    return rc;
+}
 
-    NodeType type = getNodetype(pageData);
+RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, const unsigned level, ChildEntry &childEntry)
+{
+    bool isLeaf;
+    int32_t childPage;
+    if (getChildPage(fileHandle, attribute, key, pageID, level, isLeaf, childPage))
+        return IX_READ_FAILED;
 
-    if (type == IX_TYPE_INTERNAL)
+    void *pageData;
+    if (!isLeaf)
     {
-        int32_t childPage = getNextChildPage(attribute, key, pageData);
-        free (pageData);
         if (childPage == 0)
             return IX_BAD_CHILD;
 
         // Recursively insert
-        RC rc = insert(attribute, key, rid, fileHandle, childPage, childEntry);
+        RC rc = insert(attribute, key, rid, fileHandle, childPage, level + 1, childEntry);
         if (rc)
             return rc;
         if(childEntry.key == NULL)
             return SUCCESS;
         // If we're here, we need to handle a split
-        pageData = malloc(PAGE_SIZE);
-        if (fileHandle.readPage(pageID, pageData))
-        {
-            free(pageData);
+        if (fileHandle.pinPage(pageID, pageData))
             return IX_READ_FAILED;
-        }
+        // Resident copies of this node are out of date from here on
+        fileHandle.treeChanged();
 
         rc = insertIntoInternal(attribute, childEntry, pageData);
         if (rc == SUCCESS)
         {
-            rc = fileHandle.writePage(pageID, pageData);
+            rc = fileHandle.unpinPage(pageID, true);
 
             // If childEntry contains any data, we clear it to defaults
             free (childEntry.key);
             childEntry.key = NULL;
             childEntry.childPage = 0;
-            free(pageData);
-            pageData = NULL;
             // If write succeeded, rc is success, otherwise it's a failure.
             return rc == SUCCESS ? SUCCESS : IX_WRITE_FAILED;
         }
-        else if (IX_NO_FREE_SPACE)
+        else if (rc == IX_NO_FREE_SPACE)
         {
+            // A failed split leaves the page as it was
             rc = splitInternal(fileHandle, attribute, pageID, pageData, childEntry);
-            free(pageData);
-            pageData = NULL;
+            if (fileHandle.unpinPage(pageID, rc == SUCCESS) && rc == SUCCESS)
+                return IX_WRITE_FAILED;
             return rc;
         }
         else // Some other error, probably will not occur
         {
-            free(pageData);
+            fileHandle.unpinPage(pageID, false);
             free(childEntry.key);
             childEntry.key = NULL;
             return IX_INSERT_INTERNAL_FAILED;
@@ -192,12 +301,15 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
     }
     else // This is a leaf node
     {
+        if (fileHandle.pinPage(pageID, pageData))
+            return IX_READ_FAILED;
+
         // Try to insert
-        RC rc = insertIntoLeaf(attribute, key, rid, pageData);
+        RC rc = insertIntoLeaf(fileHandle, attribute, key, rid, pageData);
         if (rc == SUCCESS) // We managed to insert the new pair into this leaf.
         {
             // Write our changes
-            if (fileHandle.writePage(pageID, pageData))
+            if (fileHandle.unpinPage(pageID, true))
                 return IX_WRITE_FAILED;
 
             // If childEntry contains any data, we clear it to defaults
@@ -205,21 +317,19 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
             childEntry.key = NULL;
             childEntry.childPage = 0;
 
-            free(pageData);
-            pageData = NULL;
             return SUCCESS;
         }
         else if (rc == IX_NO_FREE_SPACE) // Leaf is full and needs to be split
         {
+            // A failed split leaves the leaf as it was
             rc = splitLeaf(fileHandle, attribute, key, rid, pageID, pageData, childEntry);
-            free(pageData);
-            pageData = NULL;
+            if (fileHandle.unpinPage(pageID, rc == SUCCESS) && rc == SUCCESS)
+                return IX_WRITE_FAILED;
             return rc;
         }
         else // Some other error, probably will not occur
         {
-            free(pageData);
-            pageData = NULL;
+            fileHandle.unpinPage(pageID, false);
             free(childEntry.key);
             childEntry.key = NULL;
             return IX_INSERT_LEAF_FAILED;
@@ -230,109 +340,162 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
 RC IndexManager::splitLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *ins_key, const RID ins_rid, const int32_t pageID, void *originalLeaf, ChildEntry &childEntry)
 {
     LeafHeader originalHeader = getLeafHeader(originalLeaf);
+    const int entries = originalHeader.entriesNumber;
+    // A key on its own is never split, insertIntoLeaf moves its rids to overflow pages instead
+    if (entries < 1)
+        return IX_NO_FREE_SPACE;
 
-    // Create new leaf to hold overflow
+    // The keys, and the bytes their slots take before the prefix comes off, summed from the left.
+    // The new entry counts as a new key with a rid as long as they get.
+    const bool varchar = attribute.type == TypeVarChar;
+    vector<string> keys(entries);
+    vector<int> sizes(entries + 1, 0);
+    for (int j = 0; j < entries; j++)
+    {
+        keys[j] = getLeafKey(attribute, originalLeaf, j);
+        sizes[j + 1] = sizes[j] + getLeafSlotLength(attribute, originalLeaf, j) + (varchar ? originalHeader.prefixLength : 0);
+    }
+    string insKey((const char*)ins_key, varchar ? getKeyLengthLeaf(attribute, ins_key) - sizeof(DataEntry) : INT_SIZE);
+    const int insSize = getKeyLengthLeaf(attribute, ins_key) + 10;
+
+    // The first s keys stay, the rest move. Keeping all or none of them leaves the new key alone in the
+    // other leaf, which is how two keys too large to share a leaf are split. Of the splits whose halves
+    // fit, the most even one is taken, or one with a shorter separator that is nearly as even.
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    int best = -1;
+    int bestSize = 0;
+    vector<int> largest(entries + 1, capacity + 1);
+    vector<string> separators(entries + 1);
+    vector<unsigned> leftPrefixes(entries + 1, 0);
+    vector<unsigned> rightPrefixes(entries + 1, 0);
+    for (int s = 0; s <= entries; s++)
+    {
+        if ((s == 0 && compareKeys(attribute, insKey.data(), keys[0].data()) >= 0)
+            || (s == entries && compareKeys(attribute, insKey.data(), keys[entries - 1].data()) <= 0))
+            continue;
+        separators[s] = shortestSeparator(attribute, s > 0 ? keys[s - 1] : insKey, s < entries ? keys[s] : insKey);
+        bool left = compareKeys(attribute, insKey.data(), separators[s].data()) <= 0;
+        if (varchar)
+        {
+            leftPrefixes[s] = s > 0 ? commonPrefixLength(keys[0], keys[s - 1]) : 0;
+            rightPrefixes[s] = s < entries ? commonPrefixLength(keys[s], keys[entries - 1]) : 0;
+            // Next to other keys, the new one shortens their prefix
+            if (s > 0 && s < entries)
+            {
+                unsigned &prefix = left ? leftPrefixes[s] : rightPrefixes[s];
+                const string &first = left ? keys[0] : keys[s];
+                const string &last = left ? keys[s - 1] : keys[entries - 1];
+                prefix = min(prefix, min(commonPrefixLength(insKey, first), commonPrefixLength(insKey, last)));
+            }
+        }
+        int leftPrefix = leftPrefixes[s];
+        int rightPrefix = rightPrefixes[s];
+        int leftSize = sizes[s] - (s - 1) * leftPrefix + (left ? insSize - leftPrefix : 0);
+        int rightSize = sizes[entries] - sizes[s] - (entries - s - 1) * rightPrefix + (left ? 0 : insSize - rightPrefix);
+        if (leftSize > capacity || rightSize > capacity)
+            continue;
+        largest[s] = max(leftSize, rightSize);
+        if (best < 0 || largest[s] < bestSize)
+        {
+            best = s;
+            bestSize = largest[s];
+        }
+    }
+    if (best < 0)
+        return IX_NO_FREE_SPACE;
+    for (int s = 0; s <= entries; s++)
+    {
+        if (largest[s] <= min(bestSize + capacity / 16, capacity) && separators[s].size() < separators[best].size())
+            best = s;
+    }
+    const int s = best;
+    const string &separator = separators[s];
+
+    // Both leaves are built in memory, the pinned page is only overwritten once the split can no longer fail
     void *newLeaf = calloc(PAGE_SIZE, 1);
+    void *leftLeaf = malloc(PAGE_SIZE);
+    childEntry.key = malloc(separator.size());
+    if (newLeaf == NULL || leftLeaf == NULL || childEntry.key == NULL)
+    {
+        free(newLeaf);
+        free(leftLeaf);
+        free(childEntry.key);
+        childEntry.key = NULL;
+        return IX_MALLOC_FAILED;
+    }
+    memcpy(childEntry.key, separator.data(), separator.size());
     setNodeType(IX_TYPE_LEAF, newLeaf);
     LeafHeader newHeader;
     newHeader.prev = pageID;
     newHeader.next = originalHeader.next;
     newHeader.entriesNumber = 0;
     newHeader.freeSpaceOffset = PAGE_SIZE;
+    newHeader.prefixLength = 0;
     setLeafHeader(newHeader, newLeaf);
 
-    int32_t newPageNum = fileHandle.getNumberOfPages();
-    originalHeader.next = newPageNum;
-    setLeafHeader(originalHeader, originalLeaf);
-
-    int size = 0;
-    int i;
-    int lastSize = 0;
-    for (i = 0; i < originalHeader.entriesNumber; i++)
+    // Both leaves are filled from the original, with each key going at the end. Each gets the prefix
+    // of its keys, the new one included, first.
+    memcpy(leftLeaf, originalLeaf, PAGE_SIZE);
+    LeafHeader header = originalHeader;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    header.prefixLength = 0;
+    setLeafHeader(header, leftLeaf);
+    void *target = compareKeys(attribute, insKey.data(), separator.data()) <= 0 ? leftLeaf : newLeaf;
+    if (varchar)
     {
-        DataEntry entry = getDataEntry(i, originalLeaf);
-        void *key = NULL;
-
-        if (attribute.type == TypeInt)
-            key = &(entry.integer);
-        else if (attribute.type == TypeReal)
-            key = &(entry.real);
-        else
-            key = (char*)originalLeaf + entry.varcharOffset;
-        
-        lastSize = getKeyLengthLeaf(attribute, key);
-        size += lastSize;
-        if (size >= PAGE_SIZE / 2)
-        {
-            if (i >= originalHeader.entriesNumber - 1 || compareLeafSlot(attribute, key, originalLeaf, i+1) != 0)
-                break;
-        }
+        setLeafPrefix(attribute, leftLeaf, (s > 0 ? keys[0] : insKey).data(), leftPrefixes[s]);
+        setLeafPrefix(attribute, newLeaf, (s < entries ? keys[s] : insKey).data(), rightPrefixes[s]);
     }
-    // i is now middle key
-    DataEntry middleEntry = getDataEntry(i, originalLeaf);
-    childEntry.key = malloc(lastSize);
-    if (childEntry.key == NULL)
-        return IX_MALLOC_FAILED;
-    childEntry.childPage = newPageNum;
-    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(DataEntry) : INT_SIZE;
-    if (attribute.type == TypeVarChar)
-        memcpy(childEntry.key, (char*)originalLeaf + middleEntry.varcharOffset, keySize);
-    else
-        memcpy(childEntry.key, &(middleEntry.integer), keySize);
-
-    void *moving_key = malloc (attribute.length + 4);
-    for (int j = 1; j < originalHeader.entriesNumber - i; j++)
+    for (int j = 0; j < entries; j++)
+        copyLeafSlot(attribute, originalLeaf, j, j < s ? leftLeaf : newLeaf);
+
+    // Add new record to correct page. This can write overflow pages, so it comes before the new leaf
+    // gets its page.
+    RC rc = insertIntoLeaf(fileHandle, attribute, ins_key, ins_rid, target);
+    int32_t newPageNum;
+    if (rc == SUCCESS && allocatePage(fileHandle, newPageNum))
+        rc = IX_APPEND_FAILED;
+    else if (rc == SUCCESS && writeNewPage(fileHandle, newPageNum, newLeaf))
     {
-        // Grab data entry after the middle entry. We then delete it and the rest are shifted over
-        DataEntry entry = getDataEntry(i + 1, originalLeaf);
-        RID moving_rid = entry.rid;
-        if (attribute.type == TypeVarChar)
-        {
-            int32_t len;
-            memcpy(&len, (char*)originalLeaf + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE, (char*)originalLeaf + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        }
-        else
-        {
-            memcpy(moving_key, &(entry.integer), INT_SIZE);
-        }
-        // Insert into new leaf, delete from old
-        insertIntoLeaf(attribute, moving_key, moving_rid, newLeaf);
-        deleteEntryFromLeaf(attribute, moving_key, moving_rid, originalLeaf);
+        deallocatePage(fileHandle, newPageNum);
+        rc = IX_APPEND_FAILED;
     }
-    free(moving_key);
+    free(newLeaf);
 
-    // Still need to: Write back both (append new leaf)
-    // Add new record to correct page
-    if (compareLeafSlot(attribute, ins_key, originalLeaf, i) <= 0)
+    // The leaf after the new one points back to it
+    if (rc == SUCCESS && newHeader.next != 0)
     {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, originalLeaf))
+        void *nextLeaf;
+        if (fileHandle.pinPage(newHeader.next, nextLeaf))
         {
-            free(newLeaf);
-            return -1;
+            deallocatePage(fileHandle, newPageNum);
+            rc = IX_READ_FAILED;
         }
-    }
-    else
-    {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, newLeaf))
+        else
         {
-            free(newLeaf);
-            return -1;
+            LeafHeader nextHeader = getLeafHeader(nextLeaf);
+            nextHeader.prev = newPageNum;
+            setLeafHeader(nextHeader, nextLeaf);
+            if (fileHandle.unpinPage(newHeader.next, true))
+                rc = IX_WRITE_FAILED;
         }
     }
-
-    if(fileHandle.writePage(pageID, originalLeaf))
-    {
-        free(newLeaf);
-        return IX_WRITE_FAILED;
-    }
-    if(fileHandle.appendPage(newLeaf))
+    if (rc)
     {
-        free(newLeaf);
-        return IX_APPEND_FAILED;
+        free(leftLeaf);
+        free(childEntry.key);
+        childEntry.key = NULL;
+        return rc;
     }
-    free(newLeaf);
+
+    // originalLeaf is a pinned frame, the caller writes it back when unpinning
+    childEntry.childPage = newPageNum;
+    header = getLeafHeader(leftLeaf);
+    header.next = newPageNum;
+    setLeafHeader(header, leftLeaf);
+    memcpy(originalLeaf, leftLeaf, PAGE_SIZE);
+    free(leftLeaf);
     return SUCCESS;
 }
 
@@ -344,12 +507,7 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     if (getFreeSpaceInternal(pageData) < len)
         return IX_NO_FREE_SPACE;
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        if (compareSlot(attribute, entry.key, pageData, i) <= 0)
-            break;
-    }
+    int i = searchInternal(attribute, entry.key, pageData, true);
 
     // i is slot number where new entry will go
     // i is slot number to move
@@ -378,45 +536,54 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     return SUCCESS;
 }
 
-RC IndexManager::insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData)
+RC IndexManager::insertIntoLeaf(IXFileHandle &fileHandle, const Attribute attribute, const void *key, const RID &rid, void *pageData)
 {
     LeafHeader header = getLeafHeader(pageData);
+    char ridsData[IX_INLINE_RIDS_LENGTH];
+    unsigned length;
 
-    int32_t key_len = getKeyLengthLeaf(attribute, key);
-    if (getFreeSpaceLeaf(pageData) < key_len)
-        return IX_NO_FREE_SPACE;
-
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
+    // A new key gets a slot of its own
+    int i = searchLeaf(attribute, key, pageData, true);
+    if (i == header.entriesNumber || compareLeafSlot(attribute, key, pageData, i) != 0)
     {
-        if (compareLeafSlot(attribute, key, pageData, i) < 0)
-            break;
+        vector<RID> rids(1, rid);
+        encodeRids(rids, 0, 1, ridsData, IX_INLINE_RIDS_LENGTH, length);
+        return insertLeafSlot(attribute, pageData, i, key, ridsData, length);
     }
 
-    // i is slot number to move
-    int start_offset = getOffsetOfLeafSlot(i);
-    int end_offset = getOffsetOfLeafSlot(header.entriesNumber);
-    // Shift everything starting at start_offset to the right to make room for a new dataEntry
-    memmove((char*)pageData + start_offset + sizeof(DataEntry), (char*)pageData + start_offset, end_offset - start_offset);
+    DataEntry entry = getDataEntry(i, pageData);
+    if (entry.ridsLength == 0)
+    {
+        OverflowEntry overflow;
+        memcpy(&overflow, (char*)pageData + entry.ridsOffset, sizeof(OverflowEntry));
+        RC rc = insertIntoOverflow(fileHandle, overflow.firstPage, rid);
+        if (rc)
+            return rc;
+        overflow.ridsNumber++;
+        memcpy((char*)pageData + entry.ridsOffset, &overflow, sizeof(OverflowEntry));
+        return SUCCESS;
+    }
 
-    DataEntry newEntry;
-    newEntry.rid = rid;
-    if (attribute.type == TypeInt)
-        memcpy(&(newEntry.integer), key, INT_SIZE);
-    else if (attribute.type == TypeReal)
-        memcpy(&(newEntry.real), key, REAL_SIZE);
-    else
+    vector<RID> rids;
+    decodeRids((char*)pageData + entry.ridsOffset, entry.ridsLength, rids);
+    rids.insert(upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+    if (encodeRids(rids, 0, rids.size(), ridsData, IX_INLINE_RIDS_LENGTH, length) == rids.size())
     {
-        int32_t len;
-        memcpy(&len, key, VARCHAR_LENGTH_SIZE);
-        newEntry.varcharOffset = header.freeSpaceOffset - (len + VARCHAR_LENGTH_SIZE);
-        memcpy((char*)pageData + newEntry.varcharOffset, key, len + VARCHAR_LENGTH_SIZE);
-        header.freeSpaceOffset = newEntry.varcharOffset;
+        RC rc = setLeafRids(attribute, pageData, i, ridsData, length);
+        // A key on its own cannot be split from the others, so its rids move out instead
+        if (rc != IX_NO_FREE_SPACE || header.entriesNumber > 1)
+            return rc;
     }
-    header.entriesNumber += 1;
-    setLeafHeader(header, pageData);
-    setDataEntry(newEntry, i, pageData);
-    return SUCCESS;
+
+    // Too many rids to keep in the leaf
+    int32_t firstPage;
+    RC rc = writeOverflowPages(fileHandle, rids, firstPage);
+    if (rc)
+        return rc;
+    OverflowEntry overflow;
+    overflow.firstPage = firstPage;
+    overflow.ridsNumber = rids.size();
+    return setLeafRids(attribute, pageData, i, &overflow, 0);
 }
 
 int IndexManager::getOffsetOfLeafSlot(int slotNum) const
@@ -429,12 +596,13 @@ int IndexManager::getOffsetOfInternalSlot(int slotNum) const
     return sizeof(NodeType) + sizeof(InternalHeader) + slotNum * sizeof(IndexEntry);
 }
 
-RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *original, ChildEntry &childEntry)
+RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *originalPage, ChildEntry &childEntry)
 {
+    // Both halves are built in memory, the pinned page is only overwritten once the split can no longer fail
+    void *original = malloc(PAGE_SIZE);
+    memcpy(original, originalPage, PAGE_SIZE);
     InternalHeader originalHeader = getInternalHeader(original);
 
-    int32_t newPageNum = fileHandle.getNumberOfPages();
-
     int size = 0;
     int i;
     int lastSize = 0;
@@ -457,8 +625,9 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
             break;
         }
     }
-    // i is now middle key
+    // i is now middle key. Where the new key goes is decided while the middle key is still in place.
     IndexEntry middleEntry = getIndexEntry(i, original);
+    bool intoOriginal = compareSlot(attribute, childEntry.key, original, i) < 0;
 
     // Create new leaf to hold overflow
     void *newIntern = calloc(PAGE_SIZE, 1);
@@ -506,35 +675,30 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
     // Delete middle entry
     deleteEntryFromInternal(attribute, middleKey, original);
 
-    // If new key is less than middle key, put it in original node, else put it in new node
-    if (compareSlot(attribute, childEntry.key, original, i) < 0)
+    // If new key is less than middle key, put it in original node, else put it in new node.
+    // The new node only gets a page once the key is in.
+    RC rc = insertIntoInternal(attribute, childEntry, intoOriginal ? original : newIntern);
+    int32_t newPageNum;
+    if (rc)
+        rc = IX_INSERT_INTERNAL_FAILED;
+    else if (allocatePage(fileHandle, newPageNum))
+        rc = IX_APPEND_FAILED;
+    else if (writeNewPage(fileHandle, newPageNum, newIntern))
     {
-        if (insertIntoInternal(attribute, childEntry, original))
-        {
-            free(newIntern);
-            return -1;
-        }
+        deallocatePage(fileHandle, newPageNum);
+        rc = IX_APPEND_FAILED;
     }
-    else
+    free(newIntern);
+    if (rc)
     {
-        if (insertIntoInternal(attribute, childEntry, newIntern))
-        {
-            free(newIntern);
-            return -1;
-        }
+        free(original);
+        free(middleKey);
+        return rc;
     }
 
-    if(fileHandle.writePage(pageID, original))
-    {
-        free(newIntern);
-        return IX_WRITE_FAILED;
-    }
-    if(fileHandle.appendPage(newIntern))
-    {
-        free(newIntern);
-        return IX_APPEND_FAILED;
-    }
-    free(newIntern);
+    // originalPage is a pinned frame, the caller writes it back when unpinning
+    memcpy(originalPage, original, PAGE_SIZE);
+    free(original);
 
     // Take the key of middle entry and allow it to propogate up
     free(childEntry.key);
@@ -560,16 +724,16 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
         insertIntoInternal(attribute, childEntry, newRoot);
 
         // Update metadata page
-        int newRootPage = fileHandle.getNumberOfPages();
-        if(fileHandle.appendPage(newRoot))
+        int32_t newRootPage;
+        if (allocatePage(fileHandle, newRootPage) || writeNewPage(fileHandle, newRootPage, newRoot))
+        {
+            free(newRoot);
             return IX_APPEND_FAILED;
-        MetaHeader metahead;
-        metahead.rootPage = newRootPage;
-        setMetaData(metahead, newRoot);
-        if(fileHandle.writePage(0, newRoot))
+        }
+        free(newRoot);
+        if (setRootPageNum(fileHandle, newRootPage))
             return IX_WRITE_FAILED;
         // Free memory
-        free(newRoot);
         free(childEntry.key);
         childEntry.key = NULL;
 
@@ -578,765 +742,3348 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
     return SUCCESS;
 }
 
-RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
+RC IndexManager::insertEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter)
 {
-    int32_t leafPage;
-    RC rc = find(ixfileHandle, attribute, key, leafPage);
+    RC rc = sorter.sort();
     if (rc)
         return rc;
-    // leafPage is page number of leaf where this entry would be
-    // Read in page
-    void *pageData = malloc(PAGE_SIZE);
-    if (ixfileHandle.readPage(leafPage, pageData))
+    void *key = malloc(PAGE_SIZE);
+    if (key == NULL)
+        return IX_MALLOC_FAILED;
+    RID rid;
+    rc = sorter.getNext(rid, key);
+    // Sorted pairs are of no help to a hash index
+    while (rc == SUCCESS && ixfileHandle.indexType == IX_INDEX_HASH)
     {
-        free(pageData);
-        return IX_READ_FAILED;
+        rc = insertEntry(ixfileHandle, attribute, key, rid);
+        if (rc == SUCCESS)
+            rc = sorter.getNext(rid, key);
+    }
+    while (rc == SUCCESS)
+    {
+        rc = insertRun(ixfileHandle, attribute, sorter, key, rid);
+        // The leaf is full. Split it as insertEntry does, and carry on into whichever half comes next.
+        if (rc == IX_NO_FREE_SPACE)
+        {
+            rc = insertEntry(ixfileHandle, attribute, key, rid);
+            if (rc == SUCCESS)
+                rc = sorter.getNext(rid, key);
+        }
     }
+    free(key);
+    return rc == IX_EOF ? SUCCESS : rc;
+}
 
-    // Delete it from pageData
-    rc = deleteEntryFromLeaf(attribute, key, rid, pageData);
+RC IndexManager::insertRun(IXFileHandle &fileHandle, const Attribute &attribute, IX_EntrySorter &sorter, void *key, RID &rid)
+{
+    fileHandle.latchTree(false);
+    int32_t leafPage;
+    string upperBound;
+    RC rc = find(fileHandle, attribute, key, leafPage, &upperBound);
     if (rc)
     {
-        free(pageData);
+        fileHandle.unlatchTree();
         return rc;
     }
-
-    rc = ixfileHandle.writePage(leafPage, pageData);
-    free(pageData);
+    void *pageData;
+    fileHandle.latchLeaf(leafPage, true);
+    if (fileHandle.pinPage(leafPage, pageData))
+    {
+        fileHandle.unlatchLeaf(leafPage);
+        fileHandle.unlatchTree();
+        return IX_READ_FAILED;
+    }
+    bool inserted = false;
+    while (true)
+    {
+        rc = insertIntoLeaf(fileHandle, attribute, key, rid, pageData);
+        if (rc)
+            break;
+        inserted = true;
+        rc = sorter.getNext(rid, key);
+        if (rc)
+            break;
+        // Pairs past the separator right of the leaf go in a later leaf
+        if (!upperBound.empty() && compareKeys(attribute, key, upperBound.data()) > 0)
+            break;
+    }
+    if (fileHandle.unpinPage(leafPage, inserted) && inserted && (rc == SUCCESS || rc == IX_EOF))
+        rc = IX_WRITE_FAILED;
+    fileHandle.unlatchLeaf(leafPage);
+    fileHandle.unlatchTree();
     return rc;
 }
 
-
-RC IndexManager::scan(IXFileHandle &ixfileHandle,
-        const Attribute &attribute,
-        const void      *lowKey,
-        const void      *highKey,
-        bool			lowKeyInclusive,
-        bool        	highKeyInclusive,
-        IX_ScanIterator &ix_ScanIterator)
+RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    return ix_ScanIterator.initialize(ixfileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
-}
+    if (ixfileHandle.indexType == IX_INDEX_HASH)
+    {
+        ixfileHandle.latchTree(true);
+        RC rc = hashDelete(ixfileHandle, attribute, key, rid);
+        ixfileHandle.unlatchTree();
+        return rc;
+    }
 
-void IndexManager::printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const
-{
-    int32_t rootPage;
-    getRootPageNum(ixfileHandle, rootPage);
+    // The entry goes from its leaf sharing the tree
+    bool underflow;
+    ixfileHandle.latchTree(false);
+    RC rc = deleteWithinLeaf(ixfileHandle, attribute, key, rid, underflow);
+    ixfileHandle.unlatchTree();
+    if (rc || !underflow)
+        return rc;
 
-    cout << "{";
-    printBtree_rec(ixfileHandle, "  ",rootPage, attribute);
-    cout << endl << "}" << endl;
+    // Evening out the leaf changes the nodes above it, so that takes the tree to ourselves
+    int32_t rootPage;
+    ixfileHandle.latchTree(true);
+    rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc == SUCCESS)
+        rc = remove(attribute, key, NULL, ixfileHandle, rootPage, 0, underflow);
+    if (rc == SUCCESS && underflow)
+        rc = collapseRoot(ixfileHandle, rootPage);
+    ixfileHandle.unlatchTree();
+    return rc;
 }
 
-// Print comma from calling context.
-void IndexManager::printBtree_rec(IXFileHandle &ixfileHandle, string prefix, const int32_t currPage, const Attribute &attr) const
+RC IndexManager::deleteWithinLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid, bool &underflow)
 {
-    void *pageData = malloc(PAGE_SIZE);
-    ixfileHandle.readPage(currPage, pageData);
-
-    NodeType type = getNodetype(pageData);
-    if (type == IX_TYPE_LEAF)
-    {
-        printLeafNode(pageData, attr);
-    }
-    else
+    underflow = false;
+    int32_t leafPage;
+    RC rc = find(fileHandle, attribute, key, leafPage);
+    if (rc)
+        return rc;
+    void *pageData;
+    fileHandle.latchLeaf(leafPage, true);
+    if (fileHandle.pinPage(leafPage, pageData))
     {
-        printInternalNode(ixfileHandle, pageData, attr, prefix);
+        fileHandle.unlatchLeaf(leafPage);
+        return IX_READ_FAILED;
     }
-    free(pageData);
+    rc = deleteEntryFromLeaf(fileHandle, attribute, key, rid, pageData);
+    if (rc == SUCCESS)
+        underflow = leafUnderflows(pageData);
+    if (fileHandle.unpinPage(leafPage, rc == SUCCESS) && rc == SUCCESS)
+        rc = IX_WRITE_FAILED;
+    fileHandle.unlatchLeaf(leafPage);
+    return rc;
 }
 
-void IndexManager::printInternalNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr, string prefix) const
+RC IndexManager::remove(const Attribute &attribute, const void *key, const RID *rid, IXFileHandle &fileHandle, int32_t pageID, const unsigned level, bool &underflow)
 {
-    InternalHeader header = getInternalHeader(pageData);
+    underflow = false;
+    bool isLeaf;
+    int32_t childPage;
+    if (getChildPage(fileHandle, attribute, key, pageID, level, isLeaf, childPage))
+        return IX_READ_FAILED;
 
-    cout << "\n" << prefix << "\"keys\":[";
-    for (int i = 0; i < header.entriesNumber; i++)
+    void *pageData;
+    if (isLeaf)
     {
-        if (i != 0)
-            cout << ",";
-        printInternalSlot(attr, i, pageData);
+        if (fileHandle.pinPage(pageID, pageData))
+            return IX_READ_FAILED;
+        RC rc = rid == NULL ? SUCCESS : deleteEntryFromLeaf(fileHandle, attribute, key, *rid, pageData);
+        if (rc)
+        {
+            fileHandle.unpinPage(pageID, false);
+            return rc;
+        }
+        underflow = leafUnderflows(pageData);
+        return fileHandle.unpinPage(pageID, rid != NULL);
     }
-    cout << "],\n" << prefix << "\"children\":[\n" << prefix;
 
-    for (int i = 0; i <= header.entriesNumber; i++)
+    if (childPage == 0)
+        return IX_BAD_CHILD;
+    bool childUnderflow;
+    RC rc = remove(attribute, key, rid, fileHandle, childPage, level + 1, childUnderflow);
+    if (rc || !childUnderflow)
+        return rc;
+
+    // The child we went through is less than half full
+    if (fileHandle.pinPage(pageID, pageData))
+        return IX_READ_FAILED;
+    bool changed;
+    rc = rebalance(fileHandle, attribute, key, pageData, changed);
+    underflow = internalUnderflows(pageData);
+    if (fileHandle.unpinPage(pageID, changed))
+        return IX_WRITE_FAILED;
+    if (changed)
+        fileHandle.treeChanged();
+    return rc;
+}
+
+RC IndexManager::rebalance(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, void *parent, bool &changed)
+{
+    changed = false;
+    InternalHeader header = getInternalHeader(parent);
+    // An only child has no sibling to turn to
+    if (header.entriesNumber == 0)
+        return SUCCESS;
+
+    // key led to child i, 0 being leftChildPage. Pair it with the next child, or with the previous one if
+    // it is the last. sep is the slot of the key separating the pair.
+    int i = searchInternal(attribute, key, parent, true);
+    bool childIsLast = i == header.entriesNumber;
+    int sep = childIsLast ? i - 1 : i;
+    int32_t leftPage = sep == 0 ? header.leftChildPage : getIndexEntry(sep - 1, parent).childPage;
+    int32_t rightPage = getIndexEntry(sep, parent).childPage;
+
+    void *left;
+    void *right;
+    if (fileHandle.pinPage(leftPage, left))
+        return IX_READ_FAILED;
+    if (fileHandle.pinPage(rightPage, right))
     {
-        if (i == 0)
+        fileHandle.unpinPage(leftPage, false);
+        return IX_READ_FAILED;
+    }
+
+    bool merged = false;
+    RC rc;
+    if (getNodetype(left) == IX_TYPE_LEAF)
+        rc = rebalanceLeaves(fileHandle, attribute, parent, sep, leftPage, left, right, childIsLast, changed, merged);
+    else
+        rc = rebalanceInternal(attribute, parent, sep, left, right, changed, merged);
+
+    fileHandle.unpinPage(leftPage, changed);
+    fileHandle.unpinPage(rightPage, changed);
+    // Merges always empty the right node of the pair
+    if (rc == SUCCESS && merged)
+        rc = deallocatePage(fileHandle, rightPage);
+    return rc;
+}
+
+RC IndexManager::rebalanceLeaves(IXFileHandle &fileHandle, const Attribute &attribute, void *parent, const int sep,
+        const int32_t leftPage, void *left, void *right, const bool childIsLast, bool &changed, bool &merged)
+{
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    LeafHeader leftHeader = getLeafHeader(left);
+    LeafHeader rightHeader = getLeafHeader(right);
+    int leftUsed = capacity - getFreeSpaceLeaf(left);
+    int rightUsed = capacity - getFreeSpaceLeaf(right);
+
+    // Merged, the keys of both leaves share only what the first and the last of them do
+    unsigned prefix = leftHeader.prefixLength;
+    string prefixKey = getLeafPrefix(left);
+    if (attribute.type == TypeVarChar && rightHeader.entriesNumber > 0)
+    {
+        prefixKey = getLeafKey(attribute, right, rightHeader.entriesNumber - 1);
+        prefix = leftHeader.entriesNumber == 0 ? rightHeader.prefixLength
+                : commonPrefixLength(getLeafKey(attribute, left, 0), prefixKey);
+    }
+    int mergedUsed = leftUsed + rightUsed;
+    if (attribute.type == TypeVarChar)
+        mergedUsed = getLeafUsedWithPrefix(left, prefix) + getLeafUsedWithPrefix(right, prefix) - prefix;
+
+    // Entries only ever move to the end of the leaf a delete came from, so that a scan deleting what it
+    // returns does not lose its place. When that leaf is the right one of the pair, it waits until it
+    // is empty and is then unlinked.
+    if (childIsLast ? rightHeader.entriesNumber == 0 : mergedUsed <= capacity)
+    {
+        if (attribute.type == TypeVarChar && prefix != leftHeader.prefixLength && setLeafPrefix(attribute, left, prefixKey.data(), prefix))
+            return IX_INSERT_LEAF_FAILED;
+        for (int j = 0; j < rightHeader.entriesNumber; j++)
         {
-            cout << "{";
-            printBtree_rec(ixfileHandle, prefix + "  ", header.leftChildPage, attr);
-            cout << "}";
+            if (copyLeafSlot(attribute, right, j, left))
+                return IX_INSERT_LEAF_FAILED;
         }
-        else
+        leftHeader = getLeafHeader(left);
+        leftHeader.next = rightHeader.next;
+        setLeafHeader(leftHeader, left);
+        if (rightHeader.next != 0)
         {
-            cout << ",\n" << prefix;
-            IndexEntry entry = getIndexEntry(i - 1, pageData);
-            cout << "{";
-            printBtree_rec(ixfileHandle, prefix + "  ", entry.childPage, attr);
-            cout << "}";
+            void *nextLeaf;
+            if (fileHandle.pinPage(rightHeader.next, nextLeaf))
+                return IX_READ_FAILED;
+            LeafHeader nextHeader = getLeafHeader(nextLeaf);
+            nextHeader.prev = leftPage;
+            setLeafHeader(nextHeader, nextLeaf);
+            if (fileHandle.unpinPage(rightHeader.next, true))
+                return IX_WRITE_FAILED;
         }
+        // Still linked forward for a scan stopped on it
+        rightHeader.entriesNumber = 0;
+        rightHeader.freeSpaceOffset = PAGE_SIZE;
+        rightHeader.prefixLength = 0;
+        setLeafHeader(rightHeader, right);
+
+        string separator = getInternalKey(attribute, parent, sep);
+        deleteEntryFromInternal(attribute, separator.data(), parent);
+        changed = true;
+        merged = true;
+        return SUCCESS;
     }
-    cout << "\n" << prefix << "]";
+    if (childIsLast || !canReplaceSeparator(attribute, parent, sep))
+        return SUCCESS;
+
+    // Move keys from the front of the right leaf to the end of the left one while that evens them out.
+    // A key that would cut the prefix of the left leaf by more than it has room for stays.
+    while (getLeafHeader(right).entriesNumber > 1)
+    {
+        int size = getLeafSlotLength(attribute, right, 0);
+        if (leftUsed + size >= rightUsed)
+            break;
+        RC rc = copyLeafSlot(attribute, right, 0, left);
+        if (rc == IX_NO_FREE_SPACE)
+            break;
+        if (rc)
+            return IX_INSERT_LEAF_FAILED;
+        removeLeafSlot(attribute, right, 0);
+        leftUsed = capacity - getFreeSpaceLeaf(left);
+        rightUsed = capacity - getFreeSpaceLeaf(right);
+        changed = true;
+    }
+    // The separator becomes the shortest key between the leaves
+    if (changed)
+        replaceSeparator(attribute, parent, sep, shortestSeparator(attribute,
+                getLeafKey(attribute, left, getLeafHeader(left).entriesNumber - 1), getLeafKey(attribute, right, 0)));
+    return SUCCESS;
 }
 
-void IndexManager::printLeafNode(void *pageData, const Attribute &attr) const
+RC IndexManager::rebalanceInternal(const Attribute &attribute, void *parent, const int sep,
+        void *left, void *right, bool &changed, bool &merged)
 {
-    LeafHeader header = getLeafHeader(pageData);
-    void *key = NULL;
-    if (attr.type != TypeVarChar)
-        key = malloc (INT_SIZE);
-    bool first = true;
-    vector<RID> key_rids;
-
-    cout << "\"keys\":[";
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    string separator = getInternalKey(attribute, parent, sep);
+    int leftUsed = capacity - getFreeSpaceInternal(left);
+    int rightUsed = capacity - getFreeSpaceInternal(right);
 
-    for (int i = 0; i <= header.entriesNumber; i++)
+    // Merge: the separator comes down in front of the right node's entries, pointing at its left child
+    if (leftUsed + getKeyLengthInternal(attribute, separator.data()) + rightUsed <= capacity)
     {
-        DataEntry entry = getDataEntry(i, pageData);
-        if (first && i < header.entriesNumber)
+        InternalHeader rightHeader = getInternalHeader(right);
+        ChildEntry entry;
+        entry.key = (void*)separator.data();
+        entry.childPage = rightHeader.leftChildPage;
+        if (insertIntoInternal(attribute, entry, left))
+            return IX_INSERT_INTERNAL_FAILED;
+        for (int j = 0; j < rightHeader.entriesNumber; j++)
         {
-            key_rids.clear();
-            first = false;
-            if (attr.type == TypeInt)
-                memcpy(key, &(entry.integer), INT_SIZE);
-            else if (attr.type == TypeReal)
-                memcpy(key, &(entry.real), REAL_SIZE);
-            else
-            {
-                // Deal with reading in varchar
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
+            string key = getInternalKey(attribute, right, j);
+            entry.key = (void*)key.data();
+            entry.childPage = getIndexEntry(j, right).childPage;
+            if (insertIntoInternal(attribute, entry, left))
+                return IX_INSERT_INTERNAL_FAILED;
         }
-        if ( i < header.entriesNumber && compareLeafSlot(attr, key, pageData, i) == 0)
+        deleteEntryFromInternal(attribute, separator.data(), parent);
+        changed = true;
+        merged = true;
+        return SUCCESS;
+    }
+
+    // Otherwise rotate entries through the parent, from the fuller node to the other, while that evens
+    // them out: the separator comes down and the nearest key of the fuller node goes up in its place
+    while (canReplaceSeparator(attribute, parent, sep))
+    {
+        InternalHeader leftHeader = getInternalHeader(left);
+        InternalHeader rightHeader = getInternalHeader(right);
+        int sepLength = getKeyLengthInternal(attribute, separator.data());
+        ChildEntry entry;
+        entry.key = (void*)separator.data();
+        entry.childPage = rightHeader.leftChildPage;
+        string up;
+        if (leftUsed < rightUsed)
         {
-            key_rids.push_back(entry.rid);
+            up = getInternalKey(attribute, right, 0);
+            int upLength = getKeyLengthInternal(attribute, up.data());
+            if (leftUsed + sepLength >= rightUsed - upLength || getFreeSpaceInternal(left) < sepLength)
+                break;
+            if (insertIntoInternal(attribute, entry, left))
+                return IX_INSERT_INTERNAL_FAILED;
+            int32_t leftChildPage = getIndexEntry(0, right).childPage;
+            deleteEntryFromInternal(attribute, up.data(), right);
+            rightHeader = getInternalHeader(right);
+            rightHeader.leftChildPage = leftChildPage;
+            setInternalHeader(rightHeader, right);
         }
-        else if (i != 0)
+        else
         {
-            cout << "\"";
-            if (attr.type == TypeInt)
-            {
-                cout << "" << *(int*)key;
-                memcpy(key, &(entry.integer), INT_SIZE);
-            }
-            else if (attr.type == TypeReal)
-            {
-                cout << "" << *(float*)key;
-                memcpy(key, &(entry.real), REAL_SIZE);
-            }
-            else
-            {
-                cout << (char*)key + 4;
-
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
-            
-            cout << ":[";
-            for (unsigned j = 0; j < key_rids.size(); j++)
-            {
-                if (j != 0)
-                {
-                    cout << ",";
-                }
-                cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
-            }
-            cout << "]\"";
-            key_rids.clear();
-            key_rids.push_back(entry.rid);
+            up = getInternalKey(attribute, left, leftHeader.entriesNumber - 1);
+            int upLength = getKeyLengthInternal(attribute, up.data());
+            if (rightUsed + sepLength >= leftUsed - upLength || getFreeSpaceInternal(right) < sepLength)
+                break;
+            if (insertIntoInternal(attribute, entry, right))
+                return IX_INSERT_INTERNAL_FAILED;
+            rightHeader = getInternalHeader(right);
+            rightHeader.leftChildPage = getIndexEntry(leftHeader.entriesNumber - 1, left).childPage;
+            setInternalHeader(rightHeader, right);
+            deleteEntryFromInternal(attribute, up.data(), left);
         }
+        replaceSeparator(attribute, parent, sep, up);
+        separator = up;
+        leftUsed = capacity - getFreeSpaceInternal(left);
+        rightUsed = capacity - getFreeSpaceInternal(right);
+        changed = true;
     }
-    cout << "]}";
-    free (key);
+    return SUCCESS;
 }
 
-void IndexManager::printInternalSlot(const Attribute &attr, const int32_t slotNum, const void *data) const
+
+RC IndexManager::bulkLoad(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter)
 {
-    IndexEntry entry = getIndexEntry(slotNum, data);
-    if (attr.type == TypeInt)
-        cout << "" << entry.integer;
-    else if (attr.type == TypeReal)
-        cout << "" << entry.real;
-    else
+    if (ixfileHandle.indexType == IX_INDEX_HASH)
+        return insertEntries(ixfileHandle, attribute, sorter);
+    ixfileHandle.latchTree(true);
+    RC rc = bulkLoadTree(ixfileHandle, attribute, sorter);
+    ixfileHandle.unlatchTree();
+    return rc;
+}
+
+RC IndexManager::bulkLoadTree(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter)
+{
+    // The tree must be as createFile left it: root 1 with the empty leaf 2 as its only child
+    int32_t rootPage;
+    RC rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc)
+        return rc;
+    if (rootPage != 1 || ixfileHandle.getNumberOfPages() != 3)
+        return IX_NOT_EMPTY;
+    void *pageData;
+    if (ixfileHandle.pinPage(2, pageData))
+        return IX_READ_FAILED;
+    bool empty = getNodetype(pageData) == IX_TYPE_LEAF && getLeafHeader(pageData).entriesNumber == 0;
+    ixfileHandle.unpinPage(2, false);
+    if (!empty)
+        return IX_NOT_EMPTY;
+
+    rc = sorter.sort();
+    if (rc)
+        return rc;
+
+    vector<int32_t> pages;
+    vector<string> maxKeys;
+    rc = bulkLoadLeaves(ixfileHandle, attribute, sorter, pages, maxKeys);
+    if (rc)
+        return rc;
+
+    // Each pass builds the level above, the last one writing the root over page 1.
+    // A single leaf stays the only child of the root.
+    ixfileHandle.treeChanged();
+    while (pages.size() > 1)
     {
-        int32_t len;
-        memcpy(&len, (char*)data + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-        char varchar[len + 1];
-        varchar[len] = '\0';
-        memcpy(varchar, (char*)data + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        cout << "" << varchar;
+        rc = bulkLoadInternal(ixfileHandle, attribute, pages, maxKeys);
+        if (rc)
+            return rc;
     }
+    return SUCCESS;
 }
 
-IX_ScanIterator::IX_ScanIterator()
+void IndexManager::setFillFactor(float fillFactor)
 {
+    this->fillFactor = max(0.0f, min(fillFactor, 1.0f));
 }
 
-IX_ScanIterator::~IX_ScanIterator()
+float IndexManager::getFillFactor() const
 {
+    return fillFactor;
 }
 
-RC IX_ScanIterator::initialize(IXFileHandle &fh, Attribute attribute, const void *low, const void *high, bool lowInc, bool highInc)
+RC IndexManager::bulkLoadLeaves(IXFileHandle &fileHandle, const Attribute &attribute, IX_EntrySorter &sorter,
+        vector<int32_t> &pages, vector<string> &maxKeys)
 {
-    // Store all parameters because we will need them later
-    attr = attribute;
-    fileHandle = &fh;
-    lowKey = low;
-    highKey = high;
-    lowKeyInclusive = lowInc;
-    highKeyInclusive = highInc;
-
-    // Initialize our storage
-    page = malloc(PAGE_SIZE);
-    if (page == NULL)
+    void *leaf = calloc(PAGE_SIZE, 1);
+    void *key = malloc(attribute.length + VARCHAR_LENGTH_SIZE);
+    if (leaf == NULL || key == NULL)
+    {
+        free(leaf);
+        free(key);
         return IX_MALLOC_FAILED;
-    // Initialize starting slot number
-    slotNum = 0;
-
-    // Find the starting page
-    IndexManager *im = IndexManager::instance();
-    int32_t startPageNum;
-    RC rc = im->find(*fileHandle, attr, lowKey, startPageNum);
-    if (rc)
+    }
+    setNodeType(IX_TYPE_LEAF, leaf);
+    LeafHeader header;
+    header.next = 0;
+    header.prev = 0;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    header.prefixLength = 0;
+    setLeafHeader(header, leaf);
+
+    // Entries of the same key are gathered, then placed together. The first leaf goes on page 2.
+    int32_t leafPage = 2;
+    string groupKey;
+    vector<RID> groupRids;
+    RID rid;
+    RC rc;
+    while ((rc = sorter.getNext(rid, key)) == SUCCESS)
     {
-        free(page);
-        return rc;
+        int keySize = attribute.type == TypeVarChar ? getKeyLengthLeaf(attribute, key) - sizeof(DataEntry) : INT_SIZE;
+        string next((char*)key, keySize);
+        if (!groupRids.empty() && next != groupKey)
+        {
+            rc = bulkLoadKey(fileHandle, attribute, groupKey, groupRids, leaf, leafPage, pages, maxKeys);
+            if (rc)
+                break;
+            groupRids.clear();
+        }
+        groupKey = next;
+        groupRids.push_back(rid);
     }
-    rc = fileHandle->readPage(startPageNum, page);
-    if (rc)
+    if (rc == IX_EOF)
     {
-        free(page);
-        return rc;
+        rc = SUCCESS;
+        if (!groupRids.empty())
+            rc = bulkLoadKey(fileHandle, attribute, groupKey, groupRids, leaf, leafPage, pages, maxKeys);
     }
-
-    // Find the starting entry
-    LeafHeader header = im->getLeafHeader(page);
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
+    if (rc == SUCCESS)
     {
-        int cmp = (low == NULL ? -1 : im->compareLeafSlot(attr, lowKey, page, i));
-        if (cmp < 0)
-            break;
-        if (cmp == 0 && lowKeyInclusive)
-            break;
-        if (cmp > 0)
-            continue;
+        // The last leaf ends the chain
+        header = getLeafHeader(leaf);
+        rc = writeNewPage(fileHandle, leafPage, leaf);
+        pages.push_back(leafPage);
+        maxKeys.push_back(header.entriesNumber == 0 ? string() : getLeafKey(attribute, leaf, header.entriesNumber - 1));
     }
-    slotNum = i;
-    return SUCCESS;
+    free(leaf);
+    free(key);
+    return rc;
 }
 
-RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+RC IndexManager::bulkLoadKey(IXFileHandle &fileHandle, const Attribute &attribute, const string &key, const vector<RID> &rids,
+        void *leaf, int32_t &leafPage, vector<int32_t> &pages, vector<string> &maxKeys)
 {
-    IndexManager *im = IndexManager::instance();
-    LeafHeader header = im->getLeafHeader(page);
-    // If we have run off the end of the page, jump to the next one
-    if (slotNum >= header.entriesNumber)
+    // The rids come sorted. When there are too many for the leaf they go to overflow pages.
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    char ridsData[IX_INLINE_RIDS_LENGTH];
+    unsigned ridsLength;
+    bool overflow = encodeRids(rids, 0, rids.size(), ridsData, IX_INLINE_RIDS_LENGTH, ridsLength) < rids.size();
+    int length = getKeyLengthLeaf(attribute, key.data()) + (overflow ? sizeof(OverflowEntry) : ridsLength);
+    int used = capacity - getFreeSpaceLeaf(leaf);
+    LeafHeader header = getLeafHeader(leaf);
+    unsigned prefix = header.prefixLength;
+    if (attribute.type == TypeVarChar && header.entriesNumber > 0)
     {
-        // If there is no next page, return EOF
-        if (header.next == 0)
-            return IX_EOF;
-        slotNum = 0;
-        fileHandle->readPage(header.next, page);
-        return getNextEntry(rid, key);
-    }
-    // If highkey is null, always carry on
-    // Otherwise, carry on only if highkey is greater than the current key
-    int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
-    if (cmp == 0 && !highKeyInclusive)
-        return IX_EOF;
-    if (cmp < 0)
-        return IX_EOF;
+        // Keys come in order, so what the first key of the leaf shares with this one is the prefix
+        prefix = commonPrefixLength(getLeafKey(attribute, leaf, 0), key);
+        used = getLeafUsedWithPrefix(leaf, prefix);
+        length -= prefix;
+    }
 
-    // Grab the data entry, grab its rid
-    DataEntry entry = im->getDataEntry(slotNum, page);
-    rid.pageNum = entry.rid.pageNum;
-    rid.slotNum = entry.rid.slotNum;
-    // grab its key
-    if (attr.type == TypeInt)
-        memcpy(key, &(entry.integer), INT_SIZE);
-    else if (attr.type == TypeReal)
-        memcpy(key, &(entry.real), REAL_SIZE);
-    else
+    if (header.entriesNumber > 0 && (used + length > fillFactor * capacity || used + length > capacity))
     {
-        int len;
-        memcpy(&len, (char*)page + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-        memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)page + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+        // Leaves are written one after another from page 2. The next one goes on the following page,
+        // or after the overflow pages written while this one was being filled.
+        int32_t nextPage = max((int32_t)fileHandle.getNumberOfPages(), leafPage + 1);
+        header.next = nextPage;
+        setLeafHeader(header, leaf);
+        RC rc = writeNewPage(fileHandle, leafPage, leaf);
+        if (rc)
+            return rc;
+        pages.push_back(leafPage);
+        maxKeys.push_back(shortestSeparator(attribute, getLeafKey(attribute, leaf, header.entriesNumber - 1), key));
+
+        memset(leaf, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_LEAF, leaf);
+        header.next = 0;
+        header.prev = leafPage;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.prefixLength = 0;
+        setLeafHeader(header, leaf);
+        leafPage = nextPage;
+    }
+    else if (prefix != header.prefixLength)
+    {
+        RC rc = setLeafPrefix(attribute, leaf, key.data(), prefix);
+        if (rc)
+            return rc;
     }
-    // increment slotNum for the next call to getNextEntry
-    slotNum++;
-    return SUCCESS;
-}
 
-RC IX_ScanIterator::close()
-{
-    free(page);
-    return SUCCESS;
-}
+    // Keys come in order, so each one goes at the end of the leaf
+    if (!overflow)
+        return insertLeafSlot(attribute, leaf, header.entriesNumber, key.data(), ridsData, ridsLength) ? IX_INSERT_LEAF_FAILED : SUCCESS;
 
+    // Overflow pages are appended, so the page of the leaf is taken first, to be written over later
+    if (fileHandle.getNumberOfPages() == (unsigned)leafPage)
+    {
+        RC rc = writeNewPage(fileHandle, leafPage, leaf);
+        if (rc)
+            return rc;
+    }
+    OverflowEntry entry;
+    int32_t firstPage;
+    RC rc = writeOverflowPages(fileHandle, rids, firstPage);
+    if (rc)
+        return rc;
+    entry.firstPage = firstPage;
+    entry.ridsNumber = rids.size();
+    return insertLeafSlot(attribute, leaf, header.entriesNumber, key.data(), &entry, 0) ? IX_INSERT_LEAF_FAILED : SUCCESS;
+}
 
-IXFileHandle::IXFileHandle()
+RC IndexManager::bulkLoadInternal(IXFileHandle &fileHandle, const Attribute &attribute,
+        vector<int32_t> &pages, vector<string> &maxKeys)
 {
-    ixReadPageCounter = 0;
-    ixWritePageCounter = 0;
-    ixAppendPageCounter = 0;
+    void *node = calloc(PAGE_SIZE, 1);
+    if (node == NULL)
+        return IX_MALLOC_FAILED;
+    setNodeType(IX_TYPE_INTERNAL, node);
+    InternalHeader header;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = PAGE_SIZE;
+    header.leftChildPage = pages[0];
+    setInternalHeader(header, node);
+
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    vector<int32_t> levelPages;
+    vector<string> levelMaxKeys;
+    RC rc = SUCCESS;
+    for (unsigned i = 1; i < pages.size() && rc == SUCCESS; i++)
+    {
+        // The largest key under the previous child separates it from this one
+        const string &separator = maxKeys[i - 1];
+        int length = getKeyLengthInternal(attribute, separator.data());
+        int used = capacity - getFreeSpaceInternal(node);
+        if (getInternalHeader(node).entriesNumber > 0 && (used + length > fillFactor * capacity || used + length > capacity))
+        {
+            // The separator moves up a level, and this child starts the next node
+            int32_t pageNum = fileHandle.getNumberOfPages();
+            rc = writeNewPage(fileHandle, pageNum, node);
+            levelPages.push_back(pageNum);
+            levelMaxKeys.push_back(separator);
+
+            memset(node, 0, PAGE_SIZE);
+            setNodeType(IX_TYPE_INTERNAL, node);
+            header.leftChildPage = pages[i];
+            setInternalHeader(header, node);
+            continue;
+        }
+        ChildEntry entry;
+        entry.key = (void*)separator.data();
+        entry.childPage = pages[i];
+        if (insertIntoInternal(attribute, entry, node))
+            rc = IX_INSERT_INTERNAL_FAILED;
+    }
+    if (rc == SUCCESS)
+    {
+        // A level of one node is the root
+        int32_t pageNum = levelPages.empty() ? 1 : fileHandle.getNumberOfPages();
+        rc = writeNewPage(fileHandle, pageNum, node);
+        levelPages.push_back(pageNum);
+        levelMaxKeys.push_back(maxKeys.back());
+    }
+    free(node);
+    pages.swap(levelPages);
+    maxKeys.swap(levelMaxKeys);
+    return rc;
 }
 
-IXFileHandle::~IXFileHandle()
+RC IndexManager::writeNewPage(IXFileHandle &fileHandle, const int32_t pageNum, const void *pageData)
 {
+    if ((unsigned)pageNum < fileHandle.getNumberOfPages())
+        return fileHandle.writePage(pageNum, pageData) ? IX_WRITE_FAILED : SUCCESS;
+    return fileHandle.appendPage(pageData) ? IX_APPEND_FAILED : SUCCESS;
 }
 
-RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+string IndexManager::getLeafKey(const Attribute &attribute, const void *pageData, const int slotNum) const
 {
-	readPageCount = ixReadPageCounter;
-	writePageCount = ixWritePageCounter;
-	appendPageCount = ixAppendPageCounter;
-    return SUCCESS;
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (attribute.type != TypeVarChar)
+        return string((char*)&entry.integer, INT_SIZE);
+    // The prefix of the leaf, then what the key stores
+    LeafHeader header = getLeafHeader(pageData);
+    int32_t len;
+    memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+    string key = getLeafPrefix(pageData);
+    len += header.prefixLength;
+    key.replace(0, VARCHAR_LENGTH_SIZE, (char*)&len, VARCHAR_LENGTH_SIZE);
+    key.append((char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len - header.prefixLength);
+    return key;
 }
 
-RC IXFileHandle::readPage(PageNum pageNum, void *data)
+string IndexManager::getLeafPrefix(const void *pageData) const
 {
-    ixReadPageCounter++;
-    return fh.readPage(pageNum, data);
+    LeafHeader header = getLeafHeader(pageData);
+    int32_t len = header.prefixLength;
+    string prefix((char*)&len, VARCHAR_LENGTH_SIZE);
+    prefix.append((char*)pageData + PAGE_SIZE - len, len);
+    return prefix;
 }
 
-RC IXFileHandle::writePage(PageNum pageNum, const void *data)
+string IndexManager::getInternalKey(const Attribute &attribute, const void *pageData, const int slotNum) const
 {
-    ixWritePageCounter++;
-    return fh.writePage(pageNum, data);
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
+    if (attribute.type != TypeVarChar)
+        return string((char*)&entry.integer, INT_SIZE);
+    int32_t len;
+    memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+    return string((char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE + len);
 }
 
-RC IXFileHandle::appendPage(const void *data)
+// A node is underfull when less than half of its space is in use
+bool IndexManager::leafUnderflows(const void *pageData) const
 {
-    ixAppendPageCounter++;
-    return fh.appendPage(data);
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    return capacity - getFreeSpaceLeaf(pageData) < capacity / 2;
 }
 
-unsigned IXFileHandle::getNumberOfPages()
+bool IndexManager::internalUnderflows(const void *pageData) const
 {
-    return fh.getNumberOfPages();
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    return capacity - getFreeSpaceInternal(pageData) < capacity / 2;
 }
 
-// Private helpers -----------------------
-
-void IndexManager::setMetaData(const MetaHeader header, void *pageData)
+// Whether the separator in slot sep can be swapped for any other key, however long
+bool IndexManager::canReplaceSeparator(const Attribute &attribute, const void *parent, const int sep) const
 {
-    memcpy(pageData, &header, sizeof(MetaHeader));
+    if (attribute.type != TypeVarChar)
+        return true;
+    string separator = getInternalKey(attribute, parent, sep);
+    int longest = sizeof(IndexEntry) + VARCHAR_LENGTH_SIZE + attribute.length;
+    return getFreeSpaceInternal(parent) + getKeyLengthInternal(attribute, separator.data()) >= longest;
 }
 
-MetaHeader IndexManager::getMetaData(const void *pageData) const
+void IndexManager::replaceSeparator(const Attribute &attribute, void *parent, const int sep, const string &key)
 {
-    MetaHeader header;
-    memcpy(&header, pageData, sizeof(MetaHeader));
-    return header;
+    string separator = getInternalKey(attribute, parent, sep);
+    ChildEntry entry;
+    entry.key = (void*)key.data();
+    entry.childPage = getIndexEntry(sep, parent).childPage;
+    deleteEntryFromInternal(attribute, separator.data(), parent);
+    insertIntoInternal(attribute, entry, parent);
 }
 
-void IndexManager::setNodeType(const NodeType type, void *pageData)
+// An empty root over an internal node gives way to it, so the tree loses a level. A root over a
+// single leaf stays, as createFile makes it.
+RC IndexManager::collapseRoot(IXFileHandle &fileHandle, const int32_t rootPage)
 {
-    memcpy(pageData, &type, sizeof(NodeType));
+    void *pageData;
+    if (fileHandle.pinPage(rootPage, pageData))
+        return IX_READ_FAILED;
+    InternalHeader header = getInternalHeader(pageData);
+    fileHandle.unpinPage(rootPage, false);
+    if (header.entriesNumber > 0)
+        return SUCCESS;
+
+    if (fileHandle.pinPage(header.leftChildPage, pageData))
+        return IX_READ_FAILED;
+    NodeType type = getNodetype(pageData);
+    fileHandle.unpinPage(header.leftChildPage, false);
+    if (type != IX_TYPE_INTERNAL)
+        return SUCCESS;
+
+    RC rc = setRootPageNum(fileHandle, header.leftChildPage);
+    if (rc)
+        return rc;
+    return deallocatePage(fileHandle, rootPage);
 }
 
-NodeType IndexManager::getNodetype(const void *pageData) const
+RC IndexManager::setRootPageNum(IXFileHandle &fileHandle, const int32_t rootPage)
 {
-    NodeType result;
-    memcpy(&result, pageData, sizeof(NodeType));
-    return result;
+    void *metaPage;
+    if (fileHandle.pinPage(0, metaPage))
+        return IX_READ_FAILED;
+    MetaHeader meta = getMetaData(metaPage);
+    meta.rootPage = rootPage;
+    setMetaData(meta, metaPage);
+    if (fileHandle.unpinPage(0, true))
+        return IX_WRITE_FAILED;
+    fileHandle.treeChanged();
+    return SUCCESS;
 }
 
-void IndexManager::setInternalHeader(const InternalHeader header, void *pageData)
+RC IndexManager::allocatePage(IXFileHandle &fileHandle, int32_t &pageNum)
 {
-    const unsigned offset = sizeof(NodeType);
-    memcpy((char*)pageData + offset, &header, sizeof(InternalHeader));
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    lock_guard<mutex> lock(fileHandle.latches->pages);
+    void *metaPage;
+    if (fileHandle.pinPage(0, metaPage))
+        return IX_READ_FAILED;
+    MetaHeader meta = getMetaData(metaPage);
+    if (meta.freePage == 0)
+    {
+        fileHandle.unpinPage(0, false);
+        void *pageData = calloc(PAGE_SIZE, 1);
+        if (pageData == NULL)
+            return IX_MALLOC_FAILED;
+        setNodeType(IX_TYPE_FREE, pageData);
+        pageNum = fileHandle.getNumberOfPages();
+        RC rc = fileHandle.appendPage(pageData);
+        free(pageData);
+        return rc ? IX_APPEND_FAILED : SUCCESS;
+    }
+
+    pageNum = meta.freePage;
+    void *pageData;
+    if (fileHandle.pinPage(pageNum, pageData))
+    {
+        fileHandle.unpinPage(0, false);
+        return IX_READ_FAILED;
+    }
+    memcpy(&meta.freePage, (char*)pageData + PAGE_SIZE - sizeof(uint32_t), sizeof(uint32_t));
+    fileHandle.unpinPage(pageNum, false);
+    setMetaData(meta, metaPage);
+    return fileHandle.unpinPage(0, true) ? IX_WRITE_FAILED : SUCCESS;
+}
+
+RC IndexManager::deallocatePage(IXFileHandle &fileHandle, const int32_t pageNum)
+{
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    lock_guard<mutex> lock(fileHandle.latches->pages);
+    void *metaPage;
+    if (fileHandle.pinPage(0, metaPage))
+        return IX_READ_FAILED;
+    void *pageData;
+    if (fileHandle.pinPage(pageNum, pageData))
+    {
+        fileHandle.unpinPage(0, false);
+        return IX_READ_FAILED;
+    }
+    MetaHeader meta = getMetaData(metaPage);
+    setNodeType(IX_TYPE_FREE, pageData);
+    memcpy((char*)pageData + PAGE_SIZE - sizeof(uint32_t), &meta.freePage, sizeof(uint32_t));
+    meta.freePage = pageNum;
+    setMetaData(meta, metaPage);
+    RC rc = fileHandle.unpinPage(pageNum, true);
+    if (fileHandle.unpinPage(0, true) || rc)
+        return IX_WRITE_FAILED;
+    return SUCCESS;
+}
+
+RC IndexManager::scan(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        const void      *lowKey,
+        const void      *highKey,
+        bool			lowKeyInclusive,
+        bool        	highKeyInclusive,
+        IX_ScanIterator &ix_ScanIterator)
+{
+    return ix_ScanIterator.initialize(ixfileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
+}
+
+RC IndexManager::findMaxKey(IXFileHandle &ixfileHandle, const Attribute &attribute, void *key)
+{
+    if (ixfileHandle.indexType == IX_INDEX_HASH)
+        return IX_HASH_RANGE;
+
+    ixfileHandle.latchTree(false);
+    int32_t pageNum;
+    RC rc = getRootPageNum(ixfileHandle, pageNum);
+    void *pageData;
+    while (rc == SUCCESS)
+    {
+        if (ixfileHandle.pinPage(pageNum, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (getNodetype(pageData) == IX_TYPE_LEAF)
+            break;
+        InternalHeader header = getInternalHeader(pageData);
+        int32_t childPage = header.entriesNumber == 0 ? header.leftChildPage
+                : getIndexEntry(header.entriesNumber - 1, pageData).childPage;
+        ixfileHandle.unpinPage(pageNum, false);
+        pageNum = childPage;
+    }
+    if (rc)
+    {
+        ixfileHandle.unlatchTree();
+        return rc;
+    }
+
+    // Deletes leave a leaf empty only when the tree is, but go back past any empty one all the same.
+    // Leaves cannot go away while the tree is shared.
+    ixfileHandle.latchLeaf(pageNum, false);
+    LeafHeader header = getLeafHeader(pageData);
+    while (header.entriesNumber == 0 && header.prev != 0)
+    {
+        ixfileHandle.unpinPage(pageNum, false);
+        ixfileHandle.unlatchLeaf(pageNum);
+        pageNum = header.prev;
+        ixfileHandle.latchLeaf(pageNum, false);
+        if (ixfileHandle.pinPage(pageNum, pageData))
+        {
+            ixfileHandle.unlatchLeaf(pageNum);
+            ixfileHandle.unlatchTree();
+            return IX_READ_FAILED;
+        }
+        header = getLeafHeader(pageData);
+    }
+    if (header.entriesNumber == 0)
+        rc = IX_EOF;
+    else
+    {
+        string maxKey = getLeafKey(attribute, pageData, header.entriesNumber - 1);
+        memcpy(key, maxKey.data(), maxKey.size());
+    }
+    ixfileHandle.unpinPage(pageNum, false);
+    ixfileHandle.unlatchLeaf(pageNum);
+    ixfileHandle.unlatchTree();
+    return rc;
+}
+
+void IndexManager::printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const
+{
+    if (ixfileHandle.indexType == IX_INDEX_HASH)
+    {
+        printHash(ixfileHandle, attribute);
+        return;
+    }
+    // Leaves are read without their latches, so nobody else may use the tree meanwhile
+    ixfileHandle.latchTree(true);
+    int32_t rootPage;
+    getRootPageNum(ixfileHandle, rootPage);
+
+    cout << "{";
+    printBtree_rec(ixfileHandle, "  ",rootPage, attribute);
+    cout << endl << "}" << endl;
+    ixfileHandle.unlatchTree();
+}
+
+// Print comma from calling context.
+void IndexManager::printBtree_rec(IXFileHandle &ixfileHandle, string prefix, const int32_t currPage, const Attribute &attr) const
+{
+    void *pageData = malloc(PAGE_SIZE);
+    ixfileHandle.readPage(currPage, pageData);
+
+    NodeType type = getNodetype(pageData);
+    if (type == IX_TYPE_LEAF)
+    {
+        printLeafNode(ixfileHandle, pageData, attr);
+    }
+    else
+    {
+        printInternalNode(ixfileHandle, pageData, attr, prefix);
+    }
+    free(pageData);
+}
+
+void IndexManager::printInternalNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr, string prefix) const
+{
+    InternalHeader header = getInternalHeader(pageData);
+
+    cout << "\n" << prefix << "\"keys\":[";
+    for (int i = 0; i < header.entriesNumber; i++)
+    {
+        if (i != 0)
+            cout << ",";
+        printInternalSlot(attr, i, pageData);
+    }
+    cout << "],\n" << prefix << "\"children\":[\n" << prefix;
+
+    for (int i = 0; i <= header.entriesNumber; i++)
+    {
+        if (i == 0)
+        {
+            cout << "{";
+            printBtree_rec(ixfileHandle, prefix + "  ", header.leftChildPage, attr);
+            cout << "}";
+        }
+        else
+        {
+            cout << ",\n" << prefix;
+            IndexEntry entry = getIndexEntry(i - 1, pageData);
+            cout << "{";
+            printBtree_rec(ixfileHandle, prefix + "  ", entry.childPage, attr);
+            cout << "}";
+        }
+    }
+    cout << "\n" << prefix << "]";
+}
+
+void IndexManager::printLeafNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr) const
+{
+    LeafHeader header = getLeafHeader(pageData);
+    vector<RID> key_rids;
+
+    cout << "\"keys\":[";
+    for (int i = 0; i < header.entriesNumber; i++)
+    {
+        if (i != 0)
+            cout << ",";
+        cout << "\"";
+        DataEntry entry = getDataEntry(i, pageData);
+        if (attr.type == TypeInt)
+            cout << "" << entry.integer;
+        else if (attr.type == TypeReal)
+            cout << "" << entry.real;
+        else
+            cout << getLeafKey(attr, pageData, i).substr(VARCHAR_LENGTH_SIZE);
+
+        cout << ":[";
+        key_rids.clear();
+        getLeafRids(ixfileHandle, pageData, i, key_rids);
+        for (unsigned j = 0; j < key_rids.size(); j++)
+        {
+            if (j != 0)
+            {
+                cout << ",";
+            }
+            cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
+        }
+        cout << "]\"";
+    }
+    cout << "]}";
+}
+
+void IndexManager::printInternalSlot(const Attribute &attr, const int32_t slotNum, const void *data) const
+{
+    IndexEntry entry = getIndexEntry(slotNum, data);
+    if (attr.type == TypeInt)
+        cout << "" << entry.integer;
+    else if (attr.type == TypeReal)
+        cout << "" << entry.real;
+    else
+    {
+        int32_t len;
+        memcpy(&len, (char*)data + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        char varchar[len + 1];
+        varchar[len] = '\0';
+        memcpy(varchar, (char*)data + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+        cout << "" << varchar;
+    }
+}
+
+IX_ScanIterator::IX_ScanIterator()
+: page(NULL), pageNum(0), pageViewed(false), slotNum(0), keyLoaded(false), ridIndex(0), ridsPage(0), ridsNext(0),
+  prefetchedUpTo(0), leavesAhead(0), hashed(false), hashEquality(false), hashSlot(0)
+{
+}
+
+IX_ScanIterator::~IX_ScanIterator()
+{
+}
+
+RC IX_ScanIterator::initialize(IXFileHandle &fh, Attribute attribute, const void *low, const void *high, bool lowInc, bool highInc)
+{
+    // Store all parameters because we will need them later
+    attr = attribute;
+    fileHandle = &fh;
+    lowKey = low;
+    highKey = high;
+    lowKeyInclusive = lowInc;
+    highKeyInclusive = highInc;
+
+    // Leaves are walked in place, nothing is viewed yet
+    page = NULL;
+    pageViewed = false;
+    prefetchedUpTo = 0;
+    leavesAhead = 0;
+    // Initialize starting slot number
+    slotNum = 0;
+    keyLoaded = false;
+    lastKey.clear();
+    hashed = fh.indexType == IX_INDEX_HASH;
+    if (hashed)
+        return initializeHash();
+
+    // Find the starting page and entry
+    fileHandle->latchTree(false);
+    RC rc = relocate();
+    treeVersion = fileHandle->fh.getVersion();
+    fileHandle->unlatchTree();
+    return rc;
+}
+
+RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
+{
+    if (hashed)
+        return nextHashEntry(rid, key);
+
+    // The tree is shared with other threads, and with the caller between calls. Splits and merges
+    // since the last call may have moved our place to another leaf, so look for it from the root.
+    fileHandle->latchTree(false);
+    RC rc = SUCCESS;
+    if (fileHandle->fh.getVersion() != treeVersion)
+        rc = relocate();
+    if (rc == SUCCESS)
+    {
+        fileHandle->latchLeaf(pageNum, false);
+        rc = nextEntry(rid, key);
+        // nextEntry moves the latch along with the leaf
+        fileHandle->unlatchLeaf(pageNum);
+    }
+    treeVersion = fileHandle->fh.getVersion();
+    fileHandle->unlatchTree();
+    return rc;
+}
+
+RC IX_ScanIterator::relocate()
+{
+    IndexManager *im = IndexManager::instance();
+    const void *from = lastKey.empty() ? lowKey : lastKey.data();
+    int32_t leafPage;
+    RC rc = im->find(*fileHandle, attr, from, leafPage);
+    if (rc)
+        return rc;
+    rc = viewLeaf(leafPage);
+    if (rc)
+        return rc;
+    fileHandle->latchLeaf(pageNum, false);
+    readAhead();
+    fileHandle->unlatchLeaf(pageNum);
+    return SUCCESS;
+}
+
+RC IX_ScanIterator::findPlace()
+{
+    IndexManager *im = IndexManager::instance();
+    keyLoaded = false;
+    if (lastKey.empty())
+    {
+        slotNum = lowKey == NULL ? 0 : im->searchLeaf(attr, lowKey, page, lowKeyInclusive);
+        return SUCCESS;
+    }
+    slotNum = im->searchLeaf(attr, lastKey.data(), page, true);
+    if (slotNum < im->getLeafHeader(page).entriesNumber && im->compareLeafSlot(attr, lastKey.data(), page, slotNum) == 0)
+        return loadRids(true);
+    return SUCCESS;
+}
+
+// getNextEntry with the current leaf latched
+RC IX_ScanIterator::nextEntry(RID &rid, void *key)
+{
+    IndexManager *im = IndexManager::instance();
+    // The leaf is not a private copy. Inserts and deletes since the last call (the usual case is the
+    // caller deleting what we just returned) shift slots and rids around and may move keys in from the
+    // next leaf, so unless our slot is as we left it, look for where the last entry is or would be.
+    if (!keyLoaded || !slotUnchanged())
+    {
+        RC rc = findPlace();
+        if (rc)
+            return rc;
+    }
+
+    while (!keyLoaded || ridIndex >= rids.size())
+    {
+        if (keyLoaded)
+        {
+            // On to the next overflow page of the key, or to the next key
+            if (ridsNext != 0)
+            {
+                RC rc = loadOverflowPage(ridsNext);
+                if (rc)
+                    return rc;
+                continue;
+            }
+            slotNum++;
+            keyLoaded = false;
+        }
+
+        // If we have run off the end of the page, jump to the next one
+        LeafHeader header = im->getLeafHeader(page);
+        if (slotNum >= header.entriesNumber)
+        {
+            // If there is no next page, return EOF
+            if (header.next == 0)
+                return IX_EOF;
+            // Leaves laid out one after another (e.g. after a bulk load) are read several at a time,
+            // unless the prefetch thread is following the leaf chain for us
+            if (BufferManager::instance()->getPrefetchDepth() == 0
+                && header.next == pageNum + 1 && header.next >= prefetchedUpTo)
+            {
+                fileHandle->prefetchPages(header.next, IX_SCAN_PAGES_PER_READ);
+                prefetchedUpTo = header.next + IX_SCAN_PAGES_PER_READ;
+            }
+            // Leaves are only latched one at a time. The next one cannot go away meanwhile, as that
+            // takes the tree to itself.
+            fileHandle->unlatchLeaf(pageNum);
+            RC rc = viewLeaf(header.next);
+            fileHandle->latchLeaf(pageNum, false);
+            if (rc)
+                return IX_READ_FAILED;
+            readAhead();
+            continue;
+        }
+        // If highkey is null, always carry on
+        // Otherwise, carry on only if highkey is greater than the current key
+        int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
+        if (cmp == 0 && !highKeyInclusive)
+            return IX_EOF;
+        if (cmp < 0)
+            return IX_EOF;
+        RC rc = loadRids(false);
+        if (rc)
+            return rc;
+    }
+
+    rid = rids[ridIndex++];
+    lastRid = rid;
+    memcpy(key, lastKey.data(), lastKey.size());
+    return SUCCESS;
+}
+
+RC IX_ScanIterator::loadRids(bool after)
+{
+    IndexManager *im = IndexManager::instance();
+    DataEntry entry = im->getDataEntry(slotNum, page);
+    int ridsLength = entry.ridsLength == 0 ? sizeof(OverflowEntry) : entry.ridsLength;
+    loadedSlot.assign((const char*)page + im->getOffsetOfLeafSlot(slotNum), sizeof(DataEntry));
+    loadedSlot.append((const char*)page + entry.ridsOffset, ridsLength);
+    lastKey = im->getLeafKey(attr, page, slotNum);
+    keyLoaded = true;
+
+    if (entry.ridsLength > 0)
+    {
+        rids.clear();
+        ridIndex = 0;
+        ridsPage = 0;
+        ridsNext = 0;
+        im->decodeRids((const char*)page + entry.ridsOffset, entry.ridsLength, rids);
+    }
+    else
+    {
+        // Start over from the first overflow page, skipping to lastRid below. The page we were on may
+        // have been freed since, and taken by another key.
+        OverflowEntry overflow;
+        memcpy(&overflow, (const char*)page + entry.ridsOffset, sizeof(OverflowEntry));
+        RC rc = loadOverflowPage(overflow.firstPage);
+        if (rc)
+            return rc;
+    }
+    if (!after)
+        return SUCCESS;
+
+    while (true)
+    {
+        ridIndex = upper_bound(rids.begin(), rids.end(), lastRid, IndexManager::ridLess) - rids.begin();
+        if (ridIndex < rids.size() || ridsNext == 0)
+            return SUCCESS;
+        RC rc = loadOverflowPage(ridsNext);
+        if (rc)
+            return rc;
+    }
+}
+
+RC IX_ScanIterator::loadOverflowPage(PageNum overflowPage)
+{
+    IndexManager *im = IndexManager::instance();
+    const void *data;
+    if (fileHandle->viewPage(overflowPage, data))
+        return IX_READ_FAILED;
+    OverflowHeader header = im->getOverflowHeader(data);
+    rids.clear();
+    ridIndex = 0;
+    im->decodeRids((const char*)data + sizeof(NodeType) + sizeof(OverflowHeader), header.length, rids);
+    ridsPage = overflowPage;
+    ridsNext = header.next;
+    fileHandle->releasePage(overflowPage);
+    return SUCCESS;
+}
+
+// Whether the slot the rids were loaded from is still there, unchanged
+bool IX_ScanIterator::slotUnchanged() const
+{
+    IndexManager *im = IndexManager::instance();
+    if (slotNum >= im->getLeafHeader(page).entriesNumber)
+        return false;
+    const char *slot = (const char*)page + im->getOffsetOfLeafSlot(slotNum);
+    if (memcmp(slot, loadedSlot.data(), sizeof(DataEntry)) != 0)
+        return false;
+    DataEntry entry = im->getDataEntry(slotNum, page);
+    return memcmp((const char*)page + entry.ridsOffset, loadedSlot.data() + sizeof(DataEntry), loadedSlot.size() - sizeof(DataEntry)) == 0;
+}
+
+RC IX_ScanIterator::close()
+{
+    releaseLeaf();
+    return SUCCESS;
+}
+
+// Moves the in place view to leafPage
+RC IX_ScanIterator::viewLeaf(PageNum leafPage)
+{
+    releaseLeaf();
+    RC rc = fileHandle->viewPage(leafPage, page);
+    if (rc)
+        return rc;
+    pageNum = leafPage;
+    pageViewed = true;
+    slotNum = 0;
+    keyLoaded = false;
+    return SUCCESS;
+}
+
+// Keeps the prefetch thread up to the prefetch depth leaves ahead of us on the leaf chain,
+// asking again once half of the leaves it was asked for have been reached
+void IX_ScanIterator::readAhead()
+{
+    unsigned depth = BufferManager::instance()->getPrefetchDepth();
+    if (depth == 0)
+        return;
+    if (leavesAhead > 0)
+        leavesAhead--;
+    if (leavesAhead > depth / 2)
+        return;
+
+    PageNum next = IndexManager::instance()->getLeafHeader(page).next;
+    if (next != 0)
+        fileHandle->prefetchPagesAsync(next, depth, nextLeaf);
+    leavesAhead = depth;
+}
+
+// Called by the prefetch thread on each page it reads. Anything but a leaf ends the chain,
+// which can happen when the tree changed under a queued request.
+PageNum IX_ScanIterator::nextLeaf(const void *pageData)
+{
+    IndexManager *im = IndexManager::instance();
+    if (im->getNodetype(pageData) != IX_TYPE_LEAF)
+        return 0;
+    return im->getLeafHeader(pageData).next;
+}
+
+void IX_ScanIterator::releaseLeaf()
+{
+    if (!pageViewed)
+        return;
+    fileHandle->releasePage(pageNum);
+    pageViewed = false;
+}
+
+// Hash indexes find the entries of one key, or go through every bucket. Ranges are not in hash order,
+// so anything else fails and the scan returns nothing.
+RC IX_ScanIterator::initializeHash()
+{
+    IndexManager *im = IndexManager::instance();
+    rids.clear();
+    hashKeys.clear();
+    ridIndex = 0;
+    hashSlot = 0;
+    hashEquality = lowKey != NULL || highKey != NULL;
+    if (!hashEquality)
+        return SUCCESS;
+    if (lowKey == NULL || highKey == NULL || !lowKeyInclusive || !highKeyInclusive
+            || im->compareKeys(attr, lowKey, highKey) != 0)
+        return IX_HASH_RANGE;
+
+    fileHandle->latchTree(false);
+    int32_t bucketPage;
+    uint32_t entries;
+    RC rc = im->getDirectoryEntry(*fileHandle, im->hashKey(attr, lowKey), bucketPage, entries);
+    if (rc == SUCCESS)
+        rc = loadBucket(bucketPage, lowKey, 0);
+    fileHandle->unlatchTree();
+    return rc;
+}
+
+// A full scan loads a bucket at a time. Entries inserted meanwhile may be missed, or come out twice if a
+// split moves them to a bucket still to come.
+RC IX_ScanIterator::nextHashEntry(RID &rid, void *key)
+{
+    IndexManager *im = IndexManager::instance();
+    while (ridIndex >= rids.size())
+    {
+        if (hashEquality)
+            return IX_EOF;
+        rids.clear();
+        hashKeys.clear();
+        ridIndex = 0;
+
+        fileHandle->latchTree(false);
+        int32_t bucketPage;
+        uint32_t entries;
+        RC rc = im->getDirectoryEntry(*fileHandle, hashSlot, bucketPage, entries);
+        if (rc == SUCCESS && hashSlot >= entries)
+            rc = IX_EOF;
+        if (rc == SUCCESS)
+            rc = loadBucket(bucketPage, NULL, hashSlot);
+        fileHandle->unlatchTree();
+        if (rc)
+            return rc;
+        hashSlot++;
+    }
+
+    rid = rids[ridIndex];
+    memcpy(key, hashKeys[ridIndex].data(), hashKeys[ridIndex].size());
+    ridIndex++;
+    return SUCCESS;
+}
+
+RC IX_ScanIterator::loadBucket(PageNum bucketPage, const void *key, const uint32_t slot)
+{
+    IndexManager *im = IndexManager::instance();
+    PageNum current = bucketPage;
+    while (current != 0)
+    {
+        const void *pageData;
+        if (fileHandle->viewPage(current, pageData))
+            return IX_READ_FAILED;
+        BucketHeader header = im->getBucketHeader(pageData);
+        // Entries before slot pointing to the bucket have the same low bits as slot
+        if (current == bucketPage && slot >= (1u << header.localDepth))
+        {
+            fileHandle->releasePage(current);
+            return SUCCESS;
+        }
+        unsigned offset = bucketPairsOffset;
+        for (unsigned i = 0; i < header.entriesNumber; i++)
+        {
+            const char *pair = (const char*)pageData + offset;
+            unsigned length = im->getPairLength(attr, pair);
+            if (key == NULL || im->compareKeys(attr, pair + sizeof(RID), key) == 0)
+            {
+                RID rid;
+                memcpy(&rid, pair, sizeof(RID));
+                rids.push_back(rid);
+                hashKeys.push_back(string(pair + sizeof(RID), length - sizeof(RID)));
+            }
+            offset += length;
+        }
+        fileHandle->releasePage(current);
+        current = header.next;
+    }
+    return SUCCESS;
+}
+
+
+IX_EntrySorter::IX_EntrySorter(const Attribute &attribute, size_t runSize)
+: attr(attribute), runSize(runSize), sorted(false), nextOffset(0)
+{
+}
+
+IX_EntrySorter::~IX_EntrySorter()
+{
+    for (unsigned i = 0; i < runs.size(); i++)
+        fclose(runs[i].file);
+}
+
+RC IX_EntrySorter::add(const void *key, const RID &rid)
+{
+    if (sorted)
+        return IX_SORT_FAILED;
+
+    unsigned keySize = INT_SIZE;
+    if (attr.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, key, VARCHAR_LENGTH_SIZE);
+        keySize += len;
+    }
+    if (!offsets.empty() && buffer.size() + sizeof(RID) + keySize > runSize)
+    {
+        RC rc = spill();
+        if (rc)
+            return rc;
+    }
+
+    offsets.push_back(buffer.size());
+    buffer.insert(buffer.end(), (const char*)&rid, (const char*)&rid + sizeof(RID));
+    buffer.insert(buffer.end(), (const char*)key, (const char*)key + keySize);
+    return SUCCESS;
+}
+
+RC IX_EntrySorter::sort()
+{
+    if (sorted)
+        return SUCCESS;
+    sorted = true;
+
+    // Everything fit in memory, hand it back from there
+    if (runs.empty())
+    {
+        sortBuffer();
+        nextOffset = 0;
+        return SUCCESS;
+    }
+
+    if (!offsets.empty())
+    {
+        RC rc = spill();
+        if (rc)
+            return rc;
+    }
+    // Read the first pair of every run and heap them up
+    for (unsigned i = 0; i < runs.size(); i++)
+    {
+        rewind(runs[i].file);
+        if (readRun(runs[i]))
+            heap.push_back(i);
+        else if (ferror(runs[i].file))
+            return IX_SORT_FAILED;
+    }
+    for (unsigned pos = heap.size() / 2; pos-- > 0;)
+        siftDown(pos);
+    return SUCCESS;
+}
+
+RC IX_EntrySorter::getNext(RID &rid, void *key)
+{
+    if (!sorted)
+        return IX_SORT_FAILED;
+
+    const char *pair;
+    if (runs.empty())
+    {
+        if (nextOffset >= offsets.size())
+            return IX_EOF;
+        pair = &buffer[offsets[nextOffset++]];
+        memcpy(&rid, pair, sizeof(RID));
+        memcpy(key, pair + sizeof(RID), pairLength(pair) - sizeof(RID));
+        return SUCCESS;
+    }
+
+    if (heap.empty())
+        return IX_EOF;
+    SortRun &run = runs[heap[0]];
+    pair = &run.head[0];
+    memcpy(&rid, pair, sizeof(RID));
+    memcpy(key, pair + sizeof(RID), pairLength(pair) - sizeof(RID));
+
+    // Move the run on to its next pair, dropping it from the heap once it is used up
+    if (!readRun(run))
+    {
+        if (ferror(run.file))
+            return IX_SORT_FAILED;
+        heap[0] = heap.back();
+        heap.pop_back();
+    }
+    if (!heap.empty())
+        siftDown(0);
+    return SUCCESS;
+}
+
+unsigned IX_EntrySorter::getNumberOfRuns() const
+{
+    return runs.size();
+}
+
+void IX_EntrySorter::sortBuffer()
+{
+    std::sort(offsets.begin(), offsets.end(),
+        [this](uint32_t a, uint32_t b) { return comparePairs(&buffer[a], &buffer[b]) < 0; });
+}
+
+// Sorts the pairs in memory and writes them out as a run
+RC IX_EntrySorter::spill()
+{
+    sortBuffer();
+
+    SortRun run;
+    run.file = tmpfile();
+    if (run.file == NULL)
+        return IX_SORT_FAILED;
+    runs.push_back(run);
+
+    for (unsigned i = 0; i < offsets.size(); i++)
+    {
+        const char *pair = &buffer[offsets[i]];
+        if (fwrite(pair, pairLength(pair), 1, run.file) != 1)
+            return IX_SORT_FAILED;
+    }
+    buffer.clear();
+    offsets.clear();
+    return SUCCESS;
+}
+
+// Reads the next pair of a run into its head. False at the end of the run or on error
+bool IX_EntrySorter::readRun(SortRun &run)
+{
+    const unsigned fixed = sizeof(RID) + INT_SIZE;
+    run.head.resize(fixed);
+    if (fread(&run.head[0], fixed, 1, run.file) != 1)
+        return false;
+    unsigned length = pairLength(&run.head[0]);
+    if (length == fixed)
+        return true;
+    run.head.resize(length);
+    return fread(&run.head[fixed], length - fixed, 1, run.file) == 1;
+}
+
+unsigned IX_EntrySorter::pairLength(const char *pair) const
+{
+    unsigned length = sizeof(RID) + INT_SIZE;
+    if (attr.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, pair + sizeof(RID), VARCHAR_LENGTH_SIZE);
+        length += len;
+    }
+    return length;
+}
+
+// Orders by key the way the tree does, then by rid
+int IX_EntrySorter::comparePairs(const char *a, const char *b) const
+{
+    // By key, then by rid
+    int cmp = KeyNormalizer::compareValues(attr.type, a + sizeof(RID), b + sizeof(RID));
+    if (cmp != 0)
+        return cmp;
+
+    RID ridA, ridB;
+    memcpy(&ridA, a, sizeof(RID));
+    memcpy(&ridB, b, sizeof(RID));
+    if (ridA.pageNum != ridB.pageNum)
+        return ridA.pageNum < ridB.pageNum ? -1 : 1;
+    return (ridA.slotNum > ridB.slotNum) - (ridA.slotNum < ridB.slotNum);
+}
+
+void IX_EntrySorter::siftDown(unsigned pos)
+{
+    while (true)
+    {
+        unsigned smallest = pos;
+        unsigned left = 2 * pos + 1;
+        unsigned right = left + 1;
+        if (left < heap.size() && comparePairs(&runs[heap[left]].head[0], &runs[heap[smallest]].head[0]) < 0)
+            smallest = left;
+        if (right < heap.size() && comparePairs(&runs[heap[right]].head[0], &runs[heap[smallest]].head[0]) < 0)
+            smallest = right;
+        if (smallest == pos)
+            return;
+        swap(heap[pos], heap[smallest]);
+        pos = smallest;
+    }
+}
+
+IXFileHandle::IXFileHandle()
+: latches(NULL), indexType(IX_INDEX_BTREE), residentLevels(IX_RESIDENT_LEVELS), residentVersion(0), metaResident(false),
+  leafLevel(-1), directoryResident(false), globalDepth(0)
+{
+    ixReadPageCounter = 0;
+    ixWritePageCounter = 0;
+    ixAppendPageCounter = 0;
+}
+
+IXFileHandle::~IXFileHandle()
+{
+    dropResident();
+}
+
+void IXFileHandle::setResidentLevels(unsigned levels)
+{
+    residentLevels = levels;
+    dropResident();
+}
+
+unsigned IXFileHandle::getResidentLevels() const
+{
+    return residentLevels;
+}
+
+IndexType IXFileHandle::getIndexType() const
+{
+    return indexType;
+}
+
+void IXFileHandle::checkResident()
+{
+    unsigned long version = fh.getVersion();
+    if (version == residentVersion)
+        return;
+    dropResident();
+    residentVersion = version;
+}
+
+void IXFileHandle::dropResident()
+{
+    for (auto it = residentPages.begin(); it != residentPages.end(); it++)
+        free(it->second);
+    residentPages.clear();
+    metaResident = false;
+    leafLevel = -1;
+    directoryResident = false;
+    directory.clear();
+}
+
+const void *IXFileHandle::getResidentNode(PageNum pageNum)
+{
+    checkResident();
+    auto it = residentPages.find(pageNum);
+    if (it == residentPages.end())
+        return NULL;
+    return it->second;
+}
+
+void IXFileHandle::keepResident(PageNum pageNum, const void *data)
+{
+    checkResident();
+    void *&copy = residentPages[pageNum];
+    if (copy == NULL)
+        copy = malloc(PAGE_SIZE);
+    if (copy == NULL)
+    {
+        residentPages.erase(pageNum);
+        return;
+    }
+    memcpy(copy, data, PAGE_SIZE);
+}
+
+int IXFileHandle::getLeafLevel()
+{
+    checkResident();
+    return leafLevel;
+}
+
+void IXFileHandle::setLeafLevel(unsigned level)
+{
+    checkResident();
+    leafLevel = level;
+}
+
+void IXFileHandle::treeChanged()
+{
+    fh.bumpVersion();
+}
+
+void IXFileHandle::latchTree(const bool exclusive)
+{
+    if (latches == NULL)
+        return;
+    if (exclusive)
+        pthread_rwlock_wrlock(&latches->tree);
+    else
+        pthread_rwlock_rdlock(&latches->tree);
+}
+
+void IXFileHandle::unlatchTree()
+{
+    if (latches != NULL)
+        pthread_rwlock_unlock(&latches->tree);
+}
+
+void IXFileHandle::latchLeaf(const PageNum pageNum, const bool exclusive)
+{
+    if (latches == NULL)
+        return;
+    if (exclusive)
+        pthread_rwlock_wrlock(&latches->leaves[pageNum % IX_LEAF_LATCHES]);
+    else
+        pthread_rwlock_rdlock(&latches->leaves[pageNum % IX_LEAF_LATCHES]);
+}
+
+void IXFileHandle::unlatchLeaf(const PageNum pageNum)
+{
+    if (latches != NULL)
+        pthread_rwlock_unlock(&latches->leaves[pageNum % IX_LEAF_LATCHES]);
+}
+
+RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+{
+	readPageCount = ixReadPageCounter;
+	writePageCount = ixWritePageCounter;
+	appendPageCount = ixAppendPageCounter;
+    return SUCCESS;
+}
+
+RC IXFileHandle::readPage(PageNum pageNum, void *data)
+{
+    ixReadPageCounter++;
+    return fh.readPage(pageNum, data);
+}
+
+RC IXFileHandle::writePage(PageNum pageNum, const void *data)
+{
+    ixWritePageCounter++;
+    return fh.writePage(pageNum, data);
+}
+
+RC IXFileHandle::appendPage(const void *data)
+{
+    ixAppendPageCounter++;
+    return fh.appendPage(data);
+}
+
+RC IXFileHandle::pinPage(PageNum pageNum, void *&data)
+{
+    ixReadPageCounter++;
+    return fh.pinPage(pageNum, data);
+}
+
+RC IXFileHandle::unpinPage(PageNum pageNum, bool dirty)
+{
+    if (dirty)
+        ixWritePageCounter++;
+    return fh.unpinPage(pageNum, dirty);
+}
+
+RC IXFileHandle::viewPage(PageNum pageNum, const void *&data)
+{
+    ixReadPageCounter++;
+    return fh.viewPage(pageNum, data);
+}
+
+RC IXFileHandle::releasePage(PageNum pageNum)
+{
+    return fh.releasePage(pageNum);
+}
+
+RC IXFileHandle::prefetchPages(PageNum first, unsigned count)
+{
+    if (fh.isMapped())
+        return SUCCESS;
+    return fh.prefetchPages(first, count);
+}
+
+RC IXFileHandle::prefetchPagesAsync(PageNum first, unsigned count, PageNum (*nextPage)(const void *page))
+{
+    return fh.prefetchPagesAsync(first, count, nextPage);
+}
+
+unsigned IXFileHandle::getNumberOfPages()
+{
+    return fh.getNumberOfPages();
+}
+
+// Private helpers -----------------------
+
+void IndexManager::setMetaData(const MetaHeader header, void *pageData)
+{
+    memcpy(pageData, &header, sizeof(MetaHeader));
+}
+
+MetaHeader IndexManager::getMetaData(const void *pageData) const
+{
+    MetaHeader header;
+    memcpy(&header, pageData, sizeof(MetaHeader));
+    return header;
+}
+
+void IndexManager::setNodeType(const NodeType type, void *pageData)
+{
+    memcpy(pageData, &type, sizeof(NodeType));
+}
+
+NodeType IndexManager::getNodetype(const void *pageData) const
+{
+    NodeType result;
+    memcpy(&result, pageData, sizeof(NodeType));
+    return result;
+}
+
+void IndexManager::setInternalHeader(const InternalHeader header, void *pageData)
+{
+    const unsigned offset = sizeof(NodeType);
+    memcpy((char*)pageData + offset, &header, sizeof(InternalHeader));
+}
+
+InternalHeader IndexManager::getInternalHeader(const void *pageData) const
+{
+    const unsigned offset = sizeof(NodeType);
+    InternalHeader header;
+    memcpy(&header, (char*)pageData + offset, sizeof(InternalHeader));
+    return header;
+}
+
+void IndexManager::setLeafHeader(const LeafHeader header, void *pageData)
+{
+    const unsigned offset = sizeof(NodeType);
+    memcpy((char*)pageData + offset, &header, sizeof(LeafHeader));
+}
+
+LeafHeader IndexManager::getLeafHeader(const void *pageData) const
+{
+    const unsigned offset = sizeof(NodeType);
+    LeafHeader header;
+    memcpy(&header, (char*)pageData + offset, sizeof(LeafHeader));
+    return header;
+}
+
+void IndexManager::setOverflowHeader(const OverflowHeader header, void *pageData)
+{
+    // Overflow header is always right after the type
+    memcpy((char*)pageData + sizeof(NodeType), &header, sizeof(OverflowHeader));
+}
+
+OverflowHeader IndexManager::getOverflowHeader(const void *pageData) const
+{
+    OverflowHeader header;
+    memcpy(&header, (char*)pageData + sizeof(NodeType), sizeof(OverflowHeader));
+    return header;
+}
+
+void IndexManager::setIndexEntry(const IndexEntry entry, const int slotNum, void *pageData)
+{
+    const unsigned offset = sizeof(NodeType) + sizeof(InternalHeader);
+    unsigned slotOffset = offset + slotNum * sizeof(IndexEntry);
+    memcpy((char*) pageData + slotOffset, &entry, sizeof(IndexEntry));
+}
+
+IndexEntry IndexManager::getIndexEntry(const int slotNum, const void *pageData) const
+{
+    const unsigned offset = sizeof(NodeType) + sizeof(InternalHeader);
+    unsigned slotOffset = offset + slotNum * sizeof(IndexEntry);
+    IndexEntry entry;
+    memcpy(&entry, (char*)pageData + slotOffset, sizeof(IndexEntry));
+    return entry;
+}
+
+void IndexManager::setDataEntry(const DataEntry entry, const int slotNum, void *pageData)
+{
+    const unsigned offset = sizeof(NodeType) + sizeof(LeafHeader);
+    unsigned slotOffset = offset + slotNum * sizeof(DataEntry);
+    memcpy((char*) pageData + slotOffset, &entry, sizeof(DataEntry));
+}
+
+DataEntry IndexManager::getDataEntry(const int slotNum, const void *pageData) const
+{
+    const unsigned offset = sizeof(NodeType) + sizeof(LeafHeader);
+    unsigned slotOffset = offset + slotNum * sizeof(DataEntry);
+    DataEntry entry;
+    memcpy(&entry, (char*)pageData + slotOffset, sizeof(DataEntry));
+    return entry;
+}
+
+RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
+{
+    fileHandle.checkResident();
+    if (fileHandle.metaResident)
+    {
+        result = fileHandle.meta.rootPage;
+        return SUCCESS;
+    }
+
+    // Inserts and deletes sharing the tree change the free list in the meta page meanwhile.
+    // Latches come with opening the file, so a handle without them is not open.
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    lock_guard<mutex> lock(fileHandle.latches->pages);
+    void *metaPage;
+    if (fileHandle.pinPage(0, metaPage))
+        return IX_READ_FAILED;
+
+    MetaHeader header = getMetaData(metaPage);
+    fileHandle.unpinPage(0, false);
+    result = header.rootPage;
+    if (fileHandle.residentLevels > 0)
+    {
+        fileHandle.meta = header;
+        fileHandle.metaResident = true;
+    }
+    return SUCCESS;
+}
+
+RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, string *upperBound)
+{
+    int32_t rootPageNum;
+    RC rc = getRootPageNum(handle, rootPageNum);
+    if (rc)
+        return rc;
+    if (upperBound != NULL)
+        upperBound->clear();
+    return treeSearch(handle, attr, key, rootPageNum, 0, resultPageNum, upperBound);
+}
+
+RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, const unsigned level,
+        int32_t &resultPageNum, string *upperBound)
+{
+    bool isLeaf;
+    int32_t nextChildPage;
+    if (getChildPage(handle, attr, key, currPageNum, level, isLeaf, nextChildPage, upperBound))
+        return IX_READ_FAILED;
+
+    // Found our leaf!
+    if (isLeaf)
+    {
+        resultPageNum = currPageNum;
+        return SUCCESS;
+    }
+    return treeSearch(handle, attr, key, nextChildPage, level + 1, resultPageNum, upperBound);
+}
+
+RC IndexManager::getChildPage(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t pageNum,
+        const unsigned level, bool &isLeaf, int32_t &childPage, string *upperBound)
+{
+    // Every leaf is on the same level, so once a descent has found it we need not look at leaves
+    // to know what they are
+    isLeaf = handle.getLeafLevel() == (int)level;
+    if (isLeaf)
+        return SUCCESS;
+
+    const void *resident = handle.getResidentNode(pageNum);
+    if (resident != NULL)
+    {
+        childPage = getNextChildPage(attr, key, resident, upperBound);
+        return SUCCESS;
+    }
+
+    void *pageData;
+    if (handle.pinPage(pageNum, pageData))
+        return IX_READ_FAILED;
+    if (getNodetype(pageData) == IX_TYPE_LEAF)
+    {
+        isLeaf = true;
+        if (handle.residentLevels > 0)
+            handle.setLeafLevel(level);
+    }
+    else
+    {
+        childPage = getNextChildPage(attr, key, pageData, upperBound);
+        if (level < handle.residentLevels)
+            handle.keepResident(pageNum, pageData);
+    }
+    handle.unpinPage(pageNum, false);
+    return SUCCESS;
+}
+
+int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, const void *pageData, string *upperBound)
+{
+    InternalHeader header = getInternalHeader(pageData);
+    if (key == NULL)
+    {
+        if (upperBound != NULL && header.entriesNumber > 0)
+            *upperBound = getInternalKey(attr, pageData, 0);
+        return header.leftChildPage;
+    }
+
+    // First slot whose key is >= key. Keys equal to a separator live to its left
+    int i = searchInternal(attr, key, pageData, true);
+    // Bounds found further down are tighter than those above
+    if (upperBound != NULL && i < header.entriesNumber)
+        *upperBound = getInternalKey(attr, pageData, i);
+    int32_t result;
+    // Special case where key is less than all entries in this node
+    if (i == 0)
+    {
+        result = header.leftChildPage;
+    }
+    // Usual case where we grab the child to the right of the largest entry less than key
+    // This also works if key is larger than all entries
+    else
+    {
+        IndexEntry entry = getIndexEntry(i - 1, pageData);
+        result = entry.childPage;
+    }
+    return result;
+}
+
+template <typename T>
+static inline T getFixedKey(const void *key)
+{
+    T value;
+    memcpy(&value, key, sizeof(T));
+    return value;
+}
+
+template <typename T>
+int IndexManager::searchFixed(const char *entries, const int count, const T key, const bool inclusive)
+{
+    int low = 0;
+    int high = count;
+    while (high - low > IX_SEARCH_WINDOW)
+    {
+        int mid = low + (high - low) / 2;
+        T value = getFixedKey<T>(entries + mid * sizeof(DataEntry));
+        if (value < key || (value == key && !inclusive))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low + countBefore<T>(entries + low * sizeof(DataEntry), high - low, key, inclusive);
+}
+
+// Keys of four entries side by side, from the first 4 bytes of each 8
+#ifdef __SSE2__
+static inline __m128 loadFixedKeys(const char *entries)
+{
+    __m128 first = _mm_loadu_ps((const float*)entries);
+    __m128 second = _mm_loadu_ps((const float*)(entries + 2 * sizeof(DataEntry)));
+    return _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+}
+#endif
+
+template <>
+int IndexManager::countBefore<int32_t>(const char *entries, const int count, const int32_t key, const bool inclusive)
+{
+    int result = 0;
+    int i = 0;
+#ifdef __SSE2__
+    // Keys before an inclusive search are less than it, before an exclusive one not greater
+    __m128i wanted = _mm_set1_epi32(key);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i keys = _mm_castps_si128(loadFixedKeys(entries + i * sizeof(DataEntry)));
+        __m128i before = inclusive ? _mm_cmplt_epi32(keys, wanted) : _mm_cmpgt_epi32(keys, wanted);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(before));
+        result += inclusive ? __builtin_popcount(mask) : 4 - __builtin_popcount(mask);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        int32_t value = getFixedKey<int32_t>(entries + i * sizeof(DataEntry));
+        result += value < key || (value == key && !inclusive);
+    }
+    return result;
+}
+
+template <>
+int IndexManager::countBefore<float>(const char *entries, const int count, const float key, const bool inclusive)
+{
+    int result = 0;
+    int i = 0;
+#ifdef __SSE2__
+    __m128 wanted = _mm_set1_ps(key);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 keys = loadFixedKeys(entries + i * sizeof(DataEntry));
+        __m128 before = inclusive ? _mm_cmplt_ps(keys, wanted) : _mm_cmple_ps(keys, wanted);
+        result += __builtin_popcount(_mm_movemask_ps(before));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float value = getFixedKey<float>(entries + i * sizeof(DataEntry));
+        result += value < key || (value == key && !inclusive);
+    }
+    return result;
+}
+
+int IndexManager::searchInternal(const Attribute attr, const void *key, const void *pageData, bool inclusive) const
+{
+    if (attr.type != TypeVarChar)
+    {
+        const char *entries = (const char*)pageData + getOffsetOfInternalSlot(0);
+        int count = getInternalHeader(pageData).entriesNumber;
+        return attr.type == TypeInt ? searchFixed<int32_t>(entries, count, getFixedKey<int32_t>(key), inclusive)
+                : searchFixed<float>(entries, count, getFixedKey<float>(key), inclusive);
+    }
+
+    // The key is normalized once for all the comparisons
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned length;
+    const char *normalized = KeyNormalizer::normalize(attr.type, key, buffer, length);
+
+    int low = 0;
+    int high = getInternalHeader(pageData).entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareNormalizedSlot(attr, normalized, length, pageData, mid);
+        if (cmp > 0 || (cmp == 0 && !inclusive))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+int IndexManager::searchLeaf(const Attribute attr, const void *key, const void *pageData, bool inclusive) const
+{
+    if (attr.type != TypeVarChar)
+    {
+        const char *entries = (const char*)pageData + getOffsetOfLeafSlot(0);
+        int count = getLeafHeader(pageData).entriesNumber;
+        return attr.type == TypeInt ? searchFixed<int32_t>(entries, count, getFixedKey<int32_t>(key), inclusive)
+                : searchFixed<float>(entries, count, getFixedKey<float>(key), inclusive);
+    }
+
+    // The key is normalized once for all the comparisons
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned length;
+    const char *normalized = KeyNormalizer::normalize(attr.type, key, buffer, length);
+
+    int low = 0;
+    int high = getLeafHeader(pageData).entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareNormalizedLeafSlot(attr, normalized, length, pageData, mid);
+        if (cmp > 0 || (cmp == 0 && !inclusive))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+int IndexManager::compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
+{
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned length;
+    const char *normalized = KeyNormalizer::normalize(attr.type, key, buffer, length);
+    return compareNormalizedSlot(attr, normalized, length, pageData, slotNum);
+}
+
+int IndexManager::compareNormalizedSlot(const Attribute &attr, const char *key, const unsigned length, const void *pageData, const int slotNum) const
+{
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
+    const void *value = attr.type == TypeVarChar ? (const char*)pageData + entry.varcharOffset : (const void*)&entry.integer;
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned valueLength;
+    const char *normalized = KeyNormalizer::normalize(attr.type, value, buffer, valueLength);
+    return KeyNormalizer::compare(key, length, normalized, valueLength);
+}
+
+int IndexManager::compareLeafSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
+{
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned length;
+    const char *normalized = KeyNormalizer::normalize(attr.type, key, buffer, length);
+    return compareNormalizedLeafSlot(attr, normalized, length, pageData, slotNum);
+}
+
+int IndexManager::compareNormalizedLeafSlot(const Attribute &attr, const char *key, const unsigned length, const void *pageData, const int slotNum) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned valueLength;
+    if (attr.type != TypeVarChar)
+    {
+        const char *normalized = KeyNormalizer::normalize(attr.type, &entry.integer, buffer, valueLength);
+        return KeyNormalizer::compare(key, length, normalized, valueLength);
+    }
+
+    // A varchar is the prefix of the leaf followed by what the slot stores, compared in turn
+    unsigned prefixLength = getLeafHeader(pageData).prefixLength;
+    int cmp = memcmp(key, (const char*)pageData + PAGE_SIZE - prefixLength, min(length, prefixLength));
+    if (cmp != 0 || length < prefixLength)
+        return cmp != 0 ? cmp : -1;
+    const char *suffix = KeyNormalizer::normalize(attr.type, (const char*)pageData + entry.varcharOffset, buffer, valueLength);
+    return KeyNormalizer::compare(key + prefixLength, length - prefixLength, suffix, valueLength);
+}
+
+// Get size needed to insert key into page
+int IndexManager::getKeyLengthInternal(const Attribute attr, const void *key) const
+{
+    int size = sizeof(IndexEntry);
+    if (attr.type == TypeVarChar)
+    {
+        int32_t key_len;
+        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
+        size += VARCHAR_LENGTH_SIZE;
+        size += key_len;
+    }
+    return size;
+}
+
+int IndexManager::getKeyLengthLeaf(const Attribute attr, const void *key) const
+{
+    int size = sizeof(DataEntry);
+    if (attr.type == TypeVarChar)
+    {
+        int32_t key_len;
+        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
+        size += VARCHAR_LENGTH_SIZE;
+        size += key_len;
+    }
+    return size;
+}
+
+int IndexManager::getFreeSpaceInternal(const void *pageData) const
+{
+    InternalHeader header = getInternalHeader(pageData);
+    return header.freeSpaceOffset - (sizeof(NodeType) + sizeof(InternalHeader) + header.entriesNumber * sizeof(IndexEntry));
+}
+
+int IndexManager::getFreeSpaceLeaf(const void *pageData) const
+{
+    LeafHeader header = getLeafHeader(pageData);
+    return header.freeSpaceOffset - (sizeof(NodeType) + sizeof(LeafHeader) + header.entriesNumber * sizeof(DataEntry));
 }
 
-InternalHeader IndexManager::getInternalHeader(const void *pageData) const
+RC IndexManager::deleteEntryFromLeaf(IXFileHandle &fileHandle, const Attribute attr, const void *key, const RID &rid, void *pageData)
 {
-    const unsigned offset = sizeof(NodeType);
-    InternalHeader header;
-    memcpy(&header, (char*)pageData + offset, sizeof(InternalHeader));
-    return header;
+    LeafHeader header = getLeafHeader(pageData);
+
+    // Find the slot of the key. If there is none, error out
+    int i = searchLeaf(attr, key, pageData, true);
+    if (i == header.entriesNumber || compareLeafSlot(attr, key, pageData, i) != 0)
+        return IX_RECORD_DN_EXIST;
+
+    DataEntry entry = getDataEntry(i, pageData);
+    if (entry.ridsLength == 0)
+    {
+        OverflowEntry overflow;
+        memcpy(&overflow, (char*)pageData + entry.ridsOffset, sizeof(OverflowEntry));
+        int32_t firstPage = overflow.firstPage;
+        RC rc = deleteFromOverflow(fileHandle, firstPage, rid);
+        if (rc)
+            return rc;
+        overflow.firstPage = firstPage;
+        overflow.ridsNumber--;
+        if (overflow.ridsNumber == 0)
+            removeLeafSlot(attr, pageData, i);
+        else
+            memcpy((char*)pageData + entry.ridsOffset, &overflow, sizeof(OverflowEntry));
+        return SUCCESS;
+    }
+
+    vector<RID> rids;
+    decodeRids((char*)pageData + entry.ridsOffset, entry.ridsLength, rids);
+    vector<RID>::iterator it = lower_bound(rids.begin(), rids.end(), rid, ridLess);
+    if (it == rids.end() || ridLess(rid, *it))
+        return IX_RECORD_DN_EXIST;
+    rids.erase(it);
+
+    // The key goes with its last rid
+    if (rids.empty())
+    {
+        removeLeafSlot(attr, pageData, i);
+        return SUCCESS;
+    }
+    char ridsData[IX_INLINE_RIDS_LENGTH];
+    unsigned length;
+    encodeRids(rids, 0, rids.size(), ridsData, IX_INLINE_RIDS_LENGTH, length);
+    return setLeafRids(attr, pageData, i, ridsData, length);
 }
 
-void IndexManager::setLeafHeader(const LeafHeader header, void *pageData)
+unsigned IndexManager::encodeRids(const vector<RID> &rids, unsigned from, unsigned to, char *out, unsigned maxLength, unsigned &length) const
 {
-    const unsigned offset = sizeof(NodeType);
-    memcpy((char*)pageData + offset, &header, sizeof(LeafHeader));
+    length = 0;
+    unsigned i;
+    for (i = from; i < to; i++)
+    {
+        // The first rid is taken from page 0, and starts a page
+        uint32_t pageDelta = rids[i].pageNum - (i == from ? 0 : rids[i - 1].pageNum);
+        uint32_t slot = rids[i].slotNum;
+        if (i > from && pageDelta == 0)
+            slot -= rids[i - 1].slotNum;
+
+        char bytes[10];
+        unsigned size = putVarint(pageDelta, bytes);
+        size += putVarint(slot, bytes + size);
+        if (length + size > maxLength)
+            break;
+        memcpy(out + length, bytes, size);
+        length += size;
+    }
+    return i - from;
 }
 
-LeafHeader IndexManager::getLeafHeader(const void *pageData) const
+void IndexManager::decodeRids(const char *in, unsigned length, vector<RID> &rids) const
 {
-    const unsigned offset = sizeof(NodeType);
-    LeafHeader header;
-    memcpy(&header, (char*)pageData + offset, sizeof(LeafHeader));
-    return header;
+    RID rid;
+    rid.pageNum = 0;
+    rid.slotNum = 0;
+    unsigned pos = 0;
+    bool first = true;
+    while (pos < length)
+    {
+        uint32_t pageDelta = getVarint(in, pos);
+        uint32_t slot = getVarint(in, pos);
+        rid.slotNum = first || pageDelta != 0 ? slot : rid.slotNum + slot;
+        rid.pageNum += pageDelta;
+        rids.push_back(rid);
+        first = false;
+    }
 }
 
-void IndexManager::setIndexEntry(const IndexEntry entry, const int slotNum, void *pageData)
+// Seven bits a byte, lowest first, with the top bit set on all but the last byte
+unsigned IndexManager::putVarint(uint32_t value, char *out)
 {
-    const unsigned offset = sizeof(NodeType) + sizeof(InternalHeader);
-    unsigned slotOffset = offset + slotNum * sizeof(IndexEntry);
-    memcpy((char*) pageData + slotOffset, &entry, sizeof(IndexEntry));
+    unsigned size = 0;
+    while (value >= 0x80)
+    {
+        out[size++] = (char)(value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (char)value;
+    return size;
 }
 
-IndexEntry IndexManager::getIndexEntry(const int slotNum, const void *pageData) const
+uint32_t IndexManager::getVarint(const char *in, unsigned &pos)
 {
-    const unsigned offset = sizeof(NodeType) + sizeof(InternalHeader);
-    unsigned slotOffset = offset + slotNum * sizeof(IndexEntry);
-    IndexEntry entry;
-    memcpy(&entry, (char*)pageData + slotOffset, sizeof(IndexEntry));
-    return entry;
+    uint32_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do
+    {
+        byte = in[pos++];
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
 }
 
-void IndexManager::setDataEntry(const DataEntry entry, const int slotNum, void *pageData)
+bool IndexManager::ridLess(const RID &a, const RID &b)
 {
-    const unsigned offset = sizeof(NodeType) + sizeof(LeafHeader);
-    unsigned slotOffset = offset + slotNum * sizeof(DataEntry);
-    memcpy((char*) pageData + slotOffset, &entry, sizeof(DataEntry));
+    return a.pageNum < b.pageNum || (a.pageNum == b.pageNum && a.slotNum < b.slotNum);
 }
 
-DataEntry IndexManager::getDataEntry(const int slotNum, const void *pageData) const
+RC IndexManager::getLeafRids(IXFileHandle &fileHandle, const void *pageData, const int slotNum, vector<RID> &rids) const
 {
-    const unsigned offset = sizeof(NodeType) + sizeof(LeafHeader);
-    unsigned slotOffset = offset + slotNum * sizeof(DataEntry);
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (entry.ridsLength > 0)
+    {
+        decodeRids((const char*)pageData + entry.ridsOffset, entry.ridsLength, rids);
+        return SUCCESS;
+    }
+
+    OverflowEntry overflow;
+    memcpy(&overflow, (const char*)pageData + entry.ridsOffset, sizeof(OverflowEntry));
+    int32_t pageNum = overflow.firstPage;
+    while (pageNum != 0)
+    {
+        const void *overflowPage;
+        if (fileHandle.viewPage(pageNum, overflowPage))
+            return IX_READ_FAILED;
+        OverflowHeader header = getOverflowHeader(overflowPage);
+        decodeRids((const char*)overflowPage + sizeof(NodeType) + sizeof(OverflowHeader), header.length, rids);
+        fileHandle.releasePage(pageNum);
+        pageNum = header.next;
+    }
+    return SUCCESS;
+}
+
+int IndexManager::getLeafSlotLength(const Attribute &attribute, const void *pageData, const int slotNum) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    int length = sizeof(DataEntry) + (entry.ridsLength == 0 ? sizeof(OverflowEntry) : entry.ridsLength);
+    if (attribute.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, (const char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        length += VARCHAR_LENGTH_SIZE + len;
+    }
+    return length;
+}
+
+RC IndexManager::insertLeafSlot(const Attribute &attribute, void *pageData, const int slotNum, const void *key,
+        const void *rids, const uint16_t ridsLength)
+{
+    LeafHeader header = getLeafHeader(pageData);
+    int chunkLength = ridsLength == 0 ? sizeof(OverflowEntry) : ridsLength;
+    int keyLength = getKeyLengthLeaf(attribute, key) - sizeof(DataEntry);
+    if (attribute.type == TypeVarChar)
+    {
+        // The key is stored without the prefix, which first has to be cut back to what the key shares
+        // with it
+        unsigned prefix = commonPrefixLength(getLeafPrefix(pageData), string((const char*)key, keyLength));
+        int used = getLeafUsedWithPrefix(pageData, prefix);
+        keyLength -= prefix;
+        if (used + (int)sizeof(DataEntry) + keyLength + chunkLength > PAGE_SIZE - (int)sizeof(NodeType) - (int)sizeof(LeafHeader))
+            return IX_NO_FREE_SPACE;
+        if (prefix != header.prefixLength)
+        {
+            setLeafPrefix(attribute, pageData, key, prefix);
+            header = getLeafHeader(pageData);
+        }
+    }
+    else if (getFreeSpaceLeaf(pageData) < (int)sizeof(DataEntry) + keyLength + chunkLength)
+        return IX_NO_FREE_SPACE;
+
+    // Shift the slots from slotNum on to the right to make room
+    int start_offset = getOffsetOfLeafSlot(slotNum);
+    int end_offset = getOffsetOfLeafSlot(header.entriesNumber);
+    memmove((char*)pageData + start_offset + sizeof(DataEntry), (char*)pageData + start_offset, end_offset - start_offset);
+
     DataEntry entry;
-    memcpy(&entry, (char*)pageData + slotOffset, sizeof(DataEntry));
-    return entry;
+    header.freeSpaceOffset -= chunkLength;
+    entry.ridsOffset = header.freeSpaceOffset;
+    entry.ridsLength = ridsLength;
+    memcpy((char*)pageData + entry.ridsOffset, rids, chunkLength);
+    if (attribute.type == TypeVarChar)
+    {
+        int32_t suffixLength = keyLength - VARCHAR_LENGTH_SIZE;
+        header.freeSpaceOffset -= keyLength;
+        entry.varcharOffset = header.freeSpaceOffset;
+        memcpy((char*)pageData + entry.varcharOffset, &suffixLength, VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE,
+                (const char*)key + VARCHAR_LENGTH_SIZE + header.prefixLength, suffixLength);
+    }
+    else
+        memcpy(&(entry.integer), key, INT_SIZE);
+    header.entriesNumber += 1;
+    setLeafHeader(header, pageData);
+    setDataEntry(entry, slotNum, pageData);
+    return SUCCESS;
 }
 
-RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
+void IndexManager::removeLeafSlot(const Attribute &attribute, void *pageData, const int slotNum)
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    shiftLeafHeap(attribute, pageData, entry.ridsOffset, entry.ridsLength == 0 ? sizeof(OverflowEntry) : entry.ridsLength);
+    if (attribute.type == TypeVarChar)
+    {
+        entry = getDataEntry(slotNum, pageData);
+        int32_t len;
+        memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        shiftLeafHeap(attribute, pageData, entry.varcharOffset, VARCHAR_LENGTH_SIZE + len);
+    }
+
+    // Move the slots after it to the left, over it
+    LeafHeader header = getLeafHeader(pageData);
+    unsigned slotStartOffset = getOffsetOfLeafSlot(slotNum);
+    unsigned slotEndOffset = getOffsetOfLeafSlot(header.entriesNumber);
+    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(DataEntry), slotEndOffset - slotStartOffset - sizeof(DataEntry));
+    header.entriesNumber -= 1;
+    setLeafHeader(header, pageData);
+}
+
+RC IndexManager::copyLeafSlot(const Attribute &attribute, const void *source, const int slotNum, void *target)
+{
+    string key = getLeafKey(attribute, source, slotNum);
+    DataEntry entry = getDataEntry(slotNum, source);
+    int i = searchLeaf(attribute, key.data(), target, true);
+    return insertLeafSlot(attribute, target, i, key.data(), (const char*)source + entry.ridsOffset, entry.ridsLength);
+}
+
+RC IndexManager::setLeafRids(const Attribute &attribute, void *pageData, const int slotNum, const void *rids, const uint16_t ridsLength)
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    int oldLength = entry.ridsLength == 0 ? sizeof(OverflowEntry) : entry.ridsLength;
+    int newLength = ridsLength == 0 ? sizeof(OverflowEntry) : ridsLength;
+    if (newLength > oldLength && getFreeSpaceLeaf(pageData) < newLength - oldLength)
+        return IX_NO_FREE_SPACE;
+
+    // The rids keep their end where it is, and what is stored before them moves
+    shiftLeafHeap(attribute, pageData, entry.ridsOffset, oldLength - newLength);
+    entry = getDataEntry(slotNum, pageData);
+    entry.ridsOffset += oldLength - newLength;
+    entry.ridsLength = ridsLength;
+    memcpy((char*)pageData + entry.ridsOffset, rids, newLength);
+    setDataEntry(entry, slotNum, pageData);
+    return SUCCESS;
+}
+
+void IndexManager::shiftLeafHeap(const Attribute &attribute, void *pageData, const int offset, const int delta)
+{
+    if (delta == 0)
+        return;
+    LeafHeader header = getLeafHeader(pageData);
+    memmove((char*)pageData + header.freeSpaceOffset + delta, (char*)pageData + header.freeSpaceOffset, offset - header.freeSpaceOffset);
+    header.freeSpaceOffset += delta;
+    for (int i = 0; i < header.entriesNumber; i++)
+    {
+        DataEntry entry = getDataEntry(i, pageData);
+        if (attribute.type == TypeVarChar && entry.varcharOffset < offset)
+            entry.varcharOffset += delta;
+        if (entry.ridsOffset < offset)
+            entry.ridsOffset += delta;
+        setDataEntry(entry, i, pageData);
+    }
+    setLeafHeader(header, pageData);
+}
+
+RC IndexManager::setLeafPrefix(const Attribute &attribute, void *pageData, const void *key, const unsigned length)
 {
-    void *metaPage = malloc(PAGE_SIZE);
-    if (metaPage == NULL)
+    LeafHeader header = getLeafHeader(pageData);
+    if (getLeafUsedWithPrefix(pageData, length) > PAGE_SIZE - (int)sizeof(NodeType) - (int)sizeof(LeafHeader))
+        return IX_NO_FREE_SPACE;
+    void *copy = malloc(PAGE_SIZE);
+    if (copy == NULL)
         return IX_MALLOC_FAILED;
-    RC rc = fileHandle.readPage(0, metaPage);
-    if (rc)
+    memcpy(copy, pageData, PAGE_SIZE);
+
+    // Prefix bytes are read before anything is written, as key may be in the leaf
+    char prefix[PAGE_SIZE];
+    memcpy(prefix, (const char*)key + VARCHAR_LENGTH_SIZE, length);
+    int entries = header.entriesNumber;
+    header.entriesNumber = 0;
+    header.prefixLength = length;
+    header.freeSpaceOffset = PAGE_SIZE - length;
+    setLeafHeader(header, pageData);
+    memcpy((char*)pageData + PAGE_SIZE - length, prefix, length);
+
+    RC rc = SUCCESS;
+    for (int j = 0; j < entries && rc == SUCCESS; j++)
     {
-        free(metaPage);
-        return IX_READ_FAILED;
+        string slotKey = getLeafKey(attribute, copy, j);
+        DataEntry entry = getDataEntry(j, copy);
+        rc = insertLeafSlot(attribute, pageData, j, slotKey.data(), (char*)copy + entry.ridsOffset, entry.ridsLength);
     }
+    free(copy);
+    return rc;
+}
 
-    MetaHeader header = getMetaData(metaPage);
-    free(metaPage);
-    result = header.rootPage;
+int IndexManager::getLeafUsedWithPrefix(const void *pageData, const unsigned length) const
+{
+    // Each key stores what the prefix no longer has, and the prefix itself is stored once
+    LeafHeader header = getLeafHeader(pageData);
+    const int capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    return capacity - getFreeSpaceLeaf(pageData) + ((int)header.prefixLength - (int)length) * (header.entriesNumber - 1);
+}
+
+unsigned IndexManager::commonPrefixLength(const string &a, const string &b)
+{
+    unsigned length = 0;
+    unsigned end = min(a.size(), b.size());
+    for (unsigned i = VARCHAR_LENGTH_SIZE; i < end && a[i] == b[i]; i++)
+        length++;
+    return length;
+}
+
+string IndexManager::shortestSeparator(const Attribute &attribute, const string &leftMax, const string &rightMin) const
+{
+    if (attribute.type != TypeVarChar)
+        return leftMax;
+
+    // Cut leftMax after a byte that can be raised by one without reaching rightMin. Past the bytes the
+    // two keys share, any byte below 0xff will do.
+    string left = leftMax.substr(VARCHAR_LENGTH_SIZE);
+    string right = rightMin.substr(VARCHAR_LENGTH_SIZE);
+    unsigned common = commonPrefixLength(leftMax, rightMin);
+    for (unsigned j = common; j < left.size(); j++)
+    {
+        if ((uint8_t)left[j] == 0xff)
+            continue;
+        string text = left.substr(0, j + 1);
+        text[j] = text[j] + 1;
+        if (j > common || text < right)
+        {
+            int32_t len = text.size();
+            return string((char*)&len, VARCHAR_LENGTH_SIZE) + text;
+        }
+    }
+    return leftMax;
+}
+
+int IndexManager::compareKeys(const Attribute &attribute, const void *a, const void *b) const
+{
+    return KeyNormalizer::compareValues(attribute.type, a, b);
+}
+
+RC IndexManager::writeOverflowPages(IXFileHandle &fileHandle, const vector<RID> &rids, int32_t &firstPage)
+{
+    const unsigned capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(OverflowHeader);
+    void *pageData = calloc(PAGE_SIZE, 1);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    char *ridsData = (char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader);
+
+    // Where each page starts in rids
+    vector<unsigned> starts;
+    unsigned length;
+    for (unsigned from = 0; from < rids.size(); from += encodeRids(rids, from, rids.size(), ridsData, capacity, length))
+        starts.push_back(from);
+    starts.push_back(rids.size());
+
+    // Written last to first, so that each page knows the one after it
+    firstPage = 0;
+    for (int i = starts.size() - 2; i >= 0; i--)
+    {
+        memset(pageData, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_OVERFLOW, pageData);
+        OverflowHeader header;
+        header.next = firstPage;
+        header.ridsNumber = starts[i + 1] - starts[i];
+        encodeRids(rids, starts[i], starts[i + 1], ridsData, capacity, length);
+        header.length = length;
+        setOverflowHeader(header, pageData);
+        if (allocatePage(fileHandle, firstPage) || writeNewPage(fileHandle, firstPage, pageData))
+        {
+            free(pageData);
+            return IX_APPEND_FAILED;
+        }
+    }
+    free(pageData);
     return SUCCESS;
 }
 
-RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum)
+RC IndexManager::insertIntoOverflow(IXFileHandle &fileHandle, const int32_t firstPage, const RID &rid)
 {
-    int32_t rootPageNum;
-    RC rc = getRootPageNum(handle, rootPageNum);
-    if (rc)
-        return rc;
-    return treeSearch(handle, attr, key, rootPageNum, resultPageNum);
+    const unsigned capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(OverflowHeader);
+    int32_t pageNum = firstPage;
+    while (true)
+    {
+        void *pageData;
+        if (fileHandle.pinPage(pageNum, pageData))
+            return IX_READ_FAILED;
+        char *ridsData = (char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader);
+        OverflowHeader header = getOverflowHeader(pageData);
+        vector<RID> rids;
+        decodeRids(ridsData, header.length, rids);
+
+        // The rid goes on the first page whose last rid is not less than it, or on the last page
+        if (header.next != 0 && !rids.empty() && ridLess(rids.back(), rid))
+        {
+            fileHandle.unpinPage(pageNum, false);
+            pageNum = header.next;
+            continue;
+        }
+        rids.insert(upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+        unsigned length;
+        unsigned half = rids.size();
+        if (encodeRids(rids, 0, rids.size(), ridsData, capacity, length) < rids.size())
+        {
+            // The page is full. The second half of its rids moves to a new page after it, or only the
+            // new rid when it goes at the end of the list, as rids of new records do.
+            half = header.next == 0 && !ridLess(rid, rids[rids.size() - 2]) ? rids.size() - 1 : rids.size() / 2;
+            void *newPage = calloc(PAGE_SIZE, 1);
+            if (newPage == NULL)
+            {
+                fileHandle.unpinPage(pageNum, false);
+                return IX_MALLOC_FAILED;
+            }
+            setNodeType(IX_TYPE_OVERFLOW, newPage);
+            OverflowHeader newHeader;
+            newHeader.next = header.next;
+            newHeader.ridsNumber = rids.size() - half;
+            encodeRids(rids, half, rids.size(), (char*)newPage + sizeof(NodeType) + sizeof(OverflowHeader), capacity, length);
+            newHeader.length = length;
+            setOverflowHeader(newHeader, newPage);
+            int32_t newPageNum;
+            RC rc = SUCCESS;
+            if (allocatePage(fileHandle, newPageNum) || writeNewPage(fileHandle, newPageNum, newPage))
+                rc = IX_APPEND_FAILED;
+            free(newPage);
+            if (rc)
+            {
+                fileHandle.unpinPage(pageNum, false);
+                return rc;
+            }
+            header.next = newPageNum;
+            encodeRids(rids, 0, half, ridsData, capacity, length);
+        }
+        header.ridsNumber = half;
+        header.length = length;
+        setOverflowHeader(header, pageData);
+        return fileHandle.unpinPage(pageNum, true) ? IX_WRITE_FAILED : SUCCESS;
+    }
 }
 
-RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum)
+RC IndexManager::deleteFromOverflow(IXFileHandle &fileHandle, int32_t &firstPage, const RID &rid)
 {
-    void *pageData = malloc(PAGE_SIZE);
+    const unsigned capacity = PAGE_SIZE - sizeof(NodeType) - sizeof(OverflowHeader);
+    int32_t prevPage = 0;
+    int32_t pageNum = firstPage;
+    while (pageNum != 0)
+    {
+        void *pageData;
+        if (fileHandle.pinPage(pageNum, pageData))
+            return IX_READ_FAILED;
+        char *ridsData = (char*)pageData + sizeof(NodeType) + sizeof(OverflowHeader);
+        OverflowHeader header = getOverflowHeader(pageData);
+        vector<RID> rids;
+        decodeRids(ridsData, header.length, rids);
+        if (header.next != 0 && !rids.empty() && ridLess(rids.back(), rid))
+        {
+            fileHandle.unpinPage(pageNum, false);
+            prevPage = pageNum;
+            pageNum = header.next;
+            continue;
+        }
+
+        vector<RID>::iterator it = lower_bound(rids.begin(), rids.end(), rid, ridLess);
+        if (it == rids.end() || ridLess(rid, *it))
+        {
+            fileHandle.unpinPage(pageNum, false);
+            return IX_RECORD_DN_EXIST;
+        }
+        rids.erase(it);
+        unsigned length;
+        encodeRids(rids, 0, rids.size(), ridsData, capacity, length);
+        header.ridsNumber = rids.size();
+        header.length = length;
+        setOverflowHeader(header, pageData);
+        if (fileHandle.unpinPage(pageNum, true))
+            return IX_WRITE_FAILED;
+        if (!rids.empty())
+            return SUCCESS;
+
+        // An empty page leaves the list
+        if (prevPage == 0)
+            firstPage = header.next;
+        else
+        {
+            void *prevData;
+            if (fileHandle.pinPage(prevPage, prevData))
+                return IX_READ_FAILED;
+            OverflowHeader prevHeader = getOverflowHeader(prevData);
+            prevHeader.next = header.next;
+            setOverflowHeader(prevHeader, prevData);
+            if (fileHandle.unpinPage(prevPage, true))
+                return IX_WRITE_FAILED;
+        }
+        return deallocatePage(fileHandle, pageNum);
+    }
+    return IX_RECORD_DN_EXIST;
+}
+
+RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData) 
+{
+    InternalHeader header = getInternalHeader(pageData);
 
-    if (handle.readPage(currPageNum, pageData))
+    // Internal keys are unique, so the first slot >= key is the only candidate
+    int i = searchInternal(attr, key, pageData, true);
+    if (i == header.entriesNumber || compareSlot(attr, key, pageData, i) != 0)
     {
-        free (pageData);
-        return IX_READ_FAILED;
+        // error out if no match
+        return IX_RECORD_DN_EXIST;
     }
 
-    // Found our leaf!
-    if (getNodetype(pageData) == IX_TYPE_LEAF)
+    IndexEntry entry = getIndexEntry(i, pageData);
+
+    // Get positions where deleted entry starts and end
+    unsigned slotStartOffset = getOffsetOfInternalSlot(i);
+    unsigned slotEndOffset = getOffsetOfInternalSlot(header.entriesNumber);
+
+    // Move entries over, overwriting the slot being deleted
+    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(IndexEntry), slotEndOffset - slotStartOffset - sizeof(IndexEntry));
+    // Update entriesNumber
+    header.entriesNumber -= 1;
+
+    // Now, if we're a varchar, we need to move all of the varchars over as well
+    if (attr.type == TypeVarChar)
     {
-        resultPageNum = currPageNum;
-        free(pageData);
-        return SUCCESS;
+        int32_t varcharOffset = entry.varcharOffset;
+        int32_t varchar_len;
+        memcpy(&varchar_len, (char*)pageData + varcharOffset, VARCHAR_LENGTH_SIZE);
+        int32_t entryLen = varchar_len + VARCHAR_LENGTH_SIZE;
+
+        // Take everything from start of free space until the starting offset of the varchar, and move it over where the varchar once was
+        memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
+        header.freeSpaceOffset += entryLen;
+        // Update all of the slots that are moved over
+        for (i = 0; i < header.entriesNumber; i++)
+        {
+            entry = getIndexEntry(i, pageData);
+            if (entry.varcharOffset < varcharOffset)
+                entry.varcharOffset += entryLen;
+            setIndexEntry(entry, i, pageData);
+        }
     }
+    setInternalHeader(header, pageData);
+    return SUCCESS;
+}
+// Hash indexes ----------------------------
+
+RC IndexManager::createHashFile(IXFileHandle &fileHandle, void *pageData)
+{
+    // The directory starts with one entry, on page 1, for the empty bucket on page 2
+    MetaHeader meta;
+    meta.rootPage = 1;
+    meta.freePage = 0;
+    meta.indexType = IX_INDEX_HASH;
+    meta.globalDepth = 0;
+    meta.directoryPages = 1;
+    setMetaData(meta, pageData);
+    uint32_t directoryPage = 1;
+    memcpy((char*)pageData + sizeof(MetaHeader), &directoryPage, sizeof(uint32_t));
+    if (fileHandle.appendPage(pageData))
+        return IX_APPEND_FAILED;
 
-    int32_t nextChildPage = getNextChildPage(attr, key, pageData);
+    memset(pageData, 0, PAGE_SIZE);
+    setNodeType(IX_TYPE_DIRECTORY, pageData);
+    uint32_t entries = 1;
+    uint32_t bucketPage = 2;
+    memcpy((char*)pageData + sizeof(NodeType), &entries, sizeof(uint32_t));
+    memcpy((char*)pageData + directoryEntriesOffset, &bucketPage, sizeof(uint32_t));
+    if (fileHandle.appendPage(pageData))
+        return IX_APPEND_FAILED;
 
-    free(pageData);
-    return treeSearch(handle, attr, key, nextChildPage, resultPageNum);
+    memset(pageData, 0, PAGE_SIZE);
+    setNodeType(IX_TYPE_BUCKET, pageData);
+    BucketHeader header;
+    header.next = 0;
+    header.localDepth = 0;
+    header.entriesNumber = 0;
+    header.freeSpaceOffset = bucketPairsOffset;
+    setBucketHeader(header, pageData);
+    if (fileHandle.appendPage(pageData))
+        return IX_APPEND_FAILED;
+    return SUCCESS;
 }
 
-int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, void *pageData)
+uint32_t IndexManager::hashKey(const Attribute &attribute, const void *key)
 {
-    InternalHeader header = getInternalHeader(pageData);
-    if (key == NULL)
-        return header.leftChildPage;
-
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
+    const char *bytes = (const char*)key;
+    unsigned length = INT_SIZE;
+    float real;
+    if (attribute.type == TypeVarChar)
     {
-        // If key < slot key we have, then the previous entry holds the path
-        if (compareSlot(attr, key, pageData, i) <= 0)
-            break;
+        int32_t varcharLength;
+        memcpy(&varcharLength, key, VARCHAR_LENGTH_SIZE);
+        bytes += VARCHAR_LENGTH_SIZE;
+        length = varcharLength;
     }
-    int32_t result;
-    // Special case where key is less than all entries in this node
-    if (i == 0)
+    else if (attribute.type == TypeReal)
     {
-        result = header.leftChildPage;
+        // -0.0 and 0.0 are the same key
+        memcpy(&real, key, REAL_SIZE);
+        if (real == 0)
+            real = 0;
+        bytes = (const char*)&real;
     }
-    // Usual case where we grab the child to the right of the largest entry less than key
-    // This also works if key is larger than all entries
-    else
+
+    // FNV-1a, then the murmur3 finalizer so that the low bits the directory goes by depend on every byte
+    uint32_t hash = 2166136261u;
+    for (unsigned i = 0; i < length; i++)
     {
-        IndexEntry entry = getIndexEntry(i - 1, pageData);
-        result = entry.childPage;
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619u;
     }
-    return result;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
 }
 
-int IndexManager::compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
+RC IndexManager::getDirectoryEntry(IXFileHandle &fileHandle, const uint32_t slot, int32_t &pageNum, uint32_t &entries)
 {
-    IndexEntry entry = getIndexEntry(slotNum, pageData);
-    if (attr.type == TypeInt)
+    fileHandle.checkResident();
+    if (!fileHandle.directoryResident && fileHandle.residentLevels > 0)
     {
-        int32_t int_key;
-        memcpy(&int_key, key, INT_SIZE);
-        return compare(int_key, entry.integer);
+        RC rc = readDirectory(fileHandle, fileHandle.directory, fileHandle.globalDepth);
+        if (rc)
+            return rc;
+        fileHandle.directoryResident = true;
     }
-    else if (attr.type == TypeReal)
+    if (fileHandle.directoryResident)
     {
-        float real_key;
-        memcpy(&real_key, key, REAL_SIZE);
-        return compare(real_key, entry.real);
+        entries = fileHandle.directory.size();
+        pageNum = fileHandle.directory[slot & (entries - 1)];
+        return SUCCESS;
     }
-    else
-    {
-        int32_t key_size;
-        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
 
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+    // Without a copy, read the meta page and the directory page with the entry
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    uint32_t entry;
+    uint32_t directoryPage;
+    {
+        lock_guard<mutex> lock(fileHandle.latches->pages);
+        void *metaPage;
+        if (fileHandle.pinPage(0, metaPage))
+            return IX_READ_FAILED;
+        MetaHeader meta = getMetaData(metaPage);
+        entries = 1u << meta.globalDepth;
+        entry = slot & (entries - 1);
+        memcpy(&directoryPage, (char*)metaPage + sizeof(MetaHeader) + entry / IX_DIRECTORY_ENTRIES * sizeof(uint32_t), sizeof(uint32_t));
+        fileHandle.unpinPage(0, false);
     }
-    return 0;
+    const void *pageData;
+    if (fileHandle.viewPage(directoryPage, pageData))
+        return IX_READ_FAILED;
+    memcpy(&pageNum, (const char*)pageData + directoryEntriesOffset + entry % IX_DIRECTORY_ENTRIES * sizeof(uint32_t), sizeof(uint32_t));
+    fileHandle.releasePage(directoryPage);
+    return SUCCESS;
 }
 
-int IndexManager::compareLeafSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
+RC IndexManager::readDirectory(IXFileHandle &fileHandle, vector<uint32_t> &directory, uint32_t &globalDepth) const
 {
-    DataEntry entry = getDataEntry(slotNum, pageData);
-    if (attr.type == TypeInt)
-    {
-        int32_t int_key;
-        memcpy(&int_key, key, INT_SIZE);
-        return compare(int_key, entry.integer);
-    }
-    else if (attr.type == TypeReal)
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    vector<uint32_t> pages;
     {
-        float real_key;
-        memcpy(&real_key, key, REAL_SIZE);
-        return compare(real_key, entry.real);
+        lock_guard<mutex> lock(fileHandle.latches->pages);
+        void *metaPage;
+        if (fileHandle.pinPage(0, metaPage))
+            return IX_READ_FAILED;
+        MetaHeader meta = getMetaData(metaPage);
+        globalDepth = meta.globalDepth;
+        pages.resize(meta.directoryPages);
+        memcpy(pages.data(), (char*)metaPage + sizeof(MetaHeader), pages.size() * sizeof(uint32_t));
+        fileHandle.unpinPage(0, false);
     }
-    else
-    {
-        int32_t key_size;
-        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
 
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+    directory.resize(1u << globalDepth);
+    for (unsigned i = 0; i < pages.size() && i * IX_DIRECTORY_ENTRIES < directory.size(); i++)
+    {
+        const void *pageData;
+        if (fileHandle.viewPage(pages[i], pageData))
+            return IX_READ_FAILED;
+        unsigned count = min((size_t)IX_DIRECTORY_ENTRIES, directory.size() - i * IX_DIRECTORY_ENTRIES);
+        memcpy(&directory[i * IX_DIRECTORY_ENTRIES], (const char*)pageData + directoryEntriesOffset, count * sizeof(uint32_t));
+        fileHandle.releasePage(pages[i]);
     }
-    return 0; // suppress warnings
+    return SUCCESS;
 }
 
-int IndexManager::compare(const int key, const int value) const
+RC IndexManager::writeDirectory(IXFileHandle &fileHandle, const vector<uint32_t> &directory, const uint32_t globalDepth)
 {
-    if (key == value)
-        return 0;
-    if (key > value)
-        return 1;
-    if (key < value)
-        return -1;
-    return 0; // suppress warnings
-}
+    if (fileHandle.latches == NULL)
+        return IX_READ_FAILED;
+    vector<uint32_t> pages;
+    {
+        lock_guard<mutex> lock(fileHandle.latches->pages);
+        void *metaPage;
+        if (fileHandle.pinPage(0, metaPage))
+            return IX_READ_FAILED;
+        MetaHeader meta = getMetaData(metaPage);
+        pages.resize(meta.directoryPages);
+        memcpy(pages.data(), (char*)metaPage + sizeof(MetaHeader), pages.size() * sizeof(uint32_t));
+        fileHandle.unpinPage(0, false);
+    }
 
-int IndexManager::compare(const float key, const float value) const
-{
-    if (key == value)
-        return 0;
-    if (key > value)
-        return 1;
-    if (key < value)
-        return -1;
-    return 0;
-}
+    // The directory never shrinks, so it only ever needs more pages
+    RC rc;
+    while (pages.size() * IX_DIRECTORY_ENTRIES < directory.size())
+    {
+        int32_t pageNum;
+        rc = allocatePage(fileHandle, pageNum);
+        if (rc)
+            return rc;
+        pages.push_back(pageNum);
+    }
 
-int IndexManager::compare(const char *key, const char *value) const
-{
-    return strcmp(key, value);
-}
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    for (unsigned i = 0; i < pages.size(); i++)
+    {
+        memset(pageData, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_DIRECTORY, pageData);
+        uint32_t count = min((size_t)IX_DIRECTORY_ENTRIES, directory.size() - i * IX_DIRECTORY_ENTRIES);
+        memcpy((char*)pageData + sizeof(NodeType), &count, sizeof(uint32_t));
+        memcpy((char*)pageData + directoryEntriesOffset, &directory[i * IX_DIRECTORY_ENTRIES], count * sizeof(uint32_t));
+        rc = writeNewPage(fileHandle, pages[i], pageData);
+        if (rc)
+        {
+            free(pageData);
+            return rc;
+        }
+    }
+    free(pageData);
 
-// Get size needed to insert key into page
-int IndexManager::getKeyLengthInternal(const Attribute attr, const void *key) const
-{
-    int size = sizeof(IndexEntry);
-    if (attr.type == TypeVarChar)
     {
-        int32_t key_len;
-        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
-        size += VARCHAR_LENGTH_SIZE;
-        size += key_len;
+        lock_guard<mutex> lock(fileHandle.latches->pages);
+        void *metaPage;
+        if (fileHandle.pinPage(0, metaPage))
+            return IX_READ_FAILED;
+        MetaHeader meta = getMetaData(metaPage);
+        meta.globalDepth = globalDepth;
+        meta.directoryPages = pages.size();
+        setMetaData(meta, metaPage);
+        memcpy((char*)metaPage + sizeof(MetaHeader), pages.data(), pages.size() * sizeof(uint32_t));
+        if (fileHandle.unpinPage(0, true))
+            return IX_WRITE_FAILED;
     }
-    return size;
+    fileHandle.treeChanged();
+    return SUCCESS;
 }
 
-int IndexManager::getKeyLengthLeaf(const Attribute attr, const void *key) const
+RC IndexManager::hashInsert(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    int size = sizeof(DataEntry);
-    if (attr.type == TypeVarChar)
+    unsigned keyLength = INT_SIZE;
+    if (attribute.type == TypeVarChar)
     {
-        int32_t key_len;
-        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
-        size += VARCHAR_LENGTH_SIZE;
-        size += key_len;
+        int32_t varcharLength;
+        memcpy(&varcharLength, key, VARCHAR_LENGTH_SIZE);
+        keyLength = VARCHAR_LENGTH_SIZE + varcharLength;
     }
-    return size;
-}
+    string pair((const char*)&rid, sizeof(RID));
+    pair.append((const char*)key, keyLength);
+    if (pair.size() > PAGE_SIZE - bucketPairsOffset)
+        return IX_NO_FREE_SPACE;
 
-int IndexManager::getFreeSpaceInternal(void *pageData) const
-{
-    InternalHeader header = getInternalHeader(pageData);
-    return header.freeSpaceOffset - (sizeof(NodeType) + sizeof(InternalHeader) + header.entriesNumber * sizeof(IndexEntry));
-}
+    const uint32_t hash = hashKey(attribute, key);
+    while (true)
+    {
+        int32_t bucketPage;
+        uint32_t entries;
+        RC rc = getDirectoryEntry(fileHandle, hash, bucketPage, entries);
+        if (rc)
+            return rc;
 
-int IndexManager::getFreeSpaceLeaf(void *pageData) const
-{
-    LeafHeader header = getLeafHeader(pageData);
-    return header.freeSpaceOffset - (sizeof(NodeType) + sizeof(LeafHeader) + header.entriesNumber * sizeof(DataEntry));
+        // The pair goes on the first page of the bucket with room for it. Otherwise note whether a split
+        // could separate it from the pairs there.
+        int32_t pageNum = bucketPage;
+        int32_t lastPage = 0;
+        uint16_t localDepth = 0;
+        bool separable = false;
+        while (pageNum != 0)
+        {
+            void *pageData;
+            if (fileHandle.pinPage(pageNum, pageData))
+                return IX_READ_FAILED;
+            BucketHeader header = getBucketHeader(pageData);
+            if (header.freeSpaceOffset + pair.size() <= PAGE_SIZE)
+            {
+                memcpy((char*)pageData + header.freeSpaceOffset, pair.data(), pair.size());
+                header.entriesNumber++;
+                header.freeSpaceOffset += pair.size();
+                setBucketHeader(header, pageData);
+                return fileHandle.unpinPage(pageNum, true) ? IX_WRITE_FAILED : SUCCESS;
+            }
+            localDepth = header.localDepth;
+            separable = separable || bucketSeparable(attribute, pageData, hash);
+            fileHandle.unpinPage(pageNum, false);
+            lastPage = pageNum;
+            pageNum = header.next;
+        }
+
+        if (separable && localDepth < IX_HASH_MAX_DEPTH)
+        {
+            rc = splitBucket(fileHandle, attribute, bucketPage);
+            if (rc)
+                return rc;
+            continue;
+        }
+
+        // No split would make room, so the pair starts an overflow page at the end of the bucket
+        int32_t newPage;
+        rc = allocatePage(fileHandle, newPage);
+        if (rc)
+            return rc;
+        void *pageData = calloc(PAGE_SIZE, 1);
+        if (pageData == NULL)
+            return IX_MALLOC_FAILED;
+        setNodeType(IX_TYPE_BUCKET, pageData);
+        BucketHeader header;
+        header.next = 0;
+        header.localDepth = localDepth;
+        header.entriesNumber = 1;
+        header.freeSpaceOffset = bucketPairsOffset + pair.size();
+        setBucketHeader(header, pageData);
+        memcpy((char*)pageData + bucketPairsOffset, pair.data(), pair.size());
+        rc = writeNewPage(fileHandle, newPage, pageData);
+        free(pageData);
+        if (rc)
+            return rc;
+
+        if (fileHandle.pinPage(lastPage, pageData))
+            return IX_READ_FAILED;
+        header = getBucketHeader(pageData);
+        header.next = newPage;
+        setBucketHeader(header, pageData);
+        return fileHandle.unpinPage(lastPage, true) ? IX_WRITE_FAILED : SUCCESS;
+    }
 }
 
-RC IndexManager::deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData) 
+RC IndexManager::hashDelete(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    LeafHeader header = getLeafHeader(pageData);
+    int32_t pageNum;
+    uint32_t entries;
+    RC rc = getDirectoryEntry(fileHandle, hashKey(attribute, key), pageNum, entries);
+    if (rc)
+        return rc;
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
+    int32_t prevPage = 0;
+    while (pageNum != 0)
     {
-        // Find a slot whose key and rid are equal to the given key and rid
-        if(compareLeafSlot(attr, key, pageData, i) == 0)
+        void *pageData;
+        if (fileHandle.pinPage(pageNum, pageData))
+            return IX_READ_FAILED;
+        BucketHeader header = getBucketHeader(pageData);
+        unsigned offset = bucketPairsOffset;
+        for (unsigned i = 0; i < header.entriesNumber; i++)
         {
-            DataEntry entry = getDataEntry(i, pageData);
-            if (entry.rid.pageNum == rid.pageNum && entry.rid.slotNum == rid.slotNum)
+            char *pair = (char*)pageData + offset;
+            unsigned length = getPairLength(attribute, pair);
+            RID pairRid;
+            memcpy(&pairRid, pair, sizeof(RID));
+            if (pairRid.pageNum != rid.pageNum || pairRid.slotNum != rid.slotNum
+                    || compareKeys(attribute, pair + sizeof(RID), key) != 0)
             {
-                break;
+                offset += length;
+                continue;
             }
+
+            memmove(pair, pair + length, header.freeSpaceOffset - offset - length);
+            header.entriesNumber--;
+            header.freeSpaceOffset -= length;
+            setBucketHeader(header, pageData);
+            if (fileHandle.unpinPage(pageNum, true))
+                return IX_WRITE_FAILED;
+            if (header.entriesNumber > 0 || prevPage == 0)
+                return SUCCESS;
+
+            // An overflow page left empty comes off its bucket
+            void *prevData;
+            if (fileHandle.pinPage(prevPage, prevData))
+                return IX_READ_FAILED;
+            BucketHeader prevHeader = getBucketHeader(prevData);
+            prevHeader.next = header.next;
+            setBucketHeader(prevHeader, prevData);
+            if (fileHandle.unpinPage(prevPage, true))
+                return IX_WRITE_FAILED;
+            return deallocatePage(fileHandle, pageNum);
         }
+        fileHandle.unpinPage(pageNum, false);
+        prevPage = pageNum;
+        pageNum = header.next;
     }
-    // If we failed to find one, error out
-    if (i == header.entriesNumber)
+    return IX_RECORD_DN_EXIST;
+}
+
+RC IndexManager::splitBucket(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t bucketPage)
+{
+    vector<string> pairs;
+    vector<int32_t> pages;
+    uint16_t localDepth;
+    RC rc = readBucketChain(fileHandle, attribute, bucketPage, pairs, pages, localDepth);
+    if (rc)
+        return rc;
+    vector<uint32_t> directory;
+    uint32_t globalDepth;
+    rc = readDirectory(fileHandle, directory, globalDepth);
+    if (rc)
+        return rc;
+
+    // Doubled, each new entry points where the one it only differs from in its top bit does
+    if (localDepth == globalDepth)
     {
-        return IX_RECORD_DN_EXIST;
+        size_t entries = directory.size();
+        directory.resize(2 * entries);
+        copy(directory.begin(), directory.begin() + entries, directory.begin() + entries);
+        globalDepth++;
     }
 
-    DataEntry entry = getDataEntry(i, pageData);
-    // Get position where deleted entry starts
-    // Then get position where entries end. Move all entries to the left, overwriting the entry being deleted.
-    unsigned slotStartOffset = getOffsetOfLeafSlot(i);
-    unsigned slotEndOffset = getOffsetOfLeafSlot(header.entriesNumber);
-    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(DataEntry), slotEndOffset - slotStartOffset - sizeof(DataEntry));
+    // Pairs with the next bit of their hash set move to a new bucket
+    vector<string> stay;
+    vector<string> moved;
+    for (unsigned i = 0; i < pairs.size(); i++)
+    {
+        uint32_t hash = hashKey(attribute, pairs[i].data() + sizeof(RID));
+        if ((hash >> localDepth) & 1)
+            moved.push_back(pairs[i]);
+        else
+            stay.push_back(pairs[i]);
+    }
+    int32_t newPage;
+    rc = allocatePage(fileHandle, newPage);
+    if (rc)
+        return rc;
+    rc = writeBucketChain(fileHandle, attribute, pages, localDepth + 1, stay);
+    if (rc)
+        return rc;
+    rc = writeBucketChain(fileHandle, attribute, vector<int32_t>(1, newPage), localDepth + 1, moved);
+    if (rc)
+        return rc;
 
-    header.entriesNumber -= 1;
+    for (size_t i = 0; i < directory.size(); i++)
+    {
+        if (directory[i] == (uint32_t)bucketPage && ((i >> localDepth) & 1))
+            directory[i] = newPage;
+    }
+    return writeDirectory(fileHandle, directory, globalDepth);
+}
 
-    // Now, if we're a varchar, we need to move all of the varchars over as well
-    if (attr.type == TypeVarChar)
+bool IndexManager::bucketSeparable(const Attribute &attribute, const void *pageData, const uint32_t hash) const
+{
+    const uint32_t mask = (1u << IX_HASH_MAX_DEPTH) - 1;
+    BucketHeader header = getBucketHeader(pageData);
+    unsigned offset = bucketPairsOffset;
+    for (unsigned i = 0; i < header.entriesNumber; i++)
     {
-        int32_t varcharOffset = entry.varcharOffset;
-        int32_t varchar_len;
-        memcpy(&varchar_len, (char*)pageData + varcharOffset, VARCHAR_LENGTH_SIZE);
-        int32_t entryLen = varchar_len + VARCHAR_LENGTH_SIZE;
+        const char *pair = (const char*)pageData + offset;
+        if ((hashKey(attribute, pair + sizeof(RID)) ^ hash) & mask)
+            return true;
+        offset += getPairLength(attribute, pair);
+    }
+    return false;
+}
 
-        // Take everything from the start of the free space to the start of the varchar being deleted, and move it over the deleted varchar
-        memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
-        header.freeSpaceOffset += entryLen;
-        // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
+RC IndexManager::readBucketChain(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t firstPage,
+        vector<string> &pairs, vector<int32_t> &pages, uint16_t &localDepth) const
+{
+    pairs.clear();
+    pages.clear();
+    int32_t pageNum = firstPage;
+    while (pageNum != 0)
+    {
+        const void *pageData;
+        if (fileHandle.viewPage(pageNum, pageData))
+            return IX_READ_FAILED;
+        BucketHeader header = getBucketHeader(pageData);
+        if (pageNum == firstPage)
+            localDepth = header.localDepth;
+        unsigned offset = bucketPairsOffset;
+        for (unsigned i = 0; i < header.entriesNumber; i++)
         {
-            entry = getDataEntry(i, pageData);
-            if (entry.varcharOffset < varcharOffset)
-                entry.varcharOffset += entryLen;
-            setDataEntry(entry, i, pageData);
+            const char *pair = (const char*)pageData + offset;
+            unsigned length = getPairLength(attribute, pair);
+            pairs.push_back(string(pair, length));
+            offset += length;
         }
+        fileHandle.releasePage(pageNum);
+        pages.push_back(pageNum);
+        pageNum = header.next;
     }
-    setLeafHeader(header, pageData);
     return SUCCESS;
 }
 
-RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData) 
+RC IndexManager::writeBucketChain(IXFileHandle &fileHandle, const Attribute &attribute, vector<int32_t> pages,
+        const uint16_t localDepth, const vector<string> &pairs)
 {
-    InternalHeader header = getInternalHeader(pageData);
+    // Pack the pairs in order, ends[k] being the first pair past page k
+    vector<unsigned> ends;
+    unsigned used = bucketPairsOffset;
+    for (unsigned i = 0; i < pairs.size(); i++)
+    {
+        if (used + pairs[i].size() > PAGE_SIZE)
+        {
+            ends.push_back(i);
+            used = bucketPairsOffset;
+        }
+        used += pairs[i].size();
+    }
+    ends.push_back(pairs.size());
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
+    RC rc;
+    while (pages.size() < ends.size())
+    {
+        int32_t pageNum;
+        rc = allocatePage(fileHandle, pageNum);
+        if (rc)
+            return rc;
+        pages.push_back(pageNum);
+    }
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    unsigned first = 0;
+    for (unsigned k = 0; k < ends.size(); k++)
     {
-        // Scan through until we find a matching key
-        if(compareSlot(attr, key, pageData, i) == 0)
+        memset(pageData, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_BUCKET, pageData);
+        BucketHeader header;
+        header.next = k + 1 < ends.size() ? pages[k + 1] : 0;
+        header.localDepth = localDepth;
+        header.entriesNumber = ends[k] - first;
+        header.freeSpaceOffset = bucketPairsOffset;
+        for (unsigned i = first; i < ends[k]; i++)
         {
-            break;
+            memcpy((char*)pageData + header.freeSpaceOffset, pairs[i].data(), pairs[i].size());
+            header.freeSpaceOffset += pairs[i].size();
+        }
+        setBucketHeader(header, pageData);
+        rc = writeNewPage(fileHandle, pages[k], pageData);
+        if (rc)
+        {
+            free(pageData);
+            return rc;
         }
+        first = ends[k];
     }
-    if (i == header.entriesNumber)
+    free(pageData);
+
+    // Pages the pairs no longer need go back on the free list
+    for (unsigned k = ends.size(); k < pages.size(); k++)
     {
-        // error out if no match
-        return IX_RECORD_DN_EXIST;
+        rc = deallocatePage(fileHandle, pages[k]);
+        if (rc)
+            return rc;
     }
+    return SUCCESS;
+}
 
-    IndexEntry entry = getIndexEntry(i, pageData);
+unsigned IndexManager::getPairLength(const Attribute &attribute, const char *pair) const
+{
+    if (attribute.type != TypeVarChar)
+        return sizeof(RID) + INT_SIZE;
+    int32_t varcharLength;
+    memcpy(&varcharLength, pair + sizeof(RID), VARCHAR_LENGTH_SIZE);
+    return sizeof(RID) + VARCHAR_LENGTH_SIZE + varcharLength;
+}
 
-    // Get positions where deleted entry starts and end
-    unsigned slotStartOffset = getOffsetOfInternalSlot(i);
-    unsigned slotEndOffset = getOffsetOfInternalSlot(header.entriesNumber);
+void IndexManager::setBucketHeader(const BucketHeader header, void *pageData)
+{
+    memcpy((char*)pageData + sizeof(NodeType), &header, sizeof(BucketHeader));
+}
 
-    // Move entries over, overwriting the slot being deleted
-    memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(IndexEntry), slotEndOffset - slotStartOffset - sizeof(IndexEntry));
-    // Update entriesNumber
-    header.entriesNumber -= 1;
+BucketHeader IndexManager::getBucketHeader(const void *pageData) const
+{
+    BucketHeader header;
+    memcpy(&header, (const char*)pageData + sizeof(NodeType), sizeof(BucketHeader));
+    return header;
+}
 
-    // Now, if we're a varchar, we need to move all of the varchars over as well
-    if (attr.type == TypeVarChar)
-    {
-        int32_t varcharOffset = entry.varcharOffset;
-        int32_t varchar_len;
-        memcpy(&varchar_len, (char*)pageData + varcharOffset, VARCHAR_LENGTH_SIZE);
-        int32_t entryLen = varchar_len + VARCHAR_LENGTH_SIZE;
+// Prints each bucket once, at the first directory entry pointing to it
+void IndexManager::printHash(IXFileHandle &ixfileHandle, const Attribute &attribute) const
+{
+    ixfileHandle.latchTree(true);
+    vector<uint32_t> directory;
+    uint32_t globalDepth = 0;
+    readDirectory(ixfileHandle, directory, globalDepth);
 
-        // Take everything from start of free space until the starting offset of the varchar, and move it over where the varchar once was
-        memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
-        header.freeSpaceOffset += entryLen;
-        // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
+    cout << "{\"globalDepth\":" << globalDepth << ",\n  \"buckets\":[";
+    bool first = true;
+    for (uint32_t slot = 0; slot < directory.size(); slot++)
+    {
+        vector<string> pairs;
+        vector<int32_t> pages;
+        uint16_t localDepth;
+        if (readBucketChain(ixfileHandle, attribute, directory[slot], pairs, pages, localDepth) || slot >= (1u << localDepth))
+            continue;
+        cout << (first ? "\n  " : ",\n  ") << "{\"localDepth\":" << localDepth << ",\"pages\":" << pages.size() << ",\"keys\":[";
+        first = false;
+        for (unsigned i = 0; i < pairs.size(); i++)
         {
-            entry = getIndexEntry(i, pageData);
-            if (entry.varcharOffset < varcharOffset)
-                entry.varcharOffset += entryLen;
-            setIndexEntry(entry, i, pageData);
+            const char *key = pairs[i].data() + sizeof(RID);
+            RID rid;
+            memcpy(&rid, pairs[i].data(), sizeof(RID));
+            cout << (i == 0 ? "\"" : ",\"");
+            if (attribute.type == TypeInt)
+                cout << *(const int32_t*)key;
+            else if (attribute.type == TypeReal)
+                cout << *(const float*)key;
+            else
+                cout << string(key + VARCHAR_LENGTH_SIZE, pairs[i].size() - sizeof(RID) - VARCHAR_LENGTH_SIZE);
+            cout << ":(" << rid.pageNum << "," << rid.slotNum << ")\"";
         }
+        cout << "]}";
     }
-    setInternalHeader(header, pageData);
-    return SUCCESS;
-}
\ No newline at end of file
+    cout << "\n  ]\n}" << endl;
+    ixfileHandle.unlatchTree();
+}
@@ -3,14 +3,47 @@
 
 #include <vector>
 #include <string>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include <pthread.h>
 
 #include "../rbf/rbfm.h"
 #include "../rbf/pfm.h"
 
 #define IX_TYPE_LEAF     0
 #define IX_TYPE_INTERNAL 1
+#define IX_TYPE_FREE     2
+#define IX_TYPE_OVERFLOW 3
+#define IX_TYPE_BUCKET    4
+#define IX_TYPE_DIRECTORY 5
 
 # define IX_EOF (-1)  // end of the index scan
+
+// When the next leaf of a scan directly follows the current one in the file, read this many pages at once
+#define IX_SCAN_PAGES_PER_READ 8
+
+// Levels of the tree, counting from the root, whose internal nodes an IXFileHandle keeps copies of
+// unless changed with setResidentLevels
+#define IX_RESIDENT_LEVELS 2
+
+// Share of each node a bulk load fills, unless changed with IndexManager::setFillFactor.
+// The rest is left for later inserts.
+#define IX_FILL_FACTOR 0.9
+// Bytes of <key, rid> pairs IX_EntrySorter sorts in memory before spilling a sorted run to disk
+#define IX_SORT_RUN_SIZE (16 * 1024 * 1024)
+// A key keeps its rids in its leaf until they take more than this many bytes compressed. Then they
+// move to a list of overflow pages.
+#define IX_INLINE_RIDS_LENGTH (PAGE_SIZE / 8)
+// Leaves of an index file hash to this many latches (see IX_FileLatches)
+#define IX_LEAF_LATCHES 64
+// Int and real node searches stop halving at this many entries and compare the keys left with SIMD
+#define IX_SEARCH_WINDOW 32
+// A hash index directory grows to at most 2^IX_HASH_MAX_DEPTH entries. Buckets whose keys share more
+// hash bits than that get overflow pages instead of splitting.
+#define IX_HASH_MAX_DEPTH 16
+// Entries of a hash index directory page, after its node type and entry count
+#define IX_DIRECTORY_ENTRIES ((PAGE_SIZE - sizeof(NodeType) - sizeof(uint32_t)) / sizeof(uint32_t))
 #define IX_CREATE_FAILED          1
 #define IX_OPEN_FAILED            2
 #define IX_MALLOC_FAILED          3
@@ -24,24 +57,36 @@
 #define IX_INSERT_INTERNAL_FAILED 11
 #define IX_WRITE_FAILED           12
 #define IX_NO_FREE_SPACE          13
+#define IX_NOT_EMPTY              14
+#define IX_SORT_FAILED            15
+#define IX_HASH_RANGE             16  // Hash indexes only answer equality and full scans
 
 
 // Headers and data types
 
+// Kinds of index file. A B+ tree answers any range, a hash index equality lookups in about one page read.
+typedef enum { IX_INDEX_BTREE = 0, IX_INDEX_HASH } IndexType;
+
 // First byte of each Node gives the type of the node. 0 for leaf, non-zero for internal
 typedef char NodeType;
 
 // Leaf nodes contain pointers to prev and next nodes in linked list of leafs
 // Also contain number of keys within and pointer to free space
 // 0 is always meta node, so a 0 value for next/prev is like NULL
+// The bytes all varchar keys of a leaf start with are kept once, in the last prefixLength bytes of
+// the page, and each key stores only the rest.
 typedef struct LeafHeader
 {
 	uint32_t next;
 	uint32_t prev;
 	uint16_t entriesNumber;
 	uint16_t freeSpaceOffset;
+	uint16_t prefixLength;
 } LeafHeader;
 
+// Leaves hold each key once, with the rids of all its entries sorted and compressed (see
+// IndexManager::encodeRids). Varchar keys (less the leaf prefix) and the rids are stored from the end
+// of the page, below the prefix.
 typedef struct DataEntry
 {
 	union
@@ -50,9 +95,25 @@ typedef struct DataEntry
 		float real;
 		int32_t varcharOffset;
 	};
-	RID rid;
+	uint16_t ridsOffset;    // Where the rids of the key are
+	uint16_t ridsLength;    // Bytes of compressed rids there, 0 if an OverflowEntry is there instead
 } DataEntry;
 
+// Stands in a leaf for the rids of a key that are on overflow pages
+typedef struct OverflowEntry
+{
+	uint32_t firstPage;
+	uint32_t ridsNumber;
+} OverflowEntry;
+
+// Each overflow page of a key holds the next part of its sorted rids, compressed after the header
+typedef struct OverflowHeader
+{
+	uint32_t next;          // 0 for the last page
+	uint16_t ridsNumber;
+	uint16_t length;
+} OverflowHeader;
+
 // each entry has offset to key and link to child
 typedef struct IndexEntry
 {
@@ -73,6 +134,17 @@ typedef struct InternalHeader
     uint32_t leftChildPage;
 } InternalHeader;
 
+// Hash index buckets hold <rid, key> pairs, each a RID followed by the key in the format of
+// insertEntry, in no order. Pairs that do not fit go on overflow buckets linked from next, which
+// share the localDepth of the first: the number of low hash bits all keys of the bucket have in common.
+typedef struct BucketHeader
+{
+	uint32_t next;          // 0 for the last page
+	uint16_t localDepth;
+	uint16_t entriesNumber;
+	uint16_t freeSpaceOffset;
+} BucketHeader;
+
 // Used in insert to carry up result of each recursive insert
 typedef struct ChildEntry
 {
@@ -82,34 +154,68 @@ typedef struct ChildEntry
 
 // Header for metadata page, page 0
 // Contains pointer to root node so that root node can be moved when split
+// Pages deletes free up are kept on a list for splits to reuse. Each one links to the next in its
+// last bytes, and a freed leaf or overflow page keeps its header (with no entries) so that a scan
+// stopped on it carries on.
 typedef struct MetaHeader
 {
 	uint32_t rootPage;
+	uint32_t freePage;  // First page of the free list, 0 if it is empty
+	uint32_t indexType; // An IndexType
+	// Hash indexes only. Keys go to the directory entry given by the low globalDepth bits of their
+	// hash. The directory is on directoryPages pages, whose numbers follow this header.
+	uint32_t globalDepth;
+	uint32_t directoryPages;
 } MetaHeader;
 
+// Latches of an index file, shared by every IXFileHandle open on it. Threads working on the same
+// index each open a handle of their own on it.
+// - tree: taken shared by descents, scans and changes that stay within one leaf, and exclusive by
+//   splits, merges and anything else that changes internal nodes or the root. The resident copies of
+//   a handle are only checked and taken under it.
+// - leaves: whoever shares the tree latches the leaf it reads or changes, and only that one.
+//   Leaves hash to these by page number.
+// - pages: the free list and the meta page, for allocatePage, deallocatePage and reads of the root.
+//   Nothing else is latched while it is held.
+typedef struct IX_FileLatches
+{
+    FileId fileId;
+    unsigned handles;   // Handles open on the file, the latches go with the last one
+    pthread_rwlock_t tree;
+    pthread_rwlock_t leaves[IX_LEAF_LATCHES];
+    mutex pages;
+} IX_FileLatches;
+
 class IX_ScanIterator;
 class IXFileHandle;
+class IX_EntrySorter;
 
 class IndexManager {
 
     public:
         static IndexManager* instance();
 
-        // Create an index file.
-        RC createFile(const string &fileName);
+        // Create an index file of the given type. The other methods work on either type, except that
+        // scans of a hash index are equality or full scans, and full scans return entries in no order.
+        RC createFile(const string &fileName, const IndexType type = IX_INDEX_BTREE);
 
         // Delete an index file.
         RC destroyFile(const string &fileName);
 
-        // Open an index and return an ixfileHandle.
-        RC openFile(const string &fileName, IXFileHandle &ixfileHandle);
+        // Open an index and return an ixfileHandle. See FileAccessMode for mode.
+        RC openFile(const string &fileName, IXFileHandle &ixfileHandle, FileAccessMode mode = FILE_ACCESS_BUFFERED);
 
         // Close an ixfileHandle for an index.
         RC closeFile(IXFileHandle &ixfileHandle);
 
         // Insert an entry into the given index that is indicated by the given ixfileHandle.
+        // Inserts, deletes and scans may run on many threads at once, each with its own handle.
         RC insertEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
+        // Insert the pairs of sorter, which is sorted first if needed. Each descent inserts the run of
+        // pairs that belong in the leaf it reaches, and a leaf that fills up splits as with insertEntry.
+        RC insertEntries(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter);
+
         // Delete an entry from the given index that is indicated by the given ixfileHandle.
         RC deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
@@ -122,6 +228,19 @@ class IndexManager {
                 bool highKeyInclusive,
                 IX_ScanIterator &ix_ScanIterator);
 
+        // Copy the greatest key of a B+ tree index to key, going down the last child of each node.
+        // Returns IX_EOF if the index is empty, and IX_HASH_RANGE for a hash index.
+        RC findMaxKey(IXFileHandle &ixfileHandle, const Attribute &attribute, void *key);
+
+        // Build the index of a freshly created index file from the pairs of sorter, which is sorted
+        // first if needed. Leaves are written left to right, one after another, then each internal level
+        // above them. Nodes are filled to the fill factor, but all entries of a key go in the same leaf.
+        RC bulkLoad(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter);
+
+        // Share of each node bulkLoad fills, between 0 and 1
+        void setFillFactor(float fillFactor);
+        float getFillFactor() const;
+
         // Print the B+ tree in pre-order (in a JSON record format)
         void printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const;
         friend class IX_ScanIterator;
@@ -132,29 +251,47 @@ class IndexManager {
 
     private:
         static IndexManager *_index_manager;
+        float fillFactor;
+
+        // Latches of the open index files, by buffer pool file id
+        map<FileId, IX_FileLatches*> fileLatches;
+        mutex fileLatchesMutex;
+        IX_FileLatches *acquireLatches(const FileId fileId);
+        void releaseLatches(IX_FileLatches *latches);
+
+        // Insert or delete within the leaf the key belongs in, sharing the tree. An insert that needs
+        // the leaf split fails with IX_NO_FREE_SPACE, having changed nothing. A delete sets underflow if
+        // it left the leaf less than half full.
+        RC insertWithinLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        // Inserts <key, rid> and the pairs after it in sorter into the leaf key belongs in, for as long as
+        // they belong there, sharing the tree. Leaves key and rid at the first pair not inserted and
+        // returns SUCCESS, IX_EOF once sorter is done, or IX_NO_FREE_SPACE if that pair did not fit.
+        RC insertRun(IXFileHandle &fileHandle, const Attribute &attribute, IX_EntrySorter &sorter, void *key, RID &rid);
+        RC deleteWithinLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid, bool &underflow);
 
         // Utility function for insertEntry
-        RC insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry);
+        RC insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, const unsigned level, ChildEntry &childEntry);
         // Inserts ChildEntry <key, pageNum> into internal node. Returns an error if there's not enough space
         RC insertIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData);
         // Inserts <key, rid> into the given leaf node. Returns an error if there's not enough free space
-        RC insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData);
+        RC insertIntoLeaf(IXFileHandle &fileHandle, const Attribute attribute, const void *key, const RID &rid, void *pageData);
 
         // Gets offset to a leaf slot with the given slot number
         int getOffsetOfLeafSlot(int slotNum) const;
         // Gets offset to an internal slot with the given slot number
         int getOffsetOfInternalSlot(int slotNum) const;
 
-        // Handles splitting a leaf
+        // Handles splitting a leaf. The split goes where the halves, each with its own prefix, come out
+        // most even, and the shortest separator between them moves up.
         RC splitLeaf(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID rid, const int32_t pageID, void *originalLeaf, ChildEntry &childEntry);
         // Handles splitting an internal node, including the case where the root needs to be split
-        RC splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *original, ChildEntry &childEntry);
+        RC splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *originalPage, ChildEntry &childEntry);
 
         // Helper functions for printBtree
         void printBtree_rec(IXFileHandle &ixfileHandle, string prefix, const int32_t currPage, const Attribute &attr) const;
         void printInternalNode(IXFileHandle &, void *pageData, const Attribute &attr, string prefix) const;
         void printInternalSlot(const Attribute &attr, const int32_t slotNum, const void *data) const;
-        void printLeafNode(void *pageData, const Attribute &attr) const;
+        void printLeafNode(IXFileHandle &ixfileHandle, void *pageData, const Attribute &attr) const;
 
         // Each method in this block gets or sets some header data for different types of pages
         void setMetaData(const MetaHeader header, void *pageData);
@@ -172,35 +309,169 @@ class IndexManager {
 
         RC getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const;
 
-        // Finds the leaf page that would contain key
-        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum);
+        // Finds the leaf page that would contain key. If upperBound is given, it is set to the separator
+        // every key of the leaf is less than or equal to, or left empty for the last leaf.
+        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, string *upperBound = NULL);
         // Finds the leaf page that would contain key, starting at currPageNum. Utility function for find.
-        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum);
-        // Given an attribute, key, and internal node, returns the pagenumber of the childPage who would contain key
-        int32_t getNextChildPage(const Attribute attr, const void *key, void *pageData);
+        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, const unsigned level,
+                int32_t &resultPageNum, string *upperBound = NULL);
+        // Given an attribute, key, and internal node, returns the pagenumber of the childPage who would contain key.
+        // Sets upperBound, if given, to the separator right of that child when there is one.
+        int32_t getNextChildPage(const Attribute attr, const void *key, const void *pageData, string *upperBound = NULL);
+        // One step of a descent for key, at pageNum on the given level below the root. Sets isLeaf if
+        // pageNum is a leaf, otherwise childPage to the child to follow. Uses the handle's resident copy
+        // of the node when there is one.
+        RC getChildPage(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t pageNum,
+                const unsigned level, bool &isLeaf, int32_t &childPage, string *upperBound = NULL);
+
+        // Binary search over the sorted slots of a node. Returns the first slot whose key is greater
+        // than or equal to key, or greater than key when inclusive is false.
+        int searchInternal(const Attribute attr, const void *key, const void *pageData, bool inclusive) const;
+        int searchLeaf(const Attribute attr, const void *key, const void *pageData, bool inclusive) const;
+        // The same search over the int or real keys of count entries from entries, which are all as wide
+        // as a DataEntry. Binary search narrows it down to IX_SEARCH_WINDOW entries, whose keys
+        // countBefore compares several at a time.
+        template <typename T>
+        static int searchFixed(const char *entries, const int count, const T key, const bool inclusive);
+        // Number of the count entries from entries whose keys are less than key (or equal to it, when
+        // inclusive is false). Specialized for int32_t and float.
+        template <typename T>
+        static int countBefore(const char *entries, const int count, const T key, const bool inclusive);
 
         // Compares key to the value in pageDat at slotNum. For internal nodes.
         int compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
         // Compares key to the value in pageData at slotNum. For leaf nodes.
         int compareLeafSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
-        // Returns -1, 0, or 1 if key is less than, equal to, or greater than value
-        int compare(const int key, const int value) const;
-        int compare(const float key, const float value) const;
-        int compare(const char *key, const char *value) const;
+        // As above, for a key already normalized (see KeyNormalizer)
+        int compareNormalizedSlot(const Attribute &attr, const char *key, const unsigned length, const void *pageData, const int slotNum) const;
+        int compareNormalizedLeafSlot(const Attribute &attr, const char *key, const unsigned length, const void *pageData, const int slotNum) const;
 
         // Returns the amount of space requried to store this key in an internal node
         int getKeyLengthInternal(const Attribute attr, const void *key) const;
-        // Returns the amount of space required to store this key in a leaf
+        // Returns the amount of space required to store this key in a leaf, not counting its rids
         int getKeyLengthLeaf(const Attribute attr, const void *key) const;
         // Returns the amount of free space in the internal node
-        int getFreeSpaceInternal(void *pageData) const;
+        int getFreeSpaceInternal(const void *pageData) const;
         // Returns the amount of free space in the leaf
-        int getFreeSpaceLeaf(void *pageData) const;
+        int getFreeSpaceLeaf(const void *pageData) const;
 
         // Deletes an entry with key key and rid rid from leaf given by pageData
-        RC deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData);
+        RC deleteEntryFromLeaf(IXFileHandle &fileHandle, const Attribute attr, const void *key, const RID &rid, void *pageData);
+
+        // Compresses rids[from, to), which are sorted, into out. Each rid is its page number less the one
+        // before, then its slot number, less the one before too if the page is the same, as varints.
+        // Stops before a rid that would take it past maxLength. Returns the rids written and sets length.
+        unsigned encodeRids(const vector<RID> &rids, unsigned from, unsigned to, char *out, unsigned maxLength, unsigned &length) const;
+        // Appends the rids compressed in length bytes at in
+        void decodeRids(const char *in, unsigned length, vector<RID> &rids) const;
+        static unsigned putVarint(uint32_t value, char *out);
+        static uint32_t getVarint(const char *in, unsigned &pos);
+        static bool ridLess(const RID &a, const RID &b);
+
+        // All rids of the key in slotNum, from its overflow pages if it has them
+        RC getLeafRids(IXFileHandle &fileHandle, const void *pageData, const int slotNum, vector<RID> &rids) const;
+        // Bytes slotNum takes in a leaf: the slot, a varchar key and the rids or OverflowEntry
+        int getLeafSlotLength(const Attribute &attribute, const void *pageData, const int slotNum) const;
+        // Adds a slot at slotNum for key, with ridsLength bytes of rids, or an OverflowEntry if ridsLength is 0.
+        // The leaf prefix is shortened if key does not start with it.
+        RC insertLeafSlot(const Attribute &attribute, void *pageData, const int slotNum, const void *key,
+                const void *rids, const uint16_t ridsLength);
+        void removeLeafSlot(const Attribute &attribute, void *pageData, const int slotNum);
+        // Copies slotNum of source with its rids to where its key goes in target
+        RC copyLeafSlot(const Attribute &attribute, const void *source, const int slotNum, void *target);
+        // Replaces the rids of slotNum, as for insertLeafSlot
+        RC setLeafRids(const Attribute &attribute, void *pageData, const int slotNum, const void *rids, const uint16_t ridsLength);
+        // Moves the stored keys and rids between the free space and offset by delta bytes, fixing the slots
+        // that point to them
+        void shiftLeafHeap(const Attribute &attribute, void *pageData, const int offset, const int delta);
+        // Stores the keys of the leaf again under the first length bytes of key as their prefix, which
+        // they must all start with
+        RC setLeafPrefix(const Attribute &attribute, void *pageData, const void *key, const unsigned length);
+        // Bytes in use in the leaf if its prefix were length bytes long
+        int getLeafUsedWithPrefix(const void *pageData, const unsigned length) const;
+        // Prefix of the leaf, in the format of a varchar key
+        string getLeafPrefix(const void *pageData) const;
+        // Bytes two varchar keys, in the format of insertEntry, start with in common
+        static unsigned commonPrefixLength(const string &a, const string &b);
+        // Shortest key that is not less than leftMax and less than rightMin, to separate them in a parent
+        string shortestSeparator(const Attribute &attribute, const string &leftMax, const string &rightMin) const;
+        // Compares two keys in the format of insertEntry
+        int compareKeys(const Attribute &attribute, const void *a, const void *b) const;
+
+        // Overflow page lists. Pages that fill up split in two, and pages that empty are freed.
+        RC writeOverflowPages(IXFileHandle &fileHandle, const vector<RID> &rids, int32_t &firstPage);
+        RC insertIntoOverflow(IXFileHandle &fileHandle, const int32_t firstPage, const RID &rid);
+        RC deleteFromOverflow(IXFileHandle &fileHandle, int32_t &firstPage, const RID &rid);
+        OverflowHeader getOverflowHeader(const void *pageData) const;
+        void setOverflowHeader(const OverflowHeader header, void *pageData);
+        // bulkLoad with the tree latched
+        RC bulkLoadTree(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntrySorter &sorter);
+        // Helpers for bulkLoad. Each level is kept as its node pages and the largest key under each
+        RC bulkLoadLeaves(IXFileHandle &fileHandle, const Attribute &attribute, IX_EntrySorter &sorter,
+                vector<int32_t> &pages, vector<string> &maxKeys);
+        RC bulkLoadInternal(IXFileHandle &fileHandle, const Attribute &attribute,
+                vector<int32_t> &pages, vector<string> &maxKeys);
+        // Adds the entries of one key to the leaf being built, which goes on leafPage, starting a new leaf
+        // when they would take it past the fill factor
+        RC bulkLoadKey(IXFileHandle &fileHandle, const Attribute &attribute, const string &key, const vector<RID> &rids,
+                void *leaf, int32_t &leafPage, vector<int32_t> &pages, vector<string> &maxKeys);
+        // Key in slotNum of a node, in the format of insertEntry
+        string getLeafKey(const Attribute &attribute, const void *pageData, const int slotNum) const;
+        string getInternalKey(const Attribute &attribute, const void *pageData, const int slotNum) const;
+
+        // Pages for new nodes come from the free list in the meta page, or else are appended to the file
+        // at once, so that threads growing the file never get the same page. Write them with writeNewPage.
+        RC allocatePage(IXFileHandle &fileHandle, int32_t &pageNum);
+        RC writeNewPage(IXFileHandle &fileHandle, const int32_t pageNum, const void *pageData);
+        RC deallocatePage(IXFileHandle &fileHandle, const int32_t pageNum);
+        RC setRootPageNum(IXFileHandle &fileHandle, const int32_t rootPage);
+
+        // Utility function for deleteEntry. Sets underflow if pageID is left less than half full. With no
+        // rid the entry is already gone, and only the leaf key leads to is evened out.
+        RC remove(const Attribute &attribute, const void *key, const RID *rid, IXFileHandle &fileHandle, int32_t pageID, const unsigned level, bool &underflow);
+        // Handles the underfull child of parent that key leads to, by merging it with a sibling or
+        // moving entries over from the sibling. Sets changed if parent was modified.
+        RC rebalance(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, void *parent, bool &changed);
+        RC rebalanceLeaves(IXFileHandle &fileHandle, const Attribute &attribute, void *parent, const int sep,
+                const int32_t leftPage, void *left, void *right, const bool childIsLast, bool &changed, bool &merged);
+        RC rebalanceInternal(const Attribute &attribute, void *parent, const int sep,
+                void *left, void *right, bool &changed, bool &merged);
+        RC collapseRoot(IXFileHandle &fileHandle, const int32_t rootPage);
+        bool leafUnderflows(const void *pageData) const;
+        bool internalUnderflows(const void *pageData) const;
+        bool canReplaceSeparator(const Attribute &attribute, const void *parent, const int sep) const;
+        void replaceSeparator(const Attribute &attribute, void *parent, const int sep, const string &key);
+
         // Deletes key key from the Internal node given by pageData
         RC deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData);
+
+        // Hash indexes. Inserts and deletes take the whole index to themselves, lookups share it.
+        RC createHashFile(IXFileHandle &fileHandle, void *pageData);
+        static uint32_t hashKey(const Attribute &attribute, const void *key);
+        // Bucket directory entry slot points to, and the number of entries there are. slot is taken
+        // modulo that number, so the hash of a key gives the bucket the key is in.
+        RC getDirectoryEntry(IXFileHandle &fileHandle, const uint32_t slot, int32_t &pageNum, uint32_t &entries);
+        RC readDirectory(IXFileHandle &fileHandle, vector<uint32_t> &directory, uint32_t &globalDepth) const;
+        // Writes the directory, adding pages for it if it grew
+        RC writeDirectory(IXFileHandle &fileHandle, const vector<uint32_t> &directory, const uint32_t globalDepth);
+        RC hashInsert(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        RC hashDelete(IXFileHandle &fileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        // Splits the bucket on bucketPage in two by the next bit of the hash, doubling the directory
+        // if the bucket already used all of its bits
+        RC splitBucket(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t bucketPage);
+        // Whether a pair in the bucket differs from hash in the hash bits a bucket can split on
+        bool bucketSeparable(const Attribute &attribute, const void *pageData, const uint32_t hash) const;
+        // The pairs of the bucket starting at firstPage and its overflow pages, and the pages themselves
+        RC readBucketChain(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t firstPage,
+                vector<string> &pairs, vector<int32_t> &pages, uint16_t &localDepth) const;
+        // Writes pairs to a bucket on pages, the first of which stays first. Pages are added or
+        // freed to fit.
+        RC writeBucketChain(IXFileHandle &fileHandle, const Attribute &attribute, vector<int32_t> pages,
+                const uint16_t localDepth, const vector<string> &pairs);
+        unsigned getPairLength(const Attribute &attribute, const char *pair) const;
+        void setBucketHeader(const BucketHeader header, void *pageData);
+        BucketHeader getBucketHeader(const void *pageData) const;
+        void printHash(IXFileHandle &ixfileHandle, const Attribute &attribute) const;
 };
 
 class IXFileHandle {
@@ -227,12 +498,108 @@ class IXFileHandle {
     RC writePage(PageNum pageNum, const void *data);
     RC appendPage(const void *data);
 
+    // Work on the buffer pool frame of a page in place. See FileHandle::pinPage
+    RC pinPage(PageNum pageNum, void *&data);
+    RC unpinPage(PageNum pageNum, bool dirty);
+
+    // Read only access to a page in place. See FileHandle::viewPage
+    RC viewPage(PageNum pageNum, const void *&data);
+    RC releasePage(PageNum pageNum);
+    // See FileHandle::prefetchPages
+    RC prefetchPages(PageNum first, unsigned count);
+    // See FileHandle::prefetchPagesAsync
+    RC prefetchPagesAsync(PageNum first, unsigned count, PageNum (*nextPage)(const void *page) = NULL);
+
+    // The handle keeps copies of the meta header and of the internal nodes on this many levels below
+    // the root, so that descents only go to the buffer pool for the levels under them. 0 turns it off.
+    // Copies are dropped whenever any handle on the file changes the shape of the tree.
+    void setResidentLevels(unsigned levels);
+    unsigned getResidentLevels() const;
+
+    // Type of the index the handle is open on
+    IndexType getIndexType() const;
+
     friend class IndexManager;
+    friend class IX_ScanIterator;
 	private:
         FileHandle fh;
+        IX_FileLatches *latches;
+        IndexType indexType;
+
+        // See IX_FileLatches. These do nothing on a handle that is not open.
+        void latchTree(const bool exclusive);
+        void unlatchTree();
+        void latchLeaf(const PageNum pageNum, const bool exclusive);
+        void unlatchLeaf(const PageNum pageNum);
+
+        unsigned residentLevels;
+        // Version of the file (see FileHandle::getVersion) the copies below were taken at
+        unsigned long residentVersion;
+        bool metaResident;
+        MetaHeader meta;
+        map<PageNum, void*> residentPages;
+        // Level the leaves are on, -1 until a descent reaches one
+        int leafLevel;
+        // Hash indexes: the directory, kept like the internal nodes of a tree
+        bool directoryResident;
+        vector<uint32_t> directory;
+        uint32_t globalDepth;
+
+        // Drops the copies if the tree changed since they were taken
+        void checkResident();
+        void dropResident();
+        const void *getResidentNode(PageNum pageNum);
+        void keepResident(PageNum pageNum, const void *data);
+        int getLeafLevel();
+        void setLeafLevel(unsigned level);
+        // Called after changing the meta page or an internal node
+        void treeChanged();
 
 	};
 
+// Collects <key, rid> pairs in any order and hands them back sorted by key, then rid.
+// Pairs are sorted in memory up to runSize bytes at a time. When there are more, each sorted run
+// is written to a temporary file and the runs are merged as they are read back.
+class IX_EntrySorter {
+    public:
+        IX_EntrySorter(const Attribute &attribute, size_t runSize = IX_SORT_RUN_SIZE);
+        ~IX_EntrySorter();
+
+        RC add(const void *key, const RID &rid);
+        // Done adding. Sorts what is left in memory and prepares to read back
+        RC sort();
+        // Next pair in order, IX_EOF at the end. key is in the format of insertEntry
+        RC getNext(RID &rid, void *key);
+
+        unsigned getNumberOfRuns() const;
+
+    private:
+        // One spilled run and the pair at its head
+        typedef struct SortRun
+        {
+            FILE *file;
+            vector<char> head;
+        } SortRun;
+
+        Attribute attr;
+        size_t runSize;
+        bool sorted;
+        // Pairs of the current run, each a RID followed by its key, and where each starts
+        vector<char> buffer;
+        vector<uint32_t> offsets;
+        size_t nextOffset;
+        vector<SortRun> runs;
+        // Runs with a head still to hand back, ordered as a heap on their heads
+        vector<unsigned> heap;
+
+        void sortBuffer();
+        RC spill();
+        bool readRun(SortRun &run);
+        unsigned pairLength(const char *pair) const;
+        int comparePairs(const char *a, const char *b) const;
+        void siftDown(unsigned pos);
+};
+
 class IX_ScanIterator {
     public:
 
@@ -256,8 +623,56 @@ class IX_ScanIterator {
         const void *highKey;
         bool lowKeyInclusive;
         bool highKeyInclusive;
-        void *page;
+        // The current leaf, viewed in place until we move on or close
+        const void *page;
+        PageNum pageNum;
+        bool pageViewed;
         int slotNum;
+        // The rids of the key in slotNum, all of them or those of one of its overflow pages
+        bool keyLoaded;
+        vector<RID> rids;
+        unsigned ridIndex;
+        PageNum ridsPage;       // The overflow page rids came from, 0 for rids in the leaf
+        PageNum ridsNext;
+        // The slot and its rids (or OverflowEntry) as they were when loaded, to notice changes since
+        string loadedSlot;
+        // The entry returned last, to find our place again when the leaf changed. lastKey is empty
+        // until the first key is loaded.
+        RID lastRid;
+        string lastKey;
+        // Version of the file (see FileHandle::getVersion) when the last call returned. Splits and
+        // merges bump it.
+        unsigned long treeVersion;
+        // Pages before this were brought in by an earlier multi-page read
+        PageNum prefetchedUpTo;
+        // Leaves the prefetch thread was asked to read that we have not reached yet
+        unsigned leavesAhead;
+        // Scans of a hash index load the matching pairs of one bucket at a time into rids and hashKeys.
+        // A full scan goes through the directory from hashSlot, taking each bucket at its first entry.
+        bool hashed;
+        bool hashEquality;
+        uint32_t hashSlot;
+        vector<string> hashKeys;
+
+        RC viewLeaf(PageNum leafPage);
+        void releaseLeaf();
+        // Finds the leaf the scan carries on in again from the root, after splits or merges
+        RC relocate();
+        // Finds where the last entry returned is, or would be, in the current leaf. Before the first
+        // entry, finds where the scan starts.
+        RC findPlace();
+        RC nextEntry(RID &rid, void *key);
+        // Loads the rids of the key in slotNum, skipping those up to lastRid if after is set
+        RC loadRids(bool after);
+        RC loadOverflowPage(PageNum overflowPage);
+        bool slotUnchanged() const;
+        RC initializeHash();
+        RC nextHashEntry(RID &rid, void *key);
+        // Adds the pairs of the bucket on bucketPage with key key, or all of them if key is NULL.
+        // Adds nothing if a directory entry before slot points to the bucket too.
+        RC loadBucket(PageNum bucketPage, const void *key, const uint32_t slot);
+        void readAhead();
+        static PageNum nextLeaf(const void *pageData);
 };
 
 #endif
@@ -6,9 +6,114 @@
 const int fail = -1;
 #endif
 
+#include <functional>
+
 #include "ix.h"
 #include "../rbf/test_util.h"
 
-#endif
+// Pages read through the handle so far
+unsigned pagesRead(IXFileHandle &ixfileHandle)
+{
+    unsigned readPages, writePages, appendPages;
+    ixfileHandle.collectCounterValues(readPages, writePages, appendPages);
+    return readPages;
+}
+
+// Makes key number k, in the format of insertEntry. Varchar keys sort the same way as the numbers.
+void makeCityKey(const Attribute &attribute, int k, char *key)
+{
+    if (attribute.type == TypeInt)
+    {
+        memcpy(key, &k, INT_SIZE);
+        return;
+    }
+    int len = sprintf(key + VARCHAR_LENGTH_SIZE, "city-%06d", k);
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+}
+
+// Entry i has key i % keys and rid <i, 0>
+void makeCityEntry(const Attribute &attribute, int i, int keys, char *key, RID &rid)
+{
+    makeCityKey(attribute, i % keys, key);
+    rid.pageNum = i;
+    rid.slotNum = 0;
+}
+
+// Negative, zero or positive as key a sorts before, with or after key b
+int compareTestKeys(const Attribute &attribute, const char *a, const char *b)
+{
+    if (attribute.type == TypeInt)
+        return *(int*)a < *(int*)b ? -1 : *(int*)a > *(int*)b;
+    if (attribute.type == TypeReal)
+        return *(float*)a < *(float*)b ? -1 : *(float*)a > *(float*)b;
+    return string(a + VARCHAR_LENGTH_SIZE, *(int*)a).compare(string(b + VARCHAR_LENGTH_SIZE, *(int*)b));
+}
 
+// Scans the whole index, checking entries come out in order of key and then rid. If expectedKey is
+// given, it is called with each rid to make the key the entry should have. Returns the number of entries.
+unsigned checkScanOrder(IXFileHandle &ixfileHandle, const Attribute &attribute,
+        const function<void(const RID&, char*)> &expectedKey = nullptr)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = IndexManager::instance()->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
 
+    RID rid;
+    RID lastRid;
+    char key[PAGE_SIZE];
+    char last[PAGE_SIZE];
+    char expected[PAGE_SIZE];
+    unsigned count = 0;
+    while ((rc = ix_ScanIterator.getNextEntry(rid, key)) == success)
+    {
+        if (expectedKey)
+        {
+            expectedKey(rid, expected);
+            assert(compareTestKeys(attribute, key, expected) == 0 && "the key should be the one inserted with the rid");
+        }
+        if (count > 0)
+        {
+            int order = compareTestKeys(attribute, last, key);
+            assert(order <= 0 && "keys should come out in order");
+            assert((order < 0 || lastRid.pageNum < rid.pageNum || (lastRid.pageNum == rid.pageNum && lastRid.slotNum < rid.slotNum))
+                    && "rids of a key should come out in order once");
+        }
+        memcpy(last, key, attribute.type == TypeVarChar ? VARCHAR_LENGTH_SIZE + *(int*)key : INT_SIZE);
+        lastRid = rid;
+        count++;
+    }
+    assert(rc == IX_EOF && "the scan should end at the end of the index.");
+    ix_ScanIterator.close();
+    return count;
+}
+
+// Scans an index of entries made by makeCityEntry, checking each has the key of its rid
+unsigned checkScanOrder(IXFileHandle &ixfileHandle, const Attribute &attribute, int keys)
+{
+    return checkScanOrder(ixfileHandle, attribute,
+        [&](const RID &rid, char *key) {makeCityKey(attribute, rid.pageNum % keys, key);});
+}
+
+// Number of entries a scan between low and high returns
+int countBetween(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *low, const void *high,
+        bool lowInclusive, bool highInclusive)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = IndexManager::instance()->scan(ixfileHandle, attribute, low, high, lowInclusive, highInclusive, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    RID rid;
+    char key[PAGE_SIZE];
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+        count++;
+    ix_ScanIterator.close();
+    return count;
+}
+
+// Number of entries with the key
+unsigned countEqual(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key)
+{
+    return countBetween(ixfileHandle, attribute, key, key, true, true);
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Counts the entries of [low, high] with the given inclusiveness, checking they come out in order
+static unsigned countRange(IXFileHandle &ixfileHandle, const Attribute &attribute,
+        const void *low, const void *high, bool lowInc, bool highInc)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = indexManager->scan(ixfileHandle, attribute, low, high, lowInc, highInc, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    RID rid;
+    char key[PAGE_SIZE];
+    char last[PAGE_SIZE];
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        if (count > 0)
+        {
+            if (attribute.type == TypeInt)
+                assert(*(int*)last <= *(int*)key && "keys should come out in order");
+            else if (attribute.type == TypeReal)
+                assert(*(float*)last <= *(float*)key && "keys should come out in order");
+        }
+        memcpy(last, key, PAGE_SIZE);
+        count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+static void prepareVarcharKey(int value, char *key)
+{
+    char text[16];
+    int len = sprintf(text, "key%05d", value);
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    memcpy(key + VARCHAR_LENGTH_SIZE, text, len);
+}
+
+static void prepareKey(const Attribute &attribute, int value, char *key)
+{
+    if (attribute.type == TypeInt)
+        memcpy(key, &value, INT_SIZE);
+    else if (attribute.type == TypeReal)
+    {
+        float real = value + 0.5;
+        memcpy(key, &real, REAL_SIZE);
+    }
+    else
+        prepareVarcharKey(value, key);
+}
+
+int testCase_16(const string &indexFileName, const Attribute &attribute)
+{
+    // Checks range starts and deletes among duplicate keys, now that nodes are binary searched.
+    //
+    // Functions tested
+    // 1. Insert keys 0..distinct-1, each copies times, in scrambled order
+    // 2. Scan ranges with every combination of inclusive bounds, including keys not in the index
+    // 3. Delete one (key, rid) out of a run of duplicates **
+    // 4. Delete entries that do not exist **
+    cerr << endl << "***** In IX Test Case 16 (type " << attribute.type << ") *****" << endl;
+
+    const int distinct = 400;
+    const int copies = 6;
+    char key[PAGE_SIZE];
+    char high[PAGE_SIZE];
+    RID rid;
+    IXFileHandle ixfileHandle;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // 7919 is prime, so this visits every (value, copy) pair once in a scrambled order
+    const int total = distinct * copies;
+    for (int n = 0; n < total; n++)
+    {
+        int i = (n * 7919) % total;
+        int value = i % distinct;
+        rid.pageNum = value;
+        rid.slotNum = i / distinct;
+        prepareKey(attribute, value, key);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // Whole index, then ranges whose ends are present in the index
+    assert(countRange(ixfileHandle, attribute, NULL, NULL, true, true) == (unsigned)total);
+    prepareKey(attribute, 100, key);
+    prepareKey(attribute, 200, high);
+    assert(countRange(ixfileHandle, attribute, key, high, true, true) == 101 * copies);
+    assert(countRange(ixfileHandle, attribute, key, high, false, true) == 100 * copies);
+    assert(countRange(ixfileHandle, attribute, key, high, true, false) == 100 * copies);
+    assert(countRange(ixfileHandle, attribute, key, high, false, false) == 99 * copies);
+    assert(countRange(ixfileHandle, attribute, key, key, true, true) == copies);
+    assert(countRange(ixfileHandle, attribute, key, NULL, true, true) == (distinct - 100) * copies);
+    prepareKey(attribute, distinct - 1, key);
+    assert(countRange(ixfileHandle, attribute, key, NULL, false, true) == 0);
+    prepareKey(attribute, 0, key);
+    assert(countRange(ixfileHandle, attribute, NULL, key, true, false) == 0);
+
+    // Ranges starting before the first key and after the last one
+    if (attribute.type == TypeInt)
+    {
+        int below = -5, above = distinct + 5;
+        assert(countRange(ixfileHandle, attribute, &below, NULL, false, true) == (unsigned)total);
+        assert(countRange(ixfileHandle, attribute, &above, NULL, true, true) == 0);
+    }
+
+    // Delete each copy of key 150 one at a time, from the middle of the run outwards
+    int order[copies] = {3, 2, 4, 1, 5, 0};
+    prepareKey(attribute, 150, key);
+    for (int c = 0; c < copies; c++)
+    {
+        rid.pageNum = 150;
+        rid.slotNum = order[c];
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc != success && "deleting the same entry twice should fail.");
+        assert(countRange(ixfileHandle, attribute, key, key, true, true) == (unsigned)(copies - c - 1));
+    }
+
+    // A present key with an rid it was never inserted with, and a key that is not there at all
+    prepareKey(attribute, 151, key);
+    rid.pageNum = 151;
+    rid.slotNum = copies;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "deleting an entry that was never inserted should fail.");
+    prepareKey(attribute, 150, key);
+    rid.slotNum = 0;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "deleting an entry that was never inserted should fail.");
+
+    prepareKey(attribute, 149, key);
+    prepareKey(attribute, 151, high);
+    assert(countRange(ixfileHandle, attribute, key, high, true, true) == 2 * copies);
+    assert(countRange(ixfileHandle, attribute, NULL, NULL, true, true) == (unsigned)(total - copies));
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrHeight;
+    attrHeight.length = 4;
+    attrHeight.name = "height";
+    attrHeight.type = TypeReal;
+
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    if (testCase_16("age_idx", attrAge) == success
+        && testCase_16("height_idx", attrHeight) == success
+        && testCase_16("name_idx", attrName) == success)
+    {
+        cerr << "***** IX Test Case 16 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 16 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+int testCase_17_int(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Bulk load from pairs added in scrambled order, sorted in several spilled runs **
+    // 2. Scan the loaded index **
+    // 3. Insert and delete entries on a bulk loaded tree
+    // 4. Bulk load into an index that is not empty **
+    cerr << endl << "***** In IX Test Case 17 (int) *****" << endl;
+
+    const int numOfTuples = 30000;
+    const int copies = 3;
+    IXFileHandle ixfileHandle;
+    RID rid;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Small runs so that the sort has to merge
+    IX_EntrySorter sorter(attribute, 64 * 1024);
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        // 7919 is prime, so every i in [0, numOfTuples) comes up once
+        int i = (n * 7919) % numOfTuples;
+        int key = i / copies;
+        rid.pageNum = i;
+        rid.slotNum = i % copies;
+        rc = sorter.add(&key, rid);
+        assert(rc == success && "IX_EntrySorter::add() should not fail.");
+    }
+    assert(sorter.getNumberOfRuns() > 1 && "the pairs should not have fit in one run.");
+
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+    int key = 1234;
+    assert(countEqual(ixfileHandle, attribute, &key) == (unsigned)copies);
+
+    // Leaves are packed to the fill factor: a 12 byte entry each, 90% of a 4K page
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    cerr << "Pages after bulk load: " << pages << endl;
+    assert(pages < numOfTuples * 12 / (PAGE_SIZE * 0.85) + 8 && "leaves should be packed.");
+
+    // The loaded tree takes inserts (including splits) and deletes like any other
+    for (int i = 0; i < numOfTuples; i += 2)
+    {
+        key = i / copies;
+        rid.pageNum = numOfTuples + i;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    for (int i = 0; i < numOfTuples; i += 3)
+    {
+        key = i / copies;
+        rid.pageNum = i;
+        rid.slotNum = i % copies;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)(numOfTuples + numOfTuples / 2 - numOfTuples / 3));
+
+    // Only an index fresh from createFile can be bulk loaded
+    IX_EntrySorter again(attribute);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, again);
+    assert(rc == IX_NOT_EMPTY && "bulk loading a non empty index should fail.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_17_varchar(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Bulk load varchar keys in memory with a lower fill factor **
+    // 2. Bulk load of nothing **
+    cerr << endl << "***** In IX Test Case 17 (varchar) *****" << endl;
+
+    const int numOfTuples = 5000;
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    IX_EntrySorter sorter(attribute);
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        int i = (n * 7919) % numOfTuples;
+        // Lengths differ, so the order is not that of the numbers
+        int len = sprintf(key + VARCHAR_LENGTH_SIZE, "%d%.*s", i, i % 7, "zzzzzz");
+        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = sorter.add(key, rid);
+        assert(rc == success && "IX_EntrySorter::add() should not fail.");
+    }
+    assert(sorter.getNumberOfRuns() == 0 && "the pairs should have fit in memory.");
+
+    indexManager->setFillFactor(0.5);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    indexManager->setFillFactor(IX_FILL_FACTOR);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+
+    int len = sprintf(key + VARCHAR_LENGTH_SIZE, "%d%.*s", 4321, 4321 % 7, "zzzzzz");
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    assert(countEqual(ixfileHandle, attribute, key) == 1);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    // Nothing to load leaves an empty, working index
+    rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    IX_EntrySorter empty(attribute);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, empty);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    assert(checkScanOrder(ixfileHandle, attribute) == 0);
+    rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    assert(checkScanOrder(ixfileHandle, attribute) == 1);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    if (testCase_17_int("age_idx", attrAge) == success
+        && testCase_17_varchar("name_idx", attrName) == success)
+    {
+        cerr << "***** IX Test Case 17 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 17 failed. *****" << endl;
+        return fail;
+    }
+}
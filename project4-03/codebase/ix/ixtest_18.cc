@@ -0,0 +1,148 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+int testCase_18(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Descents served from the copies of the top levels an IXFileHandle keeps **
+    // 2. Those copies going stale when another handle changes the tree **
+    cerr << endl << "***** In IX Test Case 18 *****" << endl;
+
+    const int numOfTuples = 200000;
+    // Deletes stay clear of the last leaf, which bulk loading leaves part full, so that none of them
+    // has to rebalance it
+    const int measured = numOfTuples - 1000;
+    IXFileHandle ixfileHandle;
+    IXFileHandle otherHandle;
+    RID rid;
+    int key;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // A tree of three levels: root, internal nodes, leaves. Deletes below keep every node over half full.
+    IX_EntrySorter sorter(attribute);
+    for (key = 0; key < numOfTuples; key++)
+    {
+        rid.pageNum = key;
+        rid.slotNum = 0;
+        rc = sorter.add(&key, rid);
+        assert(rc == success && "IX_EntrySorter::add() should not fail.");
+    }
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+
+    // Warm up: every node of the top two levels gets looked at
+    for (key = 0; key < measured; key += 10)
+    {
+        rid.pageNum = key;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+
+    // Now a delete only reads its leaf
+    unsigned before = pagesRead(ixfileHandle);
+    for (key = 1; key < measured; key += 50)
+    {
+        rid.pageNum = key;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    unsigned reads = pagesRead(ixfileHandle) - before;
+    cerr << "Pages read by " << measured / 50 << " warm deletes: " << reads << endl;
+    assert(reads == (unsigned)measured / 50 && "warm deletes should read only the leaf.");
+
+    // Without the copies each one reads the meta page and the whole path, then the leaf again to delete from it
+    ixfileHandle.setResidentLevels(0);
+    before = pagesRead(ixfileHandle);
+    for (key = 2; key < measured; key += 50)
+    {
+        rid.pageNum = key;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    reads = pagesRead(ixfileHandle) - before;
+    cerr << "Pages read with no resident levels: " << reads << endl;
+    assert(reads == 5 * (unsigned)measured / 50 && "deletes should read the meta page and three levels.");
+    ixfileHandle.setResidentLevels(IX_RESIDENT_LEVELS);
+
+    // Warm the handle again, then grow the tree through another handle, splitting leaves and internal nodes
+    key = 3;
+    rid.pageNum = key;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+    assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    rc = indexManager->openFile(indexFileName, otherHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    unsigned pages = otherHandle.getNumberOfPages();
+    const int grown = numOfTuples + 100000;
+    for (key = numOfTuples; key < grown; key++)
+    {
+        rid.pageNum = key;
+        rc = indexManager->insertEntry(otherHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    cerr << "Pages added through the other handle: " << otherHandle.getNumberOfPages() - pages << endl;
+
+    // The first handle sees all of it
+    for (key = numOfTuples; key < grown; key += 7)
+    {
+        rid.pageNum = key;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should find entries added by another handle.");
+    }
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    int last = -1;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success)
+    {
+        assert(key > last && "keys should come out in order");
+        last = key;
+        count++;
+    }
+    ix_ScanIterator.close();
+    int deleted = measured / 10 + 2 * (measured / 50) + 1 + (grown - numOfTuples + 6) / 7;
+    assert(count == grown - deleted && "the scan should see every entry left.");
+
+    rc = indexManager->closeFile(otherHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    if (testCase_18("age_idx", attrAge) == success)
+    {
+        cerr << "***** IX Test Case 18 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 18 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Makes key number i of the test, in the format of insertEntry
+static void makeKey(const Attribute &attribute, int i, char *key)
+{
+    if (attribute.type == TypeInt)
+    {
+        memcpy(key, &i, INT_SIZE);
+        return;
+    }
+    // Long keys of different lengths, in the same order as the numbers
+    int len = sprintf(key + VARCHAR_LENGTH_SIZE, "%08d%.*s", i, 20 + i % 40,
+            "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+}
+
+// Scans the whole index, checking entries come out in order with the keys of their rids. Returns the number of entries.
+static unsigned checkKeys(IXFileHandle &ixfileHandle, const Attribute &attribute)
+{
+    return checkScanOrder(ixfileHandle, attribute, [&](const RID &rid, char *key) {makeKey(attribute, rid.pageNum, key);});
+}
+
+static void insertKeys(IXFileHandle &ixfileHandle, const Attribute &attribute, int from, int to, int step)
+{
+    char key[PAGE_SIZE];
+    RID rid;
+    for (int i = from; i < to; i += step)
+    {
+        makeKey(attribute, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        RC rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+}
+
+int testCase_19(const string &indexFileName, const Attribute &attribute, const int numOfTuples)
+{
+    // Functions tested
+    // 1. Deletes merging and evening out nodes, down to a root over a single leaf **
+    // 2. Pages freed by merges used again by splits **
+    // 3. Scans deleting the entries they return **
+    cerr << endl << "***** In IX Test Case 19 (" << (attribute.type == TypeInt ? "int" : "varchar") << ") *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    insertKeys(ixfileHandle, attribute, 0, numOfTuples, 1);
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    cerr << "Pages after inserts: " << pages << endl;
+
+    // Delete nine out of ten. The nodes left over are merged, so reinserting fits in the pages there are.
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (i % 10 == 0)
+            continue;
+        makeKey(attribute, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    assert(checkKeys(ixfileHandle, attribute) == (unsigned)(numOfTuples + 9) / 10);
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (i % 10 == 0)
+            continue;
+        makeKey(attribute, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    cerr << "Pages after deleting and inserting again: " << ixfileHandle.getNumberOfPages() << endl;
+    assert(ixfileHandle.getNumberOfPages() <= pages && "freed pages should be used again.");
+    assert(checkKeys(ixfileHandle, attribute) == (unsigned)numOfTuples);
+
+    // A scan deleting what it returns over half of the keys, then everything
+    char low[PAGE_SIZE];
+    char high[PAGE_SIZE];
+    makeKey(attribute, numOfTuples / 4, low);
+    makeKey(attribute, 3 * numOfTuples / 4, high);
+    int deleted = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        IX_ScanIterator ix_ScanIterator;
+        rc = indexManager->scan(ixfileHandle, attribute, pass == 0 ? low : NULL, pass == 0 ? high : NULL,
+                true, false, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        int count = 0;
+        while (ix_ScanIterator.getNextEntry(rid, key) == success)
+        {
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+            count++;
+        }
+        ix_ScanIterator.close();
+        cerr << "Entries deleted by scan " << pass + 1 << ": " << count << endl;
+        assert(count == (pass == 0 ? 3 * numOfTuples / 4 - numOfTuples / 4 : numOfTuples - deleted)
+                && "the scan should return every entry in range once.");
+        deleted += count;
+    }
+    assert(checkKeys(ixfileHandle, attribute) == 0);
+
+    // The tree is back to a root over one leaf: a cold insert reads the meta page, the root and the leaf twice
+    ixfileHandle.setResidentLevels(0);
+    unsigned before = pagesRead(ixfileHandle);
+    insertKeys(ixfileHandle, attribute, 0, 1, 1);
+    cerr << "Pages read by an insert into the emptied tree: " << pagesRead(ixfileHandle) - before << endl;
+    assert(pagesRead(ixfileHandle) - before == 4 && "the tree should have shrunk to two levels.");
+    ixfileHandle.setResidentLevels(IX_RESIDENT_LEVELS);
+
+    // Refilling it takes no new pages either
+    insertKeys(ixfileHandle, attribute, 1, numOfTuples, 1);
+    cerr << "Pages after refilling: " << ixfileHandle.getNumberOfPages() << endl;
+    assert(ixfileHandle.getNumberOfPages() <= pages && "freed pages should be used again.");
+    assert(checkKeys(ixfileHandle, attribute) == (unsigned)numOfTuples);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrName;
+    attrName.length = 100;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    if (testCase_19("age_idx", attrAge, 100000) == success
+        && testCase_19("name_idx", attrName, 20000) == success)
+    {
+        cerr << "***** IX Test Case 19 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 19 failed. *****" << endl;
+        return fail;
+    }
+}
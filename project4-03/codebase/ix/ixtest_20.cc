@@ -0,0 +1,175 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Entry i is a row of a table with 100 rows a page, whose column has keys distinct values
+static void makeRow(const Attribute &attribute, int i, int keys, char *key, RID &rid)
+{
+    makeCityKey(attribute, i % keys, key);
+    rid.pageNum = i / 100;
+    rid.slotNum = i % 100;
+}
+
+int testCase_20(const string &indexFileName, const Attribute &attribute, const int numOfTuples, const int keys)
+{
+    // Functions tested
+    // 1. Few distinct keys, each with thousands of entries, inserted in scrambled order **
+    // 2. Rids of a hot key kept on overflow pages, and the pages they take **
+    // 3. A scan deleting every entry of a hot key, and the overflow pages reused **
+    // 4. Bulk load of the same entries **
+    cerr << endl << "***** In IX Test Case 20 (" << (attribute.type == TypeInt ? "int" : "varchar") << ") *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        // 7919 is prime, so every i in [0, numOfTuples) comes up once
+        makeRow(attribute, (n * 7919) % numOfTuples, keys, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+    makeCityKey(attribute, keys / 2, key);
+    assert(countEqual(ixfileHandle, attribute, key) == (unsigned)(numOfTuples / keys));
+
+    // A key and a rid for every entry would fill at least this many pages. Overflow pages split in
+    // half as the scrambled inserts fill them, so they are not all full.
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    unsigned entryPages = numOfTuples * (sizeof(DataEntry) + sizeof(RID)) / PAGE_SIZE;
+    cerr << "Pages after inserts: " << pages << " (a key for every entry takes over " << entryPages << ")" << endl;
+    assert(pages * 4 < entryPages && "keys should be stored once, with their rids compressed.");
+
+    // Entries of a hot key come and go
+    makeCityKey(attribute, keys / 2, key);
+    for (int i = keys / 2; i < numOfTuples; i += 3 * keys)
+    {
+        makeRow(attribute, i, keys, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "deleting an entry twice should fail.");
+    int removed = (numOfTuples / keys + 2) / 3;
+    assert(countEqual(ixfileHandle, attribute, key) == (unsigned)(numOfTuples / keys - removed));
+    for (int i = keys / 2; i < numOfTuples; i += 3 * keys)
+    {
+        makeRow(attribute, i, keys, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    assert(countEqual(ixfileHandle, attribute, key) == (unsigned)(numOfTuples / keys));
+
+    // A scan deleting everything it returns empties the key and frees its overflow pages
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    char returnedKey[PAGE_SIZE];
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, returnedKey) == success)
+    {
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, returnedKey, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples / keys && "the scan should return every entry of the key once.");
+    assert(countEqual(ixfileHandle, attribute, key) == 0);
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)(numOfTuples - count));
+
+    for (int i = keys / 2; i < numOfTuples; i += keys)
+    {
+        makeRow(attribute, i, keys, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    cerr << "Pages after deleting and inserting a key again: " << ixfileHandle.getNumberOfPages() << endl;
+    assert(ixfileHandle.getNumberOfPages() <= pages && "freed overflow pages should be used again.");
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    // Bulk loaded, the same entries take no more pages
+    rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    IX_EntrySorter sorter(attribute);
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        makeRow(attribute, i, keys, key, rid);
+        rc = sorter.add(key, rid);
+        assert(rc == success && "IX_EntrySorter::add() should not fail.");
+    }
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    cerr << "Pages after bulk load: " << ixfileHandle.getNumberOfPages() << endl;
+    assert(ixfileHandle.getNumberOfPages() <= pages && "a bulk load should pack the rids as tightly.");
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+    makeCityKey(attribute, 0, key);
+    assert(countEqual(ixfileHandle, attribute, key) == (unsigned)(numOfTuples / keys));
+
+    // The loaded overflow pages take inserts and deletes too
+    for (int i = 0; i < numOfTuples; i += 2 * keys)
+    {
+        makeRow(attribute, i, keys, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        rid.slotNum += 100;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    assert(countEqual(ixfileHandle, attribute, key) == (unsigned)(numOfTuples / keys));
+    assert(checkScanOrder(ixfileHandle, attribute) == (unsigned)numOfTuples);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrCity;
+    attrCity.length = 50;
+    attrCity.name = "city";
+    attrCity.type = TypeVarChar;
+
+    if (testCase_20("age_idx", attrAge, 100000, 20) == success
+        && testCase_20("city_idx", attrCity, 50000, 5) == success)
+    {
+        cerr << "***** IX Test Case 20 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 20 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,259 @@
+#include <iostream>
+#include <sstream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Key number i of the test, in the format of insertEntry. URLs share a long start and differ at the
+// end. Paths differ in their first letters and share a long end.
+static void makeKey(bool url, int i, char *key)
+{
+    int len;
+    if (url)
+        len = sprintf(key + VARCHAR_LENGTH_SIZE, "http://www.example.com/catalog/electronics/item-%08d.html", i);
+    else
+    {
+        // 7919 and 26 share no factor, so the words are all different
+        char word[6];
+        int n = (i * 7919) % (26 * 26 * 26 * 26 * 26);
+        for (int j = 4; j >= 0; j--, n /= 26)
+            word[j] = 'a' + n % 26;
+        word[5] = '\0';
+        len = sprintf(key + VARCHAR_LENGTH_SIZE, "%s/profile/settings/notifications/history", word);
+    }
+    memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+}
+
+// Scans the whole index, checking keys come out in order and with their rids. Returns the number of entries.
+static unsigned checkKeys(IXFileHandle &ixfileHandle, const Attribute &attribute, bool url)
+{
+    return checkScanOrder(ixfileHandle, attribute, [&](const RID &rid, char *key) {makeKey(url, rid.pageNum, key);});
+}
+
+static void insertKeys(IXFileHandle &ixfileHandle, const Attribute &attribute, bool url, int numOfTuples)
+{
+    char key[PAGE_SIZE];
+    RID rid;
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        int i = (n * 7919) % numOfTuples;
+        makeKey(url, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        RC rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+}
+
+int testCase_21(const string &indexFileName, const Attribute &attribute, bool url, const int numOfTuples)
+{
+    // Functions tested
+    // 1. Leaf keys stored without the prefix they share **
+    // 2. Separators cut short when leaves split **
+    // 3. Deletes merging leaves with different prefixes **
+    // 4. Bulk load of the same keys **
+    cerr << endl << "***** In IX Test Case 21 (" << (url ? "urls" : "paths") << ") *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    insertKeys(ixfileHandle, attribute, url, numOfTuples);
+    assert(checkKeys(ixfileHandle, attribute, url) == (unsigned)numOfTuples);
+
+    // Leaves about two thirds full of whole keys, each with a slot and a rid, would take this many pages
+    makeKey(url, 0, key);
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    unsigned keyPages = numOfTuples * (sizeof(DataEntry) + VARCHAR_LENGTH_SIZE + *(int*)key + 2) * 3 / 2 / PAGE_SIZE;
+    cerr << "Pages after inserts: " << pages << " (whole keys take about " << keyPages << ")" << endl;
+
+    // A cold insert reads the meta page, a page on each level and the leaf again
+    ixfileHandle.setResidentLevels(0);
+    unsigned before = pagesRead(ixfileHandle);
+    rid.pageNum = numOfTuples;
+    rid.slotNum = 0;
+    rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    unsigned reads = pagesRead(ixfileHandle) - before;
+    cerr << "Pages read by a cold insert: " << reads << endl;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    ixfileHandle.setResidentLevels(IX_RESIDENT_LEVELS);
+    if (url)
+        assert(pages * 2 < keyPages && "the start the keys share should be stored once a leaf.");
+    else
+        assert(reads == 4 && "short separators should keep the tree at two levels.");
+
+    // Delete nine out of ten, merging leaves
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (i % 10 == 0)
+            continue;
+        makeKey(url, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    assert(checkKeys(ixfileHandle, attribute, url) == (unsigned)(numOfTuples + 9) / 10);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    // Bulk loaded, the keys take no more pages than inserted
+    rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    IX_EntrySorter sorter(attribute);
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        makeKey(url, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = sorter.add(key, rid);
+        assert(rc == success && "IX_EntrySorter::add() should not fail.");
+    }
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, sorter);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    cerr << "Pages after bulk load: " << ixfileHandle.getNumberOfPages() << endl;
+    assert(ixfileHandle.getNumberOfPages() <= pages && "a bulk load should compress the keys as well.");
+    assert(checkKeys(ixfileHandle, attribute, url) == (unsigned)numOfTuples);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < numOfTuples; i += 10)
+        {
+            makeKey(url, i, key);
+            rid.pageNum = i;
+            rid.slotNum = 0;
+            if (pass == 0)
+                rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+            else
+                rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+            assert(rc == success && "entries should be deleted and inserted again.");
+        }
+    }
+    assert(checkKeys(ixfileHandle, attribute, url) == (unsigned)numOfTuples);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_21_large(const string &indexFileName, const Attribute &attribute, const int numOfTuples)
+{
+    // Functions tested
+    // 1. Leaves split with keys too large for two to share a leaf **
+    cerr << endl << "***** In IX Test Case 21 (large keys) *****" << endl;
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Keys differ in their first bytes, then run on for more than half a page
+    auto makeLargeKey = [&](int i) {
+        int len = attribute.length;
+        memset(key + VARCHAR_LENGTH_SIZE, 'x', len);
+        char number[8];
+        memcpy(key + VARCHAR_LENGTH_SIZE, number, sprintf(number, "%04d", i));
+        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
+    };
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        int i = (n * 7) % numOfTuples;
+        makeLargeKey(i);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    cerr << "Pages after inserts: " << ixfileHandle.getNumberOfPages() << endl;
+    unsigned count = checkScanOrder(ixfileHandle, attribute,
+        [&](const RID &rid, char *expected) {makeLargeKey(rid.pageNum); memcpy(expected, key, VARCHAR_LENGTH_SIZE + attribute.length);});
+    assert(count == (unsigned)numOfTuples && "every large key should be in the index.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_21_print(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. printBtree shows whole keys **
+    IXFileHandle ixfileHandle;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    insertKeys(ixfileHandle, attribute, true, 200);
+
+    stringstream out;
+    streambuf *old = cout.rdbuf(out.rdbuf());
+    indexManager->printBtree(ixfileHandle, attribute);
+    cout.rdbuf(old);
+    makeKey(true, 123, key);
+    assert(out.str().find(string(key + VARCHAR_LENGTH_SIZE, *(int*)key)) != string::npos && "keys should be printed whole.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrUrl;
+    attrUrl.length = 100;
+    attrUrl.name = "url";
+    attrUrl.type = TypeVarChar;
+
+    Attribute attrLarge;
+    attrLarge.length = PAGE_SIZE * 5 / 8;
+    attrLarge.name = "description";
+    attrLarge.type = TypeVarChar;
+
+    if (testCase_21("url_idx", attrUrl, true, 50000) == success
+        && testCase_21("url_idx", attrUrl, false, 10000) == success
+        && testCase_21_large("url_idx", attrLarge, 50) == success
+        && testCase_21_print("url_idx", attrUrl) == success)
+    {
+        cerr << "***** IX Test Case 21 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 21 failed. *****" << endl;
+        return fail;
+    }
+}
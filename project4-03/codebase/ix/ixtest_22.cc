@@ -0,0 +1,126 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Key number i of the test. Keys run from negative to positive, each one twice, and reals take in -0.0.
+static void makeKey(const Attribute &attribute, int i, char *key)
+{
+    int k = i / 2 - 5000;
+    if (attribute.type == TypeInt)
+    {
+        memcpy(key, &k, INT_SIZE);
+        return;
+    }
+    float f = k == 0 ? -0.0f : k * 0.25f;
+    memcpy(key, &f, INT_SIZE);
+}
+
+int testCase_22(const string &indexFileName, const Attribute &attribute, const int numOfTuples)
+{
+    // Functions tested
+    // 1. Searches of int and real nodes, at every boundary of the window compared with SIMD **
+    // 2. Scans with inclusive and exclusive bounds over negative keys and -0.0 **
+    // 3. Deletes finding their entries **
+    cerr << endl << "***** In IX Test Case 22 (" << (attribute.type == TypeInt ? "int" : "real") << ") *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+    char high[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        int i = (n * 7919) % numOfTuples;
+        makeKey(attribute, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // Every key has two entries, key i/2 - 5000 comes after 2 * (i/2) entries
+    for (int i = 0; i < numOfTuples; i += 37)
+    {
+        int before = i / 2 * 2;
+        makeKey(attribute, i, key);
+        makeKey(attribute, min(i + 70, numOfTuples - 1), high);
+        int after = (min(i + 70, numOfTuples - 1) / 2 + 1) * 2;
+        if (countBetween(ixfileHandle, attribute, key, key, true, true) != 2
+            || countBetween(ixfileHandle, attribute, key, NULL, true, true) != numOfTuples - before
+            || countBetween(ixfileHandle, attribute, key, NULL, false, true) != numOfTuples - before - 2
+            || countBetween(ixfileHandle, attribute, NULL, key, true, false) != before
+            || countBetween(ixfileHandle, attribute, key, high, true, true) != after - before
+            || countBetween(ixfileHandle, attribute, key, high, false, false) != max(after - before - 4, 0))
+        {
+            cerr << "[FAIL] Scans around entry " << i << " returned the wrong entries." << endl;
+            indexManager->closeFile(ixfileHandle);
+            return fail;
+        }
+    }
+    float zero = 0.0f;
+    if (attribute.type == TypeReal && countBetween(ixfileHandle, attribute, &zero, &zero, true, true) != 2)
+    {
+        cerr << "[FAIL] 0.0 should find the entries of -0.0." << endl;
+        indexManager->closeFile(ixfileHandle);
+        return fail;
+    }
+
+    for (int i = 0; i < numOfTuples; i += 2)
+    {
+        makeKey(attribute, i, key);
+        rid.pageNum = i;
+        rid.slotNum = 0;
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    assert(countBetween(ixfileHandle, attribute, NULL, NULL, true, true) == numOfTuples / 2);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrHeight;
+    attrHeight.length = 4;
+    attrHeight.name = "height";
+    attrHeight.type = TypeReal;
+
+    if (testCase_22("age_idx", attrAge, 20000) == success
+        && testCase_22("height_idx", attrHeight, 20000) == success)
+    {
+        cerr << "***** IX Test Case 22 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 22 failed. *****" << endl;
+        return fail;
+    }
+}
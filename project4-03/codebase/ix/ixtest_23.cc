@@ -0,0 +1,154 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+#define THREADS 4
+
+// Scans the whole index like checkScanOrder. Returns the number of entries, and in kept the number of
+// entries that are never deleted.
+static unsigned checkKept(IXFileHandle &ixfileHandle, const Attribute &attribute, int keys, unsigned &kept)
+{
+    kept = 0;
+    return checkScanOrder(ixfileHandle, attribute, [&](const RID &rid, char *key)
+        {
+            if (rid.pageNum % 10 == 0)
+                kept++;
+            makeCityKey(attribute, rid.pageNum % keys, key);
+        });
+}
+
+// Thread t inserts, or deletes all but one in ten of, the entries i with i % THREADS == t, in
+// scrambled order. After each insert it looks the entry up again.
+static void work(const string &indexFileName, const Attribute &attribute, int numOfTuples, int keys, int t, bool insert)
+{
+    IXFileHandle ixfileHandle;
+    RC rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    char returnedKey[PAGE_SIZE];
+    RID rid;
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        // 7919 is prime, so every i in [0, numOfTuples) comes up once
+        int i = (n * 7919) % numOfTuples;
+        if (i % THREADS != t || (!insert && i % 10 == 0))
+            continue;
+        makeCityEntry(attribute, i, keys, key, rid);
+        if (!insert)
+        {
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+            continue;
+        }
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        if (keys < numOfTuples)
+            continue;
+
+        IX_ScanIterator ix_ScanIterator;
+        rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        RID found;
+        rc = ix_ScanIterator.getNextEntry(found, returnedKey);
+        assert(rc == success && found.pageNum == rid.pageNum && "an entry should be found right after it is inserted.");
+        ix_ScanIterator.close();
+    }
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+}
+
+int testCase_23(const string &indexFileName, const Attribute &attribute, const int numOfTuples, const int keys)
+{
+    // Functions tested
+    // 1. Inserts from several threads at once, each with its own handle, splitting leaves as they go **
+    // 2. Lookups of what a thread inserted, while the others insert **
+    // 3. Deletes from several threads, merging leaves, while another thread scans the index **
+    cerr << endl << "***** In IX Test Case 23 (" << (attribute.type == TypeInt ? "int" : "varchar")
+         << ", " << keys << " keys) *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    unsigned kept;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    thread workers[THREADS];
+    for (int t = 0; t < THREADS; t++)
+        workers[t] = thread(work, indexFileName, attribute, numOfTuples, keys, t, true);
+    for (int t = 0; t < THREADS; t++)
+        workers[t].join();
+    unsigned count = checkKept(ixfileHandle, attribute, keys, kept);
+    cerr << "Entries after concurrent inserts: " << count << endl;
+    assert(count == (unsigned)numOfTuples && "every entry inserted should be there once.");
+
+    // Entries i with i % 10 == 0 stay, so every scan meanwhile sees all of them
+    atomic<bool> done(false);
+    unsigned scans = 0;
+    thread scanner([&]() {
+        while (!done)
+        {
+            unsigned seen;
+            checkKept(ixfileHandle, attribute, keys, seen);
+            assert(seen == (unsigned)(numOfTuples + 9) / 10 && "a scan should see the entries no one deletes.");
+            scans++;
+        }
+    });
+    for (int t = 0; t < THREADS; t++)
+        workers[t] = thread(work, indexFileName, attribute, numOfTuples, keys, t, false);
+    for (int t = 0; t < THREADS; t++)
+        workers[t].join();
+    done = true;
+    scanner.join();
+    count = checkKept(ixfileHandle, attribute, keys, kept);
+    cerr << "Entries after concurrent deletes: " << count << " (" << scans << " scans meanwhile)" << endl;
+    assert(count == (unsigned)(numOfTuples + 9) / 10 && count == kept && "the entries not deleted should be left.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrCity;
+    attrCity.length = 50;
+    attrCity.name = "city";
+    attrCity.type = TypeVarChar;
+
+    if (testCase_23("age_idx", attrAge, 100000, 100000) == success
+        && testCase_23("city_idx", attrCity, 50000, 50000) == success
+        && testCase_23("city_idx", attrCity, 50000, 20) == success)
+    {
+        cerr << "***** IX Test Case 23 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 23 failed. *****" << endl;
+        return fail;
+    }
+}
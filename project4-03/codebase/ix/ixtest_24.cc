@@ -0,0 +1,124 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Inserts the entries i in [0, numOfTuples) with i % 2 == odd, in scrambled order, one at a time
+// or as one batch. Returns the pages read.
+static unsigned insertHalf(IXFileHandle &ixfileHandle, const Attribute &attribute, int numOfTuples, int keys, int odd, bool batch)
+{
+    char key[PAGE_SIZE];
+    RID rid;
+    RC rc;
+    IX_EntrySorter sorter(attribute);
+    unsigned before = pagesRead(ixfileHandle);
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        // 7919 is prime, so every i in [0, numOfTuples) comes up once
+        int i = (n * 7919) % numOfTuples;
+        if (i % 2 != odd)
+            continue;
+        makeCityEntry(attribute, i, keys, key, rid);
+        if (batch)
+            rc = sorter.add(key, rid);
+        else
+            rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "entries should be added.");
+    }
+    if (batch)
+    {
+        rc = indexManager->insertEntries(ixfileHandle, attribute, sorter);
+        assert(rc == success && "indexManager::insertEntries() should not fail.");
+    }
+    return pagesRead(ixfileHandle) - before;
+}
+
+int testCase_24(const string &indexFileName, const Attribute &attribute, const int numOfTuples, const int keys)
+{
+    // Functions tested
+    // 1. A batch into an empty index **
+    // 2. A batch between the entries already there, splitting leaves **
+    // 3. Pages read by a batch and by the same entries one at a time **
+    cerr << endl << "***** In IX Test Case 24 (" << (attribute.type == TypeInt ? "int" : "varchar")
+         << ", " << keys << " keys) *****" << endl;
+
+    IXFileHandle ixfileHandle;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // An empty batch changes nothing
+    IX_EntrySorter empty(attribute);
+    rc = indexManager->insertEntries(ixfileHandle, attribute, empty);
+    assert(rc == success && "indexManager::insertEntries() should not fail.");
+    assert(checkScanOrder(ixfileHandle, attribute, keys) == 0);
+
+    insertHalf(ixfileHandle, attribute, numOfTuples, keys, 0, true);
+    assert(checkScanOrder(ixfileHandle, attribute, keys) == (unsigned)(numOfTuples + 1) / 2);
+    unsigned batchReads = insertHalf(ixfileHandle, attribute, numOfTuples, keys, 1, true);
+    assert(checkScanOrder(ixfileHandle, attribute, keys) == (unsigned)numOfTuples);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    // The same, one entry at a time
+    rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    insertHalf(ixfileHandle, attribute, numOfTuples, keys, 0, false);
+    unsigned singleReads = insertHalf(ixfileHandle, attribute, numOfTuples, keys, 1, false);
+    assert(checkScanOrder(ixfileHandle, attribute, keys) == (unsigned)numOfTuples);
+    cerr << "Pages read by the second half as a batch: " << batchReads << ", one at a time: " << singleReads << endl;
+    // Rids of a key on overflow pages still go in one at a time
+    if (keys == numOfTuples)
+        assert(batchReads * 4 < singleReads && "a batch should go down to each leaf once for many entries.");
+    else
+        assert(batchReads < singleReads && "a batch should go down to each leaf once for many entries.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrCity;
+    attrCity.length = 50;
+    attrCity.name = "city";
+    attrCity.type = TypeVarChar;
+
+    if (testCase_24("age_idx", attrAge, 100000, 100000) == success
+        && testCase_24("city_idx", attrCity, 50000, 50000) == success
+        && testCase_24("city_idx", attrCity, 50000, 25) == success)
+    {
+        cerr << "***** IX Test Case 24 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 24 failed. *****" << endl;
+        return fail;
+    }
+}
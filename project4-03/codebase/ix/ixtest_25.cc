@@ -0,0 +1,222 @@
+#include <iostream>
+#include <sstream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Scans the whole index, checking each entry has the key it was inserted with and comes out once.
+// Returns the number of entries.
+static unsigned checkAll(IXFileHandle &ixfileHandle, const Attribute &attribute, int numOfTuples, int keys)
+{
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    RID rid;
+    char key[PAGE_SIZE];
+    char expected[PAGE_SIZE];
+    vector<bool> seen(numOfTuples, false);
+    unsigned count = 0;
+    while ((rc = ix_ScanIterator.getNextEntry(rid, key)) == success)
+    {
+        assert(rid.pageNum < (unsigned)numOfTuples && !seen[rid.pageNum] && "entries should come out once");
+        seen[rid.pageNum] = true;
+        makeCityKey(attribute, rid.pageNum % keys, expected);
+        assert(memcmp(key, expected, attribute.type == TypeInt ? INT_SIZE : VARCHAR_LENGTH_SIZE + *(int*)expected) == 0
+                && "the key should be the one inserted with the rid");
+        count++;
+    }
+    assert(rc == IX_EOF && "the scan should end at the end of the index.");
+    ix_ScanIterator.close();
+    return count;
+}
+
+// Number of entries with key k, checking each has the key
+static unsigned lookup(IXFileHandle &ixfileHandle, const Attribute &attribute, int k, int keys)
+{
+    char key[PAGE_SIZE];
+    char returnedKey[PAGE_SIZE];
+    makeCityKey(attribute, k, key);
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    RID rid;
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, returnedKey) == success)
+    {
+        assert((int)rid.pageNum % keys == k && "an equality scan should only find the key");
+        count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+int testCase_25(const string &indexFileName, const Attribute &attribute, const int numOfTuples, const int keys)
+{
+    // Functions tested
+    // 1. Inserts into a hash index, splitting buckets and growing the directory **
+    // 2. Equality scans, each reading about one page **
+    // 3. Full scans, and range scans refused **
+    // 4. Deletes, including from overflow pages of keys with many entries **
+    cerr << endl << "***** In IX Test Case 25 (" << (attribute.type == TypeInt ? "int" : "varchar")
+         << ", " << keys << " keys) *****" << endl;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    char key[PAGE_SIZE];
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName, IX_INDEX_HASH);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    assert(ixfileHandle.getIndexType() == IX_INDEX_HASH && "the file should be a hash index.");
+
+    for (int n = 0; n < numOfTuples; n++)
+    {
+        // 7919 is prime, so every i in [0, numOfTuples) comes up once
+        int i = (n * 7919) % numOfTuples;
+        makeCityEntry(attribute, i, keys, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    assert(checkAll(ixfileHandle, attribute, numOfTuples, keys) == (unsigned)numOfTuples);
+
+    // With the directory kept by the handle, a probe reads the bucket and its overflow pages
+    lookup(ixfileHandle, attribute, 0, keys);
+    unsigned before = pagesRead(ixfileHandle);
+    unsigned probes = keys < 1000 ? keys : 1000;
+    for (unsigned k = 0; k < probes; k++)
+        assert(lookup(ixfileHandle, attribute, k, keys) == (unsigned)(numOfTuples / keys) && "every entry of a key should be found");
+    unsigned reads = pagesRead(ixfileHandle) - before;
+    cerr << "Pages read by " << probes << " probes: " << reads << " (" << ixfileHandle.getNumberOfPages() << " pages)" << endl;
+    if (keys == numOfTuples)
+        assert(reads == probes && "a probe should read one page.");
+
+    // Ranges are refused, and return nothing
+    IX_ScanIterator ix_ScanIterator;
+    char high[PAGE_SIZE];
+    makeCityKey(attribute, 0, key);
+    makeCityKey(attribute, 1, high);
+    rc = indexManager->scan(ixfileHandle, attribute, key, high, true, true, ix_ScanIterator);
+    assert(rc == IX_HASH_RANGE && "a hash index should refuse a range.");
+    assert(ix_ScanIterator.getNextEntry(rid, key) == IX_EOF && "a refused scan should return nothing.");
+    ix_ScanIterator.close();
+
+    // Reopened, the file is still a hash index
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    assert(ixfileHandle.getIndexType() == IX_INDEX_HASH && "the file should be a hash index.");
+
+    // Delete nine out of ten
+    for (int i = 0; i < numOfTuples; i++)
+    {
+        if (i % 10 == 0)
+            continue;
+        makeCityEntry(attribute, i, keys, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    makeCityEntry(attribute, 1, keys, key, rid);
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "an entry should not be deleted twice.");
+    unsigned count = checkAll(ixfileHandle, attribute, numOfTuples, keys);
+    cerr << "Entries after deletes: " << count << endl;
+    assert(count == (unsigned)(numOfTuples + 9) / 10 && "the entries not deleted should be left.");
+    if (keys == numOfTuples)
+        assert(lookup(ixfileHandle, attribute, 1, keys) == 0 && lookup(ixfileHandle, attribute, 10, keys) == 1);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_25_real(const string &indexFileName)
+{
+    // Functions tested
+    // 1. -0.0 and 0.0 are the same key **
+    // 2. printBtree shows the buckets **
+    Attribute attrHeight;
+    attrHeight.length = 4;
+    attrHeight.name = "height";
+    attrHeight.type = TypeReal;
+
+    IXFileHandle ixfileHandle;
+    RID rid;
+    rid.pageNum = 7;
+    rid.slotNum = 3;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName, IX_INDEX_HASH);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    float key = -0.0f;
+    rc = indexManager->insertEntry(ixfileHandle, attrHeight, &key, rid);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    key = 0.0f;
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(ixfileHandle, attrHeight, &key, &key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    RID found;
+    float returnedKey;
+    rc = ix_ScanIterator.getNextEntry(found, &returnedKey);
+    assert(rc == success && found.pageNum == rid.pageNum && found.slotNum == rid.slotNum && "0.0 should find -0.0.");
+    ix_ScanIterator.close();
+
+    stringstream out;
+    streambuf *old = cout.rdbuf(out.rdbuf());
+    indexManager->printBtree(ixfileHandle, attrHeight);
+    cout.rdbuf(old);
+    assert(out.str().find("(7,3)") != string::npos && "entries should be printed.");
+
+    rc = indexManager->deleteEntry(ixfileHandle, attrHeight, &key, rid);
+    assert(rc == success && "indexManager::deleteEntry() should not fail.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    Attribute attrCity;
+    attrCity.length = 50;
+    attrCity.name = "city";
+    attrCity.type = TypeVarChar;
+
+    if (testCase_25("age_idx", attrAge, 100000, 100000) == success
+        && testCase_25("city_idx", attrCity, 50000, 50000) == success
+        && testCase_25("city_idx", attrCity, 50000, 20) == success
+        && testCase_25_real("height_idx") == success)
+    {
+        cerr << "***** IX Test Case 25 finished. The result will be examined. *****" << endl;
+        return success;
+    }
+    else
+    {
+        cerr << "***** [FAIL] IX Test Case 25 failed. *****" << endl;
+        return fail;
+    }
+}
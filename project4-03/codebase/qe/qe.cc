@@ -89,70 +89,9 @@ void Filter::getAttributes(vector<Attribute> &attrs) const {
 }
 
 bool Filter::compare(const void* val1, const void* val2) {
-    bool result = false;
-    switch (cond.rhsValue.type) {
-        case TypeInt:
-            int i1, i2;
-            memcpy(&i1, val1, 4);
-            memcpy(&i2, val2, 4);
-            result = compareValue(i1, i2);
-            break;
-        case TypeReal:
-            float r1, r2;
-            memcpy(&r1, val1, 4);
-            memcpy(&r2, val2, 4);
-            result = compareValue(r1, r2);
-            break;
-        case TypeVarChar:
-            uint32_t size1, size2;
-            string s1, s2;
-            memcpy(&size1, val1, 4);
-            memcpy(&size2, val2, 4);
-            s1 = string((char*)val1 + 4, size1);
-            s2 = string((char*)val2 + 4, size2);
-            result = compareValue(s1, s2);
-            break;
-    }
-    return result;
-}
-
-bool Filter::compareValue(const int val1, const int val2) {
-    switch (cond.op) {
-        case EQ_OP: return (val1 == val2);
-        case LT_OP: return (val1 <  val2);
-        case LE_OP: return (val1 <= val2);
-        case GT_OP: return (val1 >  val2);
-        case GE_OP: return (val1 >= val2);
-        case NE_OP: return (val1 != val2);
-        case NO_OP: return true;
-    }
-    return true;
-}
-
-bool Filter::compareValue(const float val1, const float val2) {
-    switch (cond.op) {
-        case EQ_OP: return (val1 == val2);
-        case LT_OP: return (val1 <  val2);
-        case LE_OP: return (val1 <= val2);
-        case GT_OP: return (val1 >  val2);
-        case GE_OP: return (val1 >= val2);
-        case NE_OP: return (val1 != val2);
-        case NO_OP: return true;
-    }
-    return true;
-}
-
-bool Filter::compareValue(const string &val1, const string &val2) {
-    switch (cond.op) {
-        case EQ_OP: return (val1 == val2);
-        case LT_OP: return (val1 <  val2);
-        case LE_OP: return (val1 <= val2);
-        case GT_OP: return (val1 >  val2);
-        case GE_OP: return (val1 >= val2);
-        case NE_OP: return (val1 != val2);
-        case NO_OP: return true;
-    }
-    return true;
+    // Compared as normalized keys, whatever the type
+    int cmp = KeyNormalizer::compareValues(cond.rhsValue.type, val1, val2);
+    return KeyNormalizer::satisfies(cmp, cond.op);
 }
 
 Project::Project(Iterator *input, const vector<string> &attrNames) {
@@ -216,9 +216,6 @@ public:
     void getAttributes(vector<Attribute> &attrs) const;
 private:
     bool compare(const void* val1, const void* val2);
-    bool compareValue(const int val1, const int val2);
-    bool compareValue(const float val1, const float val2);
-    bool compareValue(const string &val1, const string &val2);
 };
 
 
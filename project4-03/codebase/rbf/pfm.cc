@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -18,6 +25,7 @@ PagedFileManager* PagedFileManager::instance()
 
 
 PagedFileManager::PagedFileManager()
+: _nextFileId(0), _durabilityMode(DURABILITY_NONE)
 {
 }
 
@@ -33,45 +41,106 @@ RC PagedFileManager::createFile(const string &fileName)
     if (fileExists(fileName))
         return PFM_FILE_EXISTS;
 
-    // Attempt to open the file for writing
-    FILE *pFile = fopen(fileName.c_str(), "wb");
+    // Attempt to create the file
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
     // Return an error if we fail
-    if (pFile == NULL)
+    if (fd < 0)
         return PFM_OPEN_FAILED;
 
-    fclose (pFile);
+    close(fd);
     return SUCCESS;
 }
 
 
 RC PagedFileManager::destroyFile(const string &fileName)
 {
+    lock_guard<mutex> openLock(_openMutex);
+    // Cached pages of this file must not be served to a new file that reuses the inode
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) == 0)
+    {
+        auto it = _fileIds.find(make_pair(sb.st_dev, sb.st_ino));
+        if (it != _fileIds.end())
+        {
+            BufferManager::instance()->discardFile(it->second);
+            {
+                lock_guard<mutex> lock(_unsyncedMutex);
+                _unsyncedFiles.erase(it->second);
+            }
+            // Open handles still point to the FileInfo, the last one to close erases it
+            auto info = _files.find(it->second);
+            if (info != _files.end() && info->second.handles > 0)
+                info->second.destroyed = true;
+            else if (info != _files.end())
+                _files.erase(info);
+            _fileIds.erase(it);
+        }
+    }
+
     // If file cannot be successfully removed, error
     if (remove(fileName.c_str()) != 0)
         return PFM_REMOVE_FAILED;
 
+    // A file created later under the same name must not get this one's descriptor
+    _openPaths.erase(fileName);
+
     return SUCCESS;
 }
 
 
-RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
+RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle, FileAccessMode mode)
 {
     // If this handle already has an open file, error
-    if (fileHandle.getfd() != NULL)
+    if (fileHandle.getfd() >= 0)
         return PFM_HANDLE_IN_USE;
 
-    // If the file doesn't exist, error
-    if (!fileExists(fileName.c_str()))
-        return PFM_FILE_DN_EXIST;
+    lock_guard<mutex> lock(_openMutex);
+    int fd;
+    auto it = _openPaths.find(fileName);
+    if (it != _openPaths.end())
+    {
+        // Already open: share the descriptor, no need to look at the file system again
+        fd = it->second;
+        _openFiles[fd].handles++;
+    }
+    else
+    {
+        // If the file doesn't exist, error
+        if (!fileExists(fileName.c_str()))
+            return PFM_FILE_DN_EXIST;
+
+        // Open the file for reading/writing. Pages are cached in the buffer pool and moved with
+        // pread/pwrite, so every handle on the file sees the others' writes at once.
+        fd = open(fileName.c_str(), O_RDWR);
+        // If we fail, error
+        if (fd < 0)
+            return PFM_OPEN_FAILED;
 
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(fileName.c_str(), "rb+");
-    // If we fail, error
-    if (pFile == NULL)
-        return PFM_OPEN_FAILED;
+        _openPaths[fileName] = fd;
+        _openFiles[fd].path = fileName;
+        _openFiles[fd].fileId = getFileId(fd, fileName);
+        _openFiles[fd].handles = 1;
+    }
 
-    fileHandle.setfd(pFile);
+    fileHandle.setfd(fd);
+    fileHandle._fileId = _openFiles[fd].fileId;
+    fileHandle._fileInfo = &_files[fileHandle._fileId];
+    fileHandle._fileInfo->handles++;
+    fileHandle._accessMode = mode;
+
+    // The mapping is created on the first viewPage, an empty file cannot be mapped
+    if (mode == FILE_ACCESS_MAPPED && fileHandle.getNumberOfPages() > 0)
+    {
+        RC rc = fileHandle.growMap(fileHandle.getNumberOfPages());
+        if (rc)
+        {
+            releaseFileInfo(fileHandle._fileId);
+            releaseDescriptor(fd);
+            fileHandle.setfd(-1);
+            fileHandle._fileInfo = NULL;
+            return rc;
+        }
+    }
 
     return SUCCESS;
 }
@@ -79,20 +148,82 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    FILE *pFile = fileHandle.getfd();
+    int fd = fileHandle.getfd();
 
     // If not an open file, error
-    if (pFile == NULL)
+    if (fd < 0)
         return 1;
 
-    // Flush and close the file
-    fclose(pFile);
+    lock_guard<mutex> lock(_openMutex);
+
+    // Write back any page of this file that is still dirty in the buffer pool
+    RC rc = BufferManager::instance()->flushFile(fileHandle);
+
+    if (rc == SUCCESS && _durabilityMode == DURABILITY_ON_CLOSE && isUnsynced(fileHandle._fileId))
+        rc = fileHandle.sync();
+
+    // Drop the mapping, if any
+    fileHandle._views = 0;
+    fileHandle.unmapOldMaps();
+    if (fileHandle._map != NULL)
+        munmap(fileHandle._map, (size_t) PAGE_SIZE * fileHandle._mapPages);
+    fileHandle._map = NULL;
+    fileHandle._mapPages = 0;
+
+    // Close the file once no other handle uses its descriptor
+    releaseDescriptor(fd);
+    releaseFileInfo(fileHandle._fileId);
 
-    fileHandle.setfd(NULL);
+    fileHandle.setfd(-1);
+    fileHandle._fileInfo = NULL;
 
+    return rc;
+}
+
+RC PagedFileManager::syncAll()
+{
+    RC rc = BufferManager::instance()->flushAll();
+    if (rc)
+        return rc;
+
+    // The files may be closed by now, so open them again just to sync them
+    lock_guard<mutex> openLock(_openMutex);
+    lock_guard<mutex> lock(_unsyncedMutex);
+    for (FileId fileId : _unsyncedFiles)
+    {
+        // A destroyed file has nothing left worth syncing, and its name may belong to a new file
+        auto info = _files.find(fileId);
+        if (info == _files.end() || info->second.destroyed)
+            continue;
+        auto it = _openPaths.find(_files[fileId].name);
+        if (it != _openPaths.end())
+        {
+            if (fdatasync(it->second))
+                return FH_SYNC_FAILED;
+            continue;
+        }
+        int fd = open(_files[fileId].name.c_str(), O_RDWR);
+        if (fd < 0)
+            return FH_SYNC_FAILED;
+        rc = fdatasync(fd);
+        close(fd);
+        if (rc)
+            return FH_SYNC_FAILED;
+    }
+    _unsyncedFiles.clear();
     return SUCCESS;
 }
 
+void PagedFileManager::setDurabilityMode(DurabilityMode mode)
+{
+    _durabilityMode = mode;
+}
+
+DurabilityMode PagedFileManager::getDurabilityMode() const
+{
+    return _durabilityMode;
+}
+
 // Check if a file already exists
 bool PagedFileManager::fileExists(const string &fileName)
 {
@@ -101,6 +232,87 @@ bool PagedFileManager::fileExists(const string &fileName)
     return stat(fileName.c_str(), &sb) == 0;
 }
 
+// Every handle opened on the same file gets the same id, so they share buffer pool frames
+// The file size is read here and cached in the file's FileInfo, which appendPage keeps current
+FileId PagedFileManager::getFileId(int fd, const string &fileName)
+{
+    FileId id;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        id = _nextFileId++;
+        _files[id].name = fileName;
+        _files[id].numPages = 0;
+        return id;
+    }
+
+    auto key = make_pair(sb.st_dev, sb.st_ino);
+    auto it = _fileIds.find(key);
+    if (it != _fileIds.end())
+        id = it->second;
+    else
+    {
+        id = _nextFileId++;
+        _fileIds[key] = id;
+    }
+    // Filesize is always PAGE_SIZE * number of pages
+    _files[id].name = fileName;
+    _files[id].numPages = sb.st_size / PAGE_SIZE;
+    return id;
+}
+
+// Drops a handle's use of a descriptor from the open-file table, closing it after the last one
+void PagedFileManager::releaseDescriptor(int fd)
+{
+    auto it = _openFiles.find(fd);
+    if (it != _openFiles.end())
+    {
+        if (--it->second.handles > 0)
+            return;
+        // The path may have been destroyed and opened again since, under a new descriptor
+        auto path = _openPaths.find(it->second.path);
+        if (path != _openPaths.end() && path->second == fd)
+            _openPaths.erase(path);
+        _openFiles.erase(it);
+    }
+    close(fd);
+}
+
+// Drops a handle's use of a FileInfo. A file destroyed while open is forgotten after its last handle.
+void PagedFileManager::releaseFileInfo(FileId fileId)
+{
+    auto it = _files.find(fileId);
+    if (it == _files.end() || --it->second.handles > 0 || !it->second.destroyed)
+        return;
+    // Closing flushed the pages unpinned since the destroy, they were written to the unlinked file
+    BufferManager::instance()->discardFile(fileId);
+    {
+        lock_guard<mutex> lock(_unsyncedMutex);
+        _unsyncedFiles.erase(fileId);
+    }
+    _files.erase(it);
+}
+
+// Called after pages of fileId were handed to the OS through fd
+RC PagedFileManager::fileWritten(FileId fileId, int fd)
+{
+    if (_durabilityMode != DURABILITY_PER_OP)
+    {
+        lock_guard<mutex> lock(_unsyncedMutex);
+        _unsyncedFiles.insert(fileId);
+        return SUCCESS;
+    }
+    if (fdatasync(fd))
+        return FH_SYNC_FAILED;
+    return SUCCESS;
+}
+
+bool PagedFileManager::isUnsynced(FileId fileId)
+{
+    lock_guard<mutex> lock(_unsyncedMutex);
+    return _unsyncedFiles.count(fileId) > 0;
+}
+
 
 FileHandle::FileHandle()
 {
@@ -108,7 +320,14 @@ FileHandle::FileHandle()
     writePageCounter = 0;
     appendPageCounter = 0;
 
-    _fd = NULL;
+    _fd = -1;
+    _fileId = 0;
+    _fileInfo = NULL;
+
+    _accessMode = FILE_ACCESS_BUFFERED;
+    _map = NULL;
+    _mapPages = 0;
+    _views = 0;
 }
 
 
@@ -119,80 +338,86 @@ FileHandle::~FileHandle()
 
 RC FileHandle::readPage(PageNum pageNum, void *data)
 {
-    if (_fd == NULL)
-        return -1;
-    // If pageNum doesn't exist, error
-    if (getNumberOfPages() < pageNum)
-        return FH_PAGE_DN_EXIST;
-
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    const void *page;
+    RC rc = viewPage(pageNum, page);
+    if (rc)
+        return rc;
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
-        return FH_READ_FAILED;
-
-    readPageCounter++;
-    return SUCCESS;
+    memcpy(data, page, PAGE_SIZE);
+    return releasePage(pageNum);
 }
 
 
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
-    if (_fd == NULL)
+    if (_fd < 0)
         return -1;
     // Check if the page exists
-    if (getNumberOfPages() < pageNum)
+    if (getNumberOfPages() <= pageNum)
         return FH_PAGE_DN_EXIST;
 
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // The whole page is overwritten, so there is no need to read it on a miss
+    BufferManager *bm = BufferManager::instance();
+    char *frame;
+    RC rc = bm->pinPage(*this, pageNum, false, frame);
+    if (rc)
+        return rc;
 
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
-    {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        writePageCounter++;
-        return SUCCESS;
-    }
-    
-    return FH_WRITE_FAILED;
+    memcpy(frame, data, PAGE_SIZE);
+    writePageCounter++;
+    return bm->unpinPage(*this, pageNum, true);
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-    if (_fd == NULL)
+    if (_fd < 0)
         return -1;
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
+    // Appends go straight to disk so that the file size always reflects the cached number of pages
+    PageNum pageNum = _fileInfo->numPages;
+    if (pwrite(_fd, data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        return FH_WRITE_FAILED;
+    _fileInfo->numPages++;
+    appendPageCounter++;
+    RC rc = PagedFileManager::instance()->fileWritten(_fileId, _fd);
+    if (rc)
+        return rc;
 
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // The new page is likely to be read again soon, so keep a clean copy of it in the pool
+    BufferManager *bm = BufferManager::instance();
+    char *frame;
+    if (bm->pinPage(*this, pageNum, false, frame) == SUCCESS)
     {
-        fflush(_fd);
-        appendPageCounter++;
-        return SUCCESS;
+        memcpy(frame, data, PAGE_SIZE);
+        bm->unpinPage(*this, pageNum, false);
     }
-    return FH_WRITE_FAILED;
+    return SUCCESS;
 }
 
 
 unsigned FileHandle::getNumberOfPages()
 {
-    if (_fd == NULL)
+    if (_fd < 0)
         return 0;
-    // Use stat to get the file size
-    struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
+    return _fileInfo->numPages;
+}
+
+unsigned long FileHandle::getVersion() const
+{
+    if (_fd < 0)
         return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
+    return _fileInfo->version;
+}
+
+void FileHandle::bumpVersion()
+{
+    if (_fd >= 0)
+        _fileInfo->version++;
+}
+
+FileId FileHandle::getFileId() const
+{
+    return _fileId;
 }
 
 
@@ -204,12 +429,821 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return SUCCESS;
 }
 
-void FileHandle::setfd(FILE *fd)
+RC FileHandle::pinPage(PageNum pageNum, void *&data)
+{
+    if (_fd < 0)
+        return -1;
+    // If pageNum doesn't exist, error
+    if (getNumberOfPages() <= pageNum)
+        return FH_PAGE_DN_EXIST;
+
+    char *frame;
+    RC rc = BufferManager::instance()->pinPage(*this, pageNum, true, frame);
+    if (rc)
+        return rc;
+
+    readPageCounter++;
+    data = frame;
+    return SUCCESS;
+}
+
+RC FileHandle::unpinPage(PageNum pageNum, bool dirty)
+{
+    if (dirty)
+        writePageCounter++;
+    return BufferManager::instance()->unpinPage(*this, pageNum, dirty);
+}
+
+RC FileHandle::viewPage(PageNum pageNum, const void *&data)
+{
+    if (_accessMode == FILE_ACCESS_BUFFERED)
+    {
+        void *frame;
+        RC rc = pinPage(pageNum, frame);
+        data = frame;
+        return rc;
+    }
+
+    if (_fd < 0)
+        return -1;
+    // If pageNum doesn't exist, error
+    if (getNumberOfPages() <= pageNum)
+        return FH_PAGE_DN_EXIST;
+
+    // A dirty copy in the buffer pool is newer than the file
+    RC rc = BufferManager::instance()->flushPage(*this, pageNum);
+    if (rc)
+        return rc;
+
+    // Another handle may have appended past the end of our mapping
+    if (_mapPages <= pageNum)
+    {
+        rc = growMap(pageNum + 1);
+        if (rc)
+            return rc;
+    }
+
+    readPageCounter++;
+    _views++;
+    data = _map + (size_t) PAGE_SIZE * pageNum;
+    return SUCCESS;
+}
+
+RC FileHandle::releasePage(PageNum pageNum)
+{
+    if (_accessMode == FILE_ACCESS_BUFFERED)
+        return BufferManager::instance()->unpinPage(*this, pageNum, false);
+
+    if (_views == 0)
+        return FH_NOT_PINNED;
+    if (--_views == 0)
+        unmapOldMaps();
+    return SUCCESS;
+}
+
+bool FileHandle::isMapped() const
+{
+    return _accessMode == FILE_ACCESS_MAPPED;
+}
+
+RC FileHandle::readPages(PageNum first, unsigned count, void *buffers[])
+{
+    if (_fd < 0)
+        return -1;
+    // If any page doesn't exist, error
+    if (first >= getNumberOfPages() || count > getNumberOfPages() - first)
+        return FH_PAGE_DN_EXIST;
+
+    // Dirty copies in the buffer pool are newer than the file
+    BufferManager *bm = BufferManager::instance();
+    for (unsigned i = 0; i < count; i++)
+    {
+        RC rc = bm->flushPage(*this, first + i);
+        if (rc)
+            return rc;
+    }
+
+    // One preadv per IOV_MAX pages
+    vector<struct iovec> iov(min(count, (unsigned) IOV_MAX));
+    for (unsigned done = 0; done < count; done += iov.size())
+    {
+        unsigned n = min((unsigned) iov.size(), count - done);
+        for (unsigned i = 0; i < n; i++)
+        {
+            iov[i].iov_base = buffers[done + i];
+            iov[i].iov_len = PAGE_SIZE;
+        }
+        if (preadv(_fd, iov.data(), n, (off_t) PAGE_SIZE * (first + done)) != (ssize_t) PAGE_SIZE * n)
+            return FH_READ_FAILED;
+    }
+
+    readPageCounter += count;
+    return SUCCESS;
+}
+
+RC FileHandle::prefetchPages(PageNum first, unsigned count)
+{
+    if (_fd < 0)
+        return -1;
+    // Clip the range to the end of the file
+    unsigned numPages = getNumberOfPages();
+    if (first >= numPages)
+        return SUCCESS;
+    count = min(count, numPages - first);
+
+    return BufferManager::instance()->loadPages(*this, first, count);
+}
+
+RC FileHandle::prefetchPagesAsync(PageNum first, unsigned count, PageNum (*nextPage)(const void *page))
+{
+    if (_fd < 0)
+        return -1;
+    // The kernel already reads ahead for mappings
+    if (isMapped())
+        return SUCCESS;
+    // Clip a range to the end of the file, a chain ends where its pages say
+    unsigned numPages = getNumberOfPages();
+    if (first >= numPages)
+        return SUCCESS;
+    if (nextPage == NULL)
+        count = min(count, numPages - first);
+
+    return BufferManager::instance()->prefetchAsync(*this, first, count, nextPage);
+}
+
+RC FileHandle::sync()
+{
+    if (_fd < 0)
+        return -1;
+    RC rc = BufferManager::instance()->flushFile(*this);
+    if (rc)
+        return rc;
+
+    PagedFileManager *pfm = PagedFileManager::instance();
+    if (!pfm->isUnsynced(_fileId))
+        return SUCCESS;
+    if (fdatasync(_fd))
+        return FH_SYNC_FAILED;
+    lock_guard<mutex> lock(pfm->_unsyncedMutex);
+    pfm->_unsyncedFiles.erase(_fileId);
+    return SUCCESS;
+}
+
+void FileHandle::setfd(int fd)
 {
     _fd = fd;
 }
 
-FILE *FileHandle::getfd()
+int FileHandle::getfd()
 {
     return _fd;
-}
\ No newline at end of file
+}
+
+// Maps at least numPages pages, with room to grow. Pages that are still viewed keep the
+// old mapping alive until they are released.
+RC FileHandle::growMap(unsigned numPages)
+{
+    unsigned mapPages = max(numPages, 2 * _mapPages);
+    void *map = mmap(NULL, (size_t) PAGE_SIZE * mapPages, PROT_READ, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED)
+        return FH_MAP_FAILED;
+
+    if (_map != NULL)
+    {
+        if (_views == 0)
+            munmap(_map, (size_t) PAGE_SIZE * _mapPages);
+        else
+            _oldMaps.push_back(make_pair(_map, (size_t) PAGE_SIZE * _mapPages));
+    }
+    _map = (char*) map;
+    _mapPages = mapPages;
+    return SUCCESS;
+}
+
+void FileHandle::unmapOldMaps()
+{
+    for (auto &oldMap : _oldMaps)
+        munmap(oldMap.first, oldMap.second);
+    _oldMaps.clear();
+}
+
+
+// Replacement policies ///////////////////////////////////////////////////////////////////
+
+void LRUPolicy::reset(unsigned numFrames)
+{
+    _order.clear();
+    _positions.clear();
+    for (FrameId i = 0; i < numFrames; i++)
+        _positions.push_back(_order.insert(_order.end(), i));
+}
+
+void LRUPolicy::frameAccessed(FrameId frameId)
+{
+    // Move the frame to the most recently used end
+    _order.splice(_order.end(), _order, _positions[frameId]);
+}
+
+bool LRUPolicy::pickVictim(const vector<Frame> &frames, FrameId &victim)
+{
+    for (FrameId id : _order)
+    {
+        if (frames[id].pinCount == 0)
+        {
+            victim = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+ClockPolicy::ClockPolicy()
+: _hand(0)
+{
+}
+
+void ClockPolicy::reset(unsigned numFrames)
+{
+    _referenced.assign(numFrames, false);
+    _hand = 0;
+}
+
+void ClockPolicy::frameAccessed(FrameId frameId)
+{
+    _referenced[frameId] = true;
+}
+
+bool ClockPolicy::pickVictim(const vector<Frame> &frames, FrameId &victim)
+{
+    unsigned numFrames = frames.size();
+    if (numFrames == 0)
+        return false;
+
+    // Two sweeps are enough: the first one clears every reference bit
+    for (unsigned i = 0; i < 2 * numFrames; i++)
+    {
+        FrameId id = _hand;
+        _hand = (_hand + 1) % numFrames;
+
+        if (frames[id].pinCount != 0)
+            continue;
+        if (_referenced[id])
+        {
+            _referenced[id] = false;
+            continue;
+        }
+        victim = id;
+        return true;
+    }
+    return false;
+}
+
+
+// BufferManager ///////////////////////////////////////////////////////////////////////////
+
+BufferManager* BufferManager::_buffer_manager = NULL;
+
+BufferManager* BufferManager::instance()
+{
+    if (!_buffer_manager)
+        _buffer_manager = new BufferManager();
+
+    return _buffer_manager;
+}
+
+BufferManager::BufferManager()
+: hitCounter(0), missCounter(0), evictionCounter(0), prefetchHitCounter(0), prefetchWastedCounter(0),
+  _policy(new LRUPolicy()), _writeEpoch(0), _prefetchDepth(0), _prefetchBusy(false)
+{
+    allocateFrames(BM_DEFAULT_FRAMES);
+}
+
+BufferManager::~BufferManager()
+{
+    freeFrames();
+    delete _policy;
+}
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, bool readFromDisk, char *&data)
+{
+    lock_guard<mutex> lock(_mutex);
+    uint64_t key = pageKey(fileHandle._fileId, pageNum);
+
+    // Hit: the page is already resident
+    auto it = _pageTable.find(key);
+    if (it != _pageTable.end())
+    {
+        Frame &frame = _frames[it->second];
+        frame.pinCount++;
+        _policy->frameAccessed(it->second);
+        hitCounter++;
+        if (frame.prefetched)
+        {
+            prefetchHitCounter++;
+            frame.prefetched = false;
+        }
+        data = frame.data;
+        return SUCCESS;
+    }
+
+    // Miss: find room for the page
+    missCounter++;
+    FrameId frameId;
+    RC rc = getFreeFrame(frameId);
+    if (rc)
+        return rc;
+
+    Frame &frame = _frames[frameId];
+    if (readFromDisk)
+    {
+        if (pread(fileHandle.getfd(), frame.data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        {
+            _freeFrames.push_back(frameId);
+            return FH_READ_FAILED;
+        }
+    }
+
+    frame.fileId = fileHandle._fileId;
+    frame.pageNum = pageNum;
+    frame.pinCount = 1;
+    frame.valid = true;
+    frame.dirty = false;
+    frame.prefetched = false;
+    frame.fd = -1;
+    _pageTable[key] = frameId;
+    _policy->frameAccessed(frameId);
+
+    data = frame.data;
+    return SUCCESS;
+}
+
+RC BufferManager::unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty)
+{
+    lock_guard<mutex> lock(_mutex);
+    auto it = _pageTable.find(pageKey(fileHandle._fileId, pageNum));
+    if (it == _pageTable.end())
+        return FH_NOT_PINNED;
+
+    Frame &frame = _frames[it->second];
+    if (frame.pinCount == 0)
+        return FH_NOT_PINNED;
+
+    frame.pinCount--;
+    // The file is gone, so are the changes. The frame goes back to the pool once nobody holds it.
+    if (frame.discarded)
+    {
+        if (frame.pinCount == 0)
+        {
+            dropFrame(it->second);
+            _freeFrames.push_back(it->second);
+        }
+        return SUCCESS;
+    }
+    if (dirty)
+    {
+        frame.dirty = true;
+        frame.fd = fileHandle.getfd();
+        // Write through when every operation has to be durable, or when the handle reads
+        // through a mapping, which only sees what is in the file
+        if (PagedFileManager::instance()->getDurabilityMode() == DURABILITY_PER_OP || fileHandle.isMapped())
+            return writeFrame(frame);
+    }
+    return SUCCESS;
+}
+
+RC BufferManager::flushFile(FileHandle &fileHandle)
+{
+    lock_guard<mutex> lock(_mutex);
+    RC result = SUCCESS;
+    for (Frame &frame : _frames)
+    {
+        if (!frame.valid || !frame.dirty || frame.pinCount > 0 || frame.fileId != fileHandle._fileId)
+            continue;
+        // The handle that dirtied the frame may be the one being closed
+        frame.fd = fileHandle.getfd();
+        RC rc = writeFrame(frame);
+        if (rc)
+            result = rc;
+    }
+    return result;
+}
+
+RC BufferManager::flushAll()
+{
+    lock_guard<mutex> lock(_mutex);
+    RC result = SUCCESS;
+    for (Frame &frame : _frames)
+    {
+        if (!frame.valid || !frame.dirty || frame.pinCount > 0)
+            continue;
+        RC rc = writeFrame(frame);
+        if (rc)
+            result = rc;
+    }
+    return result;
+}
+
+RC BufferManager::flushPage(FileHandle &fileHandle, PageNum pageNum)
+{
+    lock_guard<mutex> lock(_mutex);
+    auto it = _pageTable.find(pageKey(fileHandle._fileId, pageNum));
+    if (it == _pageTable.end())
+        return SUCCESS;
+
+    Frame &frame = _frames[it->second];
+    if (!frame.dirty)
+        return SUCCESS;
+    return writeFrame(frame);
+}
+
+RC BufferManager::loadPages(FileHandle &fileHandle, PageNum first, unsigned count)
+{
+    lock_guard<mutex> lock(_mutex);
+    count = min(count, max(1u, (unsigned) _frames.size() / 4));
+    FileId fileId = fileHandle._fileId;
+    PageNum end = first + count;
+    PageNum pageNum = first;
+    vector<FrameId> run;
+    vector<struct iovec> iov;
+
+    while (pageNum < end)
+    {
+        // Skip resident pages
+        if (_pageTable.count(pageKey(fileId, pageNum)))
+        {
+            pageNum++;
+            continue;
+        }
+
+        // Gather frames for the run of missing pages starting here. They are pinned while we work
+        // so that getFreeFrame does not hand out the same frame twice.
+        PageNum runStart = pageNum;
+        run.clear();
+        iov.clear();
+        while (pageNum < end && run.size() < IOV_MAX && !_pageTable.count(pageKey(fileId, pageNum)))
+        {
+            FrameId frameId;
+            if (getFreeFrame(frameId))
+                break;
+            _frames[frameId].pinCount = 1;
+            run.push_back(frameId);
+            struct iovec vec;
+            vec.iov_base = _frames[frameId].data;
+            vec.iov_len = PAGE_SIZE;
+            iov.push_back(vec);
+            pageNum++;
+        }
+        if (run.empty())
+            return FH_NO_FREE_FRAME;
+
+        bool failed = preadv(fileHandle.getfd(), iov.data(), iov.size(), (off_t) PAGE_SIZE * runStart) != (ssize_t) (PAGE_SIZE * iov.size());
+        for (unsigned i = 0; i < run.size(); i++)
+        {
+            Frame &frame = _frames[run[i]];
+            frame.pinCount = 0;
+            if (failed)
+            {
+                _freeFrames.push_back(run[i]);
+                continue;
+            }
+            frame.fileId = fileId;
+            frame.pageNum = runStart + i;
+            frame.valid = true;
+            frame.dirty = false;
+            frame.prefetched = false;
+            frame.fd = -1;
+            _pageTable[pageKey(fileId, frame.pageNum)] = run[i];
+            _policy->frameAccessed(run[i]);
+        }
+        if (failed)
+            return FH_READ_FAILED;
+        missCounter += run.size();
+    }
+    return SUCCESS;
+}
+
+void BufferManager::discardFile(FileId fileId)
+{
+    lock_guard<mutex> lock(_mutex);
+    for (FrameId i = 0; i < _frames.size(); i++)
+    {
+        Frame &frame = _frames[i];
+        if (!frame.valid || frame.fileId != fileId)
+            continue;
+        frame.dirty = false;
+        // A pinned frame is still in use through its data pointer, unpinPage drops it later
+        if (frame.pinCount > 0)
+        {
+            frame.discarded = true;
+            continue;
+        }
+        dropFrame(i);
+        _freeFrames.push_back(i);
+    }
+}
+
+RC BufferManager::setNumberOfFrames(unsigned numFrames)
+{
+    if (numFrames == 0)
+        return -1;
+
+    // Let in flight read-ahead land first, it holds no pins
+    waitForPrefetches();
+    lock_guard<mutex> lock(_mutex);
+
+    for (Frame &frame : _frames)
+    {
+        if (frame.valid && frame.pinCount != 0)
+            return BM_FRAMES_PINNED;
+    }
+
+    for (Frame &frame : _frames)
+    {
+        if (frame.valid && frame.dirty)
+        {
+            RC rc = writeFrame(frame);
+            if (rc)
+                return rc;
+        }
+    }
+
+    freeFrames();
+    allocateFrames(numFrames);
+    return SUCCESS;
+}
+
+unsigned BufferManager::getNumberOfFrames() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _frames.size();
+}
+
+void BufferManager::setReplacementPolicy(ReplacementPolicy *policy)
+{
+    lock_guard<mutex> lock(_mutex);
+    if (policy == NULL || policy == _policy)
+        return;
+    delete _policy;
+    _policy = policy;
+    _policy->reset(_frames.size());
+}
+
+RC BufferManager::collectCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictionCount)
+{
+    lock_guard<mutex> lock(_mutex);
+    hitCount      = hitCounter;
+    missCount     = missCounter;
+    evictionCount = evictionCounter;
+    return SUCCESS;
+}
+
+RC BufferManager::collectPrefetchCounterValues(unsigned &hitCount, unsigned &wastedCount)
+{
+    lock_guard<mutex> lock(_mutex);
+    hitCount    = prefetchHitCounter;
+    wastedCount = prefetchWastedCounter;
+    return SUCCESS;
+}
+
+void BufferManager::setPrefetchDepth(unsigned pages)
+{
+    lock_guard<mutex> lock(_mutex);
+    _prefetchDepth = pages;
+}
+
+unsigned BufferManager::getPrefetchDepth() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _prefetchDepth;
+}
+
+RC BufferManager::prefetchAsync(FileHandle &fileHandle, PageNum first, unsigned count, PageNum (*nextPage)(const void *page))
+{
+    lock_guard<mutex> lock(_mutex);
+    if (_prefetchDepth == 0 || count == 0)
+        return SUCCESS;
+    // Like loadPages, never ask for so much that the request evicts itself
+    count = min(count, max(1u, (unsigned) _frames.size() / 4));
+    // Read-ahead is only a hint, drop it when the thread is falling behind
+    if (_prefetchQueue.size() >= BM_MAX_PREFETCH_REQUESTS)
+    {
+        prefetchWastedCounter += count;
+        return SUCCESS;
+    }
+
+    // The handle may be closed before the request is served, so the thread reads through its own descriptor
+    PrefetchRequest request;
+    request.fd = dup(fileHandle.getfd());
+    if (request.fd < 0)
+        return FH_READ_FAILED;
+    request.fileId = fileHandle._fileId;
+    request.first = first;
+    request.count = count;
+    request.nextPage = nextPage;
+    _prefetchQueue.push_back(request);
+
+    // Started on first use, and left running for the life of the process
+    if (!_prefetchThread.joinable())
+        _prefetchThread = thread(&BufferManager::prefetchLoop, this);
+    _prefetchWork.notify_one();
+    return SUCCESS;
+}
+
+void BufferManager::waitForPrefetches()
+{
+    unique_lock<mutex> lock(_mutex);
+    _prefetchIdle.wait(lock, [this] { return _prefetchQueue.empty() && !_prefetchBusy; });
+}
+
+// Private helper methods
+
+uint64_t BufferManager::pageKey(FileId fileId, PageNum pageNum)
+{
+    return ((uint64_t) fileId << 32) | pageNum;
+}
+
+// Returns an empty frame, evicting a page if there is none. Without writeBack a dirty victim
+// is not written out and the call fails instead.
+RC BufferManager::getFreeFrame(FrameId &frameId, bool writeBack)
+{
+    if (!_freeFrames.empty())
+    {
+        frameId = _freeFrames.back();
+        _freeFrames.pop_back();
+        return SUCCESS;
+    }
+
+    if (!_policy->pickVictim(_frames, frameId))
+        return FH_NO_FREE_FRAME;
+
+    Frame &victim = _frames[frameId];
+    if (victim.dirty)
+    {
+        if (!writeBack)
+            return FH_NO_FREE_FRAME;
+        RC rc = writeFrame(victim);
+        if (rc)
+            return rc;
+    }
+    dropFrame(frameId);
+    evictionCounter++;
+    return SUCCESS;
+}
+
+RC BufferManager::writeFrame(Frame &frame)
+{
+    if (frame.fd < 0)
+        return FH_WRITE_FAILED;
+    if (pwrite(frame.fd, frame.data, PAGE_SIZE, (off_t) PAGE_SIZE * frame.pageNum) != PAGE_SIZE)
+        return FH_WRITE_FAILED;
+    frame.dirty = false;
+    _writeEpoch++;
+    return PagedFileManager::instance()->fileWritten(frame.fileId, frame.fd);
+}
+
+// Takes a page out of the page table, counting read-ahead that was never used
+void BufferManager::dropFrame(FrameId frameId)
+{
+    Frame &frame = _frames[frameId];
+    _pageTable.erase(pageKey(frame.fileId, frame.pageNum));
+    if (frame.prefetched)
+        prefetchWastedCounter++;
+    frame.prefetched = false;
+    frame.discarded = false;
+    frame.valid = false;
+}
+
+void BufferManager::allocateFrames(unsigned numFrames)
+{
+    _frames.resize(numFrames);
+    for (FrameId i = 0; i < numFrames; i++)
+    {
+        Frame &frame = _frames[i];
+        frame.fileId = 0;
+        frame.pageNum = 0;
+        frame.pinCount = 0;
+        frame.valid = false;
+        frame.dirty = false;
+        frame.prefetched = false;
+        frame.discarded = false;
+        frame.fd = -1;
+        frame.data = (char*) malloc(PAGE_SIZE);
+    }
+    // Hand out low frame ids first
+    _freeFrames.clear();
+    for (FrameId i = numFrames; i > 0; i--)
+        _freeFrames.push_back(i - 1);
+    _policy->reset(numFrames);
+}
+
+void BufferManager::freeFrames()
+{
+    for (FrameId i = 0; i < _frames.size(); i++)
+    {
+        if (_frames[i].valid)
+            dropFrame(i);
+        free(_frames[i].data);
+    }
+    _frames.clear();
+    _freeFrames.clear();
+    _pageTable.clear();
+}
+
+// Body of the prefetch thread. Pages are read without holding _mutex and installed afterwards,
+// unless they became resident in the meantime or a write back happened while they were read.
+// The thread never writes pages back, so it never touches the PagedFileManager.
+void BufferManager::prefetchLoop()
+{
+    vector<char> buffer;
+    unique_lock<mutex> lock(_mutex);
+    while (true)
+    {
+        _prefetchWork.wait(lock, [this] { return !_prefetchQueue.empty(); });
+        PrefetchRequest request = _prefetchQueue.front();
+        _prefetchQueue.pop_front();
+        _prefetchBusy = true;
+
+        if (request.nextPage == NULL)
+        {
+            // A contiguous range: read it with one pread, then install what is still missing
+            unsigned long epoch = _writeEpoch;
+            buffer.resize((size_t) PAGE_SIZE * request.count);
+            lock.unlock();
+            ssize_t bytes = pread(request.fd, buffer.data(), buffer.size(), (off_t) PAGE_SIZE * request.first);
+            lock.lock();
+
+            unsigned pages = bytes > 0 ? bytes / PAGE_SIZE : 0;
+            if (epoch != _writeEpoch)
+                pages = 0;
+            prefetchWastedCounter += request.count - pages;
+            for (unsigned i = 0; i < pages; i++)
+                installPrefetched(request.fileId, request.first + i, buffer.data() + (size_t) PAGE_SIZE * i);
+        }
+        else
+        {
+            // A chain: every page says where the next one is, so they are read one at a time
+            buffer.resize(PAGE_SIZE);
+            PageNum pageNum = request.first;
+            for (unsigned i = 0; i < request.count && pageNum != 0; i++)
+            {
+                // A resident page is only followed while unpinned, _mutex then keeps everyone off it.
+                // A pinned one may be changing under its holder, who reads on from there anyway.
+                auto it = _pageTable.find(pageKey(request.fileId, pageNum));
+                if (it != _pageTable.end())
+                {
+                    if (_frames[it->second].pinCount > 0)
+                        break;
+                    pageNum = request.nextPage(_frames[it->second].data);
+                    continue;
+                }
+
+                unsigned long epoch = _writeEpoch;
+                lock.unlock();
+                ssize_t bytes = pread(request.fd, buffer.data(), PAGE_SIZE, (off_t) PAGE_SIZE * pageNum);
+                lock.lock();
+                if (bytes != PAGE_SIZE || epoch != _writeEpoch)
+                {
+                    prefetchWastedCounter++;
+                    break;
+                }
+                if (!installPrefetched(request.fileId, pageNum, buffer.data()))
+                    break;
+                pageNum = request.nextPage(buffer.data());
+            }
+        }
+
+        close(request.fd);
+        _prefetchBusy = false;
+        if (_prefetchQueue.empty())
+            _prefetchIdle.notify_all();
+    }
+}
+
+// Puts a page read by the prefetch thread into an unpinned frame. Returns false if the pool has no
+// frame to spare without writing a dirty page back.
+bool BufferManager::installPrefetched(FileId fileId, PageNum pageNum, const char *data)
+{
+    uint64_t key = pageKey(fileId, pageNum);
+    if (_pageTable.count(key))
+        return true;
+
+    FrameId frameId;
+    if (getFreeFrame(frameId, false))
+    {
+        prefetchWastedCounter++;
+        return false;
+    }
+
+    Frame &frame = _frames[frameId];
+    memcpy(frame.data, data, PAGE_SIZE);
+    frame.fileId = fileId;
+    frame.pageNum = pageNum;
+    frame.pinCount = 0;
+    frame.valid = true;
+    frame.dirty = false;
+    frame.prefetched = true;
+    frame.fd = -1;
+    _pageTable[key] = frameId;
+    _policy->frameAccessed(frameId);
+    return true;
+}
@@ -14,18 +14,81 @@
 #define FH_SEEK_FAILED    2
 #define FH_READ_FAILED    3
 #define FH_WRITE_FAILED   4
+#define FH_NO_FREE_FRAME  5
+#define FH_NOT_PINNED     6
+#define FH_SYNC_FAILED    7
+#define FH_MAP_FAILED     8
+
+#define BM_FRAMES_PINNED  1
 
 typedef unsigned PageNum;
 typedef int RC;
 typedef char byte;
 
 #define PAGE_SIZE 4096
+
+// Number of frames in the buffer pool unless resized with setNumberOfFrames
+#define BM_DEFAULT_FRAMES 1024
+// Read-ahead requests waiting for the prefetch thread beyond this are dropped
+#define BM_MAX_PREFETCH_REQUESTS 64
+
 #include <string>
+#include <atomic>
 #include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
 using namespace std;
 
 class FileHandle;
 
+// Identifies a file inside the buffer pool. Every handle opened on the same file shares the same id
+typedef unsigned FileId;
+typedef unsigned FrameId;
+
+// What the PagedFileManager knows about a file, shared by every handle opened on it
+typedef struct FileInfo
+{
+    string   name;
+    atomic<unsigned> numPages;  // Cached file size in pages, kept current by appendPage
+    atomic<unsigned long> version;  // See FileHandle::getVersion
+    unsigned handles;           // Open handles on the file, they point to this FileInfo
+    bool     destroyed;         // Destroyed while handles were open, erased when the last one closes
+} FileInfo;
+
+// An entry of the PagedFileManager's open-file table. Handles opened on the same path share one descriptor
+typedef struct OpenFile
+{
+    string   path;
+    FileId   fileId;
+    unsigned handles;   // Open handles using the descriptor, it is closed when this drops to 0
+} OpenFile;
+
+// How a FileHandle reads pages
+typedef enum
+{
+    FILE_ACCESS_BUFFERED = 0,   // Through the buffer pool
+    FILE_ACCESS_MAPPED          // Straight from an mmap of the file, for read mostly files
+} FileAccessMode;
+
+// When page writes are forced to stable storage with fdatasync
+typedef enum
+{
+    DURABILITY_NONE = 0,    // Only on explicit FileHandle::sync / PagedFileManager::syncAll
+    DURABILITY_ON_CLOSE,    // Also when a file is closed
+    DURABILITY_PER_OP       // Every page write goes to disk and is synced before returning
+} DurabilityMode;
+
 class PagedFileManager
 {
 public:
@@ -33,9 +96,19 @@ public:
 
     RC createFile    (const string &fileName);                          // Create a new file
     RC destroyFile   (const string &fileName);                          // Destroy a file
-    RC openFile      (const string &fileName, FileHandle &fileHandle);  // Open a file
+    RC openFile      (const string &fileName, FileHandle &fileHandle,   // Open a file
+                      FileAccessMode mode = FILE_ACCESS_BUFFERED);
     RC closeFile     (FileHandle &fileHandle);                          // Close a file
 
+    // Write back every dirty page in the buffer pool and fdatasync every file written since its last sync
+    RC syncAll();
+
+    void setDurabilityMode(DurabilityMode mode);
+    DurabilityMode getDurabilityMode() const;
+
+    friend class FileHandle;
+    friend class BufferManager;
+
 protected:
     PagedFileManager();                                                 // Constructor
     ~PagedFileManager();                                                // Destructor
@@ -43,8 +116,32 @@ protected:
 private:
     static PagedFileManager *_pf_manager;
 
+    // Maps (device, inode) of each file we have seen to its buffer pool id
+    map<pair<dev_t, ino_t>, FileId> _fileIds;
+    map<FileId, FileInfo> _files;
+    FileId _nextFileId;
+
+    // Open-file table: descriptor of each path with open handles, and who uses each descriptor.
+    // A destroyed path leaves _openPaths at once, its descriptor lives on until its last handle closes.
+    map<string, int> _openPaths;
+    map<int, OpenFile> _openFiles;
+    // Threads open and close handles on the same files, so the tables above are only touched under
+    // _openMutex. It is taken before _unsyncedMutex.
+    mutex _openMutex;
+
+    DurabilityMode _durabilityMode;
+    // Files with writes that have not been synced yet. The buffer pool adds to it while writing frames
+    // back, which can happen on any thread, so it is only touched under _unsyncedMutex.
+    set<FileId> _unsyncedFiles;
+    mutex _unsyncedMutex;
+
     // Private helper methods
     bool fileExists(const string &fileName);
+    FileId getFileId(int fd, const string &fileName);
+    RC fileWritten(FileId fileId, int fd);
+    bool isUnsynced(FileId fileId);
+    void releaseDescriptor(int fd);
+    void releaseFileInfo(FileId fileId);
 };
 
 
@@ -55,7 +152,7 @@ public:
     unsigned readPageCounter;
     unsigned writePageCounter;
     unsigned appendPageCounter;
-    
+
     FileHandle();                                                       // Default constructor
     ~FileHandle();                                                      // Destructor
 
@@ -65,15 +162,219 @@ public:
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // Put the current counter values into variables
 
+    // Pin a page in the buffer pool and get a pointer to the frame holding it. The pointer stays
+    // valid until the matching unpinPage. Pass dirty = true if the frame was modified.
+    // Pinning counts as a page read, unpinning a dirty page counts as a page write.
+    RC pinPage(PageNum pageNum, void *&data);
+    RC unpinPage(PageNum pageNum, bool dirty);
+
+    // Write back the dirty pages of this file and fdatasync it
+    RC sync();
+
+    // Read only access to a page without copying it. With a mapped handle data points into the
+    // mapping, otherwise the page is pinned in the buffer pool. data stays valid until releasePage.
+    // Viewing counts as a page read.
+    RC viewPage(PageNum pageNum, const void *&data);
+    RC releasePage(PageNum pageNum);
+    bool isMapped() const;
+
+    // Read count contiguous pages starting at first into buffers[0..count) with vectored I/O.
+    // Counts as count page reads.
+    RC readPages(PageNum first, unsigned count, void *buffers[]);
+    // Load the pages in [first, first + count) that are not resident into the buffer pool with as few
+    // reads as possible, so that pinning or viewing them later hits. Does not count as page reads.
+    RC prefetchPages(PageNum first, unsigned count);
+    // Ask the prefetch thread to load the pages in [first, first + count) while the caller keeps
+    // working. With nextPage it instead follows a chain of count pages starting at first, nextPage
+    // giving the page after a page (0 ends the chain, so does a page pinned at the time). Does nothing
+    // while the prefetch depth is 0.
+    RC prefetchPagesAsync(PageNum first, unsigned count, PageNum (*nextPage)(const void *page) = NULL);
+
+    // A counter shared by every handle on the file. Layers that keep their own copies of some pages
+    // bump it whenever they change one of those pages, so that other handles know to drop theirs.
+    unsigned long getVersion() const;
+    void bumpVersion();
+
+    // Buffer pool id of the file, the same for every handle opened on it
+    FileId getFileId() const;
+
     // Let PagedFileManager access our private helper methods
     friend class PagedFileManager;
+    friend class BufferManager;
 
 private:
-    FILE *_fd;
+    int _fd;
+    FileId _fileId;
+    FileInfo *_fileInfo;
+
+    // State of FILE_ACCESS_MAPPED handles
+    FileAccessMode _accessMode;
+    char *_map;
+    unsigned _mapPages;                     // Pages covered by _map, may run past the end of the file
+    unsigned _views;                        // Pages viewed and not yet released
+    vector<pair<char*, size_t>> _oldMaps;   // Outgrown mappings, unmapped once no page is viewed
 
     // Private helper methods
-    void setfd(FILE *fd);
-    FILE *getfd();
-}; 
+    void setfd(int fd);
+    int getfd();
+    RC growMap(unsigned numPages);
+    void unmapOldMaps();
+};
+
+
+// A page sized slot of the buffer pool
+typedef struct Frame
+{
+    FileId   fileId;
+    PageNum  pageNum;
+    unsigned pinCount;
+    bool     valid;
+    bool     dirty;
+    bool     prefetched;    // Loaded by the prefetch thread and not pinned since
+    bool     discarded;     // Its file was destroyed while it was pinned, dropped at the last unpin
+    int      fd;        // File descriptor of the last handle that dirtied the frame, used to write it back
+    char    *data;
+} Frame;
+
+
+// Chooses which frame the buffer pool evicts when it needs room for a new page
+class ReplacementPolicy
+{
+public:
+    virtual ~ReplacementPolicy() {};
+
+    // Called whenever the pool is (re)allocated with numFrames frames
+    virtual void reset(unsigned numFrames) = 0;
+    // Called every time a frame is pinned
+    virtual void frameAccessed(FrameId frameId) = 0;
+    // Picks an unpinned frame to evict. Returns false if every frame is pinned
+    virtual bool pickVictim(const vector<Frame> &frames, FrameId &victim) = 0;
+};
+
+// Evicts the unpinned frame that was pinned least recently
+class LRUPolicy : public ReplacementPolicy
+{
+public:
+    void reset(unsigned numFrames);
+    void frameAccessed(FrameId frameId);
+    bool pickVictim(const vector<Frame> &frames, FrameId &victim);
+
+private:
+    // Front is least recently used
+    list<FrameId> _order;
+    vector<list<FrameId>::iterator> _positions;
+};
+
+// Second chance: sweeps the frames, clearing reference bits until it finds an unreferenced frame
+class ClockPolicy : public ReplacementPolicy
+{
+public:
+    ClockPolicy();
+
+    void reset(unsigned numFrames);
+    void frameAccessed(FrameId frameId);
+    bool pickVictim(const vector<Frame> &frames, FrameId &victim);
+
+private:
+    vector<bool> _referenced;
+    FrameId _hand;
+};
+
+
+// Read-ahead work for the prefetch thread
+typedef struct PrefetchRequest
+{
+    FileId   fileId;
+    int      fd;            // Our own dup of the requesting handle's descriptor
+    PageNum  first;
+    unsigned count;
+    PageNum  (*nextPage)(const void *page);
+} PrefetchRequest;
+
+// Process wide page cache shared by every FileHandle. A background thread can read pages into
+// it ahead of scans, so every public method takes _mutex.
+class BufferManager
+{
+public:
+    // Counters for the whole pool
+    unsigned hitCounter;
+    unsigned missCounter;
+    unsigned evictionCounter;
+    // Prefetched pages that were pinned, and prefetched pages evicted or dropped before any pin
+    unsigned prefetchHitCounter;
+    unsigned prefetchWastedCounter;
+
+    static BufferManager* instance();
+
+    // Pin pageNum of the file behind fileHandle. If readFromDisk is false the caller is going to
+    // overwrite the whole page, so a miss does not need to read it.
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, bool readFromDisk, char *&data);
+    RC unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty);
+
+    // Write every dirty frame of the file back through fileHandle. Frames pinned meanwhile are left
+    // dirty: another thread is changing them, and would have them written back half changed.
+    RC flushFile(FileHandle &fileHandle);
+    // Write every dirty frame of every file back, leaving pinned ones as flushFile does
+    RC flushAll();
+    // Write pageNum of the file back if it is resident and dirty
+    RC flushPage(FileHandle &fileHandle, PageNum pageNum);
+    // Read the pages of [first, first + count) that are not resident into unpinned frames.
+    // count is capped at a quarter of the pool so that a batch does not evict itself.
+    RC loadPages(FileHandle &fileHandle, PageNum first, unsigned count);
+    // Drop every frame of the file without writing it back (the file is being destroyed)
+    void discardFile(FileId fileId);
+
+    // Resize the pool. Fails if any frame is pinned. Dirty frames are written back first.
+    RC setNumberOfFrames(unsigned numFrames);
+    unsigned getNumberOfFrames() const;
+
+    // The pool takes ownership of the policy
+    void setReplacementPolicy(ReplacementPolicy *policy);
+
+    RC collectCounterValues(unsigned &hitCount, unsigned &missCount, unsigned &evictionCount);
+    RC collectPrefetchCounterValues(unsigned &hitCount, unsigned &wastedCount);
+
+    // How many pages scans ask the prefetch thread to keep ahead of them. 0, the default,
+    // turns asynchronous read-ahead off.
+    void setPrefetchDepth(unsigned pages);
+    unsigned getPrefetchDepth() const;
+    // Queue a read-ahead request, see FileHandle::prefetchPagesAsync
+    RC prefetchAsync(FileHandle &fileHandle, PageNum first, unsigned count, PageNum (*nextPage)(const void *page));
+    // Block until the prefetch thread has nothing left to do
+    void waitForPrefetches();
+
+protected:
+    BufferManager();
+    ~BufferManager();
+
+private:
+    static BufferManager *_buffer_manager;
+
+    vector<Frame> _frames;
+    vector<FrameId> _freeFrames;
+    unordered_map<uint64_t, FrameId> _pageTable;
+    ReplacementPolicy *_policy;
+
+    mutable mutex _mutex;
+    // Bumped by every write back, so the prefetch thread can tell that what it read may be stale
+    unsigned long _writeEpoch;
+
+    unsigned _prefetchDepth;
+    thread _prefetchThread;
+    deque<PrefetchRequest> _prefetchQueue;
+    bool _prefetchBusy;
+    condition_variable _prefetchWork;
+    condition_variable _prefetchIdle;
+
+    // Private helper methods
+    static uint64_t pageKey(FileId fileId, PageNum pageNum);
+    RC getFreeFrame(FrameId &frameId, bool writeBack = true);
+    RC writeFrame(Frame &frame);
+    void dropFrame(FrameId frameId);
+    void allocateFrames(unsigned numFrames);
+    void freeFrames();
+    void prefetchLoop();
+    bool installPrefetched(FileId fileId, PageNum pageNum, const char *data);
+};
 
 #endif
@@ -42,11 +42,12 @@ RC RecordBasedFileManager::createFile(const string &fileName)
         return RBFM_MALLOC_FAILED;
     newRecordBasedPage(firstPageData);
 
-    // Adds the first record based page.
+    // Adds the first free space map page and the first record based page.
     FileHandle handle;
     if (_pf_manager->openFile(fileName.c_str(), handle))
         return RBFM_OPEN_FAILED;
-    if (handle.appendPage(firstPageData))
+    PageNum pageNum;
+    if (appendRecordBasedPage(handle, firstPageData, pageNum))
         return RBFM_APPEND_FAILED;
     _pf_manager->closeFile(handle);
 
@@ -60,9 +61,9 @@ RC RecordBasedFileManager::destroyFile(const string &fileName)
     return _pf_manager->destroyFile(fileName);
 }
 
-RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle) 
+RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle, FileAccessMode mode) 
 {
-    return _pf_manager->openFile(fileName.c_str(), fileHandle);
+    return _pf_manager->openFile(fileName.c_str(), fileHandle, mode);
 }
 
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) 
@@ -75,82 +76,152 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Att
     // Gets the size of the record.
     unsigned recordSize = getRecordSize(recordDescriptor, data);
 
-    // Cycles through pages looking for enough free space for the new entry.
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
+    // Asks the free space map for a page with enough space (accounting also for the size that will be added to the slot directory).
+    void *pageData = NULL;
     bool pageFound = false;
-    unsigned i;
-    unsigned numPages = fileHandle.getNumberOfPages();
-    for (i = 0; i < numPages; i++)
+    PageNum pageNum;
+    RC rc = findFreePage(fileHandle, sizeof(SlotDirectoryRecordEntry) + recordSize, pageFound, pageNum);
+    if (rc)
+        return rc;
+
+    if (pageFound)
     {
-        if (fileHandle.readPage(i, pageData))
+        if (fileHandle.pinPage(pageNum, pageData))
             return RBFM_READ_FAILED;
-
-        // When we find a page with enough space (accounting also for the size that will be added to the slot directory), we stop the loop.
-        if (getPageFreeSpaceSize(pageData) >= sizeof(SlotDirectoryRecordEntry) + recordSize)
-        {
-            pageFound = true;
-            break;
-        }
     }
-
     // If we can't find a page with enough space, we create a new one
-    if(!pageFound)
+    else
     {
+        pageData = malloc(PAGE_SIZE);
+        if (pageData == NULL)
+            return RBFM_MALLOC_FAILED;
         newRecordBasedPage(pageData);
     }
 
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    // Setting the return RID.
-    rid.pageNum = i;
-    rid.slotNum = getOpenSlot(pageData);
-
-    // Adding the new record reference in the slot directory.
-    SlotDirectoryRecordEntry newRecordEntry;
-    newRecordEntry.length = recordSize;
-    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
-    setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
-
-    // Updating the slot directory header.
-    slotHeader.freeSpaceOffset = newRecordEntry.offset;
-    if (rid.slotNum == slotHeader.recordEntriesNumber)
-        slotHeader.recordEntriesNumber += 1;
-    setSlotDirectoryHeader(pageData, slotHeader);
-
-    // Adding the record data.
-    setRecordAtOffset (pageData, newRecordEntry.offset, recordDescriptor, data);
+    // Setting the return slot. The page number is set once we know where the page lives.
+    rid.slotNum = addRecordToPage(pageData, recordDescriptor, data, recordSize);
 
     // Writing the page to disk.
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
     if (pageFound)
     {
-        if (fileHandle.writePage(i, pageData))
+        if (fileHandle.unpinPage(pageNum, true))
             return RBFM_WRITE_FAILED;
+        rc = setPageFreeSpace(fileHandle, pageNum, freeSpace);
     }
     else
     {
-        if (fileHandle.appendPage(pageData))
-            return RBFM_APPEND_FAILED;
+        rc = appendRecordBasedPage(fileHandle, pageData, pageNum);
+        free(pageData);
     }
+    rid.pageNum = pageNum;
 
-    free(pageData);
-    return SUCCESS;
+    return rc;
+}
+
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &data, vector<RID> &rids)
+{
+    rids.resize(data.size());
+
+    // The page being filled: an existing page with room, pinned, or a new one in memory until it is full
+    void *newPage = malloc(PAGE_SIZE);
+    if (newPage == NULL)
+        return RBFM_MALLOC_FAILED;
+    void *pageData = NULL;
+    bool pageFound = false;
+    PageNum pageNum = 0;
+    // Records from this one on are on the new page, and learn its number when it is appended
+    size_t firstOnPage = 0;
+    // Records before this one are in the file
+    size_t placed = 0;
+
+    auto finishPage = [&](size_t end) -> RC
+    {
+        RC rc;
+        if (pageFound)
+        {
+            if (fileHandle.unpinPage(pageNum, true))
+                return RBFM_WRITE_FAILED;
+            placed = end;
+            rc = setPageFreeSpace(fileHandle, pageNum, getPageFreeSpaceSize(pageData));
+        }
+        else
+        {
+            // The free space map may fail after the page is appended, the records are in all the same
+            rc = appendRecordBasedPage(fileHandle, pageData, pageNum);
+            if (rc == SUCCESS || fileHandle.getNumberOfPages() > pageNum)
+                placed = end;
+        }
+        for (size_t j = firstOnPage; j < end; j++)
+            rids[j].pageNum = pageNum;
+        pageData = NULL;
+        return rc;
+    };
+
+    RC rc = SUCCESS;
+    size_t i;
+    for (i = 0; i < data.size(); i++)
+    {
+        unsigned recordSize = getRecordSize(recordDescriptor, data[i]);
+        unsigned needed = sizeof(SlotDirectoryRecordEntry) + recordSize;
+        if (pageData != NULL && getPageFreeSpaceSize(pageData) < needed)
+        {
+            rc = finishPage(i);
+            if (rc)
+                break;
+        }
+
+        if (pageData == NULL)
+        {
+            rc = findFreePage(fileHandle, needed, pageFound, pageNum);
+            if (rc)
+                break;
+            if (pageFound)
+            {
+                if (fileHandle.pinPage(pageNum, pageData))
+                {
+                    rc = RBFM_READ_FAILED;
+                    break;
+                }
+            }
+            else
+            {
+                pageData = newPage;
+                newRecordBasedPage(pageData);
+            }
+            firstOnPage = i;
+        }
+
+        rids[i].slotNum = addRecordToPage(pageData, recordDescriptor, data[i], recordSize);
+    }
+
+    // The last page is written even after an error, so the records on it are where their rids say
+    if (pageData != NULL)
+    {
+        RC finishRc = finishPage(i);
+        if (rc == SUCCESS)
+            rc = finishRc;
+    }
+    free(newPage);
+    if (rc)
+        rids.resize(placed);
+    return rc;
 }
 
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data) 
 {
     // Retrieve the specific page
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData))
+    void *pageData;
+    if (fileHandle.pinPage(rid.pageNum, pageData))
         return RBFM_READ_FAILED;
 
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if(slotHeader.recordEntriesNumber <= rid.slotNum)
+    {
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_SLOT_DN_EXIST;
+    }
 
     // Gets the slot directory record entry data
     SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
@@ -160,11 +231,11 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attri
     {
         // Error to read a deleted record
         case DEAD:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
@@ -173,7 +244,7 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attri
         case VALID:
             int32_t offset = recordEntry.offset;
             getRecordAtOffset(pageData, offset, recordDescriptor, data);
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             return SUCCESS;
     }
     // Not possible to reach this point, but compiler doesn't know that
@@ -183,14 +254,17 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attri
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid)
 {
     // Get page
-    void *pageData = malloc(PAGE_SIZE);
-    if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
+    void *pageData;
+    if (fileHandle.pinPage(rid.pageNum, pageData) != SUCCESS)
         return RBFM_READ_FAILED;
 
     // Get page header
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if (slotHeader.recordEntriesNumber <= rid.slotNum)
+    {
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_SLOT_DN_EXIST;
+    }
 
     // Get slot record entry data
     SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
@@ -198,7 +272,7 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     // Cannot delete a deleted page
     if (status == DEAD)
     {
-        free(pageData);
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_SLOT_DN_EXIST;
     }
     // Recursively delete moved pages
@@ -210,7 +284,7 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
         RC rc = deleteRecord(fileHandle, recordDescriptor, newRid);
         if (rc != SUCCESS)
         {
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             return rc;
         }
         markSlotDeleted(pageData, rid.slotNum);
@@ -222,9 +296,10 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     }
     
     // Once we've deleted the page(s), write changes to disk
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
-    free(pageData);
-    return rc;
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
+    if (fileHandle.unpinPage(rid.pageNum, true))
+        return RBFM_WRITE_FAILED;
+    return setPageFreeSpace(fileHandle, rid.pageNum, freeSpace);
 }
 
 // update record
@@ -235,18 +310,15 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid)
 {
     // Retrieve the specific page
-    void *pageData = malloc(PAGE_SIZE);
-    if (fileHandle.readPage(rid.pageNum, pageData))
-    {
-        free(pageData);
+    void *pageData;
+    if (fileHandle.pinPage(rid.pageNum, pageData))
         return RBFM_READ_FAILED;
-    }
 
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if(slotHeader.recordEntriesNumber <= rid.slotNum)
     {
-        free(pageData);
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_SLOT_DN_EXIST;
     }
 
@@ -258,11 +330,11 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     {
         // Error to update a deleted record
         case DEAD:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
@@ -276,9 +348,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     if (recordSize  == recordEntry.length)
     {
         setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
     }
     else if (recordSize < recordEntry.length)
     {
@@ -286,9 +355,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
         recordEntry.length = recordSize;
         setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
         reorganizePage(pageData);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
     }
     else if (recordSize > recordEntry.length)
     {
@@ -300,7 +366,7 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
             RC rc = insertRecord(fileHandle, recordDescriptor, data, newRid);
             if (rc != SUCCESS)
             {
-                free(pageData);
+                fileHandle.unpinPage(rid.pageNum, false);
                 return rc;
             }
             recordEntry.length = newRid.pageNum;
@@ -331,9 +397,10 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
             setRecordAtOffset (pageData, recordEntry.offset, recordDescriptor, data);
         }
     }
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
-    free(pageData);
-    return rc;
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
+    if (fileHandle.unpinPage(rid.pageNum, true))
+        return RBFM_WRITE_FAILED;
+    return setPageFreeSpace(fileHandle, rid.pageNum, freeSpace);
 }
 
 RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor, const void *data) 
@@ -402,19 +469,18 @@ RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor
 
 RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string &attributeName, void *data)
 {
-    char *pageData = (char*)malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
-    {
-        free(pageData);
+    void *pageData;
+    if (fileHandle.pinPage(rid.pageNum, pageData) != SUCCESS)
         return RBFM_READ_FAILED;
-    }
+
     // Get record header, recurse if forwarded
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if(slotHeader.recordEntriesNumber < rid.slotNum)
+    {
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_SLOT_DN_EXIST;
+    }
 
     // Gets the slot directory record entry data
     SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
@@ -424,11 +490,11 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
     {
         // Error to get attribute of a deleted record
         case DEAD:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
-            free(pageData);
+            fileHandle.unpinPage(rid.pageNum, false);
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
@@ -444,11 +510,14 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
     auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
     unsigned index = distance(recordDescriptor.begin(), iterPos);
     if (index == recordDescriptor.size())
+    {
+        fileHandle.unpinPage(rid.pageNum, false);
         return RBFM_NO_SUCH_ATTR;
+    }
     AttrType type = recordDescriptor[index].type;
     // Write attribute to data
     getAttributeFromRecord(pageData, offset, index, type, data);
-    free(pageData);
+    fileHandle.unpinPage(rid.pageNum, false);
     return SUCCESS;
 }
 
@@ -465,17 +534,23 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
 }
 
 RBFM_ScanIterator::RBFM_ScanIterator()
-: currPage(0), currSlot(0), totalPage(0), totalSlot(0)
+: currPage(0), currSlot(0), totalPage(0), totalSlot(0), pageData(NULL), pageViewed(false), viewedPage(0),
+  pagesPerRead(RBFM_SCAN_PAGES_PER_READ), prefetchedUpTo(0), fileHandle(NULL)
 {
     rbfm = RecordBasedFileManager::instance();
 }
 
 RC RBFM_ScanIterator::close()
 {
-    free(pageData);
+    releasePage();
     return SUCCESS;
 }
 
+void RBFM_ScanIterator::setPagesPerRead(unsigned pages)
+{
+    pagesPerRead = max(pages, 1u);
+}
+
 // Initialize the scanIterator with all necessary state
 RC RBFM_ScanIterator::scanInit(FileHandle &fh,
         const vector<Attribute> rd,
@@ -484,37 +559,30 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
         const void *v, 
         const vector<string> &an)
 {
-    // Start at page 0 slot 0
+    // Start before the first data page. Page 0 is a free space map page, so the first call to
+    // getNextSlot moves on to page 1.
     currPage = 0;
     currSlot = 0;
     totalPage = 0;
     totalSlot = 0;
-    // Keep a buffer to hold the current page
-    pageData = malloc(PAGE_SIZE);
+    // Pages are walked in place, nothing is viewed yet
+    pageData = NULL;
+    pageViewed = false;
+    prefetchedUpTo = 0;
 
     // Store the variables passed in to
-    fileHandle = fh;
+    fileHandle = &fh;
     conditionAttribute = ca;
     recordDescriptor = rd;
     compOp = co;
     value = v;
     attributeNames = an;
+    normalizedValue.clear();
 
     skipList.clear();
 
     // Get total number of pages
     totalPage = fh.getNumberOfPages();
-    if (totalPage > 0)
-    {
-        if (fh.readPage(0, pageData))
-            return RBFM_READ_FAILED;
-    }
-    else
-        return SUCCESS;
-
-    // Get number of slots on first page
-    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
-    totalSlot = header.recordEntriesNumber;
 
     // If we don't need to do any comparisons, we can ignore the condition attribute
     if (co == NO_OP)
@@ -527,6 +595,14 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     if (attrIndex == recordDescriptor.size())
         return RBFM_NO_SUCH_ATTR;
 
+    // Each record is compared to the normalized value, so it is made once here
+    if (value != NULL)
+    {
+        char buffer[NORMALIZED_KEY_SIZE];
+        unsigned length;
+        const char *key = KeyNormalizer::normalize(recordDescriptor[attrIndex].type, value, buffer, length);
+        normalizedValue.assign(key, length);
+    }
     return SUCCESS;
 }
 
@@ -620,6 +696,9 @@ RC RBFM_ScanIterator::getNextSlot()
         // Reinitialize the current slot and increment page number
         currSlot = 0;
         currPage++;
+        // Free space map pages hold no records
+        if (rbfm->isFreeSpaceMapPage(currPage))
+            currPage++;
         // If we're done with last page, return EOF
         if (currPage >= totalPage)
             return RBFM_EOF;
@@ -643,9 +722,35 @@ RC RBFM_ScanIterator::getNextSlot()
 
 RC RBFM_ScanIterator::getNextPage()
 {
-    // Read in page
-    if (fileHandle.readPage(currPage, pageData))
+    // With a prefetch depth the prefetch thread reads ahead while we work through the current page,
+    // topped up once we are halfway through what it was asked for. Otherwise bring in the next batch
+    // of pages with one read once we are past the previous batch.
+    // Both are only hints, viewPage reads the page itself if they fail.
+    unsigned depth = BufferManager::instance()->getPrefetchDepth();
+    if (depth > 0 && !fileHandle->isMapped())
+    {
+        if (prefetchedUpTo <= currPage + depth / 2)
+        {
+            uint32_t first = max(prefetchedUpTo, currPage + 1);
+            fileHandle->prefetchPagesAsync(first, currPage + 1 + depth - first);
+            prefetchedUpTo = currPage + 1 + depth;
+        }
+    }
+    else if (pagesPerRead > 1 && !fileHandle->isMapped() && currPage >= prefetchedUpTo)
+    {
+        fileHandle->prefetchPages(currPage, pagesPerRead);
+        prefetchedUpTo = currPage + pagesPerRead;
+    }
+
+    // Let go of the previous page and view the next one in place
+    releasePage();
+    const void *page;
+    if (fileHandle->viewPage(currPage, page))
         return RBFM_READ_FAILED;
+    // Record accessors take non-const pages, but the iterator never writes through pageData
+    pageData = (void*) page;
+    pageViewed = true;
+    viewedPage = currPage;
 
     // Update slot total
     SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
@@ -653,103 +758,84 @@ RC RBFM_ScanIterator::getNextPage()
     return SUCCESS;
 }
 
+void RBFM_ScanIterator::releasePage()
+{
+    if (!pageViewed)
+        return;
+    fileHandle->releasePage(viewedPage);
+    pageViewed = false;
+}
+
 bool RBFM_ScanIterator::checkScanCondition()
 {
     if (compOp == NO_OP) return true;
     if (value == NULL) return false;
     Attribute attr = recordDescriptor[attrIndex];
-    // Allocate enough memory to hold attribute and 1 byte null indicator
-    void *data = malloc(1 + attr.length);
+    // Room for the attribute and its 1 byte null indicator
+    char data[PAGE_SIZE];
     // Get record entry to get offset
     SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
     // Grab the given attribute and store it in data
     rbfm->getAttributeFromRecord(pageData, recordEntry.offset, attrIndex, attr.type, data);
 
-    char null;
-    memcpy(&null, data, 1);
-
-    bool result = false;
-    if (null)
-    {
-        result = false;
-    }
-    // Checkscan condition on record data and scan value
-    else if (attr.type == TypeInt)
-    {
-        int32_t recordInt;
-        memcpy(&recordInt, (char*)data + 1, INT_SIZE);
-        result = checkScanCondition(recordInt, compOp, value);
-    }
-    else if (attr.type == TypeReal)
-    {
-        float recordReal;
-        memcpy(&recordReal, (char*)data + 1, REAL_SIZE);
-        result = checkScanCondition(recordReal, compOp, value);
-    }
-    else if (attr.type == TypeVarChar)
-    {
-        uint32_t varcharSize;
-        memcpy(&varcharSize, (char*)data + 1, VARCHAR_LENGTH_SIZE);
-        char recordString[varcharSize + 1];
-        memcpy(recordString, (char*)data + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-        recordString[varcharSize] = '\0';
+    // Nulls satisfy no condition
+    if (data[0])
+        return false;
 
-        result = checkScanCondition(recordString, compOp, value);
-    }
-    free (data);
-    return result;
+    char buffer[NORMALIZED_KEY_SIZE];
+    unsigned length;
+    const char *key = KeyNormalizer::normalize(attr.type, data + 1, buffer, length);
+    int cmp = KeyNormalizer::compare(key, length, normalizedValue.data(), normalizedValue.size());
+    return KeyNormalizer::satisfies(cmp, compOp);
 }
 
-bool RBFM_ScanIterator::checkScanCondition(int recordInt, CompOp compOp, const void *value)
+const char *KeyNormalizer::normalize(const AttrType type, const void *value, char *buffer, unsigned &length)
 {
-    int32_t intValue;
-    memcpy (&intValue, value, INT_SIZE);
-
-    switch (compOp)
+    if (type == TypeVarChar)
     {
-        case EQ_OP: return recordInt == intValue;
-        case LT_OP: return recordInt < intValue;
-        case GT_OP: return recordInt > intValue;
-        case LE_OP: return recordInt <= intValue;
-        case GE_OP: return recordInt >= intValue;
-        case NE_OP: return recordInt != intValue;
-        case NO_OP: return true;
-        // Should never happen
-        default: return false;
+        uint32_t size;
+        memcpy(&size, value, VARCHAR_LENGTH_SIZE);
+        length = size;
+        return (const char*)value + VARCHAR_LENGTH_SIZE;
     }
-}
 
-bool RBFM_ScanIterator::checkScanCondition(float recordReal, CompOp compOp, const void *value)
-{
-    float realValue;
-    memcpy (&realValue, value, REAL_SIZE);
-
-    switch (compOp)
+    uint32_t bits;
+    memcpy(&bits, value, NORMALIZED_KEY_SIZE);
+    if (type == TypeInt)
+        bits ^= 0x80000000u;
+    else
     {
-        case EQ_OP: return recordReal == realValue;
-        case LT_OP: return recordReal < realValue;
-        case GT_OP: return recordReal > realValue;
-        case LE_OP: return recordReal <= realValue;
-        case GE_OP: return recordReal >= realValue;
-        case NE_OP: return recordReal != realValue;
-        case NO_OP: return true;
-        // Should never happen
-        default: return false;
+        // -0.0 equals 0.0, so it gets the same key
+        if (bits == 0x80000000u)
+            bits = 0;
+        bits = (bits & 0x80000000u) ? ~bits : bits ^ 0x80000000u;
     }
+    for (int i = NORMALIZED_KEY_SIZE - 1; i >= 0; i--, bits >>= 8)
+        buffer[i] = (char)(bits & 0xff);
+    length = NORMALIZED_KEY_SIZE;
+    return buffer;
 }
 
-bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, const void *value)
+int KeyNormalizer::compare(const char *a, const unsigned lengthA, const char *b, const unsigned lengthB)
 {
-    if (compOp == NO_OP)
-        return true;
+    int cmp = memcmp(a, b, min(lengthA, lengthB));
+    if (cmp != 0)
+        return cmp;
+    return (lengthA > lengthB) - (lengthA < lengthB);
+}
 
-    int32_t valueSize;
-    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
-    char valueStr[valueSize + 1];
-    valueStr[valueSize] = '\0';
-    memcpy(valueStr, (char*) value + VARCHAR_LENGTH_SIZE, valueSize);
+int KeyNormalizer::compareValues(const AttrType type, const void *a, const void *b)
+{
+    char bufferA[NORMALIZED_KEY_SIZE];
+    char bufferB[NORMALIZED_KEY_SIZE];
+    unsigned lengthA, lengthB;
+    const char *keyA = normalize(type, a, bufferA, lengthA);
+    const char *keyB = normalize(type, b, bufferB, lengthB);
+    return compare(keyA, lengthA, keyB, lengthB);
+}
 
-    int cmp = strcmp(recordString, valueStr);
+bool KeyNormalizer::satisfies(const int cmp, const CompOp compOp)
+{
     switch (compOp)
     {
         case EQ_OP: return cmp == 0;
@@ -758,6 +844,7 @@ bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, co
         case LE_OP: return cmp <= 0;
         case GE_OP: return cmp >= 0;
         case NE_OP: return cmp != 0;
+        case NO_OP: return true;
         // Should never happen
         default: return false;
     }
@@ -774,6 +861,146 @@ void RecordBasedFileManager::newRecordBasedPage(void * page)
     setSlotDirectoryHeader(page, slotHeader);
 }
 
+// Adds a record of recordSize bytes to a page known to have room for it and its slot. Returns the slot.
+unsigned RecordBasedFileManager::addRecordToPage(void *page, const vector<Attribute> &recordDescriptor, const void *data, unsigned recordSize)
+{
+    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(page);
+    unsigned slotNum = getOpenSlot(page);
+
+    // Adding the new record reference in the slot directory.
+    SlotDirectoryRecordEntry newRecordEntry;
+    newRecordEntry.length = recordSize;
+    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
+    setSlotDirectoryRecordEntry(page, slotNum, newRecordEntry);
+
+    // Updating the slot directory header.
+    slotHeader.freeSpaceOffset = newRecordEntry.offset;
+    if (slotNum == slotHeader.recordEntriesNumber)
+        slotHeader.recordEntriesNumber += 1;
+    setSlotDirectoryHeader(page, slotHeader);
+
+    // Adding the record data.
+    setRecordAtOffset (page, newRecordEntry.offset, recordDescriptor, data);
+    return slotNum;
+}
+
+// Map pages sit at page 0 and after every FSM_PAGES_PER_MAP data pages.
+bool RecordBasedFileManager::isFreeSpaceMapPage(PageNum pageNum)
+{
+    return pageNum % (FSM_PAGES_PER_MAP + 1) == 0;
+}
+
+// Returns the map page that tracks data page pageNum.
+PageNum RecordBasedFileManager::getFreeSpaceMapPage(PageNum pageNum)
+{
+    return pageNum - pageNum % (FSM_PAGES_PER_MAP + 1);
+}
+
+// Looks for a data page with at least size bytes free. Walks the map pages from the end of the file,
+// skipping those whose maxCategory is too small, and each map from its last entry, so that a file that
+// is only growing finds its last page right away.
+RC RecordBasedFileManager::findFreePage(FileHandle &fileHandle, unsigned size, bool &found, PageNum &pageNum)
+{
+    found = false;
+    // Smallest category that is guaranteed to fit size bytes
+    unsigned category = (size + FSM_CATEGORY_SIZE - 1) / FSM_CATEGORY_SIZE;
+    if (category > FSM_MAX_CATEGORY)
+        return SUCCESS;
+
+    unsigned numPages = fileHandle.getNumberOfPages();
+    if (numPages == 0)
+        return SUCCESS;
+
+    for (PageNum mapPage = getFreeSpaceMapPage(numPages - 1); ; mapPage -= FSM_PAGES_PER_MAP + 1)
+    {
+        void *mapData;
+        if (fileHandle.pinPage(mapPage, mapData))
+            return RBFM_READ_FAILED;
+
+        FreeSpaceMapHeader header;
+        memcpy(&header, mapData, sizeof(FreeSpaceMapHeader));
+        if (header.maxCategory >= category)
+        {
+            uint8_t *entries = (uint8_t*) mapData + sizeof(FreeSpaceMapHeader);
+            unsigned numEntries = min((unsigned) FSM_PAGES_PER_MAP, numPages - mapPage - 1);
+            uint16_t largest = 0;
+            for (unsigned i = numEntries; i-- > 0;)
+            {
+                if (entries[i] >= category)
+                {
+                    pageNum = mapPage + 1 + i;
+                    found = true;
+                    fileHandle.unpinPage(mapPage, false);
+                    return SUCCESS;
+                }
+                largest = max(largest, (uint16_t) entries[i]);
+            }
+            // maxCategory was stale, now we know the exact value
+            header.maxCategory = largest;
+            memcpy(mapData, &header, sizeof(FreeSpaceMapHeader));
+            if (fileHandle.unpinPage(mapPage, true))
+                return RBFM_WRITE_FAILED;
+        }
+        else
+            fileHandle.unpinPage(mapPage, false);
+
+        if (mapPage == 0)
+            return SUCCESS;
+    }
+}
+
+// Records that data page pageNum now has freeSpace bytes free.
+RC RecordBasedFileManager::setPageFreeSpace(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace)
+{
+    PageNum mapPage = getFreeSpaceMapPage(pageNum);
+    void *mapData;
+    if (fileHandle.pinPage(mapPage, mapData))
+        return RBFM_READ_FAILED;
+
+    uint8_t category = min(freeSpace / FSM_CATEGORY_SIZE, (unsigned) FSM_MAX_CATEGORY);
+    uint8_t *entry = (uint8_t*) mapData + sizeof(FreeSpaceMapHeader) + (pageNum - mapPage - 1);
+    if (*entry == category)
+    {
+        fileHandle.unpinPage(mapPage, false);
+        return SUCCESS;
+    }
+    *entry = category;
+
+    // Only raise maxCategory here, findFreePage lowers it when it finds it stale
+    FreeSpaceMapHeader header;
+    memcpy(&header, mapData, sizeof(FreeSpaceMapHeader));
+    if (category > header.maxCategory)
+    {
+        header.maxCategory = category;
+        memcpy(mapData, &header, sizeof(FreeSpaceMapHeader));
+    }
+
+    if (fileHandle.unpinPage(mapPage, true))
+        return RBFM_WRITE_FAILED;
+    return SUCCESS;
+}
+
+// Appends a record based page to the file, adding a new map page first if one is due.
+RC RecordBasedFileManager::appendRecordBasedPage(FileHandle &fileHandle, const void *page, PageNum &pageNum)
+{
+    pageNum = fileHandle.getNumberOfPages();
+    if (isFreeSpaceMapPage(pageNum))
+    {
+        void *mapData = calloc(PAGE_SIZE, 1);
+        if (mapData == NULL)
+            return RBFM_MALLOC_FAILED;
+        RC rc = fileHandle.appendPage(mapData);
+        free(mapData);
+        if (rc)
+            return RBFM_APPEND_FAILED;
+        pageNum++;
+    }
+
+    if (fileHandle.appendPage(page))
+        return RBFM_APPEND_FAILED;
+    return setPageFreeSpace(fileHandle, pageNum, getPageFreeSpaceSize((void*) page));
+}
+
 SlotDirectoryHeader RecordBasedFileManager::getSlotDirectoryHeader(void * page)
 {
     // Getting the slot directory header.
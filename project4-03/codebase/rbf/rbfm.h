@@ -82,10 +82,42 @@ typedef struct IndexedRecordEntry
 
 typedef SlotDirectoryRecordEntry* SlotDirectory;
 
+// Free space map pages. Page 0 of every record based file is a map page, and another one follows
+// every FSM_PAGES_PER_MAP data pages. A map page holds one byte per data page that comes after it:
+// the free space of that page in units of FSM_CATEGORY_SIZE bytes, rounded down.
+typedef struct FreeSpaceMapHeader
+{
+    uint16_t maxCategory; // No data page of this map has a larger category (may be stale on the high side)
+} FreeSpaceMapHeader;
+
+#define FSM_CATEGORY_SIZE 16
+#define FSM_MAX_CATEGORY  UINT8_MAX
+#define FSM_PAGES_PER_MAP (PAGE_SIZE - sizeof(FreeSpaceMapHeader))
+
 typedef uint16_t ColumnOffset;
 
 typedef uint16_t RecordLength;
 
+// Order-preserving normalized keys, so that values of every type are ordered with one memcmp.
+// Ints and reals become NORMALIZED_KEY_SIZE big-endian bytes with the sign bit flipped, and for a
+// negative real every other bit too. A varchar is its own bytes, and of two varchars where one is
+// the start of the other the shorter comes first.
+#define NORMALIZED_KEY_SIZE 4
+
+class KeyNormalizer
+{
+public:
+  // Normalized bytes of value, which is in the format of the API, and their length. Ints and reals
+  // are written to buffer, which takes NORMALIZED_KEY_SIZE bytes. Varchars are left where they are.
+  static const char *normalize(const AttrType type, const void *value, char *buffer, unsigned &length);
+  // Negative, 0 or positive as normalized key a is less than, equal to or greater than b
+  static int compare(const char *a, const unsigned lengthA, const char *b, const unsigned lengthB);
+  // Compares two values in the format of the API
+  static int compareValues(const AttrType type, const void *a, const void *b);
+  // Whether a value comparing as cmp to another satisfies "value compOp other"
+  static bool satisfies(const int cmp, const CompOp compOp);
+};
+
 
 /********************************************************************************
 The scan iterator is NOT required to be implemented for the part 1 of the project 
@@ -93,6 +125,9 @@ The scan iterator is NOT required to be implemented for the part 1 of the projec
 
 # define RBFM_EOF (-1)  // end of a scan operator
 
+// Pages a scan reads per I/O unless changed with setPagesPerRead
+#define RBFM_SCAN_PAGES_PER_READ 16
+
 // RBFM_ScanIterator is an iterator to go through records
 // The way to use it is like the following:
 //  RBFM_ScanIterator rbfmScanIterator;
@@ -114,6 +149,9 @@ public:
   RC getNextRecord(RID &rid, void *data);
   RC close();
 
+  // Read this many contiguous pages into the buffer pool per I/O. 1 reads a page at a time.
+  void setPagesPerRead(unsigned pages);
+
   friend class RecordBasedFileManager;
 
 private:
@@ -125,16 +163,24 @@ private:
   uint32_t totalPage;
   uint16_t totalSlot;
 
+  // The current page, viewed in place (see FileHandle::viewPage) until we move on or close
   void *pageData;
+  bool pageViewed;
+  uint32_t viewedPage;
+
+  unsigned pagesPerRead;
+  uint32_t prefetchedUpTo;  // Pages before this were brought in (or requested from the prefetch thread) already
 
   AttrType type;
   unsigned attrIndex;
 
-  FileHandle fileHandle;
+  // The handle passed to scan, which must stay open until the iterator is closed
+  FileHandle *fileHandle;
   vector<Attribute> recordDescriptor;
   string conditionAttribute;
   CompOp compOp;
   const void* value;
+  string normalizedValue;   // value as a normalized key (see KeyNormalizer), made once by scanInit
   vector<string> attributeNames;
 
   vector<RID> skipList;
@@ -148,12 +194,10 @@ private:
 
   RC getNextSlot();
   RC getNextPage();
+  void releasePage();
   RC handleMovedRecord(bool &status, const RID rid, void *data);
   bool checkScanCondition();
   RC checkScanCondition(bool &result, const RID rid);
-  bool checkScanCondition(int, CompOp, const void*);
-  bool checkScanCondition(float, CompOp, const void*);
-  bool checkScanCondition(char*, CompOp, const void*);
 };
 
 
@@ -166,7 +210,7 @@ public:
   
   RC destroyFile(const string &fileName);
   
-  RC openFile(const string &fileName, FileHandle &fileHandle);
+  RC openFile(const string &fileName, FileHandle &fileHandle, FileAccessMode mode = FILE_ACCESS_BUFFERED);
   
   RC closeFile(FileHandle &fileHandle);
 
@@ -186,6 +230,11 @@ public:
   // For example, refer to the Q6 of Project 1 Environment document.
   RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+  // Insert every record of data, returning their rids in the same order. Each page is filled in
+  // memory and written once, instead of once per record. On an error, rids is cut down to the
+  // records that made it into the file.
+  RC insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &data, vector<RID> &rids);
+
   RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
   
   // This method will be mainly used for debugging/testing. 
@@ -228,6 +277,14 @@ private:
   // Private helper methods
 
   void newRecordBasedPage(void * page);
+  unsigned addRecordToPage(void *page, const vector<Attribute> &recordDescriptor, const void *data, unsigned recordSize);
+
+  // Free space map helpers
+  bool isFreeSpaceMapPage(PageNum pageNum);
+  PageNum getFreeSpaceMapPage(PageNum pageNum);
+  RC findFreePage(FileHandle &fileHandle, unsigned size, bool &found, PageNum &pageNum);
+  RC setPageFreeSpace(FileHandle &fileHandle, PageNum pageNum, unsigned freeSpace);
+  RC appendRecordBasedPage(FileHandle &fileHandle, const void *page, PageNum &pageNum);
 
   SlotDirectoryHeader getSlotDirectoryHeader(void * page);
   void setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader);
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Pin / Unpin Page
+    // 3. Write back of dirty frames on close
+    // 4. Eviction with a small buffer pool (LRU and Clock)
+    // 5. Destroy File
+    cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+    RC rc;
+    string fileName = "test13";
+    BufferManager *bm = BufferManager::instance();
+    unsigned numPages = 20;
+
+    if (FileExists(fileName))
+        pfm->destroyFile(fileName);
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append pages whose first byte is the page number
+    void *data = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(data, 0, PAGE_SIZE);
+        *((char *)data) = (char) i;
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // Modify every page in place through the buffer pool
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        void *frame;
+        rc = fileHandle.pinPage(i, frame);
+        assert(rc == success && "Pinning a page should not fail.");
+        assert(*((char *)frame) == (char) i && "Pinned frame should hold the page.");
+        *((char *)frame + 1) = (char) (i + 1);
+        rc = fileHandle.unpinPage(i, true);
+        assert(rc == success && "Unpinning a page should not fail.");
+    }
+    rc = fileHandle.unpinPage(0, false);
+    assert(rc != success && "Unpinning a page that is not pinned should fail.");
+    void *frame;
+    rc = fileHandle.pinPage(numPages, frame);
+    assert(rc != success && "Pinning a page past the end of the file should fail.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Shrink the pool so that a sweep over the file evicts frames
+    rc = bm->setNumberOfFrames(4);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+
+    for (int policy = 0; policy < 2; policy++)
+    {
+        if (policy == 1)
+            bm->setReplacementPolicy(new ClockPolicy());
+
+        unsigned hit, miss, evict;
+        unsigned hit1, miss1, evict1;
+        rc = bm->collectCounterValues(hit, miss, evict);
+        assert(rc == success && "collectCounterValues() should not fail.");
+
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        for (unsigned i = 0; i < numPages; i++)
+        {
+            rc = fileHandle.readPage(i, data);
+            assert(rc == success && "Reading a page should not fail.");
+            if (*((char *)data) != (char) i || *((char *)data + 1) != (char) (i + 1))
+            {
+                cout << "[FAIL] Page " << i << " was not written back. Test Case 13 failed." << endl;
+                pfm->closeFile(fileHandle);
+                free(data);
+                return -1;
+            }
+        }
+
+        // Four pinned frames fill the pool, a fifth pin has nowhere to go
+        void *frames[4];
+        for (unsigned i = 0; i < 4; i++)
+        {
+            rc = fileHandle.pinPage(i, frames[i]);
+            assert(rc == success && "Pinning a page should not fail.");
+        }
+        rc = fileHandle.pinPage(4, frame);
+        assert(rc != success && "Pinning with every frame pinned should fail.");
+        rc = bm->setNumberOfFrames(8);
+        assert(rc != success && "Resizing a pool with pinned frames should fail.");
+        for (unsigned i = 0; i < 4; i++)
+        {
+            rc = fileHandle.unpinPage(i, false);
+            assert(rc == success && "Unpinning a page should not fail.");
+        }
+
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+
+        rc = bm->collectCounterValues(hit1, miss1, evict1);
+        assert(rc == success && "collectCounterValues() should not fail.");
+        cout << "before:H M E - " << hit << " " << miss << " " << evict << " after:H M E - " << hit1 << " " << miss1 << " " << evict1 << endl;
+        if (miss1 - miss < numPages || evict1 - evict < numPages - 4)
+        {
+            cout << "[FAIL] A sweep over a small pool should miss and evict. Test Case 13 failed." << endl;
+            free(data);
+            return -1;
+        }
+    }
+
+    bm->setReplacementPolicy(new LRUPolicy());
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+
+    cout << "RBF Test Case 13 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test the buffer pool underneath the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    
+    RC rcmain = RBFTest_13(pfm);
+    return rcmain;
+}
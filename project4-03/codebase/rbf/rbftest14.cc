@@ -0,0 +1,126 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_14(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert Multiple Records
+    // 3. Delete Records
+    // 4. Insert Records into the freed space
+    // 5. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+
+    if (FileExists(fileName))
+        rbfm->destroyFile(fileName);
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *record = malloc(1000);
+    int numRecords = 2000;
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    // Insert records, checking that each insert only touches a few pages
+    vector<RID> rids;
+    RID rid;
+    unsigned readPageCount, writePageCount, appendPageCount;
+    unsigned readPageCount1, writePageCount1, appendPageCount1;
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "collectCounterValues() should not fail.");
+    for (int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    rc = fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(rc == success && "collectCounterValues() should not fail.");
+
+    unsigned numPages = fileHandle.getNumberOfPages();
+    cout << "pages: " << numPages << " reads per insert: " << (double) (readPageCount1 - readPageCount) / numRecords << endl;
+    if (readPageCount1 - readPageCount > 4 * (unsigned) numRecords)
+    {
+        cout << "[FAIL] Inserting should not read every page of the file. Test Case 14 failed." << endl;
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    // Delete every record of the first half of the file
+    unsigned deleted = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        if (rids[i].pageNum > numPages / 2)
+            continue;
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+        deleted++;
+    }
+
+    // Inserting the same number of records again should reuse the freed pages
+    for (unsigned i = 0; i < deleted; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    cout << "deleted and reinserted: " << deleted << " pages: " << fileHandle.getNumberOfPages() << endl;
+    if (fileHandle.getNumberOfPages() > numPages + 1)
+    {
+        cout << "[FAIL] Freed space should be reused. Test Case 14 failed." << endl;
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the free space map of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_14(rbfm);
+    return rcmain;
+}
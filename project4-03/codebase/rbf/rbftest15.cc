@@ -0,0 +1,118 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_15(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Write / Append Page under each durability mode
+    // 3. Sync a File Handle / Sync all files
+    // 4. Read back through a second File Handle
+    // 5. Destroy File
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+
+    if (FileExists(fileName))
+        pfm->destroyFile(fileName);
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    void *data = malloc(PAGE_SIZE);
+    void *buffer = malloc(PAGE_SIZE);
+    DurabilityMode modes[] = {DURABILITY_NONE, DURABILITY_ON_CLOSE, DURABILITY_PER_OP};
+
+    for (unsigned m = 0; m < 3; m++)
+    {
+        pfm->setDurabilityMode(modes[m]);
+        assert(pfm->getDurabilityMode() == modes[m] && "The durability mode should be set.");
+
+        FileHandle fileHandle;
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+
+        // Append a page, then overwrite it
+        memset(data, 'a' + m, PAGE_SIZE);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+        memset(data, 'A' + m, PAGE_SIZE);
+        rc = fileHandle.writePage(m, data);
+        assert(rc == success && "Writing a page should not fail.");
+
+        rc = fileHandle.sync();
+        assert(rc == success && "Syncing a file should not fail.");
+
+        // A second handle on the same file sees the write
+        FileHandle fileHandle2;
+        rc = pfm->openFile(fileName, fileHandle2);
+        assert(rc == success && "Opening the file should not fail.");
+        assert(fileHandle2.getNumberOfPages() == m + 1 && "The appended page should be visible.");
+        rc = fileHandle2.readPage(m, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        if (memcmp(data, buffer, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] The second handle read stale data. Test Case 15 failed." << endl;
+            free(data);
+            free(buffer);
+            return -1;
+        }
+        rc = pfm->closeFile(fileHandle2);
+        assert(rc == success && "Closing the file should not fail.");
+
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    rc = pfm->syncAll();
+    assert(rc == success && "Syncing all files should not fail.");
+    pfm->setDurabilityMode(DURABILITY_NONE);
+
+    // Every page made it to the file
+    FILE *pFile = fopen(fileName.c_str(), "rb");
+    assert(pFile != NULL && "The file should exist.");
+    for (unsigned m = 0; m < 3; m++)
+    {
+        memset(data, 'A' + m, PAGE_SIZE);
+        if (fread(buffer, 1, PAGE_SIZE, pFile) != PAGE_SIZE || memcmp(data, buffer, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << m << " is not on disk. Test Case 15 failed." << endl;
+            fclose(pFile);
+            free(data);
+            free(buffer);
+            return -1;
+        }
+    }
+    fclose(pFile);
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+    free(buffer);
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test the durability modes of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    
+    RC rcmain = RBFTest_15(pfm);
+    return rcmain;
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_16(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open a mapped and a buffered handle on it
+    // 3. Insert records through the buffered handle
+    // 4. Scan through the mapped handle, which has to grow its mapping
+    // 5. View a page in place while the file grows
+    // 6. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+    RC rc;
+    string fileName = "test16";
+
+    if (FileExists(fileName))
+        rbfm->destroyFile(fileName);
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle mappedHandle;
+    rc = rbfm->openFile(fileName, mappedHandle, FILE_ACCESS_MAPPED);
+    assert(rc == success && "Opening the file mapped should not fail.");
+    assert(mappedHandle.isMapped() && "The handle should be mapped.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+    RID rid;
+
+    // View the first data page while the buffered handle makes the file grow
+    const void *firstPage;
+    rc = mappedHandle.viewPage(1, firstPage);
+    assert(rc == success && "Viewing a page should not fail.");
+
+    int numRecords = 2000;
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i, 170.1, 5000, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    cout << "pages: " << fileHandle.getNumberOfPages() << endl;
+
+    // Flush the dirty pages so the mapping sees them, the old view must still be readable
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing a file should not fail.");
+    SlotDirectoryHeader header;
+    memcpy(&header, firstPage, sizeof(SlotDirectoryHeader));
+    assert(header.recordEntriesNumber > 0 && "The viewed page should show the inserted records.");
+    rc = mappedHandle.releasePage(1);
+    assert(rc == success && "Releasing a page should not fail.");
+
+    // Scan everything through the mapped handle
+    vector<string> attributes;
+    attributes.push_back("Age");
+    RBFM_ScanIterator rbfm_ScanIterator;
+    rc = rbfm->scan(mappedHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfm_ScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+
+    int count = 0;
+    long sum = 0;
+    while (rbfm_ScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        int age;
+        memcpy(&age, (char *)returnedData + 1, sizeof(int));
+        sum += age;
+        count++;
+    }
+    rbfm_ScanIterator.close();
+
+    cout << "scanned: " << count << endl;
+    if (count != numRecords || sum != (long) numRecords * (numRecords - 1) / 2)
+    {
+        cout << "[FAIL] The mapped scan did not return every record. Test Case 16 failed." << endl;
+        rbfm->closeFile(mappedHandle);
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    // Reads through the mapped handle see writes through the buffered one
+    rc = rbfm->readRecord(mappedHandle, recordDescriptor, rid, returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", -1, 170.1, 5000, record, &recordSize);
+    rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Updating a record should not fail.");
+    rc = rbfm->readRecord(mappedHandle, recordDescriptor, rid, returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    if (memcmp(record, returnedData, recordSize) != 0)
+    {
+        cout << "[FAIL] The mapped handle read a stale record. Test Case 16 failed." << endl;
+        rbfm->closeFile(mappedHandle);
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->closeFile(mappedHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 16 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the mapped read mode of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_16(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_17(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Append Pages
+    // 3. Read Pages with one vectored read
+    // 4. Prefetch Pages into the buffer pool
+    // 5. Destroy File
+    cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+    RC rc;
+    string fileName = "test17";
+    BufferManager *bm = BufferManager::instance();
+    unsigned numPages = 64;
+
+    if (FileExists(fileName))
+        pfm->destroyFile(fileName);
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *data = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(data, i, PAGE_SIZE);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    // A dirty page in the pool has to win over what is in the file
+    memset(data, 'x', PAGE_SIZE);
+    rc = fileHandle.writePage(10, data);
+    assert(rc == success && "Writing a page should not fail.");
+
+    void *buffers[numPages];
+    for (unsigned i = 0; i < numPages; i++)
+        buffers[i] = malloc(PAGE_SIZE);
+
+    unsigned readPageCount, writePageCount, appendPageCount;
+    unsigned readPageCount1, writePageCount1, appendPageCount1;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    rc = fileHandle.readPages(0, numPages, buffers);
+    assert(rc == success && "Reading pages should not fail.");
+    fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(readPageCount1 - readPageCount == numPages && "Every page read should be counted.");
+
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(data, i == 10 ? 'x' : i, PAGE_SIZE);
+        if (memcmp(data, buffers[i], PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << i << " was not read correctly. Test Case 17 failed." << endl;
+            pfm->closeFile(fileHandle);
+            return -1;
+        }
+    }
+    rc = fileHandle.readPages(numPages - 1, 2, buffers);
+    assert(rc != success && "Reading pages past the end of the file should fail.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Start from an empty pool, prefetch, then every read should hit
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned hit, miss, evict;
+    unsigned hit1, miss1, evict1;
+    rc = fileHandle.prefetchPages(0, numPages + 10);
+    assert(rc == success && "Prefetching pages should not fail.");
+    bm->collectCounterValues(hit, miss, evict);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        rc = fileHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+    bm->collectCounterValues(hit1, miss1, evict1);
+    cout << "hits: " << hit1 - hit << " misses: " << miss1 - miss << endl;
+    if (hit1 - hit != numPages || miss1 != miss)
+    {
+        cout << "[FAIL] Prefetched pages should be resident. Test Case 17 failed." << endl;
+        pfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    for (unsigned i = 0; i < numPages; i++)
+        free(buffers[i]);
+    free(data);
+
+    cout << "RBF Test Case 17 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test vectored reads and prefetching of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    
+    RC rcmain = RBFTest_17(pfm);
+    return rcmain;
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_18(RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Create Record-Based File
+    // 2. Insert Multiple Records
+    // 3. Asynchronous read-ahead of a page range
+    // 4. Wasted read-ahead accounting
+    // 5. Scan with the prefetch thread reading ahead
+    // 6. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+    RC rc;
+    string fileName = "test18";
+    BufferManager *bm = BufferManager::instance();
+    int numRecords = 1500;
+
+    if (FileExists(fileName))
+        rbfm->destroyFile(fileName);
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor2(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(1000);
+    int size = 0;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        memset(record, 0, 1000);
+        prepareLargeRecord2(recordDescriptor.size(), nullsIndicator, i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Nothing is read ahead while the depth is 0
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned hit, miss, evict, prefetchHit, wasted;
+    unsigned hit1, miss1, evict1, prefetchHit1, wasted1;
+    bm->collectCounterValues(hit, miss, evict);
+    rc = fileHandle.prefetchPagesAsync(0, numPages);
+    assert(rc == success && "Asking for read-ahead should not fail.");
+    bm->waitForPrefetches();
+    void *page = malloc(PAGE_SIZE);
+    rc = fileHandle.readPage(1, page);
+    assert(rc == success && "Reading a page should not fail.");
+    bm->collectCounterValues(hit1, miss1, evict1);
+    assert(miss1 - miss == 1 && "Read-ahead should be off by default.");
+
+    // With a depth every page the thread read should be a hit. The file is small enough for one request.
+    bm->setPrefetchDepth(8);
+    bm->collectCounterValues(hit, miss, evict);
+    bm->collectPrefetchCounterValues(prefetchHit, wasted);
+    rc = fileHandle.prefetchPagesAsync(2, numPages);
+    assert(rc == success && "Asking for read-ahead should not fail.");
+    bm->waitForPrefetches();
+    for (unsigned i = 2; i < numPages; i++)
+    {
+        rc = fileHandle.readPage(i, page);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+    bm->collectCounterValues(hit1, miss1, evict1);
+    bm->collectPrefetchCounterValues(prefetchHit1, wasted1);
+    cout << "hits: " << hit1 - hit << " misses: " << miss1 - miss << " prefetch hits: " << prefetchHit1 - prefetchHit << endl;
+    if (miss1 != miss || prefetchHit1 - prefetchHit != numPages - 2)
+    {
+        cout << "[FAIL] Read-ahead pages should be resident. Test Case 18 failed." << endl;
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Pages read ahead and never used are counted as wasted once they leave the pool
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.prefetchPagesAsync(0, numPages);
+    assert(rc == success && "Asking for read-ahead should not fail.");
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    bm->collectPrefetchCounterValues(prefetchHit, wasted);
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+    bm->collectPrefetchCounterValues(prefetchHit1, wasted1);
+    cout << "wasted: " << wasted1 - wasted << endl;
+    if (wasted1 - wasted != numPages)
+    {
+        cout << "[FAIL] Unused read-ahead should be counted. Test Case 18 failed." << endl;
+        return -1;
+    }
+
+    // A scan with the thread reading ahead still sees every record once
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    vector<string> attributeNames;
+    attributeNames.push_back(recordDescriptor[0].name);
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, rbfmScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    bm->collectPrefetchCounterValues(prefetchHit, wasted);
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, record) != RBFM_EOF)
+        count++;
+    rbfmScanIterator.close();
+    bm->collectPrefetchCounterValues(prefetchHit1, wasted1);
+    cout << "scanned: " << count << " prefetch hits: " << prefetchHit1 - prefetchHit << endl;
+    if (count != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << count << " records. Test Case 18 failed." << endl;
+        rbfm->closeFile(fileHandle);
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    bm->setPrefetchDepth(0);
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+    free(record);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 18 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test asynchronous read-ahead of the buffer pool
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    
+    RC rcmain = RBFTest_18(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,194 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <limits.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Compares two values by their normalized bytes
+static int normalizedCompare(const AttrType type, const void *a, const void *b)
+{
+    char bufferA[NORMALIZED_KEY_SIZE];
+    char bufferB[NORMALIZED_KEY_SIZE];
+    unsigned lengthA, lengthB;
+    const char *keyA = KeyNormalizer::normalize(type, a, bufferA, lengthA);
+    const char *keyB = KeyNormalizer::normalize(type, b, bufferB, lengthB);
+    return KeyNormalizer::compare(keyA, lengthA, keyB, lengthB);
+}
+
+static int sign(int cmp)
+{
+    return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+}
+
+// Counts the records of a scan on attribute, checking each satisfies the condition
+static int countScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const int attr, const CompOp compOp, const void *value)
+{
+    vector<string> attributeNames;
+    attributeNames.push_back(recordDescriptor[attr].name);
+    RBFM_ScanIterator rbfmScanIterator;
+    RC rc = rbfm->scan(fileHandle, recordDescriptor, recordDescriptor[attr].name, compOp, value, attributeNames, rbfmScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+
+    RID rid;
+    char data[PAGE_SIZE];
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, data) != RBFM_EOF)
+    {
+        // One field and its null byte
+        int cmp = KeyNormalizer::compareValues(recordDescriptor[attr].type, data + 1, value);
+        assert(KeyNormalizer::satisfies(cmp, compOp) && "The scan should only return records satisfying the condition.");
+        count++;
+    }
+    rbfmScanIterator.close();
+    return count;
+}
+
+int RBFTest_19(RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Normalized keys ordering ints, reals and varchars as their values
+    // 2. Create Record-Based File
+    // 3. Insert Multiple Records
+    // 4. Scan with conditions on negative ints and reals
+    // 5. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 19 *****" << endl;
+
+    // Ints and reals in increasing order
+    int ints[] = { INT_MIN, INT_MIN + 1, -65536, -256, -1, 0, 1, 255, 256, 65536, INT_MAX };
+    float reals[] = { -1e30f, -1000.5f, -1.0f, -0.5f, -1e-30f, 0.0f, 1e-30f, 0.25f, 1.0f, 1000.5f, 1e30f };
+    int numValues = sizeof(ints) / sizeof(ints[0]);
+    for (int i = 0; i < numValues; i++)
+    {
+        for (int j = 0; j < numValues; j++)
+        {
+            int expected = sign(i - j);
+            if (sign(normalizedCompare(TypeInt, &ints[i], &ints[j])) != expected
+                || sign(normalizedCompare(TypeReal, &reals[i], &reals[j])) != expected
+                || sign(KeyNormalizer::compareValues(TypeInt, &ints[i], &ints[j])) != expected
+                || sign(KeyNormalizer::compareValues(TypeReal, &reals[i], &reals[j])) != expected)
+            {
+                cout << "[FAIL] Normalized numbers " << i << " and " << j << " are out of order. Test Case 19 failed." << endl;
+                return -1;
+            }
+        }
+    }
+    float zero = 0.0f;
+    float negativeZero = -0.0f;
+    if (normalizedCompare(TypeReal, &zero, &negativeZero) != 0)
+    {
+        cout << "[FAIL] -0.0 should equal 0.0. Test Case 19 failed." << endl;
+        return -1;
+    }
+
+    // Varchars, a prefix coming before the longer strings
+    const char *strings[] = { "", "a", "ab", "abc", "abd", "b", "ba", "\xff" };
+    int numStrings = sizeof(strings) / sizeof(strings[0]);
+    char a[PAGE_SIZE];
+    char b[PAGE_SIZE];
+    for (int i = 0; i < numStrings; i++)
+    {
+        for (int j = 0; j < numStrings; j++)
+        {
+            int lengthA = strlen(strings[i]);
+            int lengthB = strlen(strings[j]);
+            memcpy(a, &lengthA, VARCHAR_LENGTH_SIZE);
+            memcpy(a + VARCHAR_LENGTH_SIZE, strings[i], lengthA);
+            memcpy(b, &lengthB, VARCHAR_LENGTH_SIZE);
+            memcpy(b + VARCHAR_LENGTH_SIZE, strings[j], lengthB);
+            if (sign(normalizedCompare(TypeVarChar, a, b)) != sign(i - j)
+                || sign(KeyNormalizer::compareValues(TypeVarChar, a, b)) != sign(i - j))
+            {
+                cout << "[FAIL] Strings \"" << strings[i] << "\" and \"" << strings[j] << "\" are out of order. Test Case 19 failed." << endl;
+                return -1;
+            }
+        }
+    }
+
+    RC rc;
+    string fileName = "test19";
+    int numRecords = 1000;
+
+    if (FileExists(fileName))
+        rbfm->destroyFile(fileName);
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Ages and heights run from negative to positive
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(1000);
+    int size = 0;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        memset(record, 0, 1000);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Employee", i - numRecords / 2,
+                (i - numRecords / 2) * 0.5f, i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+
+    int age = -100;
+    float height = -50.0f;
+    float negativeHeight = -0.0f;
+    int counts[] = {
+        countScan(rbfm, fileHandle, recordDescriptor, 1, LT_OP, &age),
+        countScan(rbfm, fileHandle, recordDescriptor, 1, GE_OP, &age),
+        countScan(rbfm, fileHandle, recordDescriptor, 1, EQ_OP, &age),
+        countScan(rbfm, fileHandle, recordDescriptor, 2, LE_OP, &height),
+        countScan(rbfm, fileHandle, recordDescriptor, 2, GT_OP, &height),
+        countScan(rbfm, fileHandle, recordDescriptor, 2, EQ_OP, &negativeHeight),
+        countScan(rbfm, fileHandle, recordDescriptor, 2, NE_OP, &negativeHeight)
+    };
+    int expected[] = { 400, 600, 1, 401, 599, 1, 999 };
+    for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        if (counts[i] != expected[i])
+        {
+            cout << "[FAIL] Scan " << i << " returned " << counts[i] << " records. Test Case 19 failed." << endl;
+            rbfm->closeFile(fileHandle);
+            return -1;
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 19 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test comparisons of normalized keys
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    
+    RC rcmain = RBFTest_19(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,136 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_20(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Destroy File while handles are open and a page is pinned **
+    // 3. Pin / Unpin Page after the destroy **
+    // 4. Create File again under the same name
+    // 5. Destroy File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RBF Test Case 20 *****" << endl;
+
+    RC rc;
+    string fileName = "test20";
+    BufferManager *bm = BufferManager::instance();
+    unsigned numPages = 4;
+
+    if (FileExists(fileName))
+        pfm->destroyFile(fileName);
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    FileHandle otherHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = pfm->openFile(fileName, otherHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append pages whose first byte is the page number
+    void *data = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(data, 0, PAGE_SIZE);
+        *((char *)data) = (char) i;
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // A small pool, so that the pages of the next file go through every frame that is free
+    rc = bm->setNumberOfFrames(4);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+
+    void *frame;
+    rc = fileHandle.pinPage(1, frame);
+    assert(rc == success && "Pinning a page should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    // The handles still work on the destroyed file
+    assert(otherHandle.getNumberOfPages() == numPages && "A handle should keep the size of the destroyed file.");
+
+    // A new file under the same name reads its pages through the frames that are not pinned
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle newHandle;
+    rc = pfm->openFile(fileName, newHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(newHandle.getNumberOfPages() == 0 && "A new file should not see the pages of the destroyed one.");
+    for (unsigned i = 0; i < 2 * numPages; i++)
+    {
+        memset(data, 0, PAGE_SIZE);
+        *((char *)data) = (char) (100 + i);
+        rc = newHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+        rc = newHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+
+    if (*((char *)frame) != 1)
+    {
+        cout << "[FAIL] A pinned frame was handed out after its file was destroyed. Test Case 20 failed." << endl;
+        free(data);
+        return -1;
+    }
+    *((char *)frame) = 50;
+    rc = fileHandle.unpinPage(1, true);
+    assert(rc == success && "Unpinning a page of a destroyed file should not fail.");
+
+    // Every frame is free again once the pin is gone
+    void *frames[4];
+    for (unsigned i = 0; i < 4; i++)
+    {
+        rc = newHandle.pinPage(i, frames[i]);
+        assert(rc == success && "Pinning a page should not fail.");
+        assert(*((char *)frames[i]) == (char) (100 + i) && "Pinned frame should hold the page.");
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        rc = newHandle.unpinPage(i, false);
+        assert(rc == success && "Unpinning a page should not fail.");
+    }
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(otherHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(newHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = bm->setNumberOfFrames(BM_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing an unpinned buffer pool should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+
+    cout << "RBF Test Case 20 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test destroying a file that is still open
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_20(pfm);
+    return rcmain;
+}
@@ -2,13 +2,25 @@
 #include "rm.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <cstdlib>
 #include <cmath>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 using namespace std;
 
 RelationManager* RelationManager::_rm = 0;
 
+static const CatalogIndex catalogIndexes[CATALOG_INDEXES] = {
+    {TABLES_TABLE_NAME, TABLES_TABLE_ID, TABLES_COL_TABLE_NAME},
+    {TABLES_TABLE_NAME, TABLES_TABLE_ID, TABLES_COL_TABLE_ID},
+    {COLUMNS_TABLE_NAME, COLUMNS_TABLE_ID, COLUMNS_COL_TABLE_ID}};
+
 RelationManager* RelationManager::instance()
 {
     if(!_rm)
@@ -18,8 +30,11 @@ RelationManager* RelationManager::instance()
 }
 
 RelationManager::RelationManager()
-: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor()), indexDescriptor(createIndexDescriptor())
+: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor()), indexDescriptor(createIndexDescriptor()),
+  _maxOpenFiles(RM_MAX_OPEN_FILES)
 {
+    // Cached handles outlive every call, so their pages are written back when the program ends
+    atexit(closeCachedFilesAtExit);
 }
 
 RelationManager::~RelationManager()
@@ -41,6 +56,23 @@ RC RelationManager::createCatalog()
     if (rc)
         return rc;
 
+    // The catalog has indexes of its own, so that finding a table and its columns is not a scan.
+    // With them in the Indexes table, the entries below go into them as they are inserted.
+    IndexManager *im = IndexManager::instance();
+    for (unsigned i = 0; i < CATALOG_INDEXES; i++)
+    {
+        rc = im->createFile(indexFileName(catalogIndexes[i].tableName, catalogIndexes[i].column));
+        if (rc)
+            return rc;
+        rc = insertIndex(catalogIndexes[i].tableID, catalogIndexes[i].column, IX_INDEX_BTREE);
+        if (rc)
+            return rc;
+    }
+    clearTableInfo();
+    rc = cacheSystemTables();
+    if (rc)
+        return rc;
+
     // Add table entries for both Tables and Columns
     rc = insertTable(TABLES_TABLE_ID, 1, TABLES_TABLE_NAME);
     if (rc)
@@ -71,7 +103,10 @@ RC RelationManager::deleteCatalog()
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    RC rc;
+    // Every cached handle and table belongs to this catalog
+    RC rc = closeCachedFiles();
+    if (rc)
+        return rc;
 
     rc = rbfm->destroyFile(getFileName(TABLES_TABLE_NAME));
     if (rc)
@@ -85,6 +120,11 @@ RC RelationManager::deleteCatalog()
     if (rc)
         return rc;
 
+    // Catalogs created before the catalog had indexes have none to destroy
+    IndexManager *im = IndexManager::instance();
+    for (unsigned i = 0; i < CATALOG_INDEXES; i++)
+        im->destroyFile(indexFileName(catalogIndexes[i].tableName, catalogIndexes[i].column));
+
     return SUCCESS;
 }
 
@@ -96,6 +136,7 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
     // Create the rbfm file to store the table
     if ((rc = rbfm->createFile(getFileName(tableName))))
         return rc;
+    invalidateTableInfo(tableName);
 
     // Get the table's ID
     int32_t id;
@@ -130,140 +171,85 @@ RC RelationManager::deleteTable(const string &tableName)
         return RM_CANNOT_MOD_SYS_TBL;
 
     // Delete the rbfm file holding this table's entries
+    rc = dropHandle(getFileName(tableName));
+    if (rc)
+        return rc;
     rc = rbfm->destroyFile(getFileName(tableName));
     if (rc)
         return rc;
 
-    // Grab the table ID
+    // Grab the table ID, the cached entry is gone from here on
     int32_t id;
     rc = getTableID(tableName, id);
     if (rc)
         return rc;
+    invalidateTableInfo(tableName);
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(INDEXES_TABLE_NAME), fileHandle);
-    if (rc)
-        return rc;
-
-    RBFM_ScanIterator rbfm_si;
-    vector<string> projection;
-    projection.push_back(INDEXES_COL_COLUMN_NAME);
-
-    void *value = &id;
-    rc = rbfm->scan(fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    RID rid;
-    void *data = malloc(INDEXES_RECORD_DATA_SIZE);
-    while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        unsigned offset = 1;
-
-        int32_t colLen;
-        memcpy(&colLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-        offset += VARCHAR_LENGTH_SIZE;
-
-        char col[colLen + 1];
-        col[colLen] = '\0';
-        memcpy(col, (char*) data + offset, colLen);
-    }
-
-    rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    free(data);
-
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
-    if (rc)
-        return rc;
-
-    projection.clear();
-    value = &id;
-
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-    rc = rbfm_si.getNextRecord(rid, NULL);
+    // The indexes of the table go with it
+    IndexManager *im = IndexManager::instance();
+    rc = readCatalog(INDEXES_TABLE_NAME, INDEXES_COL_TABLE_ID, &id,
+        [&](FileHandle &fileHandle, const RID &rid, const void *data) -> RC
+        {
+            char col[INDEXES_COL_COLUMN_NAME_SIZE + VARCHAR_LENGTH_SIZE];
+            int32_t colLen = getValue(1, indexDescriptor, data, col) - VARCHAR_LENGTH_SIZE;
+            string column(col + VARCHAR_LENGTH_SIZE, colLen);
+
+            RC rc = rbfm->deleteRecord(fileHandle, indexDescriptor, rid);
+            if (rc == SUCCESS)
+                rc = dropHandle(indexFileName(tableName, column));
+            if (rc == SUCCESS)
+                rc = im->destroyFile(indexFileName(tableName, column));
+            return rc;
+        });
     if (rc)
         return rc;
 
-    rbfm->deleteRecord(fileHandle, tableDescriptor, rid);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-
-    // Delete from Columns table
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    // Then its entries in Tables and Columns, and in the indexes of the catalog
+    rc = deleteCatalogRecords(TABLES_TABLE_NAME, TABLES_COL_TABLE_ID, id);
     if (rc)
         return rc;
-
-    // Find all of the entries whose table-id equal this table's ID
-    rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    while((rc = rbfm_si.getNextRecord(rid, NULL)) == SUCCESS)
-    {
-        // Delete each result with the returned RID
-        rc = rbfm->deleteRecord(fileHandle, columnDescriptor, rid);
-        if (rc)
-            return rc;
-    }
-    if (rc != RBFM_EOF)
-        return rc;
-
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-
-    return SUCCESS;
+    return deleteCatalogRecords(COLUMNS_TABLE_NAME, COLUMNS_COL_TABLE_ID, id);
 }
 
 // Fills the given attribute vector with the recordDescriptor of tableName
 RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &attrs)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     // Clear out any old values
     attrs.clear();
-    RC rc;
-
-    int32_t id;
-    rc = getTableID(tableName, id);
-    if (rc)
-        return rc;
-
-    void *value = &id;
-
-    // We need to get the three values that make up an Attribute: name, type, length
-    // We also need the position of each attribute in the row
-    RBFM_ScanIterator rbfm_si;
-    vector<string> projection;
-    projection.push_back(COLUMNS_COL_COLUMN_NAME);
-    projection.push_back(COLUMNS_COL_COLUMN_TYPE);
-    projection.push_back(COLUMNS_COL_COLUMN_LENGTH);
-    projection.push_back(COLUMNS_COL_COLUMN_POSITION);
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
-    // Scan through the Column table for all entries whose table-id equals tableName's table id.
-    rc = rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-    if (rc)
-        return rc;
+    attrs = info->attrs;
+    return SUCCESS;
+}
 
-    RID rid;
-    void *data = malloc(COLUMNS_RECORD_DATA_SIZE);
+// Reads the recordDescriptor of table id from the Columns table
+RC RelationManager::readAttributes(int32_t id, vector<Attribute> &attrs)
+{
+    // Clear out any old values
+    attrs.clear();
 
+    // We need to get the three values that make up an Attribute: name, type, length
+    // We also need the position of each attribute in the row.
     // IndexedAttr is an attr with a position. The position will be used to sort the vector
     vector<IndexedAttr> iattrs;
-    while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+    RC rc = readCatalog(COLUMNS_TABLE_NAME, COLUMNS_COL_TABLE_ID, &id,
+        [&](FileHandle &fileHandle, const RID &rid, const void *data) -> RC
     {
         // For each entry, create an IndexedAttr, and fill it with the 4 results
         IndexedAttr attr;
-        unsigned offset = 0;
 
         // For the Columns table, there should never be a null column
         char null;
         memcpy(&null, data, 1);
         if (null)
-            rc = RM_NULL_COLUMN;
+            return RM_NULL_COLUMN;
 
-        // Read in name
-        offset = 1;
+        // Read in name, after the table id
+        unsigned offset = 1 + INT_SIZE;
         int32_t nameLen;
         memcpy(&nameLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
         offset += VARCHAR_LENGTH_SIZE;
@@ -292,13 +278,10 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
         attr.pos = pos;
 
         iattrs.push_back(attr);
-    }
-    // Do cleanup
-    rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    free(data);
+        return SUCCESS;
+    });
     // If we ended on an error, return that error
-    if (rc != RBFM_EOF)
+    if (rc)
         return rc;
 
     // Sort attributes by position ascending
@@ -335,14 +318,14 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->insertRecord(fileHandle, recordDescriptor, data, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->insertRecord(*fileHandle, recordDescriptor, data, rid);
+    releaseHandle(getFileName(tableName));
 
     if (rc)
         return rc;
@@ -354,6 +337,224 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     return rc;
 }
 
+RC RelationManager::insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    if (info->system)
+        return RM_CANNOT_MOD_SYS_TBL;
+    vector<Attribute> recordDescriptor = info->attrs;
+
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
+    if (rc)
+        return rc;
+
+    rc = rbfm->insertRecords(*fileHandle, recordDescriptor, data, rids);
+    releaseHandle(getFileName(tableName));
+    if (rc)
+        return rc;
+
+    // Each index gets the keys of the whole batch, sorted, and goes down to each leaf once
+    IndexManager *im = IndexManager::instance();
+    void *key = malloc(PAGE_SIZE);
+    for (const IndexTuple &index : info->indexes)
+    {
+        IX_EntrySorter sorter(get<TupleAttribute>(index));
+        for (size_t i = 0; i < data.size() && rc == SUCCESS; i++)
+        {
+            if (getValue(get<TuplePosition>(index), recordDescriptor, data[i], key) > 0)
+                rc = sorter.add(key, rids[i]);
+        }
+        if (rc == SUCCESS)
+            rc = im->insertEntries(*get<TupleHandle>(index), get<TupleAttribute>(index), sorter);
+        if (rc)
+            break;
+    }
+    free(key);
+
+    return rc;
+}
+
+RC RelationManager::bulkLoad(const string &tableName, const string &csvPath, const RM_LoadOptions &options, RM_LoadStats &stats)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    IndexManager *im = IndexManager::instance();
+    auto start = chrono::steady_clock::now();
+    stats.rows = 0;
+    stats.seconds = 0;
+    stats.rowsPerSecond = 0;
+
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    if (info->system)
+        return RM_CANNOT_MOD_SYS_TBL;
+    vector<Attribute> recordDescriptor = info->attrs;
+
+    int fd = open(csvPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return RM_LOAD_OPEN_FAILED;
+    struct stat st;
+    if (fstat(fd, &st))
+    {
+        close(fd);
+        return RM_LOAD_OPEN_FAILED;
+    }
+    size_t size = st.st_size;
+    const char *input = NULL;
+    if (size > 0)
+    {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            close(fd);
+            return RM_LOAD_OPEN_FAILED;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        input = (const char*) map;
+    }
+    close(fd);
+
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
+    if (rc)
+    {
+        if (input != NULL)
+            munmap((void*) input, size);
+        return rc;
+    }
+
+    // Chunks end at the end of a line
+    vector<size_t> bounds(1, 0);
+    size_t chunkSize = max(options.chunkSize, (size_t) 1);
+    while (bounds.back() < size)
+    {
+        size_t bound = bounds.back() + chunkSize;
+        if (bound < size)
+        {
+            const char *newline = (const char*) memchr(input + bound, '\n', size - bound);
+            bound = newline == NULL ? size : newline - input + 1;
+        }
+        bounds.push_back(min(bound, size));
+    }
+    size_t numChunks = bounds.size() - 1;
+
+    // Parsers take chunks in order, staying at most window chunks ahead of the writer
+    unsigned threads = options.threads ? options.threads : thread::hardware_concurrency();
+    threads = max(threads, 1u);
+    size_t window = 2 * threads;
+    vector<LoadChunk> chunks(numChunks);
+    mutex chunksMutex;
+    condition_variable chunksChanged;
+    size_t nextChunk = 0;
+    size_t written = 0;
+    bool failed = false;
+
+    auto parse = [&]()
+    {
+        while (true)
+        {
+            size_t c;
+            {
+                unique_lock<mutex> lock(chunksMutex);
+                chunksChanged.wait(lock, [&]
+                    {return failed || nextChunk >= numChunks || nextChunk < written + window;});
+                if (failed || nextChunk >= numChunks)
+                    return;
+                c = nextChunk++;
+            }
+            RC parsed = parseRows(input + bounds[c], input + bounds[c + 1], recordDescriptor,
+                options.delimiter, chunks[c]);
+            lock_guard<mutex> lock(chunksMutex);
+            chunks[c].rc = parsed;
+            chunks[c].parsed = true;
+            chunksChanged.notify_all();
+        }
+    };
+    vector<thread> parsers;
+    for (unsigned t = 0; t < threads && t < numChunks; t++)
+        parsers.push_back(thread(parse));
+
+    // This thread writes the chunks in order, keeping the keys of each index for later
+    vector<IX_EntrySorter*> sorters;
+    for (const IndexTuple &index : info->indexes)
+        sorters.push_back(new IX_EntrySorter(get<TupleAttribute>(index)));
+    void *key = malloc(PAGE_SIZE);
+    vector<const void*> tuples;
+    vector<RID> rids;
+    RC parsed = SUCCESS;
+    for (size_t c = 0; c < numChunks && parsed == SUCCESS && rc == SUCCESS; c++)
+    {
+        LoadChunk &chunk = chunks[c];
+        {
+            unique_lock<mutex> lock(chunksMutex);
+            chunksChanged.wait(lock, [&] {return chunk.parsed;});
+        }
+        // A chunk with a bad row holds the rows before it
+        parsed = chunk.rc;
+        tuples.clear();
+        for (size_t offset : chunk.offsets)
+            tuples.push_back(&chunk.tuples[offset]);
+        rc = rbfm->insertRecords(*fileHandle, recordDescriptor, tuples, rids);
+
+        // rids holds the tuples that were written, even when the write stopped partway
+        RC added = SUCCESS;
+        for (unsigned i = 0; i < sorters.size() && added == SUCCESS; i++)
+        {
+            int32_t pos = get<TuplePosition>(info->indexes[i]);
+            for (size_t t = 0; t < rids.size() && added == SUCCESS; t++)
+            {
+                if (getValue(pos, recordDescriptor, tuples[t], key) > 0)
+                    added = sorters[i]->add(key, rids[t]);
+            }
+        }
+        stats.rows += rids.size();
+        if (rc == SUCCESS)
+            rc = added;
+
+        // The chunk is written, so its memory can go to one not parsed yet
+        vector<char>().swap(chunk.tuples);
+        vector<size_t>().swap(chunk.offsets);
+        lock_guard<mutex> lock(chunksMutex);
+        written = c + 1;
+        failed = parsed != SUCCESS || rc != SUCCESS;
+        chunksChanged.notify_all();
+    }
+    for (thread &parser : parsers)
+        parser.join();
+    releaseHandle(getFileName(tableName));
+    if (input != NULL)
+        munmap((void*) input, size);
+
+    // An empty index is built bottom up, any other takes the keys as one sorted batch. An error only
+    // stops the load, so the rows written before it get their index entries all the same.
+    RC indexed = SUCCESS;
+    for (unsigned i = 0; i < sorters.size() && indexed == SUCCESS; i++)
+    {
+        IXFileHandle &ixfileHandle = *get<TupleHandle>(info->indexes[i]);
+        const Attribute &attr = get<TupleAttribute>(info->indexes[i]);
+        indexed = im->bulkLoad(ixfileHandle, attr, *sorters[i]);
+        if (indexed == IX_NOT_EMPTY)
+            indexed = im->insertEntries(ixfileHandle, attr, *sorters[i]);
+    }
+    for (IX_EntrySorter *sorter : sorters)
+        delete sorter;
+    free(key);
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (stats.seconds > 0)
+        stats.rowsPerSecond = stats.rows / stats.seconds;
+    if (rc == SUCCESS)
+        rc = parsed;
+    return rc ? rc : indexed;
+}
+
 RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
@@ -374,23 +575,21 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
         return rc;
 
     void *oldData = malloc(PAGE_SIZE);
     rc = readTuple(tableName, rid, oldData);
-    if (rc)
-        return rc;
-
-    rc = updateIndexes(tableName, recordDescriptor, oldData, rid, INDEX_DELETE);
-    if (rc)
-        return rc;
+    if (rc == SUCCESS)
+        rc = updateIndexes(tableName, recordDescriptor, oldData, rid, INDEX_DELETE);
+    free(oldData);
 
     // Let rbfm do all the work
-    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
-    rbfm->closeFile(fileHandle);
+    if (rc == SUCCESS)
+        rc = rbfm->deleteRecord(*fileHandle, recordDescriptor, rid);
+    releaseHandle(getFileName(tableName));
 
     return rc;
 }
@@ -415,32 +614,29 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
-    if (rc)
-        return rc;
-
-    void *oldData = malloc(PAGE_SIZE);
-
-    // Read old record
-    rc = readTuple(tableName, rid, oldData);
-    if (rc)
-        return rc;
-
-    // Delete old record key
-    rc = updateIndexes(tableName, recordDescriptor, oldData, rid, INDEX_DELETE);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
         return rc;
 
-    // Let rbfm do all the work
-    rc = rbfm->updateRecord(fileHandle, recordDescriptor, data, rid);
-    rbfm->closeFile(fileHandle);
+    // The old record is only needed to compare index keys with
+    void *oldData = NULL;
+    TableInfo *info;
+    rc = getTableInfo(tableName, info);
+    if (rc == SUCCESS && !info->indexes.empty())
+    {
+        oldData = malloc(PAGE_SIZE);
+        rc = readTuple(tableName, rid, oldData);
+    }
 
-    // and then insert new key for new record
-    rc = updateIndexes(tableName, recordDescriptor, data, rid, INDEX_INSERT);
-    if (rc)
-        return rc;
+    // Let rbfm do all the work. The rid stays the same even if the record moves.
+    if (rc == SUCCESS)
+        rc = rbfm->updateRecord(*fileHandle, recordDescriptor, data, rid);
+    releaseHandle(getFileName(tableName));
 
+    if (rc == SUCCESS && oldData != NULL)
+        rc = updateChangedIndexes(tableName, recordDescriptor, oldData, data, rid);
+    free(oldData);
     return rc;
 }
 
@@ -456,14 +652,56 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readRecord(*fileHandle, recordDescriptor, rid, data);
+    releaseHandle(getFileName(tableName));
+    return rc;
+}
+
+// Make every change to every table and index durable
+RC RelationManager::flushAll()
+{
+    return PagedFileManager::instance()->syncAll();
+}
+
+void RelationManager::closeCachedFilesAtExit()
+{
+    if (_rm)
+        _rm->closeCachedFiles();
+}
+
+void RelationManager::setMaxOpenFiles(unsigned files)
+{
+    _maxOpenFiles = max(files, 1u);
+    evictHandles();
+}
+
+unsigned RelationManager::getMaxOpenFiles() const
+{
+    return _maxOpenFiles;
+}
+
+RC RelationManager::closeCachedFiles()
+{
+    // The catalog cache holds the handles of the indexes of its tables
+    clearTableInfo();
+    RC rc = SUCCESS;
+    auto it = _handleOrder.begin();
+    while (it != _handleOrder.end())
+    {
+        // dropHandle takes the file out of _handleOrder, so step past it first
+        string fileName = *it++;
+        if (_handles[fileName].inUse > 0)
+            continue;
+        RC closeRc = dropHandle(fileName);
+        if (closeRc)
+            rc = closeRc;
+    }
     return rc;
 }
 
@@ -484,16 +722,123 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     if (rc)
         return rc;
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
         return rc;
 
-    rc = rbfm->readAttribute(fileHandle, recordDescriptor, rid, attributeName, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readAttribute(*fileHandle, recordDescriptor, rid, attributeName, data);
+    releaseHandle(getFileName(tableName));
+    return rc;
+}
+
+// Handle cache
+
+RC RelationManager::getFileHandle(const string &fileName, FileHandle *&fileHandle)
+{
+    CachedHandle *cached;
+    RC rc = getHandle(fileName, false, cached);
+    if (rc)
+        return rc;
+    fileHandle = cached->fileHandle;
+    return SUCCESS;
+}
+
+RC RelationManager::getIXFileHandle(const string &fileName, IXFileHandle *&ixfileHandle)
+{
+    CachedHandle *cached;
+    RC rc = getHandle(fileName, true, cached);
+    if (rc)
+        return rc;
+    ixfileHandle = cached->ixfileHandle;
+    return SUCCESS;
+}
+
+// Finds or opens the cached handle of fileName and marks it in use and most recently used
+RC RelationManager::getHandle(const string &fileName, bool index, CachedHandle *&cached)
+{
+    auto it = _handles.find(fileName);
+    if (it != _handles.end())
+    {
+        _handleOrder.splice(_handleOrder.end(), _handleOrder, it->second.lruPosition);
+        it->second.inUse++;
+        cached = &it->second;
+        return SUCCESS;
+    }
+
+    // Make room first, so that a full cache never closes the handle we are about to return
+    evictHandles(1);
+
+    CachedHandle handle;
+    handle.fileHandle = NULL;
+    handle.ixfileHandle = NULL;
+    RC rc;
+    if (index)
+    {
+        handle.ixfileHandle = new IXFileHandle();
+        rc = IndexManager::instance()->openFile(fileName, *handle.ixfileHandle);
+    }
+    else
+    {
+        handle.fileHandle = new FileHandle();
+        rc = RecordBasedFileManager::instance()->openFile(fileName, *handle.fileHandle);
+    }
+    if (rc)
+    {
+        delete handle.fileHandle;
+        delete handle.ixfileHandle;
+        return rc;
+    }
+
+    handle.inUse = 1;
+    handle.lruPosition = _handleOrder.insert(_handleOrder.end(), fileName);
+    cached = &(_handles[fileName] = handle);
+    return SUCCESS;
+}
+
+void RelationManager::releaseHandle(const string &fileName)
+{
+    auto it = _handles.find(fileName);
+    if (it != _handles.end() && it->second.inUse > 0)
+        it->second.inUse--;
+    // Handles opened past the budget while everything was in use can go now
+    evictHandles();
+}
+
+RC RelationManager::dropHandle(const string &fileName)
+{
+    auto it = _handles.find(fileName);
+    if (it == _handles.end())
+        return SUCCESS;
+
+    RC rc;
+    if (it->second.ixfileHandle != NULL)
+    {
+        rc = IndexManager::instance()->closeFile(*it->second.ixfileHandle);
+        delete it->second.ixfileHandle;
+    }
+    else
+    {
+        rc = RecordBasedFileManager::instance()->closeFile(*it->second.fileHandle);
+        delete it->second.fileHandle;
+    }
+    _handleOrder.erase(it->second.lruPosition);
+    _handles.erase(it);
     return rc;
 }
 
+// Closes least recently used handles that are not in use until there is room for reserve more
+void RelationManager::evictHandles(unsigned reserve)
+{
+    auto it = _handleOrder.begin();
+    while (_handles.size() + reserve > _maxOpenFiles && it != _handleOrder.end())
+    {
+        string fileName = *it++;
+        if (_handles[fileName].inUse == 0)
+            dropHandle(fileName);
+    }
+}
+
 string RelationManager::getFileName(const char *tableName)
 {
     return string(tableName) + string(TABLE_FILE_EXTENSION);
@@ -590,7 +935,12 @@ vector<Attribute> RelationManager::createIndexDescriptor()
     attr.length = (AttrLength)INDEXES_COL_COLUMN_NAME_SIZE;
     id.push_back(attr);
 
-    return id;
+    attr.name = INDEXES_COL_INDEX_TYPE;
+    attr.type = TypeInt;
+    attr.length = (AttrLength)INT_SIZE;
+    id.push_back(attr);
+
+    return id;
 }
 
 // Creates the Tables table entry for the given id and tableName
@@ -661,7 +1011,7 @@ void RelationManager::prepareColumnsRecordData(int32_t id, int32_t pos, Attribut
     offset += INT_SIZE;
 }
 
-void RelationManager::prepareIndexesRecordData(int32_t tid, const string &attributeName, void *data)
+void RelationManager::prepareIndexesRecordData(int32_t tid, const string &attributeName, IndexType type, void *data)
 {
     unsigned offset = 0;
     int32_t attr_len = attributeName.length();
@@ -679,6 +1029,10 @@ void RelationManager::prepareIndexesRecordData(int32_t tid, const string &attrib
     offset += VARCHAR_LENGTH_SIZE;
     memcpy((char*) data + offset, attributeName.c_str(), attr_len);
     offset += attr_len;
+
+    int32_t indexType = type;
+    memcpy((char*) data + offset, &indexType, INT_SIZE);
+    offset += INT_SIZE;
 }
 
 // Insert the given columns into the Columns table
@@ -688,8 +1042,8 @@ RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDes
 
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(COLUMNS_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
@@ -699,54 +1053,57 @@ RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDes
     {
         int32_t pos = i+1;
         prepareColumnsRecordData(id, pos, recordDescriptor[i], columnData);
-        rc = rbfm->insertRecord(fileHandle, columnDescriptor, columnData, rid);
+        rc = rbfm->insertRecord(*fileHandle, columnDescriptor, columnData, rid);
+        if (rc == SUCCESS)
+            rc = updateIndexes(COLUMNS_TABLE_NAME, columnDescriptor, columnData, rid, INDEX_INSERT);
         if (rc)
-            return rc;
+            break;
     }
 
-    rbfm->closeFile(fileHandle);
+    releaseHandle(getFileName(COLUMNS_TABLE_NAME));
     free(columnData);
-    return SUCCESS;
+    return rc;
 }
 
 RC RelationManager::insertTable(int32_t id, int32_t system, const string &tableName)
 {
-    FileHandle fileHandle;
+    FileHandle *fileHandle;
     RID rid;
     RC rc;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    rc = getFileHandle(getFileName(TABLES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
     void *tableData = malloc (TABLES_RECORD_DATA_SIZE);
     prepareTablesRecordData(id, system, tableName, tableData);
-    rc = rbfm->insertRecord(fileHandle, tableDescriptor, tableData, rid);
+    rc = rbfm->insertRecord(*fileHandle, tableDescriptor, tableData, rid);
+    if (rc == SUCCESS)
+        rc = updateIndexes(TABLES_TABLE_NAME, tableDescriptor, tableData, rid, INDEX_INSERT);
 
-    rbfm->closeFile(fileHandle);
+    releaseHandle(getFileName(TABLES_TABLE_NAME));
     free (tableData);
     return rc;
 }
 
-RC RelationManager::insertIndex(int32_t tid, const string &attributeName)
+RC RelationManager::insertIndex(int32_t tid, const string &attributeName, IndexType type)
 {
-    FileHandle fileHandle;
+    FileHandle *fileHandle;
     RID rid;
     RC rc;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    rc = rbfm->openFile(getFileName(INDEXES_TABLE_NAME), fileHandle);
+    rc = getFileHandle(getFileName(INDEXES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
     void *indexData = malloc (INDEXES_RECORD_DATA_SIZE);
-    prepareIndexesRecordData(tid, attributeName, indexData);
-    rc = rbfm->insertRecord(fileHandle, indexDescriptor, indexData, rid);
-    if (rc) 
-        return rc;
+    prepareIndexesRecordData(tid, attributeName, type, indexData);
+    // The Indexes table has no index of its own to keep up to date
+    rc = rbfm->insertRecord(*fileHandle, indexDescriptor, indexData, rid);
 
-    rbfm->closeFile(fileHandle);
+    releaseHandle(getFileName(INDEXES_TABLE_NAME));
     free (indexData);
     return rc;
 }
@@ -754,11 +1111,28 @@ RC RelationManager::insertIndex(int32_t tid, const string &attributeName)
 // Get the next table ID for creating a table
 RC RelationManager::getNextTableID(int32_t &table_id)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
+    TableInfo *info;
+    RC rc = getTableInfo(TABLES_TABLE_NAME, info);
+    if (rc)
+        return rc;
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    // The greatest ID is the last key of the index on table-id
+    int index = findIndex(info->indexes, TABLES_COL_TABLE_ID);
+    if (index >= 0)
+    {
+        int32_t max_table_id = 0;
+        rc = IndexManager::instance()->findMaxKey(*get<TupleHandle>(info->indexes[index]),
+            get<TupleAttribute>(info->indexes[index]), &max_table_id);
+        if (rc && rc != IX_EOF)
+            return rc;
+        table_id = max_table_id + 1;
+        return SUCCESS;
+    }
+
+    // Without it, scan through all tables to get largest ID value
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(TABLES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
@@ -766,9 +1140,8 @@ RC RelationManager::getNextTableID(int32_t &table_id)
     vector<string> projection;
     projection.push_back(TABLES_COL_TABLE_ID);
 
-    // Scan through all tables to get largest ID value
     RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
+    rc = rbfm->scan(*fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
 
     RID rid;
     void *data = malloc (1 + INT_SIZE);
@@ -781,102 +1154,200 @@ RC RelationManager::getNextTableID(int32_t &table_id)
         if (tid > max_table_id)
             max_table_id = tid;
     }
-    // If we ended on eof, then we were successful
-    if (rc == RM_EOF)
-        rc = SUCCESS;
 
     free(data);
     // Next table ID is 1 more than largest table id
     table_id = max_table_id + 1;
-    rbfm->closeFile(fileHandle);
     rbfm_si.close();
+    releaseHandle(getFileName(TABLES_TABLE_NAME));
     return SUCCESS;
 }
 
 // Gets the table ID of the given tableName
 RC RelationManager::getTableID(const string &tableName, int32_t &tableID)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
-
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
-    // We only care about the table ID
-    vector<string> projection;
-    projection.push_back(TABLES_COL_TABLE_ID);
+    tableID = info->id;
+    return SUCCESS;
+}
 
+// Reads the table ID and system flag of tableName from the Tables table
+RC RelationManager::readTableEntry(const string &tableName, int32_t &tableID, bool &system)
+{
     // Fill value with the string tablename in api format (without null indicator)
-    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
+    char value[VARCHAR_LENGTH_SIZE + TABLES_COL_TABLE_NAME_SIZE];
     int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
-
-    // Find the table entries whose table-name field matches tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
-
-    // There will only be one such entry, so we use if rather than while
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        int32_t tid;
-        fromAPI(tid, data);
-        tableID = tid;
-    }
+    if (name_len > TABLES_COL_TABLE_NAME_SIZE)
+        return RBFM_EOF;
+    memcpy(value, &name_len, VARCHAR_LENGTH_SIZE);
+    memcpy(value + VARCHAR_LENGTH_SIZE, tableName.c_str(), name_len);
 
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;
+    // There will only be one such entry. The fields are never null in the Tables table.
+    bool found = false;
+    RC rc = readCatalog(TABLES_TABLE_NAME, TABLES_COL_TABLE_NAME, value,
+        [&](FileHandle &fileHandle, const RID &rid, const void *data) -> RC
+        {
+            int32_t tmp;
+            getValue(0, tableDescriptor, data, &tableID);
+            getValue(3, tableDescriptor, data, &tmp);
+            system = tmp == 1;
+            found = true;
+            return SUCCESS;
+        });
+    if (rc)
+        return rc;
+    return found ? SUCCESS : RBFM_EOF;
 }
 
 // Determine if table tableName is a system table. Set the boolean argument as the result
+// A table that does not exist is not a system table
 RC RelationManager::isSystemTable(bool &system, const string &tableName)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
+    TableInfo *info;
+    system = false;
+    if (getTableInfo(tableName, info) == SUCCESS)
+        system = info->system;
+    return SUCCESS;
+}
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+// Catalog cache
+
+// Finds tableName in the catalog cache, reading its Tables, Columns and Indexes entries on a miss
+RC RelationManager::getTableInfo(const string &tableName, TableInfo *&info)
+{
+    auto it = _catalog.find(tableName);
+    if (it != _catalog.end())
+    {
+        info = &it->second;
+        return SUCCESS;
+    }
+
+    // The system tables come first, as reading any other entry goes through their indexes
+    if (_catalog.find(TABLES_TABLE_NAME) == _catalog.end())
+    {
+        RC rc = cacheSystemTables();
+        if (rc)
+            return rc;
+        it = _catalog.find(tableName);
+        if (it != _catalog.end())
+        {
+            info = &it->second;
+            return SUCCESS;
+        }
+    }
+
+    TableInfo entry;
+    RC rc = readTableEntry(tableName, entry.id, entry.system);
+    if (rc)
+        return rc;
+    rc = readAttributes(entry.id, entry.attrs);
+    if (rc)
+        return rc;
+    vector<string> indexes;
+    rc = readIndexes(entry.id, indexes);
+    if (rc)
+        return rc;
+    rc = resolveIndexes(tableName, entry.attrs, indexes, entry.indexes);
     if (rc)
         return rc;
 
-    // We only care about system column
-    vector<string> projection;
-    projection.push_back(TABLES_COL_SYSTEM);
+    info = &(_catalog[tableName] = entry);
+    return SUCCESS;
+}
 
-    // Set up value to be tableName in API format (without null indicator)
-    void *value = malloc(5 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
+// Drops what the cache knows about tableName, to be read again on next use
+void RelationManager::invalidateTableInfo(const string &tableName)
+{
+    auto it = _catalog.find(tableName);
+    if (it == _catalog.end())
+        return;
+    vector<IndexTuple> indexes;
+    indexes.swap(it->second.indexes);
+    _catalog.erase(it);
+    for (const IndexTuple &index : indexes)
+        releaseHandle(indexFileName(tableName, get<TupleAttribute>(index).name));
+}
 
-    // Find table whose table-name is equal to tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
+// Drops every table from the cache
+void RelationManager::clearTableInfo()
+{
+    while (!_catalog.empty())
+    {
+        string tableName = _catalog.begin()->first;
+        invalidateTableInfo(tableName);
+    }
+}
 
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+RC RelationManager::resolveIndexes(const string &tableName, const vector<Attribute> &attrs, const vector<string> &indexes,
+    vector<IndexTuple> &resolved)
+{
+    resolved.clear();
+    for (const string &column : indexes)
     {
-        // Parse the system field from that table entry
-        int32_t tmp;
-        fromAPI(tmp, data);
-        system = tmp == 1;
+        unsigned pos = 0;
+        while (pos < attrs.size() && attrs[pos].name != column)
+            pos++;
+
+        IXFileHandle *ixfileHandle;
+        RC rc = pos < attrs.size() ? getIXFileHandle(indexFileName(tableName, column), ixfileHandle) : -1;
+        if (rc)
+        {
+            for (const IndexTuple &index : resolved)
+                releaseHandle(indexFileName(tableName, get<TupleAttribute>(index).name));
+            resolved.clear();
+            return rc;
+        }
+        resolved.push_back(make_tuple((int32_t) pos, attrs[pos], ixfileHandle));
     }
-    if (rc == RBFM_EOF)
-        rc = SUCCESS;
+    return SUCCESS;
+}
 
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;   
+// Position of the index on attributeName in indexes, -1 if there is none
+int RelationManager::findIndex(const vector<IndexTuple> &indexes, const string &attributeName)
+{
+    for (unsigned i = 0; i < indexes.size(); i++)
+    {
+        if (get<TupleAttribute>(indexes[i]).name == attributeName)
+            return i;
+    }
+    return -1;
+}
+
+// Seeds the cache with the system tables, whose attributes are known without reading the catalog,
+// then looks up their indexes in the Indexes table (which has none)
+RC RelationManager::cacheSystemTables()
+{
+    TableInfo info;
+    info.system = true;
+    info.id = TABLES_TABLE_ID;
+    info.attrs = tableDescriptor;
+    _catalog[TABLES_TABLE_NAME] = info;
+    info.id = COLUMNS_TABLE_ID;
+    info.attrs = columnDescriptor;
+    _catalog[COLUMNS_TABLE_NAME] = info;
+    info.id = INDEXES_TABLE_ID;
+    info.attrs = indexDescriptor;
+    _catalog[INDEXES_TABLE_NAME] = info;
+
+    const char *systemTables[] = {TABLES_TABLE_NAME, COLUMNS_TABLE_NAME};
+    for (const char *tableName : systemTables)
+    {
+        TableInfo &entry = _catalog[tableName];
+        vector<string> indexes;
+        RC rc = readIndexes(entry.id, indexes);
+        if (rc == SUCCESS)
+            rc = resolveIndexes(tableName, entry.attrs, indexes, entry.indexes);
+        if (rc)
+        {
+            clearTableInfo();
+            return rc;
+        }
+    }
+    return SUCCESS;
 }
 
 void RelationManager::toAPI(const string &str, void *data)
@@ -999,7 +1470,7 @@ RC RM_ScanIterator::close()
 
 RC RelationManager::searchIndex(const string &tableName, const string &attributeName,
     vector<Attribute> &recordDescriptor, int32_t &id, RBFM_ScanIterator &rbfm_si,
-    unsigned int colPos)
+    unsigned int &colPos)
 {
     RC rc = getAttributes(tableName, recordDescriptor);
     if (rc)
@@ -1018,50 +1489,14 @@ RC RelationManager::searchIndex(const string &tableName, const string &attribute
         return -1;
     }
 
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName("Indexes"), fileHandle);
+    // The index must not exist yet
+    TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
+    id = info->id;
 
-    vector<string> projection;
-    projection.push_back("column-name");
-
-    rc = getTableID(tableName, id);
-    if (rc)
-        return rc;
-
-    void *value = &id;
-
-    rc = rbfm->scan(fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    RID rid;
-    void *data = malloc(INDEXES_RECORD_DATA_SIZE);
-    bool found = false;
-    while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        unsigned offset = 1;
-
-        int32_t indexEntryLen;
-        memcpy(&indexEntryLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-        offset += VARCHAR_LENGTH_SIZE;
-
-        char indexEntry[indexEntryLen + 1];
-        indexEntry[indexEntryLen] = '\0';
-        memcpy(indexEntry, (char*) data + offset, indexEntryLen);
-
-        if (strcmp(indexEntry, attributeName.c_str()) == 0) 
-        {
-            found = true; 
-            break;
-        }
-    }
-
-    rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    free(data);
-
-    if (found)
+    if (findIndex(info->indexes, attributeName) >= 0)
     {
         return -1;
     }
@@ -1069,7 +1504,7 @@ RC RelationManager::searchIndex(const string &tableName, const string &attribute
     return 0;
 }
 
-RC RelationManager::createIndex(const string &tableName, const string &attributeName)
+RC RelationManager::createIndex(const string &tableName, const string &attributeName, const IndexType type)
 {
     bool isSystem;
     RC rc;
@@ -1093,34 +1528,42 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
         return rc;
     }
 
-    rc = insertIndex(id, attributeName);
+    rc = insertIndex(id, attributeName, type);
     if (rc)
         return rc;
 
-    IXFileHandle ixfileHandle;
+    IXFileHandle *ixfileHandle;
     IndexManager *im = IndexManager::instance();
 
-    rc = im->createFile(indexFileName(tableName, attributeName));
-    if (rc)
-        return rc;
-
-    rc = im->openFile(indexFileName(tableName, attributeName), ixfileHandle);
+    rc = im->createFile(indexFileName(tableName, attributeName), type);
+    if (rc == SUCCESS)
+        rc = getIXFileHandle(indexFileName(tableName, attributeName), ixfileHandle);
     if (rc)
+    {
+        invalidateTableInfo(tableName);
         return rc;
+    }
 
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
     if (rc)
+    {
+        releaseHandle(indexFileName(tableName, attributeName));
+        invalidateTableInfo(tableName);
         return rc;
+    }
 
     vector<string> projection;
     projection.push_back(attributeName);
 
-    rc = rbfm->scan(fileHandle, recordDescriptor, attributeName, 
+    rc = rbfm->scan(*fileHandle, recordDescriptor, attributeName, 
         NO_OP, NULL, projection, rbfm_si);
 
-    void *data = malloc(1 + recordDescriptor[colPos].length);
+    // Gather the keys, then build the tree bottom up from them in sorted order (a hash index just
+    // takes them one by one)
+    IX_EntrySorter sorter(recordDescriptor[colPos]);
+    void *data = malloc(1 + VARCHAR_LENGTH_SIZE + recordDescriptor[colPos].length);
     RID rid;
     while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
     {
@@ -1129,35 +1572,50 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
         if (null)
             continue;
 
-        rc = im->insertEntry(ixfileHandle, recordDescriptor[colPos], 
-            (char*) data + 1, rid);
+        rc = sorter.add((char*) data + 1, rid);
         if (rc)
-            return -1;
+            break;
     }
-    
-    if (rc != RBFM_EOF)
-        return rc;
 
     rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    im->closeFile(ixfileHandle);
+    releaseHandle(getFileName(tableName));
     free(data);
 
-    return SUCCESS;
+    if (rc == RBFM_EOF)
+        rc = im->bulkLoad(*ixfileHandle, recordDescriptor[colPos], sorter);
+
+    // The cached entry of the table takes the handle over, for updateIndexes
+    auto it = _catalog.find(tableName);
+    if (rc == SUCCESS && it != _catalog.end())
+    {
+        it->second.indexes.push_back(make_tuple((int32_t) colPos, recordDescriptor[colPos], ixfileHandle));
+        return SUCCESS;
+    }
+    releaseHandle(indexFileName(tableName, attributeName));
+    invalidateTableInfo(tableName);
+    return rc;
 }
 
 RC RelationManager::destroyIndex(const string &tableName, const string &attributeName)
 {
     RC rc = 0;
 
+    // The indexes of the catalog are part of it
+    bool isSystem;
+    rc = isSystemTable(isSystem, tableName);
+    if (rc)
+        return rc;
+    if (isSystem)
+        return RM_CANNOT_MOD_SYS_TBL;
+
     int32_t id;
     rc = getTableID(tableName, id);
     if (rc)
         return rc;
 
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(INDEXES_TABLE_NAME), fileHandle);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(INDEXES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
 
@@ -1166,7 +1624,7 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
     projection.push_back(INDEXES_COL_COLUMN_NAME);
 
     void *value = &id;
-    rc = rbfm->scan(fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, 
+    rc = rbfm->scan(*fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, 
         EQ_OP, value, projection, rbfm_si);
 
     RID rid;
@@ -1186,18 +1644,32 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
         if(strcmp(col, attributeName.c_str()) != 0)
             continue;
 
-        rc = rbfm->deleteRecord(fileHandle, indexDescriptor, rid);
-        if (rc)
-            return rc;
-
+        rc = rbfm->deleteRecord(*fileHandle, indexDescriptor, rid);
         break;
     }
 
-    rbfm->closeFile(fileHandle);
     rbfm_si.close();
+    releaseHandle(getFileName(INDEXES_TABLE_NAME));
     free(data);
+    if (rc != SUCCESS && rc != RBFM_EOF)
+    {
+        invalidateTableInfo(tableName);
+        return rc;
+    }
+
+    // Take the index out of the cached entry of the table, which lets go of its handle
+    auto it = _catalog.find(tableName);
+    int index = it == _catalog.end() ? -1 : findIndex(it->second.indexes, attributeName);
+    if (index >= 0)
+    {
+        it->second.indexes.erase(it->second.indexes.begin() + index);
+        releaseHandle(indexFileName(tableName, attributeName));
+    }
 
     IndexManager *im = IndexManager::instance();
+    rc = dropHandle(indexFileName(tableName, attributeName));
+    if (rc)
+        return rc;
     rc = im->destroyFile(indexFileName(tableName, attributeName));
     if (rc)
         return rc;
@@ -1205,132 +1677,288 @@ RC RelationManager::destroyIndex(const string &tableName, const string &attribut
     return SUCCESS;
 }
 
-RC RelationManager::getValue(const string name, const vector<Attribute> &attrs, const void* data, void* value) 
+RC RelationManager::getValue(const int32_t pos, const vector<Attribute> &attrs, const void* data, void* value)
 {
+    if (*((char*)data + pos / 8) & (1 << (7 - pos % 8)))
+        return -1;
+
+    // Walk past the fields before pos, of which only the varchars vary in size
     int offset = ceil(attrs.size() / 8.0);
-    for (size_t i = 0; i < attrs.size(); ++i) 
+    for (int32_t i = 0; i < pos; ++i)
     {
-        char target = *((char*)data + i/8);
-        if (target & (1 << (7 - i %8))) 
-        {
-            if (name == attrs[i].name) 
-            {
-                return -1;
-            }
-            else  
-            {
-                continue;
-            }
-        }
+        if (*((char*)data + i / 8) & (1 << (7 - i % 8)))
+            continue;
         int size = sizeof(int);
-        if (attrs[i].type == TypeVarChar) 
+        if (attrs[i].type == TypeVarChar)
         {
             memcpy(&size, (char*)data + offset, sizeof(int));
-            memcpy((char*)value, &size, sizeof(int));
-            memcpy((char*)value + sizeof(int), (char*)data + offset 
-                + sizeof(int), size);
             size += sizeof(int);
-        } 
-        else
-        {
-            memcpy(value, (char*)data + offset, sizeof(int));
         }
-        if (name == attrs[i].name)
-            return size;       
         offset += size;
     }
-    return 0;
+
+    int size = sizeof(int);
+    if (attrs[pos].type == TypeVarChar)
+    {
+        memcpy(&size, (char*)data + offset, sizeof(int));
+        size += sizeof(int);
+    }
+    memcpy(value, (char*)data + offset, size);
+    return size;
 }
 
-RC RelationManager::updateIndexes(const string& tableName, 
-    const vector<Attribute> recordDescriptor, 
-    const void* data, const RID& rid, char flag) 
+// Parses the lines of [begin, end) into tuples in the format of insertTuple. Blank lines are skipped.
+// At a bad row, the chunk keeps the tuples before it.
+RC RelationManager::parseRows(const char *begin, const char *end, const vector<Attribute> &attrs, char delimiter,
+    LoadChunk &chunk)
 {
-    FileHandle fileHandle;
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-
-    RC rc = rbfm->openFile(getFileName(INDEXES_TABLE_NAME), fileHandle);
-    if (rc)
-        return rc;
-
-    vector<string> projection;
-    projection.push_back(INDEXES_COL_COLUMN_NAME);
-
-    int32_t id;
-    rc = getTableID(tableName, id);
-    if (rc)
-        return rc;
+    unsigned nullSize = ceil(attrs.size() / 8.0);
+    for (const char *line = begin; line < end;)
+    {
+        const char *lineEnd = (const char*) memchr(line, '\n', end - line);
+        if (lineEnd == NULL)
+            lineEnd = end;
+        const char *next = lineEnd + 1;
+        if (lineEnd > line && lineEnd[-1] == '\r')
+            lineEnd--;
+        if (lineEnd == line)
+        {
+            line = next;
+            continue;
+        }
 
-    RBFM_ScanIterator rbfm_si;    
-    void *value = &id;
-    rc = rbfm->scan(fileHandle, indexDescriptor, INDEXES_COL_TABLE_ID, 
-        EQ_OP, value, projection, rbfm_si);
-    
-    RID recordRID;
-    void *recordData = malloc(1 + INT_SIZE + INDEXES_COL_COLUMN_NAME_SIZE);
-    vector<IndexTuple> indexes;
+        size_t start = chunk.tuples.size();
+        chunk.offsets.push_back(start);
+        chunk.tuples.resize(start + nullSize, 0);
+        auto badRow = [&]()
+        {
+            chunk.offsets.pop_back();
+            chunk.tuples.resize(start);
+            return RM_LOAD_BAD_ROW;
+        };
+        const char *field = line;
+        for (unsigned i = 0; i < attrs.size(); i++)
+        {
+            // Too few fields
+            if (field > lineEnd)
+                return badRow();
+            const char *fieldEnd = (const char*) memchr(field, delimiter, lineEnd - field);
+            if (fieldEnd == NULL)
+                fieldEnd = lineEnd;
+            size_t length = fieldEnd - field;
+            bool null = (length == 2 && field[0] == '\\' && field[1] == 'N')
+                || (length == 0 && attrs[i].type != TypeVarChar);
+            if (null)
+                chunk.tuples[start + i / 8] |= 1 << (7 - i % 8);
+            else if (appendValue(attrs[i], field, length, chunk.tuples))
+                return badRow();
+            field = fieldEnd + 1;
+        }
+        // Too many fields
+        if (field <= lineEnd)
+            return badRow();
+        line = next;
+    }
+    return SUCCESS;
+}
 
-    while ((rc = rbfm_si.getNextRecord(recordRID, recordData)) == SUCCESS)
+// Appends the value of a field to tuples, or fails if it is not a value of attr
+RC RelationManager::appendValue(const Attribute &attr, const char *field, size_t length, vector<char> &tuples)
+{
+    if (attr.type == TypeVarChar)
     {
-        unsigned offset = 1;
+        if (length > attr.length)
+            return RM_LOAD_BAD_ROW;
+        int32_t size = length;
+        tuples.insert(tuples.end(), (char*) &size, (char*) &size + VARCHAR_LENGTH_SIZE);
+        tuples.insert(tuples.end(), field, field + length);
+        return SUCCESS;
+    }
 
-        int32_t colLen;
-        memcpy(&colLen, (char*) recordData + offset, VARCHAR_LENGTH_SIZE);
-        offset += VARCHAR_LENGTH_SIZE;
+    // Numbers are copied out to be parsed, as the input has no terminating NUL
+    char number[64];
+    if (length >= sizeof(number))
+        return RM_LOAD_BAD_ROW;
+    memcpy(number, field, length);
+    number[length] = 0;
+    char *parsedEnd;
+    char value[INT_SIZE];
+    if (attr.type == TypeInt)
+    {
+        long integer = strtol(number, &parsedEnd, 10);
+        if (integer < INT32_MIN || integer > INT32_MAX)
+            return RM_LOAD_BAD_ROW;
+        int32_t i = integer;
+        memcpy(value, &i, INT_SIZE);
+    }
+    else
+    {
+        float real = strtof(number, &parsedEnd);
+        memcpy(value, &real, REAL_SIZE);
+    }
+    if (*parsedEnd != 0)
+        return RM_LOAD_BAD_ROW;
+    tuples.insert(tuples.end(), value, value + INT_SIZE);
+    return SUCCESS;
+}
 
-        char col[colLen + 1];
-        col[colLen] = '\0';
-        memcpy(col, (char*) recordData + offset, colLen);
+// Reads the names of the indexed attributes of table id from the Indexes table
+RC RelationManager::readIndexes(int32_t id, vector<string> &indexes)
+{
+    indexes.clear();
+    return readCatalog(INDEXES_TABLE_NAME, INDEXES_COL_TABLE_ID, &id,
+        [&](FileHandle &fileHandle, const RID &rid, const void *data) -> RC
+        {
+            char col[INDEXES_COL_COLUMN_NAME_SIZE + VARCHAR_LENGTH_SIZE];
+            int32_t colLen = getValue(1, indexDescriptor, data, col) - VARCHAR_LENGTH_SIZE;
+            indexes.push_back(string(col + VARCHAR_LENGTH_SIZE, colLen));
+            return SUCCESS;
+        });
+}
 
-        indexes.push_back(make_tuple(string {col}, -1));
-    }
+// Calls visit on each record of the system table tableName whose column equals value, going through
+// the catalog index on column if there is one and scanning the table otherwise. Records are in the
+// format of insertTuple, and visit may delete the one it is given.
+RC RelationManager::readCatalog(const string &tableName, const string &column, const void *value,
+    const function<RC(FileHandle &fileHandle, const RID &rid, const void *data)> &visit)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    const vector<Attribute> &recordDescriptor = info->attrs;
+    int index = findIndex(info->indexes, column);
 
-    rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    free(recordData);
+    FileHandle *fileHandle;
+    rc = getFileHandle(getFileName(tableName), fileHandle);
+    if (rc)
+        return rc;
 
-    for (unsigned i = 0; i < recordDescriptor.size(); ++i)
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    if (index >= 0)
     {
-        for (unsigned j = 0; j < indexes.size(); ++j)
+        IX_ScanIterator ix_si;
+        void *key = malloc(PAGE_SIZE);
+        rc = IndexManager::instance()->scan(*get<TupleHandle>(info->indexes[index]), get<TupleAttribute>(info->indexes[index]),
+            value, value, true, true, ix_si);
+        while (rc == SUCCESS && (rc = ix_si.getNextEntry(rid, key)) == SUCCESS)
         {
-            if (recordDescriptor[i].name == get<TupleColumn>(indexes[j]))
-            {
-                indexes[j] = make_tuple(get<TupleColumn>(indexes[j]), i);
-            }
+            rc = rbfm->readRecord(*fileHandle, recordDescriptor, rid, data);
+            if (rc == SUCCESS)
+                rc = visit(*fileHandle, rid, data);
         }
+        ix_si.close();
+        free(key);
+        if (rc == IX_EOF)
+            rc = SUCCESS;
     }
-
-    for (auto& index: indexes) 
+    else
     {
-        rc = getValue(get<TupleColumn>(index), recordDescriptor, data, value); 
+        vector<string> projection;
+        for (const Attribute &attr : recordDescriptor)
+            projection.push_back(attr.name);
+        RBFM_ScanIterator rbfm_si;
+        rc = rbfm->scan(*fileHandle, recordDescriptor, column, EQ_OP, value, projection, rbfm_si);
+        while (rc == SUCCESS && (rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+            rc = visit(*fileHandle, rid, data);
+        rbfm_si.close();
+        if (rc == RBFM_EOF)
+            rc = SUCCESS;
+    }
+
+    releaseHandle(getFileName(tableName));
+    free(data);
+    return rc;
+}
 
-        if (rc <= 0) 
+// Deletes the records of the system table tableName whose int column equals value, and their entries
+// in the catalog indexes
+RC RelationManager::deleteCatalogRecords(const string &tableName, const string &column, int32_t value)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    const vector<Attribute> &recordDescriptor = info->attrs;
+
+    return readCatalog(tableName, column, &value,
+        [&](FileHandle &fileHandle, const RID &rid, const void *data) -> RC
         {
-            continue;
-        }
+            RC rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
+            if (rc)
+                return rc;
+            return updateIndexes(tableName, recordDescriptor, data, rid, INDEX_DELETE);
+        });
+}
+
+RC RelationManager::updateIndexes(const string& tableName, 
+    const vector<Attribute> recordDescriptor, 
+    const void* data, const RID& rid, char flag) 
+{
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
 
-        IXFileHandle ixfileHandle;
-        IndexManager *im = IndexManager::instance();
+    if (info->indexes.empty())
+        return SUCCESS;
 
-        rc = im->openFile(indexFileName(tableName, get<TupleColumn>(index)), 
-            ixfileHandle);
-        if (rc)
-            return rc;
+    // The cached entry has each index resolved to its field and an open handle
+    IndexManager *im = IndexManager::instance();
+    void *key = malloc(PAGE_SIZE);
+    rc = SUCCESS;
+    for (const IndexTuple &index : info->indexes)
+    {
+        if (getValue(get<TuplePosition>(index), recordDescriptor, data, key) <= 0)
+            continue;
 
         if (flag == INDEX_DELETE)
-            rc = im->deleteEntry(ixfileHandle, 
-                recordDescriptor[get<TupleIndex>(index)], value, rid);
-        if(flag == INDEX_INSERT)
-            rc = im->insertEntry(ixfileHandle, 
-                recordDescriptor[get<TupleIndex>(index)], value, rid);
-
+            rc = im->deleteEntry(*get<TupleHandle>(index), get<TupleAttribute>(index), key, rid);
+        if (flag == INDEX_INSERT)
+            rc = im->insertEntry(*get<TupleHandle>(index), get<TupleAttribute>(index), key, rid);
         if (rc)
-            return rc;
-
-        im->closeFile(ixfileHandle);
+            break;
     }
+    free(key);
 
-    return SUCCESS;
+    return rc;
+}
+
+// Moves rid from its old key to its new one in each index whose key differs between the two versions
+// of the record. The other indexes are left alone.
+RC RelationManager::updateChangedIndexes(const string &tableName, const vector<Attribute> &recordDescriptor,
+    const void *oldData, const void *newData, const RID &rid)
+{
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+
+    IndexManager *im = IndexManager::instance();
+    void *oldKey = malloc(PAGE_SIZE);
+    void *newKey = malloc(PAGE_SIZE);
+    for (const IndexTuple &index : info->indexes)
+    {
+        int32_t pos = get<TuplePosition>(index);
+        RC oldSize = getValue(pos, recordDescriptor, oldData, oldKey);
+        RC newSize = getValue(pos, recordDescriptor, newData, newKey);
+        if (oldSize == newSize && (oldSize < 0 || memcmp(oldKey, newKey, oldSize) == 0))
+            continue;
+
+        // Null keys are not in the index
+        if (oldSize > 0)
+            rc = im->deleteEntry(*get<TupleHandle>(index), get<TupleAttribute>(index), oldKey, rid);
+        if (rc == SUCCESS && newSize > 0)
+            rc = im->insertEntry(*get<TupleHandle>(index), get<TupleAttribute>(index), newKey, rid);
+        if (rc)
+            break;
+    }
+    free(oldKey);
+    free(newKey);
+    return rc;
 }
 
 RC RelationManager::indexScan(const string &tableName,
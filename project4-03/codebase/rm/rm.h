@@ -6,6 +6,9 @@
 #include <cstring>
 #include <vector>
 #include <tuple>
+#include <functional>
+#include <list>
+#include <map>
 
 #include "../rbf/rbfm.h"
 #include "../ix/ix.h"
@@ -45,7 +48,8 @@ using namespace std;
 // 1 null byte, 4 integer fields and a varchar
 #define COLUMNS_RECORD_DATA_SIZE 1 + 5 * INT_SIZE + COLUMNS_COL_COLUMN_NAME_SIZE
 
-#define INDEXES_RECORD_DATA_SIZE 1 + 2 * INT_SIZE + INDEXES_COL_COLUMN_NAME_SIZE
+// 1 null byte, 3 integer fields and a varchar
+#define INDEXES_RECORD_DATA_SIZE 1 + 3 * INT_SIZE + INDEXES_COL_COLUMN_NAME_SIZE
 
 #define INDEXES_TABLE_NAME           "Indexes"
 #define INDEXES_TABLE_ID             3
@@ -53,11 +57,14 @@ using namespace std;
 #define INDEXES_COL_TABLE_ID         "table-id"
 #define INDEXES_COL_COLUMN_NAME      "column-name"
 #define INDEXES_COL_COLUMN_NAME_SIZE 50
+#define INDEXES_COL_INDEX_TYPE       "index-type"
 
 # define RM_EOF (-1)  // end of a scan operator
 
 #define RM_CANNOT_MOD_SYS_TBL 1
 #define RM_NULL_COLUMN        2
+#define RM_LOAD_OPEN_FAILED   3
+#define RM_LOAD_BAD_ROW       4
 
 typedef struct IndexedAttr
 {
@@ -65,13 +72,75 @@ typedef struct IndexedAttr
     Attribute attr;
 } IndexedAttr;
 
-typedef tuple<string, int> IndexTuple;
-#define TupleColumn 0
-#define TupleIndex 1
+// An index of a table, resolved for keeping it up to date: the position of the indexed attribute in
+// the table's records, the attribute, and the handle on the index file
+typedef tuple<int32_t, Attribute, IXFileHandle*> IndexTuple;
+#define TuplePosition  0
+#define TupleAttribute 1
+#define TupleHandle    2
+
+// What the catalog says about a table, cached by the RelationManager. The handles of its indexes are
+// held from the handle cache, marked in use, for as long as the entry is cached.
+typedef struct TableInfo
+{
+    int32_t id;
+    bool system;
+    vector<Attribute> attrs;
+    vector<IndexTuple> indexes;
+} TableInfo;
+
+// Indexes the catalog keeps on itself, created by createCatalog and recorded in the Indexes table
+typedef struct CatalogIndex
+{
+    const char *tableName;
+    int32_t tableID;
+    const char *column;
+} CatalogIndex;
+#define CATALOG_INDEXES 3
 
 #define INDEX_INSERT 0
 #define INDEX_DELETE 1
 
+// Table and index files the handle cache keeps open at most, unless changed with setMaxOpenFiles
+#define RM_MAX_OPEN_FILES 64
+
+// A table or index file held open by the RelationManager across calls
+typedef struct CachedHandle
+{
+    FileHandle *fileHandle;         // Set for table files
+    IXFileHandle *ixfileHandle;     // Set for index files
+    unsigned inUse;                 // Calls currently working with the handle, which cannot be closed until 0
+    list<string>::iterator lruPosition;
+} CachedHandle;
+
+// Bytes of input a bulkLoad thread parses at a time, unless set in RM_LoadOptions
+#define RM_LOAD_CHUNK_SIZE (1 << 20)
+
+// How bulkLoad reads its input
+typedef struct RM_LoadOptions
+{
+    unsigned threads = 0;                   // Parsing threads, 0 for one per core
+    size_t chunkSize = RM_LOAD_CHUNK_SIZE;
+    char delimiter = ',';
+} RM_LoadOptions;
+
+// What a bulkLoad did
+typedef struct RM_LoadStats
+{
+    uint64_t rows;
+    double seconds;
+    double rowsPerSecond;
+} RM_LoadStats;
+
+// A chunk of bulkLoad input, parsed into tuples laid one after another
+typedef struct LoadChunk
+{
+    vector<char> tuples;
+    vector<size_t> offsets;     // Where each tuple starts
+    RC rc;
+    bool parsed;
+} LoadChunk;
+
 // RM_ScanIterator is an iteratr to go through tuples
 class RM_ScanIterator {
 public:
@@ -123,12 +192,36 @@ public:
 
   RC insertTuple(const string &tableName, const void *data, RID &rid);
 
+  // Insert every tuple of data, each in the format of insertTuple, returning their rids in the same
+  // order. The catalog is looked up once, each heap page is written once, and each index takes the
+  // keys of the batch sorted. On an error, the tuples before it may be in the table.
+  RC insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids);
+
+  // Insert every line of the file at csvPath as a tuple of tableName. Fields are in the order of
+  // getAttributes. A field of \N is NULL, and so is an empty int or real field; an empty varchar field
+  // is the empty string. Chunks of the file are parsed on many threads and written in order of the
+  // file, then each index of the table takes the keys all at once, built bottom up if it was empty.
+  // A row that does not fit the table stops the load with RM_LOAD_BAD_ROW, after the rows before it.
+  // On any error, the tuples written before it stay in the table and its indexes, and are counted in stats.
+  RC bulkLoad(const string &tableName, const string &csvPath, const RM_LoadOptions &options, RM_LoadStats &stats);
+
   RC deleteTuple(const string &tableName, const RID &rid);
 
   RC updateTuple(const string &tableName, const void *data, const RID &rid);
 
   RC readTuple(const string &tableName, const RID &rid, void *data);
 
+  // Write back every buffered page and fdatasync every file written since its last sync.
+  // See PagedFileManager::setDurabilityMode for syncing automatically.
+  RC flushAll();
+
+  // Table and index files stay open between calls. Once more than this many are open, the least
+  // recently used ones nobody is working with are closed.
+  void setMaxOpenFiles(unsigned files);
+  unsigned getMaxOpenFiles() const;
+  // Close every cached file nobody is working with. Done automatically when the program exits.
+  RC closeCachedFiles();
+
   // Print a tuple that is passed to this utility method.
   // The format is the same as printRecord().
   RC printTuple(const vector<Attribute> &attrs, const void *data);
@@ -146,9 +239,10 @@ public:
 
   RC  searchIndex(const string &tableName, const string &attributeName,
      vector<Attribute> &recordDescriptor, int32_t &id, RBFM_ScanIterator &rbfm_si,
-                 unsigned int colPos);
+                 unsigned int &colPos);
 
-  RC createIndex(const string &tableName, const string &attributeName);
+  // Hash indexes only answer equality scans, such as the probes of INLJoin, and full scans
+  RC createIndex(const string &tableName, const string &attributeName, const IndexType type = IX_INDEX_BTREE);
 
   RC destroyIndex(const string &tableName, const string &attributeName);
 
@@ -172,6 +266,15 @@ private:
   const vector<Attribute> columnDescriptor;
   const vector<Attribute> indexDescriptor;
 
+  // Handle cache, keyed by file name. Front of _handleOrder is least recently used
+  map<string, CachedHandle> _handles;
+  list<string> _handleOrder;
+  unsigned _maxOpenFiles;
+
+  // Catalog cache, keyed by table name. Filled as tables are used, and dropped for a table
+  // whenever createTable, deleteTable, createIndex or destroyIndex changes its catalog entries.
+  map<string, TableInfo> _catalog;
+
   // Convert tableName to file name (append extension)
   static string getFileName(const char *tableName);
   static string getFileName(const string &tableName);
@@ -186,13 +289,13 @@ private:
   // Prepare an entry for the Table/Column table
   void prepareTablesRecordData(int32_t id, bool system, const string &tableName, void *data);
   void prepareColumnsRecordData(int32_t id, int32_t pos, Attribute attr, void *data);
-  void prepareIndexesRecordData(int32_t tid, const string &attributeName, void *data);
+  void prepareIndexesRecordData(int32_t tid, const string &attributeName, IndexType type, void *data);
 
   // Given a table ID and recordDescriptor, creates entries in Column table
   RC insertColumns(int32_t id, const vector<Attribute> &recordDescriptor);
   // Given table ID, system flag, and table name, creates entry in Table table
   RC insertTable(int32_t id, int32_t system, const string &tableName);
-  RC insertIndex(int32_t tid, const string &attributeName);
+  RC insertIndex(int32_t tid, const string &attributeName, IndexType type);
 
   // Get next table ID for creating table
   RC getNextTableID(int32_t &table_id);
@@ -200,10 +303,44 @@ private:
   RC getTableID(const string &tableName, int32_t &tableID);
 
   RC isSystemTable(bool &system, const string &tableName);
+
+  // Catalog cache helpers. The read* methods go to the catalog files.
+  RC getTableInfo(const string &tableName, TableInfo *&info);
+  void invalidateTableInfo(const string &tableName);
+  void clearTableInfo();
+  // Looks up the attributes of tableName named in indexes and gets handles on their index files
+  RC resolveIndexes(const string &tableName, const vector<Attribute> &attrs, const vector<string> &indexes,
+      vector<IndexTuple> &resolved);
+  static int findIndex(const vector<IndexTuple> &indexes, const string &attributeName);
+  RC cacheSystemTables();
+  RC readTableEntry(const string &tableName, int32_t &tableID, bool &system);
+  RC readAttributes(int32_t id, vector<Attribute> &attrs);
+  RC readIndexes(int32_t id, vector<string> &indexes);
+  RC readCatalog(const string &tableName, const string &column, const void *value,
+      const function<RC(FileHandle &fileHandle, const RID &rid, const void *data)> &visit);
+  RC deleteCatalogRecords(const string &tableName, const string &column, int32_t value);
   // RC tableExists(bool &exists, const string &tableName, int32_t tableId);
 
-  static RC getValue(const string name, const vector<Attribute> &attrs, const void* data, void* value); 
+  // Copies field pos of a record to value, in the format of an index key. Returns its size, or -1 if null.
+  static RC getValue(const int32_t pos, const vector<Attribute> &attrs, const void* data, void* value);
+  // bulkLoad helpers, turning lines of text into tuples
+  static RC parseRows(const char *begin, const char *end, const vector<Attribute> &attrs, char delimiter,
+      LoadChunk &chunk);
+  static RC appendValue(const Attribute &attr, const char *field, size_t length, vector<char> &tuples);
   RC updateIndexes(const string& tableName, const vector<Attribute> recordDescriptor, const void* data, const RID& rid, char flag);
+  RC updateChangedIndexes(const string &tableName, const vector<Attribute> &recordDescriptor,
+      const void *oldData, const void *newData, const RID &rid);
+
+  // Get an open handle on a table or index file from the handle cache, opening it if needed.
+  // Every successful get must be matched by a releaseHandle on the same file name.
+  RC getFileHandle(const string &fileName, FileHandle *&fileHandle);
+  RC getIXFileHandle(const string &fileName, IXFileHandle *&ixfileHandle);
+  void releaseHandle(const string &fileName);
+  // Close the cached handle of a file that is about to be destroyed
+  RC dropHandle(const string &fileName);
+  RC getHandle(const string &fileName, bool index, CachedHandle *&cached);
+  void evictHandles(unsigned reserve = 0);
+  static void closeCachedFilesAtExit();
 
 
   // Utility functions for converting single values to/from api format
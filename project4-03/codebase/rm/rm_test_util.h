@@ -371,6 +371,33 @@ RC createLargeTable(const string &tableName)
     return 0;
 }
 
+// Counts the index entries with keys in [low, high], or all of them if both are NULL
+int countEntries(const string &tableName, const string &attributeName, const void *low, const void *high)
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan(tableName, attributeName, low, high, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    RID rid;
+    char key[PAGE_SIZE];
+    int count = 0;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+        count++;
+    rmisi.close();
+    return count;
+}
+
+// Pages the buffer pool was asked for since the last call
+unsigned pagesTouched()
+{
+    static unsigned last = 0;
+    unsigned hit, miss, evict;
+    BufferManager::instance()->collectCounterValues(hit, miss, evict);
+    unsigned touched = hit + miss - last;
+    last = hit + miss;
+    return touched;
+}
+
 // Write RIDs to a disk - do not use this code.
 //This is not a page-based operation. For test purpose only.
 void writeRIDsToDisk(vector<RID> &rids)
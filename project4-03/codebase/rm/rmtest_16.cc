@@ -0,0 +1,148 @@
+#include "rm_test_util.h"
+
+#include <dirent.h>
+
+// Number of file descriptors this process has open
+int countOpenFiles()
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return -1;
+    while (readdir(dir) != NULL)
+        count++;
+    closedir(dir);
+    return count;
+}
+
+RC TEST_RM_16(const vector<string> &tableNames)
+{
+    // Functions tested
+    // 1. Insert, Read and Delete Tuple on several tables with a small handle cache **
+    // 2. Create Index, Index Scan and Destroy Index through the handle cache **
+    // NOTE: "**" signifies the new functions being tested in this test case. 
+    cout << endl << "***** In RM Test Case 16 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    int numTuples = 300;
+    unsigned maxOpenFiles = 2;
+
+    // Start from fresh tables
+    RC rc;
+    for (unsigned i = 0; i < tableNames.size(); i++)
+    {
+        rm->deleteTable(tableNames[i]);
+        rc = createTable(tableNames[i]);
+        assert(rc == success && "Creating a table should not fail.");
+    }
+
+    vector<Attribute> attrs;
+    rc = rm->getAttributes(tableNames[0], attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // Index one of the tables so that index files go through the cache too
+    rc = rm->createIndex(tableNames[2], "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    rc = rm->closeCachedFiles();
+    assert(rc == success && "RelationManager::closeCachedFiles() should not fail.");
+    int openFiles = countOpenFiles();
+    rm->setMaxOpenFiles(maxOpenFiles);
+
+    vector<RID> rids;
+    for (int i = 0; i < numTuples; i++)
+    {
+        const string &tableName = tableNames[i % tableNames.size()];
+        prepareTuple(attrs.size(), nullsIndicator, 6, "Peters", 1000 + i, 170.1, 5000 + i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+
+        rc = rm->readTuple(tableName, rid, returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        if (memcmp(tuple, returnedData, tupleSize) != 0)
+        {
+            cout << "**** [FAIL] RM Test Case 16 failed: tuple " << i << " was not read back *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    // Never more files open than the cache allows once the calls are done, besides the indexes of the
+    // catalog, which stay open with its cached entries
+    int extraFiles = countOpenFiles() - openFiles;
+    cout << "Extra open files: " << extraFiles << endl;
+    if (extraFiles > (int) maxOpenFiles + CATALOG_INDEXES)
+    {
+        cout << "**** [FAIL] RM Test Case 16 failed: the handle cache kept too many files open *****" << endl << endl;
+        return -1;
+    }
+
+    // Every inserted tuple of the indexed table is in the index
+    RM_IndexScanIterator rmisi;
+    int32_t lowAge = 1000;
+    rc = rm->indexScan(tableNames[2], "Age", &lowAge, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    int32_t key;
+    int count = 0;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF)
+        count++;
+    rmisi.close();
+    cout << "Indexed tuples: " << count << endl;
+    if (count != numTuples / (int) tableNames.size())
+    {
+        cout << "**** [FAIL] RM Test Case 16 failed: the index missed some tuples *****" << endl << endl;
+        return -1;
+    }
+
+    // Deletes keep the index in step as well
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->deleteTuple(tableNames[i % tableNames.size()], rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+    }
+    rc = rm->indexScan(tableNames[2], "Age", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    count = 0;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF)
+        count++;
+    rmisi.close();
+    if (count != 0)
+    {
+        cout << "**** [FAIL] RM Test Case 16 failed: deleted tuples are still indexed *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->destroyIndex(tableNames[2], "Age");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    for (unsigned i = 0; i < tableNames.size(); i++)
+    {
+        rc = rm->deleteTable(tableNames[i]);
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+    rm->setMaxOpenFiles(RM_MAX_OPEN_FILES);
+
+    free(nullsIndicator);
+    free(tuple);
+    free(returnedData);
+    cout << "**** RM Test Case 16 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Keep inserting into several tables through a handle cache smaller than what each call needs
+    vector<string> tableNames;
+    tableNames.push_back("tbl_c_employee1");
+    tableNames.push_back("tbl_c_employee2");
+    tableNames.push_back("tbl_c_employee3");
+
+    RC rcmain = TEST_RM_16(tableNames);
+    return rcmain;
+}
@@ -0,0 +1,86 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_17(const string &tableName)
+{
+    // Functions tested
+    // 1. Insert Tuple and Read Tuple served from the catalog cache **
+    // 2. Catalog cache invalidation by Delete Table and Create Table **
+    // NOTE: "**" signifies the new functions being tested in this test case. 
+    cout << endl << "***** In RM Test Case 17 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    int numTuples = 100;
+    BufferManager *bm = BufferManager::instance();
+
+    rm->deleteTable(tableName);
+    RC rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+
+    vector<Attribute> attrs;
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // Warm up, then count every page the inserts touch
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Peters", 24, 170.1, 5000, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    unsigned hit, miss, evict;
+    unsigned hit1, miss1, evict1;
+    bm->collectCounterValues(hit, miss, evict);
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    bm->collectCounterValues(hit1, miss1, evict1);
+    unsigned pages = (hit1 + miss1) - (hit + miss);
+    cout << "Pages touched per insert: " << (float) pages / numTuples << endl;
+    // Finding a page and updating its free space, nothing in Tables or Columns
+    if (pages > 4 * (unsigned) numTuples)
+    {
+        cout << "**** [FAIL] RM Test Case 17 failed: inserts still read the catalog *****" << endl << endl;
+        return -1;
+    }
+
+    // A table created again under the same name must not be served from stale cache entries
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->readTuple(tableName, rid, returnedData);
+    assert(rc != success && "RelationManager::readTuple() on a deleted table should fail.");
+
+    vector<Attribute> newAttrs;
+    newAttrs.push_back(attrs[1]);
+    rc = rm->createTable(tableName, newAttrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    if (attrs.size() != 1 || attrs[0].name != newAttrs[0].name)
+    {
+        cout << "**** [FAIL] RM Test Case 17 failed: stale attributes after create table *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(nullsIndicator);
+    free(tuple);
+    free(returnedData);
+    cout << "**** RM Test Case 17 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Inserts should find everything they need about the table in the catalog cache
+    RC rcmain = TEST_RM_17("tbl_c_employee4");
+    return rcmain;
+}
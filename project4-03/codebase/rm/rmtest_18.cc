@@ -0,0 +1,125 @@
+#include "rm_test_util.h"
+
+// Counts the index entries in [low, high], checking each one against the tuple it points to
+int countIndexed(const string &tableName, const string &attributeName, const void *low, const void *high, void *returnedData)
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan(tableName, attributeName, low, high, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    RID rid;
+    char key[PAGE_SIZE];
+    int count = 0;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+    {
+        rc = rm->readAttribute(tableName, rid, attributeName, returnedData);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        // readAttribute puts a null indicator byte in front of the value
+        int length = 4;
+        if (attributeName == "EmpName")
+            length += *(int*)key;
+        if (memcmp((char*)returnedData + 1, key, length) != 0)
+            return -1;
+        count++;
+    }
+    rmisi.close();
+    return count;
+}
+
+RC TEST_RM_18(const string &tableName)
+{
+    // Functions tested
+    // 1. Create Index on a table that already has tuples, built by bulk loading **
+    // 2. Create Index on attributes other than the first one **
+    // 3. Index Scan, and Insert and Delete Tuple on the bulk loaded indexes
+    // NOTE: "**" signifies the new functions being tested in this test case. 
+    cout << endl << "***** In RM Test Case 18 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    int numTuples = 3000;
+
+    rm->deleteTable(tableName);
+    RC rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+
+    vector<Attribute> attrs;
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // Heights repeat every 300 tuples and names every 500
+    vector<RID> rids;
+    char name[16];
+    for (int i = 0; i < numTuples; i++)
+    {
+        int nameLength = sprintf(name, "Emp%03d", (i * 7) % 500);
+        prepareTuple(attrs.size(), nullsIndicator, nameLength, name, i, (i % 300) + 0.5, 5000 + i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+
+    rc = rm->createIndex(tableName, "Height");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "EmpName");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    // Each entry points to a tuple with its key
+    float lowHeight = 100.5, highHeight = 199.5;
+    int count = countIndexed(tableName, "Height", &lowHeight, &highHeight, returnedData);
+    cout << "Heights in [100.5, 199.5]: " << count << endl;
+    if (count != 100 * numTuples / 300)
+    {
+        cout << "**** [FAIL] RM Test Case 18 failed: wrong Height index *****" << endl << endl;
+        return -1;
+    }
+    char lowName[16], highName[16];
+    *(int*)lowName = sprintf(lowName + 4, "Emp100");
+    *(int*)highName = sprintf(highName + 4, "Emp199");
+    count = countIndexed(tableName, "EmpName", lowName, highName, returnedData);
+    cout << "Names in [Emp100, Emp199]: " << count << endl;
+    if (count != 100 * numTuples / 500)
+    {
+        cout << "**** [FAIL] RM Test Case 18 failed: wrong EmpName index *****" << endl << endl;
+        return -1;
+    }
+
+    // The loaded indexes are kept up to date like any other
+    for (int i = 0; i < numTuples; i += 2)
+    {
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+    }
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Emp150", 0, 150.5, 0, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    if (countIndexed(tableName, "Height", NULL, NULL, returnedData) != numTuples / 2 + 1
+        || countIndexed(tableName, "EmpName", NULL, NULL, returnedData) != numTuples / 2 + 1)
+    {
+        cout << "**** [FAIL] RM Test Case 18 failed: indexes out of step with the table *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(nullsIndicator);
+    free(tuple);
+    free(returnedData);
+    cout << "**** RM Test Case 18 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Indexes created on a table with tuples in it are bulk loaded
+    RC rcmain = TEST_RM_18("tbl_c_employee5");
+    return rcmain;
+}
@@ -0,0 +1,133 @@
+#include "rm_test_util.h"
+
+bool fileExists(const string &fileName)
+{
+    FILE *file = fopen(fileName.c_str(), "r");
+    if (file == NULL)
+        return false;
+    fclose(file);
+    return true;
+}
+
+RC TEST_RM_19(const string &tableName)
+{
+    // Functions tested
+    // 1. Insert, Update and Delete Tuple keeping indexes up to date through the cached catalog entry **
+    // 2. Create Index and Destroy Index on a table whose entry is cached **
+    // 3. Delete Table destroying its indexes, and a table of the same name created again **
+    // 4. Create Index of the hash type **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 19 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    int numTuples = 2000;
+
+    rm->deleteTable(tableName);
+    RC rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "Salary", IX_INDEX_HASH);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    vector<Attribute> attrs;
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // Ages repeat every 50 tuples, salaries every 100
+    vector<RID> rids;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, 6, "Emp001", i % 50, 170.5, 1000 + i % 100, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+    int age = 7;
+    int salary = 1007;
+    if (countEntries(tableName, "Age", &age, &age) != numTuples / 50
+        || countEntries(tableName, "Salary", &salary, &salary) != numTuples / 100)
+    {
+        cout << "**** [FAIL] RM Test Case 19 failed: indexes out of step after inserts *****" << endl << endl;
+        return -1;
+    }
+    RM_IndexScanIterator rmisi;
+    int highSalary = 1010;
+    rc = rm->indexScan(tableName, "Salary", &salary, &highSalary, true, true, rmisi);
+    assert(rc != success && "a hash index should refuse a range.");
+    rmisi.close();
+
+    // An index created now is kept up to date as well
+    rc = rm->createIndex(tableName, "Height");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    for (int i = 0; i < numTuples; i += 2)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, 6, "Emp001", 99, 180.5, 1000 + i % 100, tuple, &tupleSize);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+    for (int i = 1; i < numTuples; i += 4)
+    {
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+    }
+    age = 99;
+    float height = 180.5;
+    int left = numTuples - numTuples / 4;
+    if (countEntries(tableName, "Age", &age, &age) != numTuples / 2
+        || countEntries(tableName, "Height", &height, &height) != numTuples / 2
+        || countEntries(tableName, "Age", NULL, NULL) != left
+        || countEntries(tableName, "Height", NULL, NULL) != left
+        || countEntries(tableName, "Salary", NULL, NULL) != left)
+    {
+        cout << "**** [FAIL] RM Test Case 19 failed: indexes out of step after updates and deletes *****" << endl << endl;
+        return -1;
+    }
+
+    // Without its index, a table keeps the others up to date
+    rc = rm->destroyIndex(tableName, "Height");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Emp001", 99, 180.5, 5000, tuple, &tupleSize);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    if (countEntries(tableName, "Age", &age, &age) != numTuples / 2 + 1)
+    {
+        cout << "**** [FAIL] RM Test Case 19 failed: indexes out of step after Destroy Index *****" << endl << endl;
+        return -1;
+    }
+
+    // The indexes go with the table, and a table made again under its name starts without them
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    assert(!fileExists(tableName + "_Age.i") && !fileExists(tableName + "_Salary.i") && "indexes should be destroyed with their table.");
+    rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    if (countEntries(tableName, "Age", NULL, NULL) != 1)
+    {
+        cout << "**** [FAIL] RM Test Case 19 failed: index of a table made again *****" << endl << endl;
+        return -1;
+    }
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(nullsIndicator);
+    free(tuple);
+    cout << "**** RM Test Case 19 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Indexes are kept up to date through the cached catalog entry of their table
+    RC rcmain = TEST_RM_19("tbl_c_employee6");
+    return rcmain;
+}
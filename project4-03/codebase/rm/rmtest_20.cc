@@ -0,0 +1,124 @@
+#include "rm_test_util.h"
+
+// Updates every tuple of the table, renaming the employee and setting age and salary
+void updateAll(const string &tableName, const vector<RID> &rids, const vector<Attribute> &attrs,
+        const string &name, const int age, unsigned char *nullsIndicator, void *tuple)
+{
+    int tupleSize = 0;
+    for (unsigned i = 0; i < rids.size(); i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, name.length(), name, age == -1 ? i % 50 : age, 170.5, 1000 + i, tuple, &tupleSize);
+        RC rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+}
+
+RC TEST_RM_20(const string &tableName, const string &plainTableName)
+{
+    // Functions tested
+    // 1. Update Tuple changing no indexed attribute, leaving the indexes alone **
+    // 2. Update Tuple changing one indexed attribute, moving only its entries **
+    // 3. Update Tuple setting an indexed attribute to null and back **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 20 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    int numTuples = 500;
+
+    vector<Attribute> attrs;
+    vector<RID> rids;
+    vector<RID> plainRids;
+    for (int t = 0; t < 2; t++)
+    {
+        const string &name = t == 0 ? tableName : plainTableName;
+        rm->deleteTable(name);
+        RC rc = createTable(name);
+        assert(rc == success && "Creating a table should not fail.");
+        rc = rm->getAttributes(name, attrs);
+        assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    }
+    RC rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "Height");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "Salary", IX_INDEX_HASH);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, 3, "Emp", i % 50, 170.5, 1000 + i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+        rc = rm->insertTuple(plainTableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        plainRids.push_back(rid);
+    }
+
+    // Longer names move records off full pages, but the rids and keys stay. The indexed table only
+    // reads each old record on top of what the table without indexes does.
+    string longName(20, 'x');
+    pagesTouched();
+    updateAll(plainTableName, plainRids, attrs, longName, -1, nullsIndicator, tuple);
+    unsigned plainPages = pagesTouched();
+    updateAll(tableName, rids, attrs, longName, -1, nullsIndicator, tuple);
+    unsigned indexedPages = pagesTouched();
+    cout << "Pages touched by updates of a name: " << indexedPages << " with indexes, " << plainPages << " without" << endl;
+    if (indexedPages > plainPages + numTuples)
+    {
+        cout << "**** [FAIL] RM Test Case 20 failed: indexes touched by an update of no key *****" << endl << endl;
+        return -1;
+    }
+
+    // Only the Age index changes
+    updateAll(tableName, rids, attrs, longName, 77, nullsIndicator, tuple);
+    unsigned agePages = pagesTouched();
+    cout << "Pages touched by updates of an age: " << agePages << endl;
+    int age = 77;
+    float height = 170.5;
+    if (countEntries(tableName, "Age", &age, &age) != numTuples
+        || countEntries(tableName, "Age", NULL, NULL) != numTuples
+        || countEntries(tableName, "Height", &height, &height) != numTuples
+        || countEntries(tableName, "Salary", NULL, NULL) != numTuples
+        || agePages <= indexedPages)
+    {
+        cout << "**** [FAIL] RM Test Case 20 failed: wrong index entries after updates of a key *****" << endl << endl;
+        return -1;
+    }
+
+    // A null salary leaves the Salary index, and comes back with a value
+    nullsIndicator[0] = 0x10;
+    updateAll(tableName, rids, attrs, longName, 77, nullsIndicator, tuple);
+    int salaries = countEntries(tableName, "Salary", NULL, NULL);
+    nullsIndicator[0] = 0;
+    updateAll(tableName, rids, attrs, longName, 77, nullsIndicator, tuple);
+    int salary = 1042;
+    if (salaries != 0 || countEntries(tableName, "Salary", &salary, &salary) != 1
+        || countEntries(tableName, "Salary", NULL, NULL) != numTuples)
+    {
+        cout << "**** [FAIL] RM Test Case 20 failed: wrong index entries after null keys *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(plainTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(nullsIndicator);
+    free(tuple);
+    cout << "**** RM Test Case 20 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Updates only touch the indexes whose key changed
+    RC rcmain = TEST_RM_20("tbl_c_employee7", "tbl_c_employee8");
+    return rcmain;
+}
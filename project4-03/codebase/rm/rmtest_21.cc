@@ -0,0 +1,129 @@
+#include "rm_test_util.h"
+
+// Makes tuple i of the test: ages repeat every 50 tuples, and every tenth salary is null
+void *makeTuple(const vector<Attribute> &attrs, unsigned char *nullsIndicator, int i, int &tupleSize)
+{
+    void *tuple = malloc(200);
+    char name[16];
+    int len = sprintf(name, "Emp%05d", i);
+    nullsIndicator[0] = i % 10 == 0 ? 0x10 : 0;
+    prepareTuple(attrs.size(), nullsIndicator, len, name, i % 50, 150.5 + i, 1000 + i, tuple, &tupleSize);
+    return tuple;
+}
+
+RC TEST_RM_21(const string &tableName, const string &singleTableName)
+{
+    // Functions tested
+    // 1. Insert Tuples into a table with indexes, and into one with tuples already in it **
+    // 2. Read Tuple of the rids returned, and the indexes holding each tuple **
+    // 3. Pages touched by a batch and by the same tuples one at a time **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 21 *****" << endl;
+
+    RID rid;
+    int numTuples = 5000;
+
+    vector<Attribute> attrs;
+    for (int t = 0; t < 2; t++)
+    {
+        const string &name = t == 0 ? tableName : singleTableName;
+        rm->deleteTable(name);
+        RC rc = createTable(name);
+        assert(rc == success && "Creating a table should not fail.");
+        rc = rm->createIndex(name, "Age");
+        assert(rc == success && "RelationManager::createIndex() should not fail.");
+        rc = rm->createIndex(name, "Salary", IX_INDEX_HASH);
+        assert(rc == success && "RelationManager::createIndex() should not fail.");
+        rc = rm->getAttributes(name, attrs);
+        assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    }
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    vector<const void*> tuples;
+    int tupleSize = 0;
+    for (int i = 0; i < numTuples; i++)
+        tuples.push_back(makeTuple(attrs, nullsIndicator, i, tupleSize));
+
+    // An empty batch, then the tuples in two batches
+    vector<RID> rids;
+    vector<const void*> none;
+    RC rc = rm->insertTuples(tableName, none, rids);
+    assert(rc == success && rids.empty() && "RelationManager::insertTuples() should not fail.");
+
+    pagesTouched();
+    vector<const void*> firstHalf(tuples.begin(), tuples.begin() + numTuples / 2);
+    vector<const void*> secondHalf(tuples.begin() + numTuples / 2, tuples.end());
+    vector<RID> moreRids;
+    rc = rm->insertTuples(tableName, firstHalf, rids);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+    rc = rm->insertTuples(tableName, secondHalf, moreRids);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+    unsigned batchPages = pagesTouched();
+    rids.insert(rids.end(), moreRids.begin(), moreRids.end());
+
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->insertTuple(singleTableName, tuples[i], rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    unsigned singlePages = pagesTouched();
+    cout << "Pages touched by " << numTuples << " tuples in batches: " << batchPages << ", one at a time: " << singlePages << endl;
+    if (rids.size() != (unsigned) numTuples || batchPages * 4 > singlePages)
+    {
+        cout << "**** [FAIL] RM Test Case 21 failed: a batch should touch each page about once *****" << endl << endl;
+        return -1;
+    }
+
+    // Every rid reads back its tuple
+    void *returnedData = malloc(200);
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        void *expected = makeTuple(attrs, nullsIndicator, i, tupleSize);
+        if (memcmp(returnedData, expected, tupleSize) != 0)
+        {
+            cout << "**** [FAIL] RM Test Case 21 failed: tuple " << i << " read back differently *****" << endl << endl;
+            return -1;
+        }
+        free(expected);
+    }
+
+    int age = 7;
+    int salary = 1007;
+    int nullSalary = 1010;
+    if (countEntries(tableName, "Age", NULL, NULL) != numTuples
+        || countEntries(tableName, "Age", &age, &age) != numTuples / 50
+        || countEntries(tableName, "Salary", NULL, NULL) != numTuples - numTuples / 10
+        || countEntries(tableName, "Salary", &salary, &salary) != 1
+        || countEntries(tableName, "Salary", &nullSalary, &nullSalary) != 0)
+    {
+        cout << "**** [FAIL] RM Test Case 21 failed: wrong index entries after batches *****" << endl << endl;
+        return -1;
+    }
+
+    // System tables refuse batches like they refuse single tuples
+    rc = rm->insertTuples("Tables", tuples, rids);
+    assert(rc != success && "a system table should not take tuples.");
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(singleTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    for (const void *tuple : tuples)
+        free((void*) tuple);
+    free(returnedData);
+    free(nullsIndicator);
+    cout << "**** RM Test Case 21 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Tuples inserted as batches
+    RC rcmain = TEST_RM_21("tbl_c_employee9", "tbl_c_employee10");
+    return rcmain;
+}
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "rm_test_util.h"
+
+// Reads the tuples of the table back as lines of the file they were loaded from
+vector<string> readLines(const string &tableName)
+{
+    vector<string> attributes;
+    attributes.push_back("EmpName");
+    attributes.push_back("Age");
+    attributes.push_back("Height");
+    attributes.push_back("Salary");
+    RM_ScanIterator rmsi;
+    RC rc = rm->scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    vector<string> lines;
+    RID rid;
+    char data[200];
+    while (rmsi.getNextTuple(rid, data) != RM_EOF)
+    {
+        stringstream line;
+        char nulls = data[0];
+        int offset = 1;
+        int length;
+        memcpy(&length, data + offset, 4);
+        line << string(data + offset + 4, length);
+        offset += 4 + length;
+        int age;
+        memcpy(&age, data + offset, 4);
+        line << "," << age;
+        offset += 4;
+        float height;
+        memcpy(&height, data + offset, 4);
+        line << "," << fixed << setprecision(1) << height;
+        offset += 4;
+        line << ",";
+        if (!(nulls & 0x10))
+        {
+            int salary;
+            memcpy(&salary, data + offset, 4);
+            line << salary;
+        }
+        lines.push_back(line.str());
+    }
+    rmsi.close();
+    sort(lines.begin(), lines.end());
+    return lines;
+}
+
+RC TEST_RM_22(const string &tableName)
+{
+    // Functions tested
+    // 1. Bulk Load of a fixture in data/, read back by Scan **
+    // 2. Bulk Load on many threads, with NULLs, building empty indexes bottom up **
+    // 3. Bulk Load into a table with tuples and index entries already **
+    // 4. Bulk Load of empty varchars and of \N for NULL **
+    // 5. Bulk Load of rows that do not fit the table **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 22 *****" << endl;
+
+    RM_LoadOptions options;
+    RM_LoadStats stats;
+
+    // The fixture reads back as it is, with its last line missing its newline
+    rm->deleteTable(tableName);
+    RC rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+    rc = rm->bulkLoad(tableName, "../data/employee_50", options, stats);
+    assert(rc == success && "RelationManager::bulkLoad() should not fail.");
+    ifstream fixture("../data/employee_50");
+    vector<string> expected;
+    string line;
+    while (getline(fixture, line))
+        expected.push_back(line);
+    sort(expected.begin(), expected.end());
+    if (stats.rows != 50 || readLines(tableName) != expected)
+    {
+        cout << "**** [FAIL] RM Test Case 22 failed: the fixture read back differently *****" << endl << endl;
+        return -1;
+    }
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    // Many small chunks on four threads. Every seventh salary is NULL.
+    int numTuples = 200000;
+    string csvPath = tableName + ".csv";
+    FILE *csv = fopen(csvPath.c_str(), "w");
+    for (int i = 0; i < numTuples; i++)
+    {
+        if (i % 7 == 0)
+            fprintf(csv, "Emp%06d,%d,%.1f,\n", i, i % 90, 150.5 + i % 40);
+        else
+            fprintf(csv, "Emp%06d,%d,%.1f,%d\r\n", i, i % 90, 150.5 + i % 40, 1000 + i);
+    }
+    fclose(csv);
+
+    rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = rm->createIndex(tableName, "Salary", IX_INDEX_HASH);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    options.threads = 4;
+    options.chunkSize = 1 << 16;
+    rc = rm->bulkLoad(tableName, csvPath, options, stats);
+    assert(rc == success && "RelationManager::bulkLoad() should not fail.");
+    cout << "Loaded " << stats.rows << " rows in " << stats.seconds << " s (" << (uint64_t) stats.rowsPerSecond << " rows/s)" << endl;
+
+    int age = 42;
+    int salary = 1000 + 12345;
+    int nullSalary = 1000 + 7 * 100;
+    int salaries = numTuples - (numTuples + 6) / 7;
+    if (stats.rows != (uint64_t) numTuples
+        || countEntries(tableName, "Age", NULL, NULL) != numTuples
+        || countEntries(tableName, "Age", &age, &age) != (numTuples - age + 89) / 90
+        || countEntries(tableName, "Salary", NULL, NULL) != salaries
+        || countEntries(tableName, "Salary", &salary, &salary) != 1
+        || countEntries(tableName, "Salary", &nullSalary, &nullSalary) != 0)
+    {
+        cout << "**** [FAIL] RM Test Case 22 failed: wrong tuples or index entries after a load *****" << endl << endl;
+        return -1;
+    }
+
+    // A second load goes in with the entries already in the indexes
+    options = RM_LoadOptions();
+    rc = rm->bulkLoad(tableName, "../data/employee_5", options, stats);
+    assert(rc == success && "RelationManager::bulkLoad() should not fail.");
+    age = 45;
+    if (stats.rows != 5 || countEntries(tableName, "Age", NULL, NULL) != numTuples + 5
+        || countEntries(tableName, "Age", &age, &age) != (numTuples - age + 89) / 90 + 1
+        || countEntries(tableName, "Salary", NULL, NULL) != salaries + 5)
+    {
+        cout << "**** [FAIL] RM Test Case 22 failed: wrong index entries after a second load *****" << endl << endl;
+        return -1;
+    }
+
+    // An empty name is an empty string, \N a NULL salary
+    csv = fopen(csvPath.c_str(), "w");
+    fprintf(csv, ",7777,1.5,\\N\n");
+    fclose(csv);
+    rc = rm->bulkLoad(tableName, csvPath, options, stats);
+    assert(rc == success && "RelationManager::bulkLoad() should not fail.");
+    age = 7777;
+    RM_IndexScanIterator rmisi;
+    rc = rm->indexScan(tableName, "Age", &age, &age, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    RID rid;
+    char data[200];
+    rc = rmisi.getNextEntry(rid, data);
+    rmisi.close();
+    if (rc == success)
+        rc = rm->readAttribute(tableName, rid, "EmpName", data);
+    if (rc != success || data[0] != 0 || *(int*)(data + 1) != 0
+        || countEntries(tableName, "Salary", NULL, NULL) != salaries + 5)
+    {
+        cout << "**** [FAIL] RM Test Case 22 failed: an empty name or a \\N salary loaded wrong *****" << endl << endl;
+        return -1;
+    }
+
+    // Rows with too many or too few fields, a name too long, or a number that is not one. The good row
+    // before each is loaded.
+    const char *bad[] = {"Emp,1,1.5,1,1\n", "Emp,1,1.5\n", "Emp,x1,1.5,1\n", "Emp,1,1.5e,1\n",
+        "Emp0123456789012345678901234567890,1,1.5,1\n"};
+    for (const char *row : bad)
+    {
+        csv = fopen(csvPath.c_str(), "w");
+        fprintf(csv, "Emp,1,1.5,1\n%s", row);
+        fclose(csv);
+        rc = rm->bulkLoad(tableName, csvPath, options, stats);
+        if (rc != RM_LOAD_BAD_ROW || stats.rows != 1)
+        {
+            cout << "**** [FAIL] RM Test Case 22 failed: loaded a bad row " << row << " *****" << endl << endl;
+            return -1;
+        }
+    }
+    rc = rm->bulkLoad(tableName, "no_such_file.csv", options, stats);
+    assert(rc == RM_LOAD_OPEN_FAILED && "a missing file should not load.");
+
+    // A bad row after many chunks of good ones keeps the rows written before it, in the indexes too
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = createTable(tableName);
+    assert(rc == success && "Creating a table should not fail.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    csv = fopen(csvPath.c_str(), "w");
+    for (int i = 0; i < 20000; i++)
+        fprintf(csv, "Emp%06d,%d,%.1f,%d\n", i, i % 90, 150.5 + i % 40, 1000 + i);
+    fprintf(csv, "Emp,x1,1.5,1\n");
+    fclose(csv);
+    options.threads = 4;
+    options.chunkSize = 4096;
+    rc = rm->bulkLoad(tableName, csvPath, options, stats);
+    int written = readLines(tableName).size();
+    cout << "Rows kept by a load stopped by a bad row: " << stats.rows << endl;
+    if (rc != RM_LOAD_BAD_ROW || stats.rows != 20000 || stats.rows != (uint64_t) written
+        || countEntries(tableName, "Age", NULL, NULL) != written)
+    {
+        cout << "**** [FAIL] RM Test Case 22 failed: a stopped load left the table and its index out of step *****" << endl << endl;
+        return -1;
+    }
+
+    remove(csvPath.c_str());
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    cout << "**** RM Test Case 22 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Tables loaded from comma separated files
+    RC rcmain = TEST_RM_22("tbl_c_employee11");
+    return rcmain;
+}
@@ -0,0 +1,135 @@
+#include "rm_test_util.h"
+
+// Table id of the table in the catalog, or -1 if it is not there
+int32_t readTableID(const string &tableName)
+{
+    char name[PAGE_SIZE];
+    int32_t length = tableName.length();
+    memcpy(name, &length, VARCHAR_LENGTH_SIZE);
+    memcpy(name + VARCHAR_LENGTH_SIZE, tableName.c_str(), length);
+    vector<string> attributes;
+    attributes.push_back("table-id");
+    RM_ScanIterator rmsi;
+    RC rc = rm->scan("Tables", "table-name", EQ_OP, name, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    RID rid;
+    char data[PAGE_SIZE];
+    int32_t tableID = -1;
+    if (rmsi.getNextTuple(rid, data) != RM_EOF)
+        memcpy(&tableID, data + 1, INT_SIZE);
+    rmsi.close();
+    return tableID;
+}
+
+// Largest key of the Tables(table-id) index
+int32_t maxTableID()
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan("Tables", "table-id", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    RID rid;
+    int32_t key;
+    int32_t maxKey = -1;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF)
+        maxKey = key;
+    rmisi.close();
+    return maxKey;
+}
+
+// Reads every column of the catalog, the way a lookup without indexes would
+void scanColumns()
+{
+    vector<string> attributes;
+    attributes.push_back("column-name");
+    RM_ScanIterator rmsi;
+    RC rc = rm->scan("Columns", "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    RID rid;
+    char data[PAGE_SIZE];
+    while (rmsi.getNextTuple(rid, data) != RM_EOF);
+    rmsi.close();
+}
+
+RC TEST_RM_23(const string &tableName, const int numTables)
+{
+    // Functions tested
+    // 1. Create Table and Delete Table with a thousand tables in the catalog **
+    // 2. Get Attributes through the catalog indexes, with no table entry cached **
+    // 3. Table ids handed out past the largest one in the catalog **
+    // 4. Destroy Index refused on the catalog **
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    cout << endl << "***** In RM Test Case 23 *****" << endl;
+
+    // The first table is made the usual way, the others quietly with its attributes
+    vector<string> names;
+    vector<Attribute> attrs;
+    for (int i = 0; i < numTables; i++)
+    {
+        names.push_back(tableName + "_" + to_string(i));
+        rm->deleteTable(names[i]);
+        RC rc = i == 0 ? createTable(names[i]) : rm->createTable(names[i], attrs);
+        assert(rc == success && "Creating a table should not fail.");
+        if (i == 0)
+            rm->getAttributes(names[i], attrs);
+    }
+
+    // The catalog indexes find a table among the others without reading the whole catalog
+    rm->closeCachedFiles();
+    pagesTouched();
+    scanColumns();
+    unsigned scanPages = pagesTouched();
+    RC rc = rm->getAttributes(names[numTables / 2], attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    unsigned lookupPages = pagesTouched();
+    cout << "Pages touched by Get Attributes: " << lookupPages << ", by a scan of the columns: " << scanPages << endl;
+    if (attrs.size() != 4 || attrs[0].name != "EmpName" || lookupPages * 4 > scanPages)
+    {
+        cout << "**** [FAIL] RM Test Case 23 failed: Get Attributes should not scan the catalog *****" << endl << endl;
+        return -1;
+    }
+
+    // Ids of deleted tables in the middle are not handed out again, and the next id follows the largest.
+    // Neither call reads as much as a scan of the columns would.
+    int32_t maxKey = maxTableID();
+    pagesTouched();
+    rc = rm->deleteTable(names[numTables / 2]);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    unsigned deletePages = pagesTouched();
+    assert(readTableID(names[numTables / 2]) == -1 && "a deleted table should leave the catalog.");
+    pagesTouched();
+    rc = rm->createTable(names[numTables / 2], attrs);
+    assert(rc == success && "Creating a table should not fail.");
+    unsigned createPages = pagesTouched();
+    cout << "Pages touched by Delete Table: " << deletePages << ", by Create Table: " << createPages << endl;
+    if (readTableID(names[numTables / 2]) != maxKey + 1 || maxTableID() != maxKey + 1
+        || deletePages > scanPages || createPages > scanPages)
+    {
+        cout << "**** [FAIL] RM Test Case 23 failed: a new table should take the next id *****" << endl << endl;
+        return -1;
+    }
+
+    // The catalog keeps its indexes
+    rc = rm->destroyIndex("Tables", "table-name");
+    assert(rc != success && "the catalog indexes should not be destroyed.");
+
+    for (int i = 0; i < numTables; i++)
+    {
+        rc = rm->deleteTable(names[i]);
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+    rc = rm->getAttributes(names[0], attrs);
+    assert(rc != success && "a deleted table should have no attributes.");
+
+    cout << "**** RM Test Case 23 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Catalog lookups through indexes on table names and ids
+    RC rcmain = TEST_RM_23("tbl_c_employee12", 1000);
+    return rcmain;
+}